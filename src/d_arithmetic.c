@@ -9,7 +9,46 @@ to reset the value.
 */
 
 #include "m_pd.h"
-#include <math.h> /* needed for log~ */
+
+    /* kernels for the "perf8" routines, chosen according to the CPU in
+    d_simd.c */
+extern void (*simd_minus)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_times)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_over)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_max)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_min)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_scalarplus)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_scalarminus)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_reversescalarminus)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_scalartimes)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_reversescalarover)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_scalarmax)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_scalarmin)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_log)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_pow)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_scalarlog)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_reversescalarlog)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_scalarpow)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+extern void (*simd_reversescalarpow)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+void simd_setup(void);
 
 /* -------------- convenience routines for multichannel binops ----- */
 
@@ -153,18 +192,8 @@ t_int *scalarplus_perform(t_int *w)
 
 t_int *scalarplus_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = f0 + g; out[1] = f1 + g; out[2] = f2 + g; out[3] = f3 + g;
-        out[4] = f4 + g; out[5] = f5 + g; out[6] = f6 + g; out[7] = f7 + g;
-    }
+    (*simd_scalarplus)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -247,21 +276,8 @@ t_int *minus_perform(t_int *w)
 
 t_int *minus_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in1 += 8, in2 += 8, out += 8)
-    {
-        t_sample f0 = in1[0], f1 = in1[1], f2 = in1[2], f3 = in1[3];
-        t_sample f4 = in1[4], f5 = in1[5], f6 = in1[6], f7 = in1[7];
-
-        t_sample g0 = in2[0], g1 = in2[1], g2 = in2[2], g3 = in2[3];
-        t_sample g4 = in2[4], g5 = in2[5], g6 = in2[6], g7 = in2[7];
-
-        out[0] = f0 - g0; out[1] = f1 - g1; out[2] = f2 - g2; out[3] = f3 - g3;
-        out[4] = f4 - g4; out[5] = f5 - g5; out[6] = f6 - g6; out[7] = f7 - g7;
-    }
+    (*simd_minus)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -277,18 +293,8 @@ t_int *scalarminus_perform(t_int *w)
 
 t_int *scalarminus_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = f0 - g; out[1] = f1 - g; out[2] = f2 - g; out[3] = f3 - g;
-        out[4] = f4 - g; out[5] = f5 - g; out[6] = f6 - g; out[7] = f7 - g;
-    }
+    (*simd_scalarminus)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -304,18 +310,8 @@ t_int *reversescalarminus_perform(t_int *w)
 
 t_int *reversescalarminus_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = g - f0; out[1] = g - f1; out[2] = g - f2; out[3] = g - f3;
-        out[4] = g - f4; out[5] = g - f5; out[6] = g - f6; out[7] = g - f7;
-    }
+    (*simd_reversescalarminus)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -399,21 +395,8 @@ t_int *times_perform(t_int *w)
 
 t_int *times_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in1 += 8, in2 += 8, out += 8)
-    {
-        t_sample f0 = in1[0], f1 = in1[1], f2 = in1[2], f3 = in1[3];
-        t_sample f4 = in1[4], f5 = in1[5], f6 = in1[6], f7 = in1[7];
-
-        t_sample g0 = in2[0], g1 = in2[1], g2 = in2[2], g3 = in2[3];
-        t_sample g4 = in2[4], g5 = in2[5], g6 = in2[6], g7 = in2[7];
-
-        out[0] = f0 * g0; out[1] = f1 * g1; out[2] = f2 * g2; out[3] = f3 * g3;
-        out[4] = f4 * g4; out[5] = f5 * g5; out[6] = f6 * g6; out[7] = f7 * g7;
-    }
+    (*simd_times)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -429,18 +412,8 @@ t_int *scalartimes_perform(t_int *w)
 
 t_int *scalartimes_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = f0 * g; out[1] = f1 * g; out[2] = f2 * g; out[3] = f3 * g;
-        out[4] = f4 * g; out[5] = f5 * g; out[6] = f6 * g; out[7] = f7 * g;
-    }
+    (*simd_scalartimes)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -527,27 +500,8 @@ t_int *over_perform(t_int *w)
 
 t_int *over_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in1 += 8, in2 += 8, out += 8)
-    {
-        t_sample f0 = in1[0], f1 = in1[1], f2 = in1[2], f3 = in1[3];
-        t_sample f4 = in1[4], f5 = in1[5], f6 = in1[6], f7 = in1[7];
-
-        t_sample g0 = in2[0], g1 = in2[1], g2 = in2[2], g3 = in2[3];
-        t_sample g4 = in2[4], g5 = in2[5], g6 = in2[6], g7 = in2[7];
-
-        out[0] = (g0? f0 / g0 : 0);
-        out[1] = (g1? f1 / g1 : 0);
-        out[2] = (g2? f2 / g2 : 0);
-        out[3] = (g3? f3 / g3 : 0);
-        out[4] = (g4? f4 / g4 : 0);
-        out[5] = (g5? f5 / g5 : 0);
-        out[6] = (g6? f6 / g6 : 0);
-        out[7] = (g7? f7 / g7 : 0);
-    }
+    (*simd_over)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -564,19 +518,9 @@ t_int *scalarover_perform(t_int *w)
 
 t_int *scalarover_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
     t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
     if (g) g = 1.f / g;
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = f0 * g; out[1] = f1 * g; out[2] = f2 * g; out[3] = f3 * g;
-        out[4] = f4 * g; out[5] = f5 * g; out[6] = f6 * g; out[7] = f7 * g;
-    }
+    (*simd_scalartimes)((t_sample *)(w[1]), g, (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -596,20 +540,8 @@ t_int *reversescalarover_perform(t_int *w)
 
 t_int *reversescalarover_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = (f0 != 0 ? g/f0 : 0); out[1] = (f1 != 0 ? g/f1 : 0);
-        out[2] = (f2 != 0 ? g/f2 : 0); out[3] = (f3 != 0 ? g/f3 : 0);
-        out[4] = (f4 != 0 ? g/f4 : 0); out[5] = (f5 != 0 ? g/f5 : 0);
-        out[6] = (f6 != 0 ? g/f6 : 0); out[7] = (f7 != 0 ? g/f7 : 0);
-    }
+    (*simd_reversescalarover)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -697,23 +629,8 @@ t_int *max_perform(t_int *w)
 
 t_int *max_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in1 += 8, in2 += 8, out += 8)
-    {
-        t_sample f0 = in1[0], f1 = in1[1], f2 = in1[2], f3 = in1[3];
-        t_sample f4 = in1[4], f5 = in1[5], f6 = in1[6], f7 = in1[7];
-
-        t_sample g0 = in2[0], g1 = in2[1], g2 = in2[2], g3 = in2[3];
-        t_sample g4 = in2[4], g5 = in2[5], g6 = in2[6], g7 = in2[7];
-
-        out[0] = (f0 > g0 ? f0 : g0); out[1] = (f1 > g1 ? f1 : g1);
-        out[2] = (f2 > g2 ? f2 : g2); out[3] = (f3 > g3 ? f3 : g3);
-        out[4] = (f4 > g4 ? f4 : g4); out[5] = (f5 > g5 ? f5 : g5);
-        out[6] = (f6 > g6 ? f6 : g6); out[7] = (f7 > g7 ? f7 : g7);
-    }
+    (*simd_max)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -733,20 +650,8 @@ t_int *scalarmax_perform(t_int *w)
 
 t_int *scalarmax_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = (f0 > g ? f0 : g); out[1] = (f1 > g ? f1 : g);
-        out[2] = (f2 > g ? f2 : g); out[3] = (f3 > g ? f3 : g);
-        out[4] = (f4 > g ? f4 : g); out[5] = (f5 > g ? f5 : g);
-        out[6] = (f6 > g ? f6 : g); out[7] = (f7 > g ? f7 : g);
-    }
+    (*simd_scalarmax)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -833,23 +738,8 @@ t_int *min_perform(t_int *w)
 
 t_int *min_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in1 += 8, in2 += 8, out += 8)
-    {
-        t_sample f0 = in1[0], f1 = in1[1], f2 = in1[2], f3 = in1[3];
-        t_sample f4 = in1[4], f5 = in1[5], f6 = in1[6], f7 = in1[7];
-
-        t_sample g0 = in2[0], g1 = in2[1], g2 = in2[2], g3 = in2[3];
-        t_sample g4 = in2[4], g5 = in2[5], g6 = in2[6], g7 = in2[7];
-
-        out[0] = (f0 < g0 ? f0 : g0); out[1] = (f1 < g1 ? f1 : g1);
-        out[2] = (f2 < g2 ? f2 : g2); out[3] = (f3 < g3 ? f3 : g3);
-        out[4] = (f4 < g4 ? f4 : g4); out[5] = (f5 < g5 ? f5 : g5);
-        out[6] = (f6 < g6 ? f6 : g6); out[7] = (f7 < g7 ? f7 : g7);
-    }
+    (*simd_min)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -869,20 +759,8 @@ t_int *scalarmin_perform(t_int *w)
 
 t_int *scalarmin_perf8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_float g = *(t_float *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-
-        out[0] = (f0 < g ? f0 : g); out[1] = (f1 < g ? f1 : g);
-        out[2] = (f2 < g ? f2 : g); out[3] = (f3 < g ? f3 : g);
-        out[4] = (f4 < g ? f4 : g); out[5] = (f5 < g ? f5 : g);
-        out[6] = (f6 < g ? f6 : g); out[7] = (f7 < g ? f7 : g);
-    }
+    (*simd_scalarmin)((t_sample *)(w[1]), *(t_float *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -956,58 +834,23 @@ static void *log_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
 t_int *log_tilde_perform(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    while (n--)
-    {
-        t_sample f = *in1++, g = *in2++;
-        if (f <= 0)
-            *out = -1000;   /* rather than blow up, output a number << 0 */
-        else if (g == 1 || g <= 0)
-            *out = log(f);
-        else *out = log(f)/log(g);
-        out++;
-    }
+    (*simd_log)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
 t_int *log_tilde_perform_scalar(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample base = *(t_sample *)(w[2]),
-        multiplier = ((base > 0 && base != 1) ? 1./log(base) : 1);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    while (n--)
-    {
-        t_sample f = *in1++;
-        if (f <= 0)
-            *out = -1000;   /* rather than blow up, output a number << 0 */
-        else *out = log(f) * multiplier;
-        out++;
-    }
+    (*simd_scalarlog)((t_sample *)(w[1]), *(t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
     /* nobody sane will ever ask for log(scalar) to a signal base but ok... */
 t_int *log_tilde_perform_reversescalar(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample scalarin = *(t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    while (n--)
-    {
-        t_sample base = *in1++;
-        if (base <= 1)
-            *out = -1000;   /* rather than blow up, output a number << 0 */
-        else if (scalarin <- 0)
-            *out = -1000;
-        else *out = log(scalarin) / log(base);
-        out++;
-    }
+    (*simd_reversescalarlog)((t_sample *)(w[1]), *(t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -1082,49 +925,22 @@ static void *pow_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
 t_int *pow_tilde_perform(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    while (n--)
-    {
-        t_sample f = *in1++, g = *in2++;
-        *out++ = (f == 0 && g < 0) ||
-            (f < 0 && (g - (int)g) != 0) ?
-                0 : pow(f, g);
-    }
+    (*simd_pow)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
 t_int *pow_tilde_perform_scalar(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample g = *(t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    while (n--)
-    {
-        t_sample f = *in1++;
-        *out++ = (f == 0 && g < 0) ||
-            (f < 0 && (g - (int)g) != 0) ?
-                0 : pow(f, g);
-    }
+    (*simd_scalarpow)((t_sample *)(w[1]), *(t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
 t_int *pow_tilde_perform_reversescalar(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample f = *(t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    while (n--)
-    {
-        t_sample g = *in1++;
-        *out++ = (f == 0 && g < 0) ||
-            (f < 0 && (g - (int)g) != 0) ?
-                0 : pow(f, g);
-    }
+    (*simd_reversescalarpow)((t_sample *)(w[1]), *(t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -1161,6 +977,7 @@ static void pow_tilde_setup(void)
 /* ----------------------- global setup routine ---------------- */
 void d_arithmetic_setup(void)
 {
+    simd_setup();
     plus_setup();
     minus_setup();
     times_setup();
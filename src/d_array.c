@@ -7,6 +7,9 @@
 
 #include "m_pd.h"
 #include "g_canvas.h"
+#include "d_soundfile.h"
+
+void class_setdspshared(t_class *c);   /* in m_class.c */
 
 #define MAX_PHASE 0x7fffffff
 
@@ -17,12 +20,15 @@ typedef struct _dsparray
     t_gpointer d_gp;
     int d_phase;    /* used for tabwrite~ and tabplay~ */
     void *d_owner;  /* for pd_error() */
+    t_sfmap *d_map; /* mapped soundfile if there's no array (see below) */
+    int d_mapvalid; /* value of sfmap_valid when we looked for d_map */
 } t_dsparray;
 
 typedef struct _arrayvec
 {
     int v_n;
     t_dsparray *v_vec;
+    t_canvas *v_canvas; /* the canvas we're in, for local DSP updates */
 } t_arrayvec;
 
     /* LATER consider exporting this and using it for tabosc4~ too */
@@ -43,8 +49,10 @@ static int dsparray_get_array(t_dsparray *d, int *npoints, t_word **vec,
     {
         if (!(a = (t_garray *)pd_findbyclass(d->d_symbol, garray_class)))
         {
-            if (d->d_owner && *d->d_symbol->s_name)
-                pd_error(d->d_owner, "%s: no such array", d->d_symbol->s_name);
+            if (d->d_owner && *d->d_symbol->s_name &&
+                !sfmap_find(d->d_symbol))
+                    pd_error(d->d_owner, "%s: no such array",
+                        d->d_symbol->s_name);
             gpointer_unset(&d->d_gp);
             return 0;
         }
@@ -64,6 +72,23 @@ static int dsparray_get_array(t_dsparray *d, int *npoints, t_word **vec,
     return 0;
 }
 
+    /* tabread~, tabread4~ and tabplay~ can also read from soundfiles mapped
+    into memory with "soundfiler read -map" (see d_soundfile.c).  They
+    call this when dsparray_get_array() comes up empty.  We only look the
+    name up again if a mapped soundfile has come or gone since last time. */
+static t_sfmap *dsparray_get_map(t_dsparray *d, int *npoints)
+{
+    if (d->d_mapvalid != sfmap_valid)
+    {
+        d->d_map = (*d->d_symbol->s_name ? sfmap_find(d->d_symbol) : 0);
+        d->d_mapvalid = sfmap_valid;
+    }
+    if (!d->d_map || d->d_map->m_n < 1)
+        return (0);
+    *npoints = d->d_map->m_n;
+    return (d->d_map);
+}
+
 static void arrayvec_testvec(t_arrayvec *v)
 {
     int i, vecsize;
@@ -89,6 +114,7 @@ static void arrayvec_set(t_arrayvec *v, int argc, t_atom *argv)
         {
             gpointer_unset(&v->v_vec[i].d_gp);
             v->v_vec[i].d_symbol = &s_;
+            v->v_vec[i].d_mapvalid = sfmap_valid - 1;
         }
         return;
     }
@@ -121,6 +147,7 @@ static void arrayvec_set(t_arrayvec *v, int argc, t_atom *argv)
             v->v_vec[i].d_phase = MAX_PHASE;
             v->v_vec[i].d_symbol = argv[i].a_w.w_symbol;
         }
+        v->v_vec[i].d_mapvalid = sfmap_valid - 1;
     }
     if (pd_getdspstate())
         arrayvec_testvec(v);
@@ -140,6 +167,7 @@ static void arrayvec_init(t_arrayvec *v, void *x, int rawargc, t_atom *rawargv)
 
     v->v_vec = (t_dsparray *)getbytes(argc * sizeof(*v->v_vec));
     v->v_n = argc;
+    v->v_canvas = canvas_getcurrent();
     for (i = 0; i < v->v_n; i++)
     {
         v->v_vec[i].d_owner = x;
@@ -226,7 +254,7 @@ static void tabwrite_tilde_set(t_tabwrite_tilde *x, t_symbol *s,
     int nchans = x->x_v.v_n;
     arrayvec_set(&x->x_v, argc, argv);
     if (x->x_v.v_n != nchans) /* channels have changed! */
-        canvas_update_dsp();
+        canvas_update_dsp_local(x->x_v.v_canvas);
 }
 
 static void tabwrite_tilde_dsp(t_tabwrite_tilde *x, t_signal **sp)
@@ -272,6 +300,7 @@ static void tabwrite_tilde_setup(void)
     tabwrite_tilde_class = class_new(gensym("tabwrite~"),
         (t_newmethod)tabwrite_tilde_new, (t_method)tabwrite_tilde_free,
         sizeof(t_tabwrite_tilde), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(tabwrite_tilde_class);
     CLASS_MAINSIGNALIN(tabwrite_tilde_class, t_tabwrite_tilde, x_f);
     class_addmethod(tabwrite_tilde_class, (t_method)tabwrite_tilde_dsp,
         gensym("dsp"), A_CANT, 0);
@@ -316,21 +345,31 @@ static t_int *tabplay_tilde_perform(t_int *w)
     t_dsparray *d = (t_dsparray *)(w[2]);
     t_sample *out = (t_sample *)(w[3]);
     int n = (int)(w[4]), phase = d->d_phase, endphase, nxfer, n3;
-    t_word *buf, *wp;
+    t_word *buf = 0, *wp;
+    t_sfmap *map = 0;
 
-    if (!dsparray_get_array(d, &endphase, &buf, 0) || phase >= endphase)
-        goto zero;
+    if ((!dsparray_get_array(d, &endphase, &buf, 0) &&
+        !(map = dsparray_get_map(d, &endphase))) || phase >= endphase)
+            goto zero;
 
     if (endphase > x->x_limit)
         endphase = x->x_limit;
     nxfer = endphase - phase;
-    wp = buf + phase;
     if (nxfer > n)
         nxfer = n;
     n3 = n - nxfer;
-    phase += nxfer;
-    while (nxfer--)
-        *out++ = (wp++)->w_float;
+    if (map)
+    {
+        while (nxfer--)
+            *out++ = sfmap_get(map, phase++);
+    }
+    else
+    {
+        wp = buf + phase;
+        phase += nxfer;
+        while (nxfer--)
+            *out++ = (wp++)->w_float;
+    }
     if (phase >= endphase)
     {
         int i, playing = 0;
@@ -358,7 +397,7 @@ static void tabplay_tilde_set(t_tabplay_tilde *x, t_symbol *s,
     int nchans = x->x_v.v_n;
     arrayvec_set(&x->x_v, argc, argv);
     if (x->x_v.v_n != nchans) /* update number of output channels! */
-        canvas_update_dsp();
+        canvas_update_dsp_local(x->x_v.v_canvas);
 }
 
 static void tabplay_tilde_dsp(t_tabplay_tilde *x, t_signal **sp)
@@ -409,6 +448,7 @@ static void tabplay_tilde_setup(void)
     tabplay_tilde_class = class_new(gensym("tabplay~"),
         (t_newmethod)tabplay_tilde_new, (t_method)tabplay_tilde_free,
         sizeof(t_tabplay_tilde), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(tabplay_tilde_class);
     class_addmethod(tabplay_tilde_class, (t_method)tabplay_tilde_dsp,
         gensym("dsp"), A_CANT, 0);
     class_addmethod(tabplay_tilde_class, (t_method)tabplay_tilde_stop,
@@ -445,10 +485,24 @@ static t_int *tabread_tilde_perform(t_int *w)
     t_sample *out = (t_sample *)(w[3]);
     int n = (int)(w[4]), i, maxindex;
     t_word *buf;
+    t_sfmap *map;
 
     if (!dsparray_get_array(d, &maxindex, &buf, 0))
     {
-        while (n--) *out++ = 0;
+        if ((map = dsparray_get_map(d, &maxindex)))
+        {
+            maxindex -= 1;
+            for (i = 0; i < n; i++)
+            {
+                int index = *in++;
+                if (index < 0)
+                    index = 0;
+                else if (index > maxindex)
+                    index = maxindex;
+                *out++ = sfmap_get(map, index);
+            }
+        }
+        else while (n--) *out++ = 0;
         return (w+5);
     }
 
@@ -472,7 +526,7 @@ static void tabread_tilde_set(t_tabread_tilde *x, t_symbol *s,
     int nchans = x->x_v.v_n;
     arrayvec_set(&x->x_v, argc, argv);
     if (x->x_v.v_n != nchans) /* update number of output channels! */
-        canvas_update_dsp();
+        canvas_update_dsp_local(x->x_v.v_canvas);
 }
 
 static void tabread_tilde_dsp(t_tabread_tilde *x, t_signal **sp)
@@ -499,6 +553,7 @@ static void tabread_tilde_setup(void)
     tabread_tilde_class = class_new(gensym("tabread~"),
         (t_newmethod)tabread_tilde_new, (t_method)tabread_tilde_free,
         sizeof(t_tabread_tilde), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(tabread_tilde_class);
     CLASS_MAINSIGNALIN(tabread_tilde_class, t_tabread_tilde, x_f);
     class_addmethod(tabread_tilde_class, (t_method)tabread_tilde_dsp,
         gensym("dsp"), A_CANT, 0);
@@ -527,6 +582,44 @@ static void *tabread4_tilde_new(t_symbol *s, int argc, t_atom *argv)
     return (x);
 }
 
+    /* same as below, reading from a mapped soundfile */
+static t_int *tabread4_tilde_performmap(t_sfmap *map, int maxindex,
+    t_sample *in, t_sample *onset, t_sample *out, int n, t_int *w)
+{
+    int i;
+    const t_sample one_over_six = 1./6.;
+    maxindex -= 3;
+    if (maxindex < 1)
+    {
+        while (n--)
+            *out++ = 0;
+        return (w+6);
+    }
+    for (i = 0; i < n; i++)
+    {
+        double findex = (double)*in++ + (double)*onset++;
+        int index = findex;
+        t_sample frac,  a,  b,  c,  d, cminusb;
+        if (index < 1)
+            index = 1, frac = 0;
+        else if (index > maxindex)
+            index = maxindex, frac = 1;
+        else frac = findex - index;
+        a = sfmap_get(map, index - 1);
+        b = sfmap_get(map, index);
+        c = sfmap_get(map, index + 1);
+        d = sfmap_get(map, index + 2);
+        cminusb = c-b;
+        *out++ = b + frac * (
+            cminusb - one_over_six * ((t_sample)1.-frac) * (
+                (d - a - (t_sample)3.0 * cminusb) * frac +
+                (d + a*(t_sample)2.0 - b*(t_sample)3.0)
+            )
+        );
+    }
+    return (w+6);
+}
+
 static t_int *tabread4_tilde_perform(t_int *w)
 {
     t_dsparray *d = (t_dsparray *)(w[1]);
@@ -536,10 +629,16 @@ static t_int *tabread4_tilde_perform(t_int *w)
     int n = (int)(w[5]);
     int maxindex, i;
     t_word *buf, *wp;
+    t_sfmap *map;
     const t_sample one_over_six = 1./6.;
 
     if (!dsparray_get_array(d, &maxindex, &buf, 0))
+    {
+        if ((map = dsparray_get_map(d, &maxindex)))
+            return (tabread4_tilde_performmap(map, maxindex, in, onset,
+                out, n, w));
         goto zero;
+    }
 
     maxindex -= 3;
     if (maxindex < 1)
@@ -582,7 +681,7 @@ static void tabread4_tilde_set(t_tabread4_tilde *x, t_symbol *s,
     int nchans = x->x_v.v_n;
     arrayvec_set(&x->x_v, argc, argv);
     if (x->x_v.v_n != nchans) /* update number of output channels! */
-        canvas_update_dsp();
+        canvas_update_dsp_local(x->x_v.v_canvas);
 }
 
 static void tabread4_tilde_dsp(t_tabread4_tilde *x, t_signal **sp)
@@ -612,6 +711,7 @@ static void tabread4_tilde_setup(void)
     tabread4_tilde_class = class_new(gensym("tabread4~"),
         (t_newmethod)tabread4_tilde_new, (t_method)tabread4_tilde_free,
         sizeof(t_tabread4_tilde), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(tabread4_tilde_class);
     CLASS_MAINSIGNALIN(tabread4_tilde_class, t_tabread4_tilde, x_f);
     class_addmethod(tabread4_tilde_class, (t_method)tabread4_tilde_dsp,
         gensym("dsp"), A_CANT, 0);
@@ -678,7 +778,7 @@ static void tabsend_set(t_tabsend *x, t_symbol *s, int argc, t_atom *argv)
     int nchans = x->x_v.v_n;
     arrayvec_set(&x->x_v, argc, argv);
     if (x->x_v.v_n != nchans) /* channels have changed! */
-        canvas_update_dsp();
+        canvas_update_dsp_local(x->x_v.v_canvas);
 }
 
 static void tabsend_dsp(t_tabsend *x, t_signal **sp)
@@ -705,6 +805,7 @@ static void tabsend_setup(void)
     tabsend_class = class_new(gensym("tabsend~"),
         (t_newmethod)tabsend_new, (t_method)tabsend_free,
         sizeof(t_tabsend), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(tabsend_class);
     CLASS_MAINSIGNALIN(tabsend_class, t_tabsend, x_f);
     class_addmethod(tabsend_class, (t_method)tabsend_dsp,
         gensym("dsp"), A_CANT, 0);
@@ -761,7 +862,7 @@ static void tabreceive_set(t_tabreceive *x, t_symbol *s,
     int nchans = x->x_v.v_n;
     arrayvec_set(&x->x_v, argc, argv);
     if (x->x_v.v_n != nchans) /* update number of output channels! */
-        canvas_update_dsp();
+        canvas_update_dsp_local(x->x_v.v_canvas);
 }
 
 static void tabreceive_dsp(t_tabreceive *x, t_signal **sp)
@@ -784,6 +885,7 @@ static void tabreceive_setup(void)
     tabreceive_class = class_new(gensym("tabreceive~"),
         (t_newmethod)tabreceive_new, (t_method)tabreceive_free,
         sizeof(t_tabreceive), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(tabreceive_class);
     class_addmethod(tabreceive_class, (t_method)tabreceive_dsp,
         gensym("dsp"), A_CANT, 0);
     class_addmethod(tabreceive_class, (t_method)tabreceive_set,
@@ -9,6 +9,8 @@
 #include "m_pd.h"
 #include "math.h"
 
+void class_setdspshared(t_class *c);   /* in m_class.c */
+
 /* -------------------------- sig~ ------------------------------ */
 static t_class *sig_tilde_class;
 
@@ -743,6 +745,7 @@ void env_tilde_setup(void)
 {
     env_tilde_class = class_new(gensym("env~"), (t_newmethod)env_tilde_new,
         (t_method)env_tilde_ff, sizeof(t_sigenv), 0, A_DEFFLOAT, A_DEFFLOAT, 0);
+    class_setdspshared(env_tilde_class);
     CLASS_MAINSIGNALIN(env_tilde_class, t_sigenv, x_f);
     class_addmethod(env_tilde_class, (t_method)env_tilde_dsp,
         gensym("dsp"), A_CANT, 0);
@@ -874,6 +877,7 @@ static void threshold_tilde_setup(void)
         (t_newmethod)threshold_tilde_new, (t_method)threshold_tilde_ff,
         sizeof(t_threshold_tilde), 0,
             A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, A_DEFFLOAT, 0);
+    class_setdspshared(threshold_tilde_class);
     CLASS_MAINSIGNALIN(threshold_tilde_class, t_threshold_tilde, x_f);
     class_addmethod(threshold_tilde_class, (t_method)threshold_tilde_set,
         gensym("set"), A_FLOAT, A_FLOAT, A_FLOAT, A_FLOAT, 0);
@@ -9,6 +9,9 @@
 #include "s_stuff.h"
 #include <string.h>
 
+void class_setdspshared(t_class *c);   /* in m_class.c */
+void canvas_update_dsp_local(t_glist *x);   /* in g_canvas.c */
+
 /* ----------------------------- dac~ --------------------------- */
 static t_class *dac_class;
 
@@ -18,6 +21,7 @@ typedef struct _dac
     t_int x_n;
     t_int *x_vec;
     t_float x_f;
+    t_glist *x_canvas;
 } t_dac;
 
 static void *dac_new(t_symbol *s, int argc, t_atom *argv)
@@ -39,6 +43,7 @@ static void *dac_new(t_symbol *s, int argc, t_atom *argv)
     for (i = 1; i < argc; i++)
         inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_signal, &s_signal);
     x->x_f = 0;
+    x->x_canvas = canvas_getcurrent();
     return (x);
 }
 
@@ -69,7 +74,7 @@ static void dac_set(t_dac *x, t_symbol *s, int argc, t_atom *argv)
     int i;
     for (i = 0; i < argc && i < x->x_n; i++)
         x->x_vec[i] = atom_getfloatarg(i, argc, argv);
-    canvas_update_dsp();
+    canvas_update_dsp_local(x->x_canvas);
 }
 
 static void dac_free(t_dac *x)
@@ -81,6 +86,7 @@ static void dac_setup(void)
 {
     dac_class = class_new(gensym("dac~"), (t_newmethod)dac_new,
         (t_method)dac_free, sizeof(t_dac), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(dac_class);
     CLASS_MAINSIGNALIN(dac_class, t_dac, x_f);
     class_addmethod(dac_class, (t_method)dac_dsp, gensym("dsp"), A_CANT, 0);
     class_addmethod(dac_class, (t_method)dac_set, gensym("set"), A_GIMME, 0);
@@ -96,6 +102,7 @@ typedef struct _adc
     int x_n;
     int *x_vec;
     int x_multi;
+    t_glist *x_canvas;
 } t_adc;
 
 static void *adc_new(t_symbol *s, int argc, t_atom *argv)
@@ -133,6 +140,7 @@ static void *adc_new(t_symbol *s, int argc, t_atom *argv)
         for (i = 0; i < x->x_n; i++)
             outlet_new(&x->x_obj, &s_signal);
     }
+    x->x_canvas = canvas_getcurrent();
     return (x);
 }
 
@@ -180,7 +188,7 @@ static void adc_set(t_adc *x, t_symbol *s, int argc, t_atom *argv)
     }
     else for (i = 0; i < argc && i < x->x_n; i++)
         x->x_vec[i] = atom_getfloatarg(i, argc, argv);
-    canvas_update_dsp();
+    canvas_update_dsp_local(x->x_canvas);
 }
 
 static void adc_free(t_adc *x)
@@ -192,6 +200,7 @@ static void adc_setup(void)
 {
     adc_class = class_new(gensym("adc~"), (t_newmethod)adc_new,
         (t_method)adc_free, sizeof(t_adc), 0, A_GIMME, 0);
+    class_setdspshared(adc_class);
     class_addmethod(adc_class, (t_method)adc_dsp, gensym("dsp"), A_CANT, 0);
     class_addmethod(adc_class, (t_method)adc_set, gensym("set"), A_GIMME, 0);
     class_sethelpsymbol(adc_class, gensym("adc~_dac~"));
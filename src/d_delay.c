@@ -7,6 +7,9 @@
 #include "m_pd.h"
 #include <string.h>
 extern int ugen_getsortno(void);
+extern void class_setdspshared(t_class *c);
+extern void ugen_dsplink(void *key);
+extern void canvas_update_dsp_links(int nkeys, void **keys);
 
 /* ----------------------------- delwrite~ ----------------------------- */
 static t_class *sigdelwrite_class;
@@ -114,8 +117,9 @@ static void sigdelwrite_clear (t_sigdelwrite *x) /* added by Orm Finnendahl */
 
 static void sigdelwrite_channels(t_sigdelwrite *x, t_floatarg nchans)
 {
+    void *key = x->x_sym;
     x->x_nchans = nchans > 0 ? nchans : 1;
-    canvas_update_dsp();
+    canvas_update_dsp_links(1, &key);
 }
 
 static t_int *sigdelwrite_perform(t_int *w)
@@ -173,6 +177,7 @@ static t_int *sigdelwrite_perform(t_int *w)
 
 static void sigdelwrite_dsp(t_sigdelwrite *x, t_signal **sp)
 {
+    ugen_dsplink(x->x_sym);
     x->x_sortno = ugen_getsortno();
     sigdelwrite_check(x, sp[0]->s_length, sp[0]->s_sr);
     sigdelwrite_update(x);
@@ -195,6 +200,7 @@ static void sigdelwrite_setup(void)
         (t_newmethod)sigdelwrite_new, (t_method)sigdelwrite_free,
         sizeof(t_sigdelwrite), CLASS_MULTICHANNEL,
         A_DEFSYM, A_DEFFLOAT, A_DEFFLOAT, 0);
+    class_setdspshared(sigdelwrite_class);
     CLASS_MAINSIGNALIN(sigdelwrite_class, t_sigdelwrite, x_f);
     class_addmethod(sigdelwrite_class, (t_method)sigdelwrite_dsp,
         gensym("dsp"), A_CANT, 0);
@@ -274,6 +280,7 @@ static void sigdelread_dsp(t_sigdelread *x, t_signal **sp)
     t_sigdelwrite *delwriter =
         (t_sigdelwrite *)pd_findbyclass(x->x_sym, sigdelwrite_class);
     int i, length = sp[0]->s_length;
+    ugen_dsplink(x->x_sym);
     x->x_sr = sp[0]->s_sr * 0.001;
     x->x_n = length;
     if (delwriter)
@@ -308,6 +315,7 @@ static void sigdelread_setup(void)
     sigdelread_class = class_new(gensym("delread~"),
         (t_newmethod)sigdelread_new, 0,
         sizeof(t_sigdelread), CLASS_MULTICHANNEL, A_DEFSYM, A_DEFFLOAT, 0);
+    class_setdspshared(sigdelread_class);
     class_addmethod(sigdelread_class, (t_method)sigdelread_dsp,
         gensym("dsp"), A_CANT, 0);
     class_addfloat(sigdelread_class, (t_method)sigdelread_float);
@@ -394,6 +402,7 @@ static void sigvd_dsp(t_sigvd *x, t_signal **sp)
     t_sigdelwrite *delwriter =
         (t_sigdelwrite *)pd_findbyclass(x->x_sym, sigdelwrite_class);
     int i, length = sp[0]->s_length, nchans;
+    ugen_dsplink(x->x_sym);
     x->x_sr = sp[0]->s_sr * 0.001;
     if (delwriter)
     {
@@ -430,6 +439,7 @@ static void sigvd_setup(void)
 {
     sigvd_class = class_new(gensym("delread4~"), (t_newmethod)sigvd_new, 0,
         sizeof(t_sigvd), CLASS_MULTICHANNEL, A_DEFSYM, 0);
+    class_setdspshared(sigvd_class);
     class_addcreator((t_newmethod)sigvd_new, gensym("vd~"), A_DEFSYM, 0);
     class_addmethod(sigvd_class, (t_method)sigvd_dsp, gensym("dsp"), A_CANT, 0);
     CLASS_MAINSIGNALIN(sigvd_class, t_sigvd, x_f);
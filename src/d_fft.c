@@ -15,6 +15,7 @@ linked in.  The configure script can be used to select which one.
 
 void mayer_init( void);
 void mayer_term( void);
+void class_setdspshared(t_class *c);
 
 static void fftclass_cleanup(t_class *c)
 {
@@ -154,6 +155,7 @@ static void sigfft_setup(void)
 {
     sigfft_class = class_new(gensym("fft~"), sigfft_new, 0,
         sizeof(t_sigfft), CLASS_MULTICHANNEL, 0);
+    class_setdspshared(sigfft_class);
     class_setfreefn(sigfft_class, fftclass_cleanup);
     CLASS_MAINSIGNALIN(sigfft_class, t_sigfft, x_f);
     class_addmethod(sigfft_class, (t_method)sigfft_dsp,
@@ -162,6 +164,7 @@ static void sigfft_setup(void)
 
     sigifft_class = class_new(gensym("ifft~"), sigifft_new, 0,
         sizeof(t_sigfft), CLASS_MULTICHANNEL, 0);
+    class_setdspshared(sigifft_class);
     class_setfreefn(sigifft_class, fftclass_cleanup);
     CLASS_MAINSIGNALIN(sigifft_class, t_sigfft, x_f);
     class_addmethod(sigifft_class, (t_method)sigifft_dsp,
@@ -233,6 +236,7 @@ static void sigrfft_setup(void)
 {
     sigrfft_class = class_new(gensym("rfft~"), sigrfft_new, 0,
         sizeof(t_sigrfft), CLASS_MULTICHANNEL, 0);
+    class_setdspshared(sigrfft_class);
     class_setfreefn(sigrfft_class, fftclass_cleanup);
     CLASS_MAINSIGNALIN(sigrfft_class, t_sigrfft, x_f);
     class_addmethod(sigrfft_class, (t_method)sigrfft_dsp,
@@ -309,6 +313,7 @@ static void sigrifft_setup(void)
 {
     sigrifft_class = class_new(gensym("rifft~"), sigrifft_new, 0,
         sizeof(t_sigrifft), CLASS_MULTICHANNEL, 0);
+    class_setdspshared(sigrifft_class);
     class_setfreefn(sigrifft_class, fftclass_cleanup);
     CLASS_MAINSIGNALIN(sigrifft_class, t_sigrifft, x_f);
     class_addmethod(sigrifft_class, (t_method)sigrifft_dsp,
@@ -7,6 +7,10 @@
 #include "m_pd.h"
 #include <string.h>
 
+void class_setdspshared(t_class *c);   /* in m_class.c */
+void ugen_dsplink(void *key);           /* in d_ugen.c */
+void canvas_update_dsp_links(int nkeys, void **keys);  /* in g_canvas.c */
+
 /* ----------------------------- send~ ----------------------------- */
 static t_class *sigsend_class;
 
@@ -54,9 +58,10 @@ static t_int *sigsend_perform(t_int *w)
 
 static void sigsend_channels(t_sigsend *x, t_float fnchans)
 {
+    void *key = x->x_sym;
     x->x_nchans = fnchans >= 1 ? fnchans : 1;
         /* buffer will be resized in sigsend_fixbuf() */
-    canvas_update_dsp();
+    canvas_update_dsp_links(1, &key);
 }
 
 static void sigsend_fixbuf(t_sigsend *x, int length)
@@ -75,6 +80,7 @@ static void sigsend_dsp(t_sigsend *x, t_signal **sp)
 {
     int usenchans = (x->x_nchans < sp[0]->s_nchans ?
         x->x_nchans : sp[0]->s_nchans);
+    ugen_dsplink(x->x_sym);
     sigsend_fixbuf(x, sp[0]->s_length);
     dsp_add(sigsend_perform, 3, sp[0]->s_vec, x->x_vec,
         x->x_length * usenchans);
@@ -95,6 +101,7 @@ static void sigsend_setup(void)
     sigsend_class = class_new(gensym("send~"), (t_newmethod)sigsend_new,
         (t_method)sigsend_free, sizeof(t_sigsend), CLASS_MULTICHANNEL,
             A_DEFSYM, A_DEFFLOAT, 0);
+    class_setdspshared(sigsend_class);
     class_addcreator((t_newmethod)sigsend_new, gensym("s~"),
         A_DEFSYM, A_DEFFLOAT, 0);
     CLASS_MAINSIGNALIN(sigsend_class, t_sigsend, x_f);
@@ -179,6 +186,7 @@ static void sigreceive_set(t_sigreceive *x, t_symbol *s)
 {
     t_sigsend *sender = (t_sigsend *)pd_findbyclass((x->x_sym = s),
         sigsend_class);
+    ugen_dsplink(s);
     x->x_wherefrom = 0;
     if (sender)
     {
@@ -223,6 +231,7 @@ static void sigreceive_setup(void)
     sigreceive_class = class_new(gensym("receive~"),
         (t_newmethod)sigreceive_new, 0,
         sizeof(t_sigreceive), CLASS_MULTICHANNEL, A_DEFSYM, 0);
+    class_setdspshared(sigreceive_class);
     class_addcreator((t_newmethod)sigreceive_new, gensym("r~"),
         A_DEFSYM, 0);
     class_addmethod(sigreceive_class, (t_method)sigreceive_set, gensym("set"),
@@ -264,9 +273,10 @@ static void *sigcatch_new(t_symbol *s, t_floatarg fnchans)
 
 static void sigcatch_channels(t_sigcatch *x, t_float fnchans)
 {
+    void *key = x->x_sym;
     x->x_nchans = fnchans >= 1 ? fnchans : 1;
         /* buffer will be resized in sigcatch_fixbuf() */
-    canvas_update_dsp();
+    canvas_update_dsp_links(1, &key);
 }
 
 static void sigcatch_fixbuf(t_sigcatch *x, int length)
@@ -297,6 +307,7 @@ static t_int *sigcatch_perform(t_int *w)
 
 static void sigcatch_dsp(t_sigcatch *x, t_signal **sp)
 {
+    ugen_dsplink(x->x_sym);
     sigcatch_fixbuf(x, sp[0]->s_length);
     signal_setmultiout(&sp[0], x->x_nchans);
     dsp_add(sigcatch_perform, 3, x->x_vec, sp[0]->s_vec,
@@ -315,6 +326,7 @@ static void sigcatch_setup(void)
     sigcatch_class = class_new(gensym("catch~"), (t_newmethod)sigcatch_new,
         (t_method)sigcatch_free, sizeof(t_sigcatch),
             CLASS_MULTICHANNEL, A_DEFSYM, A_DEFFLOAT, 0);
+    class_setdspshared(sigcatch_class);
     class_addmethod(sigcatch_class, (t_method)sigcatch_channels,
         gensym("channels"), A_FLOAT, 0);
     class_addmethod(sigcatch_class, (t_method)sigcatch_dsp,
@@ -364,6 +376,7 @@ static void sigthrow_set(t_sigthrow *x, t_symbol *s)
 {
     t_sigcatch *catcher = (t_sigcatch *)pd_findbyclass((x->x_sym = s),
         sigcatch_class);
+    ugen_dsplink(s);
     if (catcher)
     {
         int length = canvas_getsignallength(catcher->x_canvas);
@@ -395,6 +408,7 @@ static void sigthrow_setup(void)
 {
     sigthrow_class = class_new(gensym("throw~"), (t_newmethod)sigthrow_new, 0,
         sizeof(t_sigthrow), CLASS_MULTICHANNEL, A_DEFSYM, 0);
+    class_setdspshared(sigthrow_class);
     class_addmethod(sigthrow_class, (t_method)sigthrow_set, gensym("set"),
         A_DEFSYM, 0);
     CLASS_MAINSIGNALIN(sigthrow_class, t_sigthrow, x_f);
@@ -12,6 +12,18 @@
 #define LOGTEN 2.302585092994046
 #define SIGTOTAL(s) ((t_int)((s)->s_length * (s)->s_nchans))
 
+    /* kernels for the "perform8" routines, chosen according to the CPU in
+    d_simd.c */
+extern void (*simd_clip)(const t_sample *in, t_sample lo, t_sample hi,
+    t_sample *out, int n);
+extern void (*simd_abs)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_wrap)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_sqrt)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_rsqrt)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_mtof)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_dbtorms)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_exp)(const t_sample *in, t_sample *out, int n);
+
 /* ------------------------- clip~ -------------------------- */
 static t_class *clip_class;
 
@@ -38,46 +50,34 @@ static void *clip_new(t_floatarg lo, t_floatarg hi)
 #define CLIP_DO(f, lo, hi) \
     ((f) < (lo) ? (lo) : (f) > (hi) ? (hi) : (f))
 
-static t_int *clip_perform(t_int *w)
+    /* not static; also used in d_ugen.c, which fuses it with others */
+t_int *clip_perform(t_int *w)
 {
-    t_clip *x = (t_clip *)(w[1]);
-    t_sample *in = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    t_sample lo = x->x_lo, hi = x->x_hi;
+    t_sample *in = (t_sample *)(w[1]);
+    t_sample *out = (t_sample *)(w[2]);
+    int n = (int)(w[3]);
+    t_sample lo = *(t_float *)(w[4]), hi = *(t_float *)(w[5]);
     while (n--)
     {
         t_sample f = *in++;
         *out++ = CLIP_DO(f, lo, hi);
     }
-    return (w+5);
+    return (w+6);
 }
 
-static t_int *clip_perform8(t_int *w)
+t_int *clip_perform8(t_int *w)
 {
-    t_clip *x = (t_clip *)(w[1]);
-    t_sample *in = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    t_sample lo = x->x_lo, hi = x->x_hi;
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-        out[0] = CLIP_DO(f0, lo, hi); out[1] = CLIP_DO(f1, lo, hi);
-        out[2] = CLIP_DO(f2, lo, hi); out[3] = CLIP_DO(f3, lo, hi);
-        out[4] = CLIP_DO(f4, lo, hi); out[5] = CLIP_DO(f5, lo, hi);
-        out[6] = CLIP_DO(f6, lo, hi); out[7] = CLIP_DO(f7, lo, hi);
-    }
-    return (w+5);
+    (*simd_clip)((t_sample *)(w[1]), *(t_float *)(w[4]), *(t_float *)(w[5]),
+        (t_sample *)(w[2]), (int)(w[3]));
+    return (w+6);
 }
 
 static void clip_dsp(t_clip *x, t_signal **sp)
 {
     t_int n = SIGTOTAL(sp[0]);
     signal_setmultiout(&sp[1], sp[0]->s_nchans);
-    dsp_add(((n & 7) ? clip_perform : clip_perform8), 4, x,
-        sp[0]->s_vec, sp[1]->s_vec, n);
+    dsp_add(((n & 7) ? clip_perform : clip_perform8), 5,
+        sp[0]->s_vec, sp[1]->s_vec, n, &x->x_lo, &x->x_hi);
 }
 
 static void clip_setup(void)
@@ -210,21 +210,7 @@ static t_int *sigrsqrt_perform(t_int *w)
 
 static t_int *sigrsqrt_perform8(t_int *w)
 {
-    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
-    int n = (int)w[3];
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-        out[0] = f0 <= 0 ? 0 : 1./sqrt(f0);
-        out[1] = f1 <= 0 ? 0 : 1./sqrt(f1);
-        out[2] = f2 <= 0 ? 0 : 1./sqrt(f2);
-        out[3] = f3 <= 0 ? 0 : 1./sqrt(f3);
-        out[4] = f4 <= 0 ? 0 : 1./sqrt(f4);
-        out[5] = f5 <= 0 ? 0 : 1./sqrt(f5);
-        out[6] = f6 <= 0 ? 0 : 1./sqrt(f6);
-        out[7] = f7 <= 0 ? 0 : 1./sqrt(f7);
-    }
+    (*simd_rsqrt)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w + 4);
 }
 
@@ -308,21 +294,7 @@ t_int *sigsqrt_perform(t_int *w)    /* not static; also used in d_fft.c */
 
 static t_int *sigsqrt_perform8(t_int *w)
 {
-    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
-    int n = (int)w[3];
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-        out[0] = f0 < 0 ? 0 : sqrt(f0);
-        out[1] = f1 < 0 ? 0 : sqrt(f1);
-        out[2] = f2 < 0 ? 0 : sqrt(f2);
-        out[3] = f3 < 0 ? 0 : sqrt(f3);
-        out[4] = f4 < 0 ? 0 : sqrt(f4);
-        out[5] = f5 < 0 ? 0 : sqrt(f5);
-        out[6] = f6 < 0 ? 0 : sqrt(f6);
-        out[7] = f7 < 0 ? 0 : sqrt(f7);
-    }
+    (*simd_sqrt)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w + 4);
 }
 
@@ -385,19 +357,7 @@ t_int *sigwrap_perform(t_int *w)
 
 t_int *sigwrap_perform8(t_int *w)
 {
-    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
-    int n = (int)w[3];
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = WRAP_CHECK(in[0]), f1 = WRAP_CHECK(in[1]);
-        t_sample f2 = WRAP_CHECK(in[2]), f3 = WRAP_CHECK(in[3]);
-        t_sample f4 = WRAP_CHECK(in[4]), f5 = WRAP_CHECK(in[5]);
-        t_sample f6 = WRAP_CHECK(in[6]), f7 = WRAP_CHECK(in[7]);
-        out[0] = WRAP_DO(f0); out[1] = WRAP_DO(f1);
-        out[2] = WRAP_DO(f2); out[3] = WRAP_DO(f3);
-        out[4] = WRAP_DO(f4); out[5] = WRAP_DO(f5);
-        out[6] = WRAP_DO(f6); out[7] = WRAP_DO(f7);
-    }
+    (*simd_wrap)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w + 4);
 }
 
@@ -455,18 +415,7 @@ static void *mtof_tilde_new(void)
 
 static t_int *mtof_tilde_perform(t_int *w)
 {
-    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
-    int n = (int)w[3];
-    for (; n--; in++, out++)
-    {
-        t_sample f = *in;
-        if (f <= -1500) *out = 0;
-        else
-        {
-            if (f > 1499) f = 1499;
-            *out = 8.17579891564 * exp(.0577622650 * f);
-        }
-    }
+    (*simd_mtof)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w + 4);
 }
 
@@ -550,19 +499,7 @@ static void *dbtorms_tilde_new(void)
 
 static t_int *dbtorms_tilde_perform(t_int *w)
 {
-    t_sample *in = (t_sample *)w[1], *out = (t_sample *)w[2];
-    int n = (int)w[3];
-    for (; n--; in++, out++)
-    {
-        t_sample f = *in;
-        if (f <= 0) *out = 0;
-        else
-        {
-            if (f > 485)
-                f = 485;
-            *out = exp((LOGTEN * 0.05) * (f-100.));
-        }
-    }
+    (*simd_dbtorms)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w + 4);
 }
 
@@ -757,11 +694,7 @@ static void *exp_tilde_new(void)
 
 t_int *exp_tilde_perform(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *out = (t_sample *)(w[2]);
-    int n = (int)(w[3]);
-    while (n--)
-        *out++ = exp(*in1++);
+    (*simd_exp)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w+4);
 }
 
@@ -814,18 +747,7 @@ t_int *abs_tilde_perform(t_int *w)
 
 t_int *abs_tilde_perform8(t_int *w)
 {
-    t_sample *in = (t_sample *)(w[1]);
-    t_sample *out = (t_sample *)(w[2]);
-    int n = (int)(w[3]);
-    for (; n; n -= 8, in += 8, out += 8)
-    {
-        t_sample f0 = in[0], f1 = in[1], f2 = in[2], f3 = in[3];
-        t_sample f4 = in[4], f5 = in[5], f6 = in[6], f7 = in[7];
-        out[0] = ABS_DO(f0); out[1] = ABS_DO(f1);
-        out[2] = ABS_DO(f2); out[3] = ABS_DO(f3);
-        out[4] = ABS_DO(f4); out[5] = ABS_DO(f5);
-        out[6] = ABS_DO(f6); out[7] = ABS_DO(f7);
-    }
+    (*simd_abs)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w+4);
 }
 
@@ -8,6 +8,9 @@
 #include "m_pd.h"
 #include <string.h>
 
+void class_setdspshared(t_class *c);   /* in m_class.c */
+void canvas_update_dsp_local(t_glist *x);   /* in g_canvas.c */
+
 /* ------------------------- print~ -------------------------- */
 static t_class *print_class;
 
@@ -78,6 +81,7 @@ static void print_setup(void)
 {
     print_class = class_new(gensym("print~"), (t_newmethod)print_new, 0,
         sizeof(t_print), CLASS_MULTICHANNEL, A_DEFSYM, 0);
+    class_setdspshared(print_class);
     CLASS_MAINSIGNALIN(print_class, t_print, x_f);
     class_addmethod(print_class, (t_method)print_dsp, gensym("dsp"), A_CANT, 0);
     class_addbang(print_class, print_bang);
@@ -128,6 +132,7 @@ static void bang_tilde_setup(void)
 {
     bang_tilde_class = class_new(gensym("bang~"), (t_newmethod)bang_tilde_new,
         (t_method)bang_tilde_free, sizeof(t_bang), 0, 0);
+    class_setdspshared(bang_tilde_class);
     class_addmethod(bang_tilde_class, (t_method)bang_tilde_dsp,
         gensym("dsp"), 0);
 }
@@ -261,6 +266,7 @@ typedef struct _snake_split
     t_object x_obj;
     t_sample x_f;
     int x_index;        /* split index (0-based) */
+    t_glist *x_canvas;  /* canvas we're in, for DSP updates */
 } t_snake_split;
 
 static void snake_split_tilde_dsp(t_snake_split *x, t_signal **sp)
@@ -307,13 +313,14 @@ static void snake_split_tilde_dsp(t_snake_split *x, t_signal **sp)
 static void snake_split_tilde_index(t_snake_split *x, t_floatarg f)
 {
     x->x_index = (int)f;
-    canvas_update_dsp();
+    canvas_update_dsp_local(x->x_canvas);
 }
 
 static void *snake_split_tilde_new(t_floatarg f)
 {
     t_snake_split *x = (t_snake_split *)pd_new(snake_split_tilde_class);
     x->x_index = (int)f;
+    x->x_canvas = canvas_getcurrent();
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_float, gensym("index"));
     outlet_new(&x->x_obj, &s_signal);
     outlet_new(&x->x_obj, &s_signal);
@@ -330,6 +337,7 @@ typedef struct _snake_pick
     t_sample x_f;
     int x_npick;        /* number of channels to pick */
     int *x_indices;     /* array of channel indices */
+    t_glist *x_canvas;  /* canvas we're in, for DSP updates */
 } t_snake_pick;
 
 static void snake_pick_tilde_dsp(t_snake_pick *x, t_signal **sp)
@@ -378,7 +386,7 @@ static void snake_pick_tilde_channels(t_snake_pick *x, t_symbol *s, int argc, t_
         /* update indices (convert from 1-based to 0-based) */
     for (i = 0; i < argc; i++)
         x->x_indices[i] = (int)atom_getfloatarg(i, argc, argv) - 1;
-    canvas_update_dsp();
+    canvas_update_dsp_local(x->x_canvas);
 }
 
 static void snake_pick_tilde_free(t_snake_pick *x)
@@ -393,6 +401,7 @@ static void *snake_pick_tilde_new(t_symbol *s, int argc, t_atom *argv)
 
     x->x_npick = 0;
     x->x_indices = NULL;
+    x->x_canvas = canvas_getcurrent();
     snake_pick_tilde_channels(x, s, argc, argv);
 
     inlet_new(&x->x_obj, &x->x_obj.ob_pd, &s_list, gensym("channels"));
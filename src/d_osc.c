@@ -17,6 +17,9 @@
 
 #include "m_private_utils.h"
 
+void class_setdspshared(t_class *c);   /* in m_class.c */
+void ugen_dsplink(void *key);           /* in d_ugen.c */
+
 #if BYTE_ORDER == LITTLE_ENDIAN
 # define HIOFFSET 1
 # define LOWOFFSET 0
@@ -507,6 +510,7 @@ static void tabosc4_tilde_set(t_tabosc4_tilde *x, t_symbol *s)
     int npoints, pointsinarray;
 
     x->x_arrayname = s;
+    ugen_dsplink(s);
     if (!(a = (t_garray *)pd_findbyclass(x->x_arrayname, garray_class)))
     {
         if (*s->s_name)
@@ -551,6 +555,7 @@ static void tabosc4_tilde_setup(void)
     tabosc4_tilde_class = class_new(gensym("tabosc4~"),
         (t_newmethod)tabosc4_tilde_new, 0,
         sizeof(t_tabosc4_tilde), 0, A_DEFSYM, 0);
+    class_setdspshared(tabosc4_tilde_class);
     CLASS_MAINSIGNALIN(tabosc4_tilde_class, t_tabosc4_tilde, x_f);
     class_addmethod(tabosc4_tilde_class, (t_method)tabosc4_tilde_dsp,
         gensym("dsp"), A_CANT, 0);
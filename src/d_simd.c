@@ -0,0 +1,912 @@
+/* Copyright (c) 2026 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/*  SIMD versions of the inner loops of the arithmetic and math objects
+    (+~, -~, *~, /~, max~, min~, clip~, abs~, wrap~, sqrt~, rsqrt~), of
+    copying and zeroing signals, and the dot product the soundfile resampler
+    is built on.  The kernels themselves are in d_simd.h,
+    which we include once for each instruction set.  At startup we ask the CPU
+    which of them it can run and point the "simd_xxx" function pointers at the
+    best one; the "perf8" routines call through these.  The generic version
+    is plain C and does exactly what the perf8 routines always did, and so do
+    the others, so the choice doesn't change any output.
+
+    The exception is mtof~, dbtorms~, exp~, log~ and pow~: their generic
+    versions (below) still call the C library, in double precision, but the
+    vector ones use single precision approximations of exp() and log(), which
+    may be off in the last bit or two.  "pd dsp-simd generic" gets the old
+    results back.
+
+    "pd dsp-simd <name>" picks an instruction set by hand ("generic", "sse2",
+    "avx2", "avx512", "neon", or "auto" for the best available), and
+    "pd dsp-simd-bench" times each kernel in each available instruction set
+    and checks it against the generic version (or for the transcendental
+    ones, reports the largest relative error). */
+
+#include "m_pd.h"
+#include "m_imp.h"
+#include <math.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+#if PD_FLOATSIZE == 32
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define SIMD_AVX
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif /* PD_FLOATSIZE == 32 */
+
+/* ------------------------ generic C versions ------------------------ */
+
+#define SIMDNAME(x) x##_generic
+#define SIMDFN static
+#define V t_sample
+#define W 1
+#define LD(p) (*(p))
+#define ST(p, v) (*(p) = (v))
+#define SET1(f) ((t_sample)(f))
+#define ZERO ((t_sample)0)
+#define ADD(a, b) ((a) + (b))
+#define SUB(a, b) ((a) - (b))
+#define MUL(a, b) ((a) * (b))
+#define DIV(a, b) ((a) / (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define SQRT(a) ((t_sample)sqrt(a))
+#define RSQRT(a) ((t_sample)(1./sqrt(a)))
+#define NEG(a) (-(a))
+#define TRUNC(a) ((t_sample)(int)(a))
+#define TRUNCM1(a) ((t_sample)((int)(a) - 1))
+#define CMPGT(a, b) ((a) > (b))
+#define CMPLT(a, b) ((a) < (b))
+#define CMPGE(a, b) ((a) >= (b))
+#define CMPLE(a, b) ((a) <= (b))
+#define CMPNE(a, b) ((a) != (b))
+#define MOR(a, b) ((a) || (b))
+#define SEL(m, a, b) ((m) ? (a) : (b))
+
+#include "d_simd.h"
+
+#undef SIMDNAME
+#undef SIMDFN
+#undef V
+#undef W
+#undef LD
+#undef ST
+#undef SET1
+#undef ZERO
+#undef ADD
+#undef SUB
+#undef MUL
+#undef DIV
+#undef MAX
+#undef MIN
+#undef SQRT
+#undef RSQRT
+#undef NEG
+#undef TRUNC
+#undef TRUNCM1
+#undef CMPGT
+#undef CMPLT
+#undef CMPGE
+#undef CMPLE
+#undef CMPNE
+#undef MOR
+#undef SEL
+
+#define SIMDREST(x) x##_generic
+
+    /* generic mtof~, dbtorms~, exp~, log~ and pow~, which d_simd.h doesn't
+    have: these are just what the perform routines always did */
+static void mtof_generic(const t_sample *in, t_sample *out, int n)
+{
+    for (; n--; in++, out++)
+    {
+        t_sample f = *in;
+        if (f <= -1500) *out = 0;
+        else
+        {
+            if (f > 1499) f = 1499;
+            *out = 8.17579891564 * exp(.0577622650 * f);
+        }
+    }
+}
+
+static void dbtorms_generic(const t_sample *in, t_sample *out, int n)
+{
+    for (; n--; in++, out++)
+    {
+        t_sample f = *in;
+        if (f <= 0) *out = 0;
+        else
+        {
+            if (f > 485)
+                f = 485;
+            *out = exp((2.302585092994046 * 0.05) * (f-100.));
+        }
+    }
+}
+
+static void exp_generic(const t_sample *in, t_sample *out, int n)
+{
+    while (n--)
+        *out++ = exp(*in++);
+}
+
+static void log_generic(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    while (n--)
+    {
+        t_sample f = *in1++, g = *in2++;
+        if (f <= 0)
+            *out = -1000;   /* rather than blow up, output a number << 0 */
+        else if (g == 1 || g <= 0)
+            *out = log(f);
+        else *out = log(f)/log(g);
+        out++;
+    }
+}
+
+static void scalarlog_generic(const t_sample *in, t_sample base,
+    t_sample *out, int n)
+{
+    t_sample multiplier = ((base > 0 && base != 1) ? 1./log(base) : 1);
+    while (n--)
+    {
+        t_sample f = *in++;
+        if (f <= 0)
+            *out = -1000;   /* rather than blow up, output a number << 0 */
+        else *out = log(f) * multiplier;
+        out++;
+    }
+}
+
+static void reversescalarlog_generic(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    while (n--)
+    {
+        t_sample base = *in++;
+        if (base <= 1)
+            *out = -1000;   /* rather than blow up, output a number << 0 */
+        else if (f < 0)
+            *out = -1000;
+        else *out = log(f) / log(base);
+        out++;
+    }
+}
+
+static void pow_generic(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    while (n--)
+    {
+        t_sample f = *in1++, g = *in2++;
+        *out++ = (f == 0 && g < 0) ||
+            (f < 0 && (g - (int)g) != 0) ?
+                0 : pow(f, g);
+    }
+}
+
+static void scalarpow_generic(const t_sample *in, t_sample g,
+    t_sample *out, int n)
+{
+    while (n--)
+    {
+        t_sample f = *in++;
+        *out++ = (f == 0 && g < 0) ||
+            (f < 0 && (g - (int)g) != 0) ?
+                0 : pow(f, g);
+    }
+}
+
+static void reversescalarpow_generic(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    while (n--)
+    {
+        t_sample g = *in++;
+        *out++ = (f == 0 && g < 0) ||
+            (f < 0 && (g - (int)g) != 0) ?
+                0 : pow(f, g);
+    }
+}
+
+/* ------------------------------- SSE2 -------------------------------- */
+
+#ifdef SIMD_SSE2
+
+static __m128 vrsqrt_sse2(__m128 a)
+{
+    __m128d one = _mm_set1_pd(1.), lo = _mm_cvtps_pd(a),
+        hi = _mm_cvtps_pd(_mm_movehl_ps(a, a));
+    lo = _mm_div_pd(one, _mm_sqrt_pd(lo));
+    hi = _mm_div_pd(one, _mm_sqrt_pd(hi));
+    return (_mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi)));
+}
+
+#define SIMDNAME(x) x##_sse2
+#define SIMDFN static
+#define V __m128
+#define W 4
+#define LD(p) _mm_loadu_ps(p)
+#define ST(p, v) _mm_storeu_ps(p, v)
+#define SET1(f) _mm_set1_ps(f)
+#define ZERO _mm_setzero_ps()
+#define ADD _mm_add_ps
+#define SUB _mm_sub_ps
+#define MUL _mm_mul_ps
+#define DIV _mm_div_ps
+#define MAX _mm_max_ps
+#define MIN _mm_min_ps
+#define SQRT _mm_sqrt_ps
+#define RSQRT vrsqrt_sse2
+#define NEG(a) _mm_xor_ps(a, _mm_set1_ps(-0.f))
+#define TRUNC(a) _mm_cvtepi32_ps(_mm_cvttps_epi32(a))
+#define TRUNCM1(a) _mm_cvtepi32_ps(_mm_sub_epi32(_mm_cvttps_epi32(a), \
+    _mm_set1_epi32(1)))
+#define CMPGT _mm_cmpgt_ps
+#define CMPLT _mm_cmplt_ps
+#define CMPGE _mm_cmpge_ps
+#define CMPLE _mm_cmple_ps
+#define CMPNE _mm_cmpneq_ps
+#define MOR _mm_or_ps
+#define MASK __m128
+#define MAND _mm_and_ps
+#define SEL(m, a, b) _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b))
+#define POW2I(a) _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32( \
+    _mm_cvttps_epi32(a), _mm_set1_epi32(127)), 23))
+#define GETEXP(a) _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32( \
+    _mm_castps_si128(a), 23), _mm_set1_epi32(127)))
+#define GETMANT(a) _mm_or_ps(_mm_and_ps(a, \
+    _mm_castsi128_ps(_mm_set1_epi32(0x007fffff))), _mm_set1_ps(1.f))
+
+#include "d_simd.h"
+
+#undef SIMDNAME
+#undef SIMDFN
+#undef V
+#undef W
+#undef LD
+#undef ST
+#undef SET1
+#undef ZERO
+#undef ADD
+#undef SUB
+#undef MUL
+#undef DIV
+#undef MAX
+#undef MIN
+#undef SQRT
+#undef RSQRT
+#undef NEG
+#undef TRUNC
+#undef TRUNCM1
+#undef CMPGT
+#undef CMPLT
+#undef CMPGE
+#undef CMPLE
+#undef CMPNE
+#undef MOR
+#undef SEL
+#undef MASK
+#undef MAND
+#undef POW2I
+#undef GETEXP
+#undef GETMANT
+
+#endif /* SIMD_SSE2 */
+
+/* ------------------------------- AVX2 -------------------------------- */
+
+#ifdef SIMD_AVX
+
+    /* these are compiled for AVX2 even if the rest of Pd isn't, and only
+    called if the CPU says it has it.  We don't ask for FMA so that the
+    compiler can't fuse multiplies and adds behind our back. */
+#define SIMDATTR_AVX2 __attribute__((target("avx2")))
+
+SIMDATTR_AVX2 static __m256 vrsqrt_avx2(__m256 a)
+{
+    __m256d one = _mm256_set1_pd(1.),
+        lo = _mm256_cvtps_pd(_mm256_castps256_ps128(a)),
+        hi = _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+    lo = _mm256_div_pd(one, _mm256_sqrt_pd(lo));
+    hi = _mm256_div_pd(one, _mm256_sqrt_pd(hi));
+    return (_mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(lo)),
+        _mm256_cvtpd_ps(hi), 1));
+}
+
+#define SIMDNAME(x) x##_avx2
+#define SIMDFN SIMDATTR_AVX2 static
+#define V __m256
+#define W 8
+#define LD(p) _mm256_loadu_ps(p)
+#define ST(p, v) _mm256_storeu_ps(p, v)
+#define SET1(f) _mm256_set1_ps(f)
+#define ZERO _mm256_setzero_ps()
+#define ADD _mm256_add_ps
+#define SUB _mm256_sub_ps
+#define MUL _mm256_mul_ps
+#define DIV _mm256_div_ps
+#define MAX _mm256_max_ps
+#define MIN _mm256_min_ps
+#define SQRT _mm256_sqrt_ps
+#define RSQRT vrsqrt_avx2
+#define NEG(a) _mm256_xor_ps(a, _mm256_set1_ps(-0.f))
+#define TRUNC(a) _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a))
+#define TRUNCM1(a) _mm256_cvtepi32_ps(_mm256_sub_epi32( \
+    _mm256_cvttps_epi32(a), _mm256_set1_epi32(1)))
+#define CMPGT(a, b) _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define CMPLT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define CMPGE(a, b) _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define CMPLE(a, b) _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define CMPNE(a, b) _mm256_cmp_ps(a, b, _CMP_NEQ_UQ)
+#define MOR _mm256_or_ps
+#define MASK __m256
+#define MAND _mm256_and_ps
+#define SEL(m, a, b) _mm256_blendv_ps(b, a, m)
+#define POW2I(a) _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32( \
+    _mm256_cvttps_epi32(a), _mm256_set1_epi32(127)), 23))
+#define GETEXP(a) _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32( \
+    _mm256_castps_si256(a), 23), _mm256_set1_epi32(127)))
+#define GETMANT(a) _mm256_or_ps(_mm256_and_ps(a, \
+    _mm256_castsi256_ps(_mm256_set1_epi32(0x007fffff))), _mm256_set1_ps(1.f))
+
+#include "d_simd.h"
+
+#undef SIMDNAME
+#undef SIMDFN
+#undef V
+#undef W
+#undef LD
+#undef ST
+#undef SET1
+#undef ZERO
+#undef ADD
+#undef SUB
+#undef MUL
+#undef DIV
+#undef MAX
+#undef MIN
+#undef SQRT
+#undef RSQRT
+#undef NEG
+#undef TRUNC
+#undef TRUNCM1
+#undef CMPGT
+#undef CMPLT
+#undef CMPGE
+#undef CMPLE
+#undef CMPNE
+#undef MOR
+#undef SEL
+#undef MASK
+#undef MAND
+#undef POW2I
+#undef GETEXP
+#undef GETMANT
+
+/* ------------------------------ AVX-512 ------------------------------ */
+
+    /* only AVX512F instructions, which every AVX-512 CPU has */
+#define SIMDATTR_AVX512 __attribute__((target("avx512f")))
+
+SIMDATTR_AVX512 static __m512 vrsqrt_avx512(__m512 a)
+{
+    __m512d one = _mm512_set1_pd(1.),
+        lo = _mm512_cvtps_pd(_mm512_castps512_ps256(a)),
+        hi = _mm512_cvtps_pd(_mm256_castpd_ps(
+            _mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)));
+    lo = _mm512_div_pd(one, _mm512_sqrt_pd(lo));
+    hi = _mm512_div_pd(one, _mm512_sqrt_pd(hi));
+    return (_mm512_castpd_ps(_mm512_insertf64x4(
+        _mm512_castps_pd(_mm512_castps256_ps512(_mm512_cvtpd_ps(lo))),
+            _mm256_castps_pd(_mm512_cvtpd_ps(hi)), 1)));
+}
+
+#define SIMDNAME(x) x##_avx512
+#define SIMDFN SIMDATTR_AVX512 static
+#define V __m512
+#define W 16
+#define LD(p) _mm512_loadu_ps(p)
+#define ST(p, v) _mm512_storeu_ps(p, v)
+#define SET1(f) _mm512_set1_ps(f)
+#define ZERO _mm512_setzero_ps()
+#define ADD _mm512_add_ps
+#define SUB _mm512_sub_ps
+#define MUL _mm512_mul_ps
+#define DIV _mm512_div_ps
+#define MAX _mm512_max_ps
+#define MIN _mm512_min_ps
+#define SQRT _mm512_sqrt_ps
+#define RSQRT vrsqrt_avx512
+#define NEG(a) _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), \
+    _mm512_set1_epi32((int)0x80000000)))
+#define TRUNC(a) _mm512_cvtepi32_ps(_mm512_cvttps_epi32(a))
+#define TRUNCM1(a) _mm512_cvtepi32_ps(_mm512_sub_epi32( \
+    _mm512_cvttps_epi32(a), _mm512_set1_epi32(1)))
+#define CMPGT(a, b) _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ)
+#define CMPLT(a, b) _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)
+#define CMPGE(a, b) _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ)
+#define CMPLE(a, b) _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ)
+#define CMPNE(a, b) _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ)
+#define MOR(a, b) ((__mmask16)((a) | (b)))
+#define MASK __mmask16
+#define MAND(a, b) ((__mmask16)((a) & (b)))
+#define SEL(m, a, b) _mm512_mask_blend_ps(m, b, a)
+#define POW2I(a) _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32( \
+    _mm512_cvttps_epi32(a), _mm512_set1_epi32(127)), 23))
+#define GETEXP(a) _mm512_cvtepi32_ps(_mm512_sub_epi32(_mm512_srli_epi32( \
+    _mm512_castps_si512(a), 23), _mm512_set1_epi32(127)))
+#define GETMANT(a) _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512( \
+    _mm512_castps_si512(a), _mm512_set1_epi32(0x007fffff)), \
+        _mm512_set1_epi32(0x3f800000)))
+    /* do what's left over (at most 8 points for perf8 routines) in AVX2 */
+#undef SIMDREST
+#define SIMDREST(x) x##_avx2
+
+#include "d_simd.h"
+
+#undef SIMDNAME
+#undef SIMDFN
+#undef V
+#undef W
+#undef LD
+#undef ST
+#undef SET1
+#undef ZERO
+#undef ADD
+#undef SUB
+#undef MUL
+#undef DIV
+#undef MAX
+#undef MIN
+#undef SQRT
+#undef RSQRT
+#undef NEG
+#undef TRUNC
+#undef TRUNCM1
+#undef CMPGT
+#undef CMPLT
+#undef CMPGE
+#undef CMPLE
+#undef CMPNE
+#undef MOR
+#undef SEL
+#undef MASK
+#undef MAND
+#undef POW2I
+#undef GETEXP
+#undef GETMANT
+#undef SIMDREST
+#define SIMDREST(x) x##_generic
+
+#endif /* SIMD_AVX */
+
+/* ------------------------------- NEON -------------------------------- */
+
+#ifdef SIMD_NEON
+
+static float32x4_t vrsqrt_neon(float32x4_t a)
+{
+    float64x2_t one = vdupq_n_f64(1.),
+        lo = vcvt_f64_f32(vget_low_f32(a)), hi = vcvt_high_f64_f32(a);
+    lo = vdivq_f64(one, vsqrtq_f64(lo));
+    hi = vdivq_f64(one, vsqrtq_f64(hi));
+    return (vcvt_high_f32_f64(vcvt_f32_f64(lo), hi));
+}
+
+#define SIMDNAME(x) x##_neon
+#define SIMDFN static
+#define V float32x4_t
+#define W 4
+#define LD(p) vld1q_f32(p)
+#define ST(p, v) vst1q_f32(p, v)
+#define SET1(f) vdupq_n_f32(f)
+#define ZERO vdupq_n_f32(0)
+#define ADD vaddq_f32
+#define SUB vsubq_f32
+#define MUL vmulq_f32
+#define DIV vdivq_f32
+    /* vmaxq_f32() and vminq_f32() treat NaNs and signed zeros differently
+    from the C code, so we compare and select instead */
+#define MAX(a, b) vbslq_f32(vcgtq_f32(a, b), a, b)
+#define MIN(a, b) vbslq_f32(vcltq_f32(a, b), a, b)
+#define SQRT vsqrtq_f32
+#define RSQRT vrsqrt_neon
+#define NEG vnegq_f32
+#define TRUNC(a) vcvtq_f32_s32(vcvtq_s32_f32(a))
+#define TRUNCM1(a) vcvtq_f32_s32(vsubq_s32(vcvtq_s32_f32(a), vdupq_n_s32(1)))
+#define CMPGT vcgtq_f32
+#define CMPLT vcltq_f32
+#define CMPGE vcgeq_f32
+#define CMPLE vcleq_f32
+#define CMPNE(a, b) vmvnq_u32(vceqq_f32(a, b))
+#define MOR vorrq_u32
+#define MASK uint32x4_t
+#define MAND vandq_u32
+#define SEL vbslq_f32
+#define POW2I(a) vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32( \
+    vcvtq_s32_f32(a), vdupq_n_s32(127)), 23))
+#define GETEXP(a) vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32( \
+    vshrq_n_u32(vreinterpretq_u32_f32(a), 23)), vdupq_n_s32(127)))
+#define GETMANT(a) vreinterpretq_f32_u32(vorrq_u32(vandq_u32( \
+    vreinterpretq_u32_f32(a), vdupq_n_u32(0x007fffff)), \
+        vdupq_n_u32(0x3f800000)))
+
+#include "d_simd.h"
+
+#undef SIMDNAME
+#undef SIMDFN
+#undef V
+#undef W
+#undef LD
+#undef ST
+#undef SET1
+#undef ZERO
+#undef ADD
+#undef SUB
+#undef MUL
+#undef DIV
+#undef MAX
+#undef MIN
+#undef SQRT
+#undef RSQRT
+#undef NEG
+#undef TRUNC
+#undef TRUNCM1
+#undef CMPGT
+#undef CMPLT
+#undef CMPGE
+#undef CMPLE
+#undef CMPNE
+#undef MOR
+#undef SEL
+#undef MASK
+#undef MAND
+#undef POW2I
+#undef GETEXP
+#undef GETMANT
+
+#endif /* SIMD_NEON */
+
+/* ----------------------------- dispatch ------------------------------ */
+
+typedef void (*t_simdbinop)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+typedef void (*t_simdscalarop)(const t_sample *in, t_sample f,
+    t_sample *out, int n);
+typedef void (*t_simdclip)(const t_sample *in, t_sample lo, t_sample hi,
+    t_sample *out, int n);
+typedef void (*t_simdunop)(const t_sample *in, t_sample *out, int n);
+typedef void (*t_simdzero)(t_sample *out, int n);
+typedef t_sample (*t_simddot)(const t_sample *in1, const t_sample *in2,
+    int n);
+
+    /* the kernels the perform routines call */
+t_simdbinop simd_plus = plus_generic, simd_minus = minus_generic,
+    simd_times = times_generic, simd_over = over_generic,
+    simd_max = max_generic, simd_min = min_generic;
+t_simdscalarop simd_scalarplus = scalarplus_generic,
+    simd_scalarminus = scalarminus_generic,
+    simd_reversescalarminus = reversescalarminus_generic,
+    simd_scalartimes = scalartimes_generic,
+    simd_reversescalarover = reversescalarover_generic,
+    simd_scalarmax = scalarmax_generic, simd_scalarmin = scalarmin_generic;
+t_simdclip simd_clip = clip_generic;
+t_simdunop simd_abs = abs_generic, simd_wrap = wrap_generic,
+    simd_sqrt = sqrt_generic, simd_rsqrt = rsqrt_generic,
+    simd_copy = copy_generic;
+t_simdzero simd_zero = zero_generic;
+t_simddot simd_dot = dot_generic;
+t_simdunop simd_mtof = mtof_generic, simd_dbtorms = dbtorms_generic,
+    simd_exp = exp_generic;
+t_simdbinop simd_log = log_generic, simd_pow = pow_generic;
+t_simdscalarop simd_scalarlog = scalarlog_generic,
+    simd_reversescalarlog = reversescalarlog_generic,
+    simd_scalarpow = scalarpow_generic,
+    simd_reversescalarpow = reversescalarpow_generic;
+
+typedef struct _simdset
+{
+    const char *s_name;
+    int (*s_available)(void);
+    t_simdbinop s_plus, s_minus, s_times, s_over, s_max, s_min;
+    t_simdscalarop s_scalarplus, s_scalarminus, s_reversescalarminus,
+        s_scalartimes, s_reversescalarover, s_scalarmax, s_scalarmin;
+    t_simdclip s_clip;
+    t_simdunop s_abs, s_wrap, s_sqrt, s_rsqrt, s_copy;
+    t_simdzero s_zero;
+    t_simddot s_dot;
+    t_simdunop s_mtof, s_dbtorms, s_exp;
+    t_simdbinop s_log, s_pow;
+    t_simdscalarop s_scalarlog, s_reversescalarlog, s_scalarpow,
+        s_reversescalarpow;
+} t_simdset;
+
+static int simd_always(void)
+{
+    return (1);
+}
+
+#ifdef SIMD_AVX
+static int simd_hasavx2(void)
+{
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("avx2"));
+}
+
+static int simd_hasavx512(void)
+{
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("avx512f"));
+}
+#endif
+
+#define SIMDSET(name, x, avail) {name, avail, \
+    plus_##x, minus_##x, times_##x, over_##x, max_##x, min_##x, \
+    scalarplus_##x, scalarminus_##x, reversescalarminus_##x, \
+    scalartimes_##x, reversescalarover_##x, scalarmax_##x, scalarmin_##x, \
+    clip_##x, abs_##x, wrap_##x, sqrt_##x, rsqrt_##x, copy_##x, zero_##x, \
+    dot_##x, mtof_##x, dbtorms_##x, exp_##x, log_##x, pow_##x, \
+    scalarlog_##x, reversescalarlog_##x, scalarpow_##x, reversescalarpow_##x}
+
+    /* in order of preference, best last */
+static const t_simdset simd_sets[] =
+{
+    SIMDSET("generic", generic, simd_always),
+#ifdef SIMD_SSE2
+    SIMDSET("sse2", sse2, simd_always),
+#endif
+#ifdef SIMD_AVX
+    SIMDSET("avx2", avx2, simd_hasavx2),
+    SIMDSET("avx512", avx512, simd_hasavx512),
+#endif
+#ifdef SIMD_NEON
+    SIMDSET("neon", neon, simd_always),
+#endif
+};
+
+#define NSIMDSETS ((int)(sizeof(simd_sets)/sizeof(*simd_sets)))
+
+static const t_simdset *simd_current = &simd_sets[0];
+
+static void simd_use(const t_simdset *s)
+{
+    simd_plus = s->s_plus;
+    simd_minus = s->s_minus;
+    simd_times = s->s_times;
+    simd_over = s->s_over;
+    simd_max = s->s_max;
+    simd_min = s->s_min;
+    simd_scalarplus = s->s_scalarplus;
+    simd_scalarminus = s->s_scalarminus;
+    simd_reversescalarminus = s->s_reversescalarminus;
+    simd_scalartimes = s->s_scalartimes;
+    simd_reversescalarover = s->s_reversescalarover;
+    simd_scalarmax = s->s_scalarmax;
+    simd_scalarmin = s->s_scalarmin;
+    simd_clip = s->s_clip;
+    simd_abs = s->s_abs;
+    simd_wrap = s->s_wrap;
+    simd_sqrt = s->s_sqrt;
+    simd_rsqrt = s->s_rsqrt;
+    simd_copy = s->s_copy;
+    simd_zero = s->s_zero;
+    simd_dot = s->s_dot;
+    simd_mtof = s->s_mtof;
+    simd_dbtorms = s->s_dbtorms;
+    simd_exp = s->s_exp;
+    simd_log = s->s_log;
+    simd_pow = s->s_pow;
+    simd_scalarlog = s->s_scalarlog;
+    simd_reversescalarlog = s->s_reversescalarlog;
+    simd_scalarpow = s->s_scalarpow;
+    simd_reversescalarpow = s->s_reversescalarpow;
+    simd_current = s;
+}
+
+static const t_simdset *simd_best(void)
+{
+    int i;
+    for (i = NSIMDSETS; i--; )
+        if ((*simd_sets[i].s_available)())
+            return (&simd_sets[i]);
+    return (&simd_sets[0]);
+}
+
+    /* called from d_arithmetic_setup() */
+void simd_setup(void)
+{
+    simd_use(simd_best());
+    logpost(0, PD_VERBOSE, "SIMD kernels: %s", simd_current->s_name);
+}
+
+    /* "pd dsp-simd <name>": choose an instruction set, or report */
+void glob_dspsimd(void *dummy, t_symbol *s)
+{
+    int i;
+    if (!*s->s_name)
+    {
+        startpost("SIMD kernels: %s (available:", simd_current->s_name);
+        for (i = 0; i < NSIMDSETS; i++)
+            if ((*simd_sets[i].s_available)())
+                startpost(" %s", simd_sets[i].s_name);
+        post(")");
+        return;
+    }
+    if (!strcmp(s->s_name, "auto"))
+    {
+        simd_use(simd_best());
+        return;
+    }
+    for (i = 0; i < NSIMDSETS; i++)
+        if (!strcmp(s->s_name, simd_sets[i].s_name))
+    {
+        if ((*simd_sets[i].s_available)())
+            simd_use(&simd_sets[i]);
+        else pd_error(0, "dsp-simd: %s not supported by this CPU",
+            s->s_name);
+        return;
+    }
+    pd_error(0, "dsp-simd: unknown instruction set '%s'", s->s_name);
+}
+
+/* ----------------------------- benchmark ----------------------------- */
+
+#define BENCHPOINTS 1024        /* points per kernel call */
+#define BENCHTIME 0.05          /* seconds to run each kernel */
+
+    /* run kernel number "which" of set "s" once.  mtof and dbtorms get
+    "in3", which covers more of their range. */
+static void simd_benchcall(const t_simdset *s, int which,
+    const t_sample *in1, const t_sample *in2, const t_sample *in3,
+    t_sample *out)
+{
+    switch (which)
+    {
+    case 0: (*s->s_plus)(in1, in2, out, BENCHPOINTS); break;
+    case 1: (*s->s_minus)(in1, in2, out, BENCHPOINTS); break;
+    case 2: (*s->s_times)(in1, in2, out, BENCHPOINTS); break;
+    case 3: (*s->s_over)(in1, in2, out, BENCHPOINTS); break;
+    case 4: (*s->s_max)(in1, in2, out, BENCHPOINTS); break;
+    case 5: (*s->s_min)(in1, in2, out, BENCHPOINTS); break;
+    case 6: (*s->s_scalarplus)(in1, 0.5, out, BENCHPOINTS); break;
+    case 7: (*s->s_scalarminus)(in1, 0.5, out, BENCHPOINTS); break;
+    case 8: (*s->s_reversescalarminus)(in1, 0.5, out, BENCHPOINTS); break;
+    case 9: (*s->s_scalartimes)(in1, 0.5, out, BENCHPOINTS); break;
+    case 10: (*s->s_reversescalarover)(in1, 0.5, out, BENCHPOINTS); break;
+    case 11: (*s->s_scalarmax)(in1, 0.5, out, BENCHPOINTS); break;
+    case 12: (*s->s_scalarmin)(in1, 0.5, out, BENCHPOINTS); break;
+    case 13: (*s->s_clip)(in1, -0.5, 0.5, out, BENCHPOINTS); break;
+    case 14: (*s->s_abs)(in1, out, BENCHPOINTS); break;
+    case 15: (*s->s_wrap)(in1, out, BENCHPOINTS); break;
+    case 16: (*s->s_sqrt)(in1, out, BENCHPOINTS); break;
+    case 17: (*s->s_rsqrt)(in1, out, BENCHPOINTS); break;
+    case 18: (*s->s_copy)(in1, out, BENCHPOINTS); break;
+    case 19: (*s->s_zero)(out, BENCHPOINTS); break;
+    case 20: out[0] = (*s->s_dot)(in1, in2, BENCHPOINTS); break;
+    case 21: (*s->s_mtof)(in3, out, BENCHPOINTS); break;
+    case 22: (*s->s_dbtorms)(in3, out, BENCHPOINTS); break;
+    case 23: (*s->s_exp)(in1, out, BENCHPOINTS); break;
+    case 24: (*s->s_log)(in1, in2, out, BENCHPOINTS); break;
+    case 25: (*s->s_scalarlog)(in1, 10, out, BENCHPOINTS); break;
+    case 26: (*s->s_reversescalarlog)(in1, 0.5, out, BENCHPOINTS); break;
+    case 27: (*s->s_pow)(in1, in2, out, BENCHPOINTS); break;
+    case 28: (*s->s_scalarpow)(in1, 0.5, out, BENCHPOINTS); break;
+    case 29: (*s->s_reversescalarpow)(in1, 0.5, out, BENCHPOINTS); break;
+    }
+}
+
+static const char *simd_kernelnames[] =
+{
+    "plus", "minus", "times", "over", "max", "min", "scalarplus",
+    "scalarminus", "reversescalarminus", "scalartimes", "reversescalarover",
+    "scalarmax", "scalarmin", "clip", "abs", "wrap", "sqrt", "rsqrt",
+    "copy", "zero", "dot", "mtof", "dbtorms", "exp", "log", "scalarlog",
+    "reversescalarlog", "pow", "scalarpow", "reversescalarpow"
+};
+
+#define NKERNELS ((int)(sizeof(simd_kernelnames)/sizeof(*simd_kernelnames)))
+#define FIRSTINEXACT 21     /* kernels from here on only approximate */
+
+    /* largest difference between "out" and "ref" relative to "ref" (or
+    for tiny values, to the smallest normal float) */
+static double simd_maxerror(const t_sample *out, const t_sample *ref)
+{
+    double max = 0;
+    int i;
+    for (i = 0; i < BENCHPOINTS; i++)
+    {
+        double err, mag = fabs(ref[i]);
+        if (out[i] == ref[i])
+            continue;
+        err = fabs((double)out[i] - ref[i]) / (mag > 1.17549435e-38 ?
+            mag : 1.17549435e-38);
+        if (!(err <= max))  /* NaN counts too */
+            max = err;
+    }
+    return (max);
+}
+
+    /* "pd dsp-simd-bench": for each kernel, print the throughput (in
+    millions of points per second) of each available instruction set, and
+    check that it gives the same output as the generic version, or for
+    those that only approximate it, print the largest relative error. */
+void glob_dspsimdbench(void *dummy)
+{
+    t_sample *in1 = (t_sample *)getbytes(BENCHPOINTS * sizeof(t_sample)),
+        *in2 = (t_sample *)getbytes(BENCHPOINTS * sizeof(t_sample)),
+        *in3 = (t_sample *)getbytes(BENCHPOINTS * sizeof(t_sample)),
+        *ref = (t_sample *)getbytes(BENCHPOINTS * sizeof(t_sample)),
+        *out = (t_sample *)getbytes(BENCHPOINTS * sizeof(t_sample));
+    int i, j, k;
+    unsigned int seed = 12345;
+        /* some awkward values among the test data */
+    for (i = 0; i < BENCHPOINTS; i++)
+    {
+        seed = seed * 435898247 + 382842987;
+        in1[i] = ((int)((seed >> 8) & 0xffff) - 32768) / 4096.;
+        seed = seed * 435898247 + 382842987;
+        in2[i] = ((int)((seed >> 8) & 0xffff) - 32768) / 4096.;
+        in3[i] = 64 + 32 * in1[i];
+    }
+    in1[0] = 0; in1[1] = -0.; in2[2] = 0; in1[3] = 1e10; in1[4] = -1e10;
+    in1[5] = -3; in1[6] = 3;
+    post("SIMD kernel throughput (Mpoints/sec), current set %s:",
+        simd_current->s_name);
+    for (k = 0; k < NKERNELS; k++)
+    {
+        char buf[MAXPDSTRING];
+        memset(ref, 0, BENCHPOINTS * sizeof(t_sample));
+        simd_benchcall(&simd_sets[0], k, in1, in2, in3, ref);
+        snprintf(buf, MAXPDSTRING, "%-20s", simd_kernelnames[k]);
+        for (j = 0; j < NSIMDSETS; j++)
+        {
+            const t_simdset *s = &simd_sets[j];
+            double start, elapsed;
+            int ncalls = 0;
+            size_t len = strlen(buf);
+            char check[40];
+            if (!(*s->s_available)())
+                continue;
+            memset(out, 0, BENCHPOINTS * sizeof(t_sample));
+            simd_benchcall(s, k, in1, in2, in3, out);
+            if (k >= FIRSTINEXACT && s != &simd_sets[0])
+                snprintf(check, sizeof(check), " (error %.1e)",
+                    simd_maxerror(out, ref));
+            else if (memcmp(out, ref, BENCHPOINTS * sizeof(t_sample)))
+                strcpy(check, " (DIFFERS!)");
+            else check[0] = 0;
+            start = sys_getrealtime();
+            do
+            {
+                for (i = 0; i < 64; i++)
+                    simd_benchcall(s, k, in1, in2, in3, out);
+                ncalls += 64;
+            } while ((elapsed = sys_getrealtime() - start) < BENCHTIME);
+            snprintf(buf + len, MAXPDSTRING - len, " %s %.0f%s",
+                s->s_name, (ncalls * (double)BENCHPOINTS) / (elapsed * 1e6),
+                    check);
+        }
+        post("%s", buf);
+    }
+    freebytes(in1, BENCHPOINTS * sizeof(t_sample));
+    freebytes(in2, BENCHPOINTS * sizeof(t_sample));
+    freebytes(in3, BENCHPOINTS * sizeof(t_sample));
+    freebytes(ref, BENCHPOINTS * sizeof(t_sample));
+    freebytes(out, BENCHPOINTS * sizeof(t_sample));
+}
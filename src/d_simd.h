@@ -0,0 +1,595 @@
+/* Copyright (c) 1997-2024 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* kernels for the arithmetic and math objects, broken out in this file so
+that d_simd.c can include it once for each instruction set it knows about
+(see d_osc.h for the same trick).  Before each inclusion these macros have
+to be defined:
+
+SIMDNAME(x)     the name of kernel "x" for this instruction set
+SIMDFN          storage class and attributes for the kernels
+V, W            the vector type and the number of points in it
+LD(p), ST(p, v) load and store W points (unaligned)
+SET1(f), ZERO   a vector with all points set to f (or zero)
+ADD, SUB, MUL, DIV, MAX, MIN, SQRT, NEG     the obvious; MAX(a, b) has to
+                mean "a > b ? a : b" and MIN(a, b) "a < b ? a : b"
+RSQRT(v)        1/sqrt() of each point, computed in double precision
+TRUNC(v)        the float nearest (int)v, for each point
+TRUNCM1(v)      the float nearest ((int)v - 1)
+CMPGT, CMPLT, CMPGE, CMPLE, CMPNE       comparisons yielding a mask (CMPNE
+                true for NaNs), MOR(m1, m2) the "or" of two masks, and
+                SEL(m, a, b) the points of a where m is set, else of b.
+
+and for the vector versions also:
+
+MASK            the type of a mask
+MAND(m1, m2)    the "and" of two masks
+POW2I(v)        2 to the v, for whole numbers v from -126 to 127
+GETEXP(v)       the exponent of each (positive, normal) point as a float...
+GETMANT(v)      ... and the mantissa, from 1 up to 2
+
+Each kernel but dot() takes any number of points.  For the vector versions
+SIMDREST(x) names the generic kernel, which does whatever is left over
+after the last full vector.  Since all of these do exactly what the scalar
+"perf8" routines did (in the same precision and the same order) the output
+doesn't depend on which version we run -- except for the transcendental
+functions at the end, which only approximate the C library. */
+
+    /* vector-vector binops (+~, -~, *~, /~, max~, min~) */
+SIMDFN void SIMDNAME(plus)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+        ST(out, ADD(LD(in1), LD(in2)));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(plus)(in1, in2, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(minus)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+        ST(out, SUB(LD(in1), LD(in2)));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(minus)(in1, in2, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(times)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+        ST(out, MUL(LD(in1), LD(in2)));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(times)(in1, in2, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(over)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+    {
+        V f = LD(in1), g = LD(in2);
+        ST(out, SEL(CMPNE(g, ZERO), DIV(f, g), ZERO));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(over)(in1, in2, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(max)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+    {
+        V f = LD(in1), g = LD(in2);
+        ST(out, MAX(f, g));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(max)(in1, in2, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(min)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+    {
+        V f = LD(in1), g = LD(in2);
+        ST(out, MIN(f, g));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(min)(in1, in2, out, n);
+#endif
+}
+
+    /* vector-scalar binops.  scalar "/~" multiplies by the reciprocal, so
+    it uses the "times" kernel. */
+SIMDFN void SIMDNAME(scalarplus)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, ADD(LD(in), g));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(scalarplus)(in, f, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(scalarminus)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SUB(LD(in), g));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(scalarminus)(in, f, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(reversescalarminus)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SUB(g, LD(in)));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(reversescalarminus)(in, f, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(scalartimes)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, MUL(LD(in), g));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(scalartimes)(in, f, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(reversescalarover)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V h = LD(in);
+        ST(out, SEL(CMPNE(h, ZERO), DIV(g, h), ZERO));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(reversescalarover)(in, f, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(scalarmax)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V h = LD(in);
+        ST(out, MAX(h, g));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(scalarmax)(in, f, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(scalarmin)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    V g = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V h = LD(in);
+        ST(out, MIN(h, g));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(scalarmin)(in, f, out, n);
+#endif
+}
+
+    /* clip~, abs~, wrap~, sqrt~, rsqrt~ */
+SIMDFN void SIMDNAME(clip)(const t_sample *in, t_sample lo, t_sample hi,
+    t_sample *out, int n)
+{
+    V vlo = SET1(lo), vhi = SET1(hi);
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V f = LD(in);
+        ST(out, SEL(CMPLT(f, vlo), vlo, SEL(CMPGT(f, vhi), vhi, f)));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(clip)(in, lo, hi, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(abs)(const t_sample *in, t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V f = LD(in);
+        ST(out, SEL(CMPGE(f, ZERO), f, NEG(f)));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(abs)(in, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(wrap)(const t_sample *in, t_sample *out, int n)
+{
+    V big = SET1((t_sample)INT_MAX), small = SET1((t_sample)INT_MIN);
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V f = LD(in), k;
+        f = SEL(MOR(CMPGT(f, big), CMPLT(f, small)), ZERO, f);
+        k = TRUNC(f);
+        ST(out, SEL(CMPLE(k, f), SUB(f, k), SUB(f, TRUNCM1(f))));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(wrap)(in, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(sqrt)(const t_sample *in, t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V f = LD(in);
+        ST(out, SEL(CMPLT(f, ZERO), ZERO, SQRT(f)));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(sqrt)(in, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(rsqrt)(const t_sample *in, t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in += W, out += W)
+    {
+        V f = LD(in);
+        ST(out, SEL(CMPLE(f, ZERO), ZERO, RSQRT(f)));
+    }
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(rsqrt)(in, out, n);
+#endif
+}
+
+    /* copying and zeroing signals */
+SIMDFN void SIMDNAME(copy)(const t_sample *in, t_sample *out, int n)
+{
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, LD(in));
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(copy)(in, out, n);
+#endif
+}
+
+SIMDFN void SIMDNAME(zero)(t_sample *out, int n)
+{
+    for (; n >= W; n -= W, out += W)
+        ST(out, ZERO);
+#ifdef SIMDREST
+    if (n)
+        SIMDREST(zero)(out, n);
+#endif
+}
+
+    /* dot product, for the FIR filters in the soundfile resampler
+    (d_soundfile_resample.c).  n has to be a multiple of 16.  Point k goes
+    into partial sum k % 16, and the 16 sums are then added pairwise (0 + 8,
+    then 0 + 4, and so on), which every version does in the same order. */
+SIMDFN t_sample SIMDNAME(dot)(const t_sample *in1, const t_sample *in2,
+    int n)
+{
+    V acc[16/W];
+    t_sample sum[W];
+    int i, m;
+    for (i = 0; i < 16/W; i++)
+        acc[i] = ZERO;
+    for (; n > 0; n -= 16, in1 += 16, in2 += 16)
+        for (i = 0; i < 16/W; i++)
+            acc[i] = ADD(acc[i], MUL(LD(in1 + i*W), LD(in2 + i*W)));
+    for (m = 16/W; m > 1; m /= 2)
+        for (i = 0; i < m/2; i++)
+            acc[i] = ADD(acc[i], acc[i + m/2]);
+    ST(sum, acc[0]);
+    for (m = W; m > 1; m /= 2)
+        for (i = 0; i < m/2; i++)
+            sum[i] += sum[i + m/2];
+    return (sum[0]);
+}
+
+#if W > 1
+
+    /* mtof~, dbtorms~, exp~, log~ and pow~.  The generic versions of these
+    call the C library in double precision (they're in d_simd.c), and the
+    vector ones use single precision approximations after Cephes' expf()
+    and logf(), so they differ in the last bit or two; "pd dsp-simd-bench"
+    reports how much.  Points left over after the last full vector are
+    copied to a buffer and done the same way, so that each point's result
+    doesn't depend on where it is in the signal. */
+
+    /* e to the x.  Below about -87.3 this gives 0 instead of a denormal,
+    above about 88.7 infinity. */
+SIMDFN V SIMDNAME(vexp)(V x)
+{
+    V t, k, k2, r, p, y;
+    V big = SET1(88.72283f), small = SET1(-87.33654f);
+    MASK hi = CMPGT(x, big), lo = CMPLT(x, small);
+    x = MIN(MAX(x, small), big);
+        /* x = k ln(2) + r, with |r| <= ln(2)/2; ln(2) is split in two so
+        that k ln(2) is exact */
+    t = ADD(MUL(x, SET1(1.44269504088896341f)), SET1(0.5f));
+    k = SEL(CMPGT(TRUNC(t), t), TRUNCM1(t), TRUNC(t));
+    r = SUB(SUB(x, MUL(k, SET1(0.693359375f))),
+        MUL(k, SET1(-2.12194440e-4f)));
+    p = SET1(1.9875691500e-4f);
+    p = ADD(MUL(p, r), SET1(1.3981999507e-3f));
+    p = ADD(MUL(p, r), SET1(8.3334519073e-3f));
+    p = ADD(MUL(p, r), SET1(4.1665795894e-2f));
+    p = ADD(MUL(p, r), SET1(1.6666665459e-1f));
+    p = ADD(MUL(p, r), SET1(5.0000001201e-1f));
+    p = ADD(ADD(MUL(MUL(p, r), r), r), SET1(1.f));
+        /* k can be 128, which POW2I() can't make */
+    k2 = MIN(k, SET1(127.f));
+    y = MUL(p, POW2I(k2));
+    y = SEL(CMPGT(k, k2), ADD(y, y), y);
+    return (SEL(hi, SET1(INFINITY), SEL(lo, ZERO, y)));
+}
+
+    /* natural log, for x > 0 */
+SIMDFN V SIMDNAME(vlog)(V x)
+{
+    V e, m, z, p, y;
+    MASK denormal = CMPLT(x, SET1(1.17549435e-38f)), big;
+        /* make denormals normal */
+    x = SEL(denormal, MUL(x, SET1(8388608.f)), x);
+        /* x = 2^e m, with sqrt(1/2) <= m < sqrt(2) */
+    e = SUB(GETEXP(x), SEL(denormal, SET1(23.f), ZERO));
+    m = GETMANT(x);
+    big = CMPGT(m, SET1(1.41421356237f));
+    m = SEL(big, MUL(m, SET1(0.5f)), m);
+    e = SEL(big, ADD(e, SET1(1.f)), e);
+    m = SUB(m, SET1(1.f));
+    z = MUL(m, m);
+    p = SET1(7.0376836292e-2f);
+    p = ADD(MUL(p, m), SET1(-1.1514610310e-1f));
+    p = ADD(MUL(p, m), SET1(1.1676998740e-1f));
+    p = ADD(MUL(p, m), SET1(-1.2420140846e-1f));
+    p = ADD(MUL(p, m), SET1(1.4249322787e-1f));
+    p = ADD(MUL(p, m), SET1(-1.6668057665e-1f));
+    p = ADD(MUL(p, m), SET1(2.0000714765e-1f));
+    p = ADD(MUL(p, m), SET1(-2.4999993993e-1f));
+    p = ADD(MUL(p, m), SET1(3.3333331174e-1f));
+    y = MUL(MUL(p, m), z);
+    y = ADD(y, MUL(e, SET1(-2.12194440e-4f)));
+    y = SUB(y, MUL(z, SET1(0.5f)));
+    return (ADD(ADD(m, y), MUL(e, SET1(0.693359375f))));
+}
+
+    /* pow(f, g) as pow~ has it: 0 where f is 0 and g is negative, or f is
+    negative and g isn't a whole number */
+SIMDFN V SIMDNAME(vpow)(V f, V g)
+{
+    V absf = SEL(CMPLT(f, ZERO), NEG(f), f), half = MUL(g, SET1(0.5f)),
+        y = SIMDNAME(vexp)(MUL(g, SIMDNAME(vlog)(absf)));
+        /* odd powers of negative numbers are negative */
+    y = SEL(MAND(CMPLT(f, ZERO), CMPNE(half, TRUNC(half))), NEG(y), y);
+    y = SEL(CMPNE(f, ZERO), y, ZERO);
+    y = SEL(CMPNE(g, ZERO), y, SET1(1.f));
+    return (SEL(MAND(CMPLT(f, ZERO), CMPNE(g, TRUNC(g))), ZERO, y));
+}
+
+    /* copy the last n < W points in or out of a vector-sized buffer */
+SIMDFN void SIMDNAME(partload)(t_sample *buf, const t_sample *in, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        buf[i] = in[i];
+    for (; i < W; i++)
+        buf[i] = 1;
+}
+
+SIMDFN void SIMDNAME(partstore)(t_sample *out, const t_sample *buf, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        out[i] = buf[i];
+}
+
+SIMDFN V SIMDNAME(vmtof)(V f)
+{
+    V y = MUL(SET1(8.17579891564f), SIMDNAME(vexp)(
+        MUL(SET1(0.0577622650f), MIN(f, SET1(1499.f)))));
+    return (SEL(CMPLE(f, SET1(-1500.f)), ZERO, y));
+}
+
+SIMDFN void SIMDNAME(mtof)(const t_sample *in, t_sample *out, int n)
+{
+    t_sample buf[W];
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vmtof)(LD(in)));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vmtof)(LD(buf)));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+SIMDFN V SIMDNAME(vdbtorms)(V f)
+{
+    V y = SIMDNAME(vexp)(MUL(SET1((float)(2.302585092994046 * 0.05)),
+        SUB(MIN(f, SET1(485.f)), SET1(100.f))));
+    return (SEL(CMPLE(f, ZERO), ZERO, y));
+}
+
+SIMDFN void SIMDNAME(dbtorms)(const t_sample *in, t_sample *out, int n)
+{
+    t_sample buf[W];
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vdbtorms)(LD(in)));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vdbtorms)(LD(buf)));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+SIMDFN void SIMDNAME(exp)(const t_sample *in, t_sample *out, int n)
+{
+    t_sample buf[W];
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vexp)(LD(in)));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vexp)(LD(buf)));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+    /* log~: -1000 for f <= 0, and the natural log if the base is 1 or
+    less than or equal to 0 */
+SIMDFN V SIMDNAME(vlogbase)(V f, V g)
+{
+    V y = SIMDNAME(vlog)(f),
+        q = DIV(y, SIMDNAME(vlog)(SEL(CMPGT(g, ZERO), g, SET1(2.f))));
+    y = SEL(MAND(CMPGT(g, ZERO), CMPNE(g, SET1(1.f))), q, y);
+    return (SEL(CMPLE(f, ZERO), SET1(-1000.f), y));
+}
+
+SIMDFN void SIMDNAME(log)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    t_sample buf1[W], buf2[W];
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+        ST(out, SIMDNAME(vlogbase)(LD(in1), LD(in2)));
+    if (n)
+    {
+        SIMDNAME(partload)(buf1, in1, n);
+        SIMDNAME(partload)(buf2, in2, n);
+        ST(buf1, SIMDNAME(vlogbase)(LD(buf1), LD(buf2)));
+        SIMDNAME(partstore)(out, buf1, n);
+    }
+}
+
+    /* the multiplier (1/log(base)) is computed in double as before */
+SIMDFN V SIMDNAME(vscalarlog)(V f, V mul)
+{
+    return (SEL(CMPLE(f, ZERO), SET1(-1000.f),
+        MUL(SIMDNAME(vlog)(f), mul)));
+}
+
+SIMDFN void SIMDNAME(scalarlog)(const t_sample *in, t_sample base,
+    t_sample *out, int n)
+{
+    t_sample buf[W];
+    V mul = SET1((base > 0 && base != 1) ? (t_sample)(1./log(base)) : 1);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vscalarlog)(LD(in), mul));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vscalarlog)(LD(buf), mul));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+    /* log(f) to a signal base: -1000 if the base is 1 or less or f is
+    negative; log(f) itself is computed in double as before */
+SIMDFN V SIMDNAME(vreversescalarlog)(V base, V logf, int fneg)
+{
+    MASK small = CMPLE(base, SET1(1.f));
+    V y = DIV(logf, SIMDNAME(vlog)(SEL(small, SET1(2.f), base)));
+    return (fneg ? SET1(-1000.f) : SEL(small, SET1(-1000.f), y));
+}
+
+SIMDFN void SIMDNAME(reversescalarlog)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    t_sample buf[W];
+    int fneg = (f < 0);
+    V logf = SET1(f > 0 ? (t_sample)log(f) : -INFINITY);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vreversescalarlog)(LD(in), logf, fneg));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vreversescalarlog)(LD(buf), logf, fneg));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+SIMDFN void SIMDNAME(pow)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n)
+{
+    t_sample buf1[W], buf2[W];
+    for (; n >= W; n -= W, in1 += W, in2 += W, out += W)
+        ST(out, SIMDNAME(vpow)(LD(in1), LD(in2)));
+    if (n)
+    {
+        SIMDNAME(partload)(buf1, in1, n);
+        SIMDNAME(partload)(buf2, in2, n);
+        ST(buf1, SIMDNAME(vpow)(LD(buf1), LD(buf2)));
+        SIMDNAME(partstore)(out, buf1, n);
+    }
+}
+
+SIMDFN void SIMDNAME(scalarpow)(const t_sample *in, t_sample g,
+    t_sample *out, int n)
+{
+    t_sample buf[W];
+    V vg = SET1(g);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vpow)(LD(in), vg));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vpow)(LD(buf), vg));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+SIMDFN void SIMDNAME(reversescalarpow)(const t_sample *in, t_sample f,
+    t_sample *out, int n)
+{
+    t_sample buf[W];
+    V vf = SET1(f);
+    for (; n >= W; n -= W, in += W, out += W)
+        ST(out, SIMDNAME(vpow)(vf, LD(in)));
+    if (n)
+    {
+        SIMDNAME(partload)(buf, in, n);
+        ST(buf, SIMDNAME(vpow)(vf, LD(buf)));
+        SIMDNAME(partstore)(out, buf, n);
+    }
+}
+
+#endif /* W > 1 */
@@ -6,7 +6,8 @@
 sort of soundfile library.  Second, the "soundfiler" object is defined which
 uses the routines to read or write soundfiles, synchronously, from garrays.
 These operations are not to be done in "real time" as they may have to wait
-for disk accesses (even the write routine.)  Finally, the realtime objects
+for disk accesses (even the write routine), unless the "-async" flag sends
+them to a separate thread.  Finally, the realtime objects
 readsf~ and writesf~ are defined which confine disk operations to a separate
 thread so that they can be used in real time.  The readsf~ and writesf~
 objects use Posix-like threads. */
@@ -14,12 +15,19 @@ objects use Posix-like threads. */
 #include "d_soundfile.h"
 #include "g_canvas.h"
 #include "s_stuff.h"
+#include "s_audio_paring.h"
+#include "m_private_utils.h"
 #ifdef _WIN32
 #include <io.h>
 #endif
 #include <fcntl.h>
 #include <stdio.h>
 #include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 /* Supported sample formats: LPCM (16 or 24 bit int) & 32 or 64 bit float */
 
@@ -138,6 +146,7 @@ void soundfile_wave_setup(void);
 void soundfile_aiff_setup(void);
 void soundfile_caf_setup(void);
 void soundfile_next_setup(void);
+void class_setdspshared(t_class *c);
 
     /** set up built-in types */
 void soundfile_type_setup(void)
@@ -652,6 +661,7 @@ static void soundfile_xferin_words(const t_soundfile *sf, int nvecs,
          -ascii
          -big
          -little
+         -async (soundfiler only)
     */
 
     /** parsed write arguments */
@@ -666,6 +676,7 @@ typedef struct _soundfiler_writeargs
     size_t wa_onsetframes;            /* sample frame onset when writing */
     int wa_normalize;                 /* normalize samples? */
     int wa_ascii;                     /* write ascii? */
+    int wa_async;                     /* write in the I/O thread? */
 } t_soundfiler_writeargs;
 
 
@@ -682,7 +693,7 @@ static int soundfiler_parsewriteargs(void *obj, int *p_argc, t_atom **p_argv,
     t_atom *argv = *p_argv;
     int samplerate = -1, bytespersample = 2, bigendian = 0, endianness = -1;
     size_t nframes = SFMAXFRAMES, onsetframes = 0;
-    int normalize = 0, ascii = 0;
+    int normalize = 0, ascii = 0, async = 0;
     t_symbol *filesym;
     t_soundfile_type *type = NULL;
 
@@ -741,6 +752,11 @@ static int soundfiler_parsewriteargs(void *obj, int *p_argc, t_atom **p_argv,
             ascii = 1;
             argc -= 1; argv += 1;
         }
+        else if (!strcmp(flag, "async"))
+        {
+            async = 1;
+            argc -= 1; argv += 1;
+        }
         else if (!strcmp(flag, "nextstep"))
         {
                 /* handle old "-nextstep" alias */
@@ -800,6 +816,7 @@ static int soundfiler_parsewriteargs(void *obj, int *p_argc, t_atom **p_argv,
     wa->wa_onsetframes = onsetframes;
     wa->wa_normalize = normalize;
     wa->wa_ascii = ascii;
+    wa->wa_async = async;
     return 0;
 }
 
@@ -1126,6 +1143,122 @@ static void soundfile_xferout_words(const t_soundfile *sf, int nvecs,
             memset(sp2, 0, sf->sf_bytespersample);
 }
 
+/* ----- reading with sample rate conversion ----- */
+
+/* "soundfiler read -resample" and readsf~'s "open -resample" read the file
+through one of these, which decodes SFCONVFRAMES frames at a time into a
+resampler (see d_soundfile_resample.c) and gets the converted frames back
+out.  Only the first "c_nchannels" channels of the file are converted. */
+
+#define SFCONVFRAMES 1024
+
+typedef struct _sfconvert
+{
+    t_sfresample *c_resample;
+    int c_nchannels;                /* number of channels converted */
+    unsigned char *c_raw;           /* frames as read from the file */
+    size_t c_rawsize;
+    t_sample *c_in[MAXSFCHANS];     /* ... decoded */
+    t_sample *c_out[MAXSFCHANS];    /* ... and converted */
+    int c_error;                    /* errno if reading failed */
+} t_sfconvert;
+
+    /* returns NULL if the file is already at "samplerate" */
+static t_sfconvert *sfconvert_new(const t_soundfile *sf, int nchannels,
+    t_float samplerate, int quality)
+{
+    t_sfconvert *c;
+    t_sfresample *r;
+    int i;
+    if (sf->sf_samplerate <= 0 || sf->sf_samplerate == samplerate ||
+        !(r = sfresample_new(nchannels, sf->sf_samplerate, samplerate,
+            quality)))
+                return (0);
+    c = (t_sfconvert *)getbytes(sizeof(*c));
+    c->c_resample = r;
+    c->c_nchannels = nchannels;
+    c->c_rawsize = SFCONVFRAMES * sf->sf_bytesperframe;
+    c->c_raw = (unsigned char *)getbytes(c->c_rawsize);
+    for (i = 0; i < nchannels; i++)
+    {
+        c->c_in[i] = (t_sample *)getbytes(SFCONVFRAMES * sizeof(t_sample));
+        c->c_out[i] = (t_sample *)getbytes(SFCONVFRAMES * sizeof(t_sample));
+    }
+    c->c_error = 0;
+    return (c);
+}
+
+static void sfconvert_free(t_sfconvert *c)
+{
+    int i;
+    for (i = 0; i < c->c_nchannels; i++)
+    {
+        freebytes(c->c_in[i], SFCONVFRAMES * sizeof(t_sample));
+        freebytes(c->c_out[i], SFCONVFRAMES * sizeof(t_sample));
+    }
+    freebytes(c->c_raw, c->c_rawsize);
+    sfresample_free(c->c_resample);
+    freebytes(c, sizeof(*c));
+}
+
+    /* get up to "n" (at most SFCONVFRAMES) converted frames into c_out,
+    reading from the file as needed.  Returns the number of frames, which
+    is only zero at the end of the file. */
+static int sfconvert_pull(t_sfconvert *c, t_soundfile *sf, int n)
+{
+    int got;
+    while (!(got = sfresample_read(c->c_resample, c->c_out, n)))
+    {
+        size_t nframes = sfresample_room(c->c_resample);
+        ssize_t bytesread = 0;
+        if (!nframes)
+            return (0);     /* finished */
+        if (nframes > SFCONVFRAMES)
+            nframes = SFCONVFRAMES;
+        if (sf->sf_bytelimit >= 0 &&
+            nframes > (size_t)sf->sf_bytelimit / sf->sf_bytesperframe)
+                nframes = sf->sf_bytelimit / sf->sf_bytesperframe;
+        if (nframes)
+            bytesread = read(sf->sf_fd, c->c_raw,
+                nframes * sf->sf_bytesperframe);
+        if (bytesread < sf->sf_bytesperframe)
+        {
+            if (bytesread < 0)
+                c->c_error = errno;
+            sfresample_finish(c->c_resample);
+            continue;
+        }
+        nframes = bytesread / sf->sf_bytesperframe;
+        if (sf->sf_bytelimit >= 0)
+            sf->sf_bytelimit -= nframes * sf->sf_bytesperframe;
+        soundfile_xferin_sample(sf, c->c_nchannels, c->c_in, 0, c->c_raw,
+            nframes);
+        sfresample_write(c->c_resample, c->c_in, nframes);
+    }
+    return (got);
+}
+
+    /* convert up to "nframes" frames into arrays starting at "onset";
+    returns the number of frames, fewer at the end of the file */
+static size_t sfconvert_words(t_sfconvert *c, t_soundfile *sf,
+    t_word **vecs, size_t onset, size_t nframes)
+{
+    size_t done = 0;
+    int n, i, k;
+    while (done < nframes)
+    {
+        size_t want = nframes - done;
+        if (!(n = sfconvert_pull(c, sf,
+            (want > SFCONVFRAMES ? SFCONVFRAMES : (int)want))))
+                break;
+        for (i = 0; i < c->c_nchannels; i++)
+            for (k = 0; k < n; k++)
+                vecs[i][onset + done + k].w_float = c->c_out[i][k];
+        done += n;
+    }
+    return (done);
+}
+
 /* ----- soundfiler - reads and writes soundfiles to/from "garrays" ----- */
 
 #define SAMPBUFSIZE 1024
@@ -1148,6 +1281,537 @@ static t_soundfiler *soundfiler_new(void)
     return x;
 }
 
+/* "read -async" and "write -async": the file is opened (and for writing,
+the arrays are copied) in Pd's thread, but the bulk of the reading or
+writing is done in an I/O thread shared by all soundfilers.  When a job is
+done the I/O thread hands it back to Pd's thread with pd_queue_mess().  For
+reading, the staging vectors are then swapped into the arrays (see
+garray_swapfloatwords()), so the arrays keep their old contents and size
+until then.  Results go to the outlets just as for synchronous reads and
+writes.  Jobs are done one at a time in the order they were asked for.
+Finished jobs stay on a list until Pd's thread has picked them up, so that
+soundfiler_free() can disown them there too; the soundfiler still gets its
+result if the message queue drops the message. */
+
+#define SFASYNCBUFSIZE 65536
+
+typedef struct _sfjob
+{
+    struct _sfjob *j_next;
+    t_soundfiler *j_owner;          /* zeroed if the soundfiler is freed */
+    struct _pdinstance *j_pdthis;   /* instance to send the result to */
+    int j_write;                    /* 1 to write, 0 to read */
+    t_soundfile j_sf;               /* the open file */
+    t_symbol *j_filename;
+    int j_nvecs;
+    t_symbol *j_arrays[MAXSFCHANS]; /* read: arrays to swap into */
+    t_word *j_vecs[MAXSFCHANS];     /* staging vectors */
+    size_t j_vecsize;               /* size of each staging vector */
+    size_t j_nframes;               /* frames to read or write */
+    size_t j_framesdone;            /* frames actually read or written */
+    int j_resize;                   /* read: resize the arrays */
+    t_sfconvert *j_convert;         /* read: resampler, if any */
+    t_sample j_normfactor;          /* write: scale samples by this */
+    int j_failed;                   /* reading or writing failed ... */
+    int j_errno;                    /* ... with this error */
+} t_sfjob;
+
+static pthread_mutex_t sfjob_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sfjob_cond = PTHREAD_COND_INITIALIZER;
+static t_sfjob *sfjob_head, *sfjob_tail, *sfjob_current;
+static t_sfjob *sfjob_donelist;     /* finished, waiting for Pd's thread */
+static int sfjob_started;
+
+static t_sfjob *sfjob_new(int write)
+{
+    t_sfjob *j = (t_sfjob *)getbytes(sizeof(*j));
+    soundfile_clear(&j->j_sf);
+    j->j_write = write;
+    return (j);
+}
+
+static void sfjob_free(t_sfjob *j)
+{
+    int i;
+    for (i = 0; i < j->j_nvecs; i++)
+        if (j->j_vecs[i])
+            freebytes(j->j_vecs[i], j->j_vecsize * sizeof(t_word));
+    if (j->j_convert)
+        sfconvert_free(j->j_convert);
+    if (j->j_sf.sf_fd >= 0)
+        sys_close(j->j_sf.sf_fd);
+    freebytes(j, sizeof(*j));
+}
+
+static int sfjob_canceled(t_sfjob *j)
+{
+    int canceled;
+    pthread_mutex_lock(&sfjob_mutex);
+    canceled = !j->j_owner;
+    pthread_mutex_unlock(&sfjob_mutex);
+    return (canceled);
+}
+
+    /* these two run in the I/O thread */
+static void sfjob_read(t_sfjob *j, unsigned char *buf)
+{
+    t_soundfile *sf = &j->j_sf;
+    size_t bufframes = SFASYNCBUFSIZE / sf->sf_bytesperframe;
+    if (j->j_convert)
+    {
+        while (j->j_framesdone < j->j_nframes && !sfjob_canceled(j))
+        {
+            size_t thisread = j->j_nframes - j->j_framesdone, nframes;
+            thisread = (thisread > bufframes ? bufframes : thisread);
+            nframes = sfconvert_words(j->j_convert, sf, j->j_vecs,
+                j->j_framesdone, thisread);
+            j->j_framesdone += nframes;
+            if (nframes < thisread) break;
+        }
+        if (j->j_convert->c_error)
+            j->j_failed = 1, j->j_errno = j->j_convert->c_error;
+        return;
+    }
+    while (j->j_framesdone < j->j_nframes && !sfjob_canceled(j))
+    {
+        size_t thisread = j->j_nframes - j->j_framesdone;
+        ssize_t nframes;
+        thisread = (thisread > bufframes ? bufframes : thisread);
+        nframes = read(sf->sf_fd, buf,
+            thisread * sf->sf_bytesperframe) / sf->sf_bytesperframe;
+        if (nframes <= 0) break;
+        soundfile_xferin_words(sf, j->j_nvecs, j->j_vecs, j->j_framesdone,
+            buf, nframes);
+        j->j_framesdone += nframes;
+    }
+}
+
+static void sfjob_write(t_sfjob *j, unsigned char *buf)
+{
+    t_soundfile *sf = &j->j_sf;
+    size_t bufframes = SFASYNCBUFSIZE / sf->sf_bytesperframe;
+    while (j->j_framesdone < j->j_nframes)
+    {
+        size_t thiswrite = j->j_nframes - j->j_framesdone, datasize;
+        ssize_t byteswritten;
+        thiswrite = (thiswrite > bufframes ? bufframes : thiswrite);
+        datasize = sf->sf_bytesperframe * thiswrite;
+        soundfile_xferout_words(sf, j->j_nvecs, j->j_vecs, buf,
+            thiswrite, j->j_framesdone, j->j_normfactor);
+        byteswritten = write(sf->sf_fd, buf, datasize);
+        if (byteswritten < 0 || (size_t)byteswritten < datasize)
+        {
+            j->j_failed = 1;
+            j->j_errno = errno;
+            if (byteswritten > 0)
+                j->j_framesdone += byteswritten / sf->sf_bytesperframe;
+            break;
+        }
+        j->j_framesdone += thiswrite;
+    }
+}
+
+static void soundfiler_readdone(t_soundfiler *x, t_sfjob *j)
+{
+    int i, vecsize;
+    size_t k;
+    t_word *vec;
+    if (j->j_failed)
+        object_sferror(x, "[soundfiler] read", j->j_filename->s_name,
+            j->j_errno, &j->j_sf);
+    else if (j->j_resize && j->j_framesdone < j->j_vecsize)
+        post("warning: soundfile %s header promised \
+%ld points but file was truncated to %ld",
+            j->j_filename->s_name, (long)j->j_vecsize, (long)j->j_framesdone);
+    for (i = 0; i < j->j_nvecs; i++)
+    {
+        t_garray *a = (t_garray *)pd_findbyclass(j->j_arrays[i], garray_class);
+        if (!a)
+        {
+            pd_error(x, "[soundfiler] read: %s: no such table",
+                j->j_arrays[i]->s_name);
+            continue;
+        }
+            /* normally we just swap the new vector in; but if we weren't
+            to resize and the array has been resized since, copy instead */
+        if ((j->j_resize || (size_t)garray_npoints(a) == j->j_vecsize) &&
+            garray_swapfloatwords(a, (long)j->j_vecsize, j->j_vecs[i]))
+        {
+            j->j_vecs[i] = 0;
+            if (j->j_resize)
+                garray_setsaveit(a, 0);
+        }
+        else if (garray_getfloatwords(a, &vecsize, &vec))
+        {
+            for (k = 0; k < (size_t)vecsize; k++)
+                vec[k].w_float = (k < j->j_vecsize ? j->j_vecs[i][k].w_float : 0);
+            garray_redraw(a);
+        }
+    }
+    j->j_sf.sf_fd = -1;
+    outlet_soundfileinfo(x->x_out2, &j->j_sf);
+    outlet_float(x->x_obj.ob_outlet, (t_float)j->j_framesdone);
+}
+
+static void soundfiler_writedone(t_soundfiler *x, t_sfjob *j)
+{
+    if (j->j_failed)
+        object_sferror(x, "[soundfiler] write", j->j_filename->s_name,
+            j->j_errno, &j->j_sf);
+    soundfile_finishwrite(x, j->j_filename->s_name, &j->j_sf,
+        j->j_nframes, j->j_framesdone);
+    sys_close(j->j_sf.sf_fd);
+    j->j_sf.sf_fd = -1;
+    outlet_soundfileinfo(x->x_out2, &j->j_sf);
+    outlet_float(x->x_obj.ob_outlet, (t_float)j->j_framesdone);
+}
+
+    /* called with the finished job, in Pd's thread unless the soundfiler
+    was freed before the job was done.  We go by j_owner, not 'obj', which
+    is also NULL if the message queue dropped the message. */
+static void sfjob_done(t_pd *obj, void *data)
+{
+    t_sfjob *j = (t_sfjob *)data, **jp;
+    t_soundfiler *owner;
+    pthread_mutex_lock(&sfjob_mutex);
+    for (jp = &sfjob_donelist; *jp; jp = &(*jp)->j_next)
+    {
+        if (*jp == j)
+        {
+            *jp = j->j_next;
+            break;
+        }
+    }
+    owner = j->j_owner;
+    pthread_mutex_unlock(&sfjob_mutex);
+    if (owner && j->j_write)
+        soundfiler_writedone(owner, j);
+    else if (owner)
+        soundfiler_readdone(owner, j);
+    else if (j->j_write && j->j_framesdone < j->j_nframes)
+        j->j_sf.sf_type->t_updateheaderfn(&j->j_sf, j->j_framesdone);
+    sfjob_free(j);
+}
+
+static void sfjob_run(t_sfjob *j, unsigned char *buf)
+{
+    if (j->j_write)
+        sfjob_write(j, buf);
+    else sfjob_read(j, buf);
+}
+
+static void *sfjob_threadmain(void *dummy)
+{
+    unsigned char *buf = (unsigned char *)getbytes(SFASYNCBUFSIZE);
+    pthread_mutex_lock(&sfjob_mutex);
+    while (1)
+    {
+        t_sfjob *j;
+        t_soundfiler *owner;
+        while (!sfjob_head)
+            pthread_cond_wait(&sfjob_cond, &sfjob_mutex);
+        j = sfjob_current = sfjob_head;
+        if (!(sfjob_head = j->j_next))
+            sfjob_tail = 0;
+        pthread_mutex_unlock(&sfjob_mutex);
+        sfjob_run(j, buf);
+        pthread_mutex_lock(&sfjob_mutex);
+        sfjob_current = 0;
+            /* queue the result while holding the lock so that
+            soundfiler_free() can't miss it */
+        if ((owner = j->j_owner))
+        {
+            j->j_next = sfjob_donelist;
+            sfjob_donelist = j;
+            pd_queue_mess(j->j_pdthis, &owner->x_obj.ob_pd, j, sfjob_done);
+        }
+        else
+        {
+            pthread_mutex_unlock(&sfjob_mutex);
+            sfjob_done(0, j);
+            pthread_mutex_lock(&sfjob_mutex);
+        }
+    }
+    return (0);
+}
+
+static void sfjob_submit(t_soundfiler *x, t_sfjob *j)
+{
+    j->j_owner = x;
+    j->j_pdthis = pd_this;
+    j->j_next = 0;
+    pthread_mutex_lock(&sfjob_mutex);
+    if (!sfjob_started)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, 0, sfjob_threadmain, 0))
+        {
+            unsigned char *buf;
+            pthread_mutex_unlock(&sfjob_mutex);
+            pd_error(x, "[soundfiler]: couldn't start I/O thread");
+            buf = (unsigned char *)getbytes(SFASYNCBUFSIZE);
+            sfjob_run(j, buf);
+            freebytes(buf, SFASYNCBUFSIZE);
+            sfjob_done(&x->x_obj.ob_pd, j);
+            return;
+        }
+        pthread_detach(thread);
+        sfjob_started = 1;
+    }
+    if (sfjob_tail)
+        sfjob_tail = (sfjob_tail->j_next = j);
+    else sfjob_head = sfjob_tail = j;
+    pthread_cond_signal(&sfjob_cond);
+    pthread_mutex_unlock(&sfjob_mutex);
+}
+
+static void soundfiler_free(t_soundfiler *x)
+{
+    t_sfjob *j;
+    pthread_mutex_lock(&sfjob_mutex);
+    for (j = sfjob_head; j; j = j->j_next)
+        if (j->j_owner == x)
+            j->j_owner = 0;
+    if (sfjob_current && sfjob_current->j_owner == x)
+        sfjob_current->j_owner = 0;
+    for (j = sfjob_donelist; j; j = j->j_next)
+        if (j->j_owner == x)
+            j->j_owner = 0;
+    pthread_mutex_unlock(&sfjob_mutex);
+    pd_queue_cancel(&x->x_obj.ob_pd);
+}
+
+/* "read -map" maps the file into memory instead of reading it into
+arrays, and binds each channel to one of the given names (see t_sfmap in
+d_soundfile.h).  Nothing is copied: samples are converted when tabread~,
+tabread4~ or tabplay~ get them, and the pages come straight from the file
+system's cache, so even very big files "load" immediately and several Pd
+processes mapping the same file share the memory.  The mapping goes away
+when all its names are unmapped ("unmap" message) or mapped to other files.
+Mapped names can't be written to or used as arrays otherwise. */
+
+typedef struct _sfmapfile
+{
+    void *f_addr;
+    size_t f_size;
+    int f_refcount;         /* number of channels using it */
+#ifdef _WIN32
+    HANDLE f_mapping;
+#endif
+} t_sfmapfile;
+
+static t_class *sfmap_class;
+int sfmap_valid;
+
+#define SFMAP_U16(a, b) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16))
+#define SFMAP_U24(a, b, c) (SFMAP_U16(a, b) | ((uint32_t)(c) << 8))
+#define SFMAP_U32(a, b, c, d) (SFMAP_U24(a, b, c) | (uint32_t)(d))
+
+static t_sample sfmap_get2b(const unsigned char *p)
+{
+    return (SCALE * (int32_t)SFMAP_U16(p[0], p[1]));
+}
+
+static t_sample sfmap_get2l(const unsigned char *p)
+{
+    return (SCALE * (int32_t)SFMAP_U16(p[1], p[0]));
+}
+
+static t_sample sfmap_get3b(const unsigned char *p)
+{
+    return (SCALE * (int32_t)SFMAP_U24(p[0], p[1], p[2]));
+}
+
+static t_sample sfmap_get3l(const unsigned char *p)
+{
+    return (SCALE * (int32_t)SFMAP_U24(p[2], p[1], p[0]));
+}
+
+static t_sample sfmap_get4b(const unsigned char *p)
+{
+    t_floatuint alias;
+    alias.ui = SFMAP_U32(p[0], p[1], p[2], p[3]);
+    return (alias.f);
+}
+
+static t_sample sfmap_get4l(const unsigned char *p)
+{
+    t_floatuint alias;
+    alias.ui = SFMAP_U32(p[3], p[2], p[1], p[0]);
+    return (alias.f);
+}
+
+static t_sample sfmap_get8b(const unsigned char *p)
+{
+    t_doubleuint alias;
+    alias.ui = ((uint64_t)SFMAP_U32(p[0], p[1], p[2], p[3]) << 32) |
+        SFMAP_U32(p[4], p[5], p[6], p[7]);
+    return (alias.d);
+}
+
+static t_sample sfmap_get8l(const unsigned char *p)
+{
+    t_doubleuint alias;
+    alias.ui = ((uint64_t)SFMAP_U32(p[7], p[6], p[5], p[4]) << 32) |
+        SFMAP_U32(p[3], p[2], p[1], p[0]);
+    return (alias.d);
+}
+
+t_sfmap *sfmap_find(t_symbol *s)
+{
+    return (sfmap_class ? (t_sfmap *)pd_findbyclass(s, sfmap_class) : 0);
+}
+
+    /* map the whole of an open file; returns NULL and sets errno on
+    failure */
+static t_sfmapfile *sfmapfile_new(int fd)
+{
+    t_sfmapfile *f;
+    off_t size = lseek(fd, 0, SEEK_END);
+    void *addr;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+    if (size <= 0)
+    {
+        if (!size)
+            errno = SOUNDFILE_ERRMALFORMED;
+        return (0);
+    }
+    if ((uint64_t)size > (uint64_t)SIZE_MAX)
+    {
+        errno = ENOMEM;
+        return (0);
+    }
+#ifdef _WIN32
+    if (!(mapping = CreateFileMapping((HANDLE)_get_osfhandle(fd), NULL,
+        PAGE_READONLY, 0, 0, NULL)))
+    {
+        errno = EACCES;
+        return (0);
+    }
+    if (!(addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)))
+    {
+        CloseHandle(mapping);
+        errno = ENOMEM;
+        return (0);
+    }
+#else
+    if ((addr = mmap(0, (size_t)size, PROT_READ, MAP_SHARED, fd, 0)) ==
+        MAP_FAILED)
+            return (0);
+#endif
+    f = (t_sfmapfile *)getbytes(sizeof(*f));
+    f->f_addr = addr;
+    f->f_size = (size_t)size;
+    f->f_refcount = 0;
+#ifdef _WIN32
+    f->f_mapping = mapping;
+#endif
+    return (f);
+}
+
+static void sfmapfile_release(t_sfmapfile *f)
+{
+    if (--f->f_refcount > 0)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(f->f_addr);
+    CloseHandle(f->f_mapping);
+#else
+    munmap(f->f_addr, f->f_size);
+#endif
+    freebytes(f, sizeof(*f));
+}
+
+    /* unbind and free a channel.  DSP objects using it notice the change
+    of sfmap_valid before they read from it again. */
+static void sfmap_free(t_sfmap *m)
+{
+    pd_unbind(&m->m_pd, m->m_name);
+    sfmapfile_release(m->m_file);
+    freebytes(m, sizeof(*m));
+    sfmap_valid++;
+}
+
+static void sfmap_new(t_symbol *name, t_sfmapfile *f, const t_soundfile *sf,
+    int channel, size_t offset, size_t nframes)
+{
+    t_sfmap *m = (t_sfmap *)getbytes(sizeof(*m));
+    static const t_sfmapgetfn getfns[2][4] = {
+        {sfmap_get2l, sfmap_get3l, sfmap_get4l, sfmap_get8l},
+        {sfmap_get2b, sfmap_get3b, sfmap_get4b, sfmap_get8b}
+    };
+    int format = (sf->sf_bytespersample == 8 ? 3 : sf->sf_bytespersample - 2);
+    m->m_pd = sfmap_class;
+    m->m_name = name;
+    m->m_file = f;
+    m->m_data = (const unsigned char *)f->f_addr + offset +
+        channel * sf->sf_bytespersample;
+    m->m_stride = sf->sf_bytesperframe;
+    m->m_n = (int)nframes;
+    m->m_get = getfns[sf->sf_bigendian != 0][format];
+    f->f_refcount++;
+    pd_bind(&m->m_pd, name);
+    sfmap_valid++;
+}
+
+    /* map an open soundfile and bind its channels to the names in argv;
+    channels beyond the ones in the file, like arrays in a plain read, are
+    silent -- we map them to the first channel but with no frames.  Returns
+    the number of frames or -1 on failure with errno set. */
+static ssize_t soundfiler_map(t_soundfiler *x, t_soundfile *sf,
+    int argc, t_atom *argv)
+{
+    t_sfmapfile *f;
+    off_t offset = lseek(sf->sf_fd, 0, SEEK_CUR);
+    size_t nframes;
+    int i;
+    if (offset < 0 || !(f = sfmapfile_new(sf->sf_fd)))
+        return (-1);
+    nframes = ((size_t)offset < f->f_size ?
+        (f->f_size - offset) / sf->sf_bytesperframe : 0);
+    if (sf->sf_bytelimit >= 0 &&
+        nframes > (size_t)(sf->sf_bytelimit / sf->sf_bytesperframe))
+            nframes = sf->sf_bytelimit / sf->sf_bytesperframe;
+    if (nframes > INT_MAX)
+    {
+        pd_error(x, "[soundfiler] read: truncated to %d frames", INT_MAX);
+        nframes = INT_MAX;
+    }
+    f->f_refcount = 1;  /* hold on to it while we're replacing old maps */
+    for (i = 0; i < argc; i++)
+    {
+        t_symbol *name = argv[i].a_w.w_symbol;
+        t_sfmap *old = sfmap_find(name);
+        if (pd_findbyclass(name, garray_class))
+            post("warning: %s: array by the same name hides mapped file",
+                name->s_name);
+        if (old)
+            sfmap_free(old);
+        sfmap_new(name, f, sf, (i < sf->sf_nchannels ? i : 0), offset,
+            (i < sf->sf_nchannels ? nframes : 0));
+    }
+    sfmapfile_release(f);
+    return (nframes);
+}
+
+    /* "unmap name ..." -- let go of mapped soundfile channels */
+static void soundfiler_unmap(t_soundfiler *x, t_symbol *s,
+    int argc, t_atom *argv)
+{
+    t_sfmap *m;
+    for (; argc--; argv++)
+    {
+        if (argv->a_type != A_SYMBOL)
+            pd_error(x, "[soundfiler] unmap: expected a name");
+        else if (!(m = sfmap_find(argv->a_w.w_symbol)))
+            pd_error(x, "[soundfiler] unmap: %s: not mapped",
+                argv->a_w.w_symbol->s_name);
+        else sfmap_free(m);
+    }
+}
+
 static int soundfiler_readascii(t_soundfiler *x, const char *filename,
     t_asciiargs *a)
 {
@@ -1243,21 +1907,25 @@ done:
            -caf
            -next
            -ascii
+           -async ... read in the I/O thread (not for ascii files)
+           -map ... map the file into memory instead (not for ascii files)
     */
 
 static void soundfiler_read(t_soundfiler *x, t_symbol *s,
     int argc, t_atom *argv)
 {
     t_soundfile sf = {0};
-    int fd = -1, resize = 0, ascii = 0, raw = 0, i;
+    int fd = -1, resize = 0, ascii = 0, raw = 0, async = 0, map = 0,
+        resample = -1, i;
     size_t skipframes = 0, finalsize = 0, maxsize = SFMAXFRAMES,
-           framesread = 0, bufframes, j;
+           framesread = 0, bufframes, stagesize, j;
     ssize_t nframes, framesinfile;
     char endianness;
     const char *filename;
     t_garray *garrays[MAXSFCHANS];
     t_word *vecs[MAXSFCHANS];
     char sampbuf[SAMPBUFSIZE];
+    t_sfconvert *convert = 0;
 
     soundfile_clear(&sf);
     sf.sf_headersize = -1;
@@ -1315,6 +1983,27 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
             resize = 1;
             argc -= 1; argv += 1;
         }
+        else if (!strcmp(flag, "async"))
+        {
+            async = 1;
+            argc -= 1; argv += 1;
+        }
+        else if (!strcmp(flag, "map"))
+        {
+            map = 1;
+            argc -= 1; argv += 1;
+        }
+        else if (!strcmp(flag, "resample"))
+        {
+                /* optionally followed by the quality */
+            resample = SFRESAMPLE_DEFQUALITY;
+            if (argc >= 2 && argv[1].a_type == A_FLOAT)
+            {
+                resample = argv[1].a_w.w_float;
+                argc--; argv++;
+            }
+            argc -= 1; argv += 1;
+        }
         else if (!strcmp(flag, "maxsize"))
         {
             if (argc < 2 || argv[1].a_type != A_FLOAT ||
@@ -1352,6 +2041,33 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
     if (!ascii && !sf.sf_type && sf.sf_headersize < 0)
         ascii = ascii_hasextension(filename, MAXPDSTRING);
 
+    if (map)
+    {
+        ssize_t nmapped;
+        for (i = 0; i < argc; i++)
+            if (argv[i].a_type != A_SYMBOL)
+                goto usage;
+        if (ascii)
+        {
+            pd_error(x, "[soundfiler] read: can't map ascii files");
+            goto done;
+        }
+        if (resample >= 0)
+        {
+            pd_error(x, "[soundfiler] read: can't resample mapped files");
+            goto done;
+        }
+        if ((fd = open_soundfile_via_canvas(x->x_canvas, filename,
+            &sf, skipframes)) < 0 ||
+                (nmapped = soundfiler_map(x, &sf, argc, argv)) < 0)
+        {
+            object_sferror(x, "[soundfiler] read", filename, errno, &sf);
+            goto done;
+        }
+        framesread = nmapped;
+        goto done;
+    }
+
     for (i = 0; i < argc; i++)
     {
         int vecsize;
@@ -1366,8 +2082,13 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
         }
         else if (!garray_getfloatwords(garrays[i], &vecsize,
                 &vecs[i]))
+        {
             pd_error(x, "[soundfiler] read: %s: bad template for tabwrite",
                 argv[i].a_w.w_symbol->s_name);
+                /* can't swap a vector into this one later */
+            if (async)
+                goto done;
+        }
         if (finalsize && finalsize != (size_t)vecsize && !resize)
         {
             post("arrays have different lengths, resizing...");
@@ -1375,6 +2096,7 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
         }
         finalsize = vecsize;
     }
+    stagesize = finalsize;
     if (ascii)
     {
         t_asciiargs a =
@@ -1404,6 +2126,20 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
     }
     framesinfile = sf.sf_bytelimit / sf.sf_bytesperframe;
 
+        /* from here on, sizes are in frames at Pd's sample rate */
+    if (resample >= 0 && sf.sf_samplerate > 0 &&
+        sf.sf_samplerate != sys_getsr())
+    {
+        size_t n = sfresample_nframes(framesinfile, sf.sf_samplerate,
+            sys_getsr());
+        if (argc)
+            convert = sfconvert_new(&sf, (argc < sf.sf_nchannels ?
+                argc : sf.sf_nchannels), sys_getsr(), resample);
+            /* framesinfile is signed, so SFMAXFRAMES won't fit */
+        framesinfile = (n > (size_t)SSIZE_MAX ? SSIZE_MAX : (ssize_t)n);
+        sf.sf_samplerate = sys_getsr();
+    }
+
     if (resize)
     {
             /* figure out what to resize to using header info */
@@ -1413,8 +2149,9 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
                 (long)maxsize);
             framesinfile = maxsize;
         }
-        finalsize = framesinfile;
-        for (i = 0; i < argc; i++)
+        finalsize = stagesize = framesinfile;
+            /* for async reads we resize when the data arrive */
+        for (i = 0; i < argc && !async; i++)
         {
             int vecsize;
             garray_resize_long(garrays[i], finalsize);
@@ -1446,12 +2183,46 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
         goto done;
     }
 
+        /* hand the file over to the I/O thread */
+    if (async)
+    {
+        t_sfjob *job = sfjob_new(0);
+        soundfile_copy(&job->j_sf, &sf);
+        job->j_filename = gensym(filename);
+        job->j_vecsize = (stagesize > 0 ? stagesize : 1);
+        job->j_nframes = finalsize;
+        job->j_resize = resize;
+        job->j_convert = convert;
+        convert = 0;
+        for (i = 0; i < argc; i++)
+        {
+            job->j_arrays[i] = argv[i].a_w.w_symbol;
+            if (!(job->j_vecs[i] = (t_word *)getbytes(
+                job->j_vecsize * sizeof(t_word))))
+            {
+                job->j_sf.sf_fd = -1;   /* we close it below */
+                sfjob_free(job);
+                goto done;
+            }
+            job->j_nvecs = i + 1;
+        }
+        sfjob_submit(x, job);
+        return;
+    }
+
         /* read */
 #ifdef DEBUG_SOUNDFILE
     post("reading frames");
 #endif
     bufframes = SAMPBUFSIZE / sf.sf_bytesperframe;
-    for (framesread = 0; framesread < finalsize;)
+    if (convert)
+    {
+        framesread = sfconvert_words(convert, &sf, vecs, 0, finalsize);
+        if (convert->c_error)
+            object_sferror(x, "[soundfiler] read", filename,
+                convert->c_error, &sf);
+    }
+    else for (framesread = 0; framesread < finalsize;)
     {
         size_t thisread = finalsize - framesread;
         thisread = (thisread > bufframes ? bufframes : thisread);
@@ -1463,7 +2234,8 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
         framesread += nframes;
     }
         /* warn if a file's bad size field is gobbling memory */
-    if (resize && framesread < (size_t)finalsize)
+    if (resize && framesread < (size_t)finalsize &&
+        !(convert && convert->c_error))
     {
         post("warning: soundfile %s header promised \
 %ld points but file was truncated to %ld",
@@ -1492,13 +2264,17 @@ static void soundfiler_read(t_soundfiler *x, t_symbol *s,
     goto done;
 usage:
     pd_error(x, "[soundfiler]: usage; read [flags] filename [tablename]...");
-    post("flags: -skip <n> -resize -maxsize <n> %s -ascii ...", sf_typeargs);
+    post("flags: -skip <n> -resize -maxsize <n> %s -ascii -async -map ...",
+        sf_typeargs);
+    post("-resample [<quality 0-2>]");
     post("-raw <headerbytes> <channels> <bytespersample> <endian (b, l, or n)>");
     post("(-ascii flag can only be combined with -resize)");
 done:
     sf.sf_fd = -1;
     if (fd >= 0)
         sys_close(fd);
+    if (convert)
+        sfconvert_free(convert);
     outlet_soundfileinfo(x->x_out2, &sf);
     outlet_float(x->x_obj.ob_outlet, (t_float)framesread);
 }
@@ -1531,12 +2307,15 @@ int soundfiler_writeascii(t_soundfiler *x, const char *filename, t_asciiargs *a)
     return (ret == 0 ? frameswritten : 0);
 }
 
-    /** this is broken out from soundfiler_write below so garray_write can
-        call it too... not done yet though. */
-size_t soundfiler_dowrite(void *obj, t_canvas *canvas,
-    int argc, t_atom *argv, t_soundfile *sf)
+    /** if "jobp" is given and the "-async" flag is, don't write the samples
+        but copy them into a new job for the I/O thread, leaving the file
+        open, and return the job in "*jobp"; ascii files are always written
+        right away. */
+static size_t soundfiler_writejob(void *obj, t_canvas *canvas,
+    int argc, t_atom *argv, t_soundfile *sf, t_sfjob **jobp)
 {
     t_soundfiler_writeargs wa = {0};
+    t_sfjob *job = 0;
     int fd = -1, i;
     size_t bufframes, frameswritten = 0, j;
     t_garray *garrays[MAXSFCHANS];
@@ -1547,6 +2326,8 @@ size_t soundfiler_dowrite(void *obj, t_canvas *canvas,
     soundfile_clear(sf);
     if (soundfiler_parsewriteargs(obj, &argc, &argv, &wa))
         goto usage;
+    if (wa.wa_async && jobp)
+        job = *jobp = sfjob_new(1);
     sf->sf_type = (wa.wa_ascii ? NULL : wa.wa_type);
     sf->sf_nchannels = argc;
     sf->sf_samplerate = wa.wa_samplerate;
@@ -1642,6 +2423,24 @@ size_t soundfiler_dowrite(void *obj, t_canvas *canvas,
     if (wa.wa_normalize)
         normfactor = (biggest > 0 ? 32767./(32768. * biggest) : 1);
 
+    if (job)
+    {
+        soundfile_copy(&job->j_sf, sf);
+        job->j_filename = wa.wa_filesym;
+        job->j_vecsize = job->j_nframes = wa.wa_nframes;
+        job->j_normfactor = normfactor;
+        for (i = 0; i < argc; i++)
+        {
+            if (!(job->j_vecs[i] = (t_word *)getbytes(
+                wa.wa_nframes * sizeof(t_word))))
+                    goto fail;
+            job->j_nvecs = i + 1;
+            memcpy(job->j_vecs[i], vectors[i] + wa.wa_onsetframes,
+                wa.wa_nframes * sizeof(t_word));
+        }
+        return 0;
+    }
+
         /* write samples */
     bufframes = SAMPBUFSIZE / sf->sf_bytesperframe;
     for (frameswritten = 0; frameswritten < wa.wa_nframes;)
@@ -1677,21 +2476,40 @@ size_t soundfiler_dowrite(void *obj, t_canvas *canvas,
 usage:
     pd_error(obj, "[soundfiler] usage; write [flags] filename tablename...");
     post("flags: -skip <n> -nframes <n> -bytes <n> %s ...", sf_typeargs);
-    post("-ascii -big -little -normalize");
+    post("-ascii -big -little -normalize -async");
     post("(defaults to a 16 bit wave file)");
 fail:
     soundfile_clear(sf); /* clear any bad data */
+    if (job)
+        soundfile_clear(&job->j_sf);
     if (fd >= 0)
         sys_close(fd);
     return 0;
 }
 
+    /** this is broken out from soundfiler_write below so garray_write can
+        call it too... not done yet though. */
+size_t soundfiler_dowrite(void *obj, t_canvas *canvas,
+    int argc, t_atom *argv, t_soundfile *sf)
+{
+    return (soundfiler_writejob(obj, canvas, argc, argv, sf, 0));
+}
+
 static void soundfiler_write(t_soundfiler *x, t_symbol *s,
     int argc, t_atom *argv)
 {
     size_t frameswritten;
     t_soundfile sf = {0};
-    frameswritten = soundfiler_dowrite(x, x->x_canvas, argc, argv, &sf);
+    t_sfjob *job = 0;
+    frameswritten = soundfiler_writejob(x, x->x_canvas, argc, argv, &sf,
+        &job);
+    if (job && job->j_sf.sf_fd >= 0)
+    {
+        sfjob_submit(x, job);
+        return;
+    }
+    if (job)
+        sfjob_free(job);
     outlet_soundfileinfo(x->x_out2, &sf);
     outlet_float(x->x_obj.ob_outlet, (t_float)frameswritten);
 }
@@ -1699,12 +2517,16 @@ static void soundfiler_write(t_soundfiler *x, t_symbol *s,
 static void soundfiler_setup(void)
 {
     soundfiler_class = class_new(gensym("soundfiler"),
-        (t_newmethod)soundfiler_new, 0,
+        (t_newmethod)soundfiler_new, (t_method)soundfiler_free,
         sizeof(t_soundfiler), 0, 0);
     class_addmethod(soundfiler_class, (t_method)soundfiler_read,
         gensym("read"), A_GIMME, 0);
     class_addmethod(soundfiler_class, (t_method)soundfiler_write,
         gensym("write"), A_GIMME, 0);
+    class_addmethod(soundfiler_class, (t_method)soundfiler_unmap,
+        gensym("unmap"), A_GIMME, 0);
+    sfmap_class = class_new(gensym("soundfiler map"), 0, 0,
+        sizeof(t_sfmap), CLASS_PD, 0);
 }
 
 /* ------------------------- readsf object ------------------------- */
@@ -1712,14 +2534,23 @@ static void soundfiler_setup(void)
 /* READSF uses the Posix threads package; for the moment we're Linux
 only although this should be portable to the other platforms.
 
-Each instance of readsf~ owns a "child" thread for doing the Posix file reading.
-The parent thread signals the child each time:
+Each instance of writesf~ owns a "child" thread for doing the Posix file
+writing; the reading for all readsf~ objects is done by a few I/O threads
+which they share (see "the streaming engine" below).  The parent thread wakes
+the child (or the I/O threads) each time:
     (1) a file wants opening or closing;
     (2) we've eaten another 1/16 of the shared buffer (so that the
         child thread should check if it's time to read some more.)
-The child signals the parent whenever a read has completed.  Signaling
-is done by setting "conditions" and putting data in mutex-controlled common
-areas.
+Requests to open and close files are passed in mutex-controlled common areas,
+and the child signals the "answer" condition whenever it has done something.
+The buffer itself is a single-producer, single-consumer ring: the child
+thread owns one index and the perform routine the other, and they only
+exchange them through atomics, so that the perform routine never takes the
+mutex or waits.  It wakes the child by posting a semaphore, which is safe
+to do from the audio thread.  If the disk can't keep up, readsf~ outputs
+zeros and writesf~ drops the block, and both count these in "print".  In
+batch mode ("-batch") nothing runs in real time, so there the perform
+routine waits for the child instead.
 */
 
 #define MAXVECSIZE 128
@@ -1771,19 +2602,28 @@ typedef struct _readsf
     int x_fileerror;          /**< slot for "errno" return */
     t_soundfile x_sf;         /**< soundfile fd, type, and format info */
     size_t x_onsetframes;     /**< number of sample frames to skip */
+    t_soundfile x_dspsf;      /**< writesf~ only; x_sf for the perform routine */
     int x_fifosize;           /**< buffer size appropriately rounded down */
-    int x_fifohead;           /**< index of next byte to get from file */
-    int x_fifotail;           /**< index of next byte the ugen will read */
-    int x_eof;                /**< true if fifohead has stopped changing */
+    atomic_int x_fifohead;    /**< index of next byte to get from file */
+    atomic_int x_fifotail;    /**< index of next byte the ugen will read */
+    atomic_int x_eof;         /**< true if fifohead has stopped changing */
     int x_sigcountdown;       /**< counter for signaling child for more data */
     int x_sigperiod;          /**< number of ticks per signal */
+    int x_xruns;              /**< blocks the disk couldn't keep up with */
     size_t x_frameswritten;   /**< writesf~ only; frames written */
     t_float x_f;              /**< writesf~ only; scalar for signal inlet */
     pthread_mutex_t x_mutex;
-    pthread_cond_t x_requestcondition;
+    t_semaphore *x_wakeup;    /**< posted to wake the child thread */
     pthread_cond_t x_answercondition;
     pthread_t x_childthread;
     t_namelist *x_namelist;
+    struct _readsf *x_next;   /**< readsf~ only; next in sfstream_list */
+    int x_busy;               /**< readsf~ only; an I/O thread is on it */
+    t_soundfile x_iosf;       /**< readsf~ only; the I/O threads' x_sf */
+    int x_resample;           /**< readsf~ only; quality, or -1 for none */
+    t_float x_dsprate;        /**< readsf~ only; sample rate to convert to */
+    int x_gotdata;            /**< readsf~ only; data came since "open" */
+    t_sfconvert *x_convert;   /**< readsf~ only; resampler for this file */
 #ifdef PDINSTANCE
     t_pdinstance *x_pd_this;  /**< pointer to the owner pd instance */
 #endif
@@ -1797,6 +2637,7 @@ typedef struct _readsf
 #if 1
 #define sfread_cond_wait pthread_cond_wait
 #define sfread_cond_signal pthread_cond_signal
+#define sfread_cond_broadcast pthread_cond_broadcast
 #else
 #include <sys/time.h>    /* debugging version... */
 #include <sys/types.h>
@@ -1812,291 +2653,379 @@ static void readsf_fakewait(pthread_mutex_t *b)
 
 #define sfread_cond_wait(a,b) readsf_fakewait(b)
 #define sfread_cond_signal(a)
+#define sfread_cond_broadcast(a)
 #endif
 
-static void *readsf_child_main(void *zz)
+    /* wait, with the mutex released, until some other thread wakes us */
+static void sfthread_wait(t_readsf *x)
 {
-    t_readsf *x = zz;
-    t_soundfile sf = {0};
-    soundfile_clear(&sf);
-#ifdef PDINSTANCE
-    pd_this = x->x_pd_this;
-#endif
-#ifdef DEBUG_SOUNDFILE_THREADS
-    fprintf(stderr, "readsf~: 1\n");
-#endif
+    pthread_mutex_unlock(&x->x_mutex);
+    sys_semaphore_wait(x->x_wakeup);
     pthread_mutex_lock(&x->x_mutex);
-    while (1)
-    {
-        int fifohead;
-        char *buf;
-#ifdef DEBUG_SOUNDFILE_THREADS
-        fprintf(stderr, "readsf~: 0\n");
-#endif
-        if (x->x_requestcode == REQUEST_NOTHING)
-        {
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: wait 2\n");
-#endif
-            sfread_cond_signal(&x->x_answercondition);
-            sfread_cond_wait(&x->x_requestcondition, &x->x_mutex);
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: 3\n");
-#endif
-        }
-        else if (x->x_requestcode == REQUEST_OPEN)
-        {
-            ssize_t bytesread;
-            size_t wantbytes;
+}
 
-                /* copy file stuff out of the data structure so we can
-                relinquish the mutex while we're in open_soundfile_via_path() */
-            size_t onsetframes = x->x_onsetframes;
-            const char *filename = x->x_filename;
-            const char *dirname = canvas_getdir(x->x_canvas)->s_name;
+    /* wake the child thread.  This doesn't lock anything, so it can be
+    called from the perform routines. */
+#define sfthread_wake(x) sys_semaphore_post((x)->x_wakeup)
 
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: 4\n");
-#endif
-                /* alter the request code so that an ensuing "open" will get
-                noticed. */
-            x->x_requestcode = REQUEST_BUSY;
-            x->x_fileerror = 0;
+/* ----- the streaming engine which reads files for readsf~ ----- */
 
-                /* if there's already a file open, close it */
-            if (sf.sf_fd >= 0)
-            {
-                pthread_mutex_unlock(&x->x_mutex);
-                sys_close(sf.sf_fd);
-                sf.sf_fd = -1;
-                pthread_mutex_lock(&x->x_mutex);
-                x->x_sf.sf_fd = -1;
-                if (x->x_requestcode != REQUEST_BUSY)
-                    goto lost;
-            }
-                /* cache sf *after* closing as x->sf's type
-                    may have changed in readsf_open() */
-            soundfile_copy(&sf, &x->x_sf);
+/* Rather than each readsf~ having a thread and a buffer of its own, all of
+them are serviced by SFSTREAM_NTHREADS I/O threads.  Whenever one of these is
+free it takes the stream that needs it most: first any that have "open" or
+"close" requests pending, and then, of those which are playing and have room
+for at least READSIZE bytes, the one whose buffer is emptiest, into which it
+reads as much as fits, up to SFSTREAM_MAXREAD bytes at once.  Buffers are only
+held while there's a file to play and are recycled through a pool of spares,
+so that threads and memory go with the number of streams actually playing,
+not with the number of readsf~ objects.  Everything here is protected by
+sfstream_mutex; "x_busy" marks the streams an I/O thread is working on with
+the mutex released. */
 
-                /* open the soundfile with the mutex unlocked */
-            pthread_mutex_unlock(&x->x_mutex);
-            open_soundfile_via_namelist(dirname, filename, x->x_namelist,
-                &sf, onsetframes);
-            pthread_mutex_lock(&x->x_mutex);
+#define SFSTREAM_NTHREADS 2             /* number of I/O threads */
+#define SFSTREAM_MAXREAD (4 * READSIZE) /* most we read in one go */
+#define SFSTREAM_MAXSPARE 4             /* spare buffers to keep */
 
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: 5\n");
-#endif
-            if (sf.sf_fd < 0)
-            {
-                x->x_fileerror = errno;
-                x->x_eof = 1;
-#ifdef DEBUG_SOUNDFILE_THREADS
-                fprintf(stderr, "readsf~: open failed %s %s\n",
-                    filename, dirname);
-#endif
-                goto lost;
-            }
-                /* copy back into the instance structure. */
-            soundfile_copy(&x->x_sf, &sf);
-                /* check if another request has been made; if so, field it */
-            if (x->x_requestcode != REQUEST_BUSY)
-                goto lost;
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: 6\n");
-#endif
-            x->x_fifohead = 0;
-                    /* set fifosize from bufsize.  fifosize must be a
-                    multiple of the number of bytes eaten for each DSP
-                    tick.  We pessimistically assume MAXVECSIZE samples
-                    per tick since that could change.  There could be a
-                    problem here if the vector size increases while a
-                    soundfile is being played...  */
-            x->x_fifosize = x->x_bufsize - (x->x_bufsize %
-                (sf.sf_bytesperframe * MAXVECSIZE));
-                    /* arrange for the "request" condition to be signaled 16
-                    times per buffer */
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: fifosize %d\n", x->x_fifosize);
-#endif
-            x->x_sigcountdown = x->x_sigperiod = (x->x_fifosize /
-                (16 * sf.sf_bytesperframe * x->x_vecsize));
-                /* in a loop, wait for the fifo to get hungry and feed it */
+    /* spare buffers keep their size and the link in their first bytes */
+typedef struct _sfbuf
+{
+    struct _sfbuf *b_next;
+    int b_size;
+} t_sfbuf;
 
-            while (x->x_requestcode == REQUEST_BUSY)
-            {
-                int fifosize = x->x_fifosize;
-#ifdef DEBUG_SOUNDFILE_THREADS
-                fprintf(stderr, "readsf~: 77\n");
-#endif
-                if (x->x_eof)
-                    break;
-                if (x->x_fifohead >= x->x_fifotail)
-                {
-                        /* if the head is >= the tail, we can immediately read
-                        to the end of the fifo.  Unless, that is, we would
-                        read all the way to the end of the buffer and the
-                        "tail" is zero; this would fill the buffer completely
-                        which isn't allowed because you can't tell a completely
-                        full buffer from an empty one. */
-                    if (x->x_fifotail || (fifosize - x->x_fifohead > READSIZE))
-                    {
-                        wantbytes = fifosize - x->x_fifohead;
-                        if (wantbytes > READSIZE)
-                            wantbytes = READSIZE;
-                        if (sf.sf_bytelimit >= 0 && wantbytes > (size_t)sf.sf_bytelimit)
-                            wantbytes = sf.sf_bytelimit;
-#ifdef DEBUG_SOUNDFILE_THREADS
-                        fprintf(stderr, "readsf~: head %d, tail %d, size %ld\n",
-                            x->x_fifohead, x->x_fifotail, wantbytes);
-#endif
-                    }
-                    else
-                    {
-#ifdef DEBUG_SOUNDFILE_THREADS
-                        fprintf(stderr, "readsf~: wait 7a...\n");
-#endif
-                        sfread_cond_signal(&x->x_answercondition);
-#ifdef DEBUG_SOUNDFILE_THREADS
-                        fprintf(stderr, "readsf~: signaled...\n");
-#endif
-                        sfread_cond_wait(&x->x_requestcondition, &x->x_mutex);
-#ifdef DEBUG_SOUNDFILE_THREADS
-                        fprintf(stderr, "readsf~: 7a ... done\n");
-#endif
-                        continue;
-                    }
-                }
-                else
-                {
-                        /* otherwise check if there are at least READSIZE
-                        bytes to read.  If not, wait and loop back. */
-                    wantbytes =  x->x_fifotail - x->x_fifohead - 1;
-                    if (wantbytes < READSIZE)
-                    {
-#ifdef DEBUG_SOUNDFILE_THREADS
-                        fprintf(stderr, "readsf~: wait 7...\n");
-#endif
-                        sfread_cond_signal(&x->x_answercondition);
-                        sfread_cond_wait(&x->x_requestcondition, &x->x_mutex);
-#ifdef DEBUG_SOUNDFILE_THREADS
-                        fprintf(stderr, "readsf~: 7 ... done\n");
-#endif
-                        continue;
-                    }
-                    else wantbytes = READSIZE;
-                    if (sf.sf_bytelimit >= 0 && wantbytes > (size_t)sf.sf_bytelimit)
-                        wantbytes = sf.sf_bytelimit;
-                }
-#ifdef DEBUG_SOUNDFILE_THREADS
-                fprintf(stderr, "readsf~: 8\n");
-#endif
-                buf = x->x_buf;
-                fifohead = x->x_fifohead;
-                pthread_mutex_unlock(&x->x_mutex);
-                bytesread = read(sf.sf_fd, buf + fifohead, wantbytes);
-                pthread_mutex_lock(&x->x_mutex);
-                if (x->x_requestcode != REQUEST_BUSY)
-                    break;
-                if (bytesread < 0)
-                {
-#ifdef DEBUG_SOUNDFILE_THREADS
-                    fprintf(stderr, "readsf~: fileerror %d\n", errno);
-#endif
-                    x->x_fileerror = errno;
-                    break;
-                }
-                else if (bytesread == 0)
-                {
-                    x->x_eof = 1;
-                    break;
-                }
-                else
-                {
-                    x->x_fifohead += bytesread;
-                    sf.sf_bytelimit -= bytesread;
-                    if (x->x_fifohead == fifosize)
-                        x->x_fifohead = 0;
-                    if (sf.sf_bytelimit <= 0)
-                    {
-                        x->x_eof = 1;
-                        break;
-                    }
-                }
-#ifdef DEBUG_SOUNDFILE_THREADS
-                fprintf(stderr, "readsf~: after, head %d tail %d\n",
-                    x->x_fifohead, x->x_fifotail);
-#endif
-                    /* signal parent in case it's waiting for data */
-                sfread_cond_signal(&x->x_answercondition);
-            }
+static pthread_mutex_t sfstream_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sfstream_answercondition = PTHREAD_COND_INITIALIZER;
+static t_semaphore *sfstream_wakeup;
+static t_readsf *sfstream_list;     /* all readsf~ objects */
+static t_sfbuf *sfstream_spare;     /* buffers nobody's using */
+static int sfstream_nspare, sfstream_nthreads;
 
-        lost:
-            if (x->x_requestcode == REQUEST_BUSY)
-                x->x_requestcode = REQUEST_NOTHING;
-#ifdef DEBUG_SOUNDFILE_THREADS
-                fprintf(stderr, "readsf~: lost\n");
-#endif
-                /* fell out of read loop: close file if necessary,
-                set EOF and signal once more */
-            if (sf.sf_fd >= 0)
-            {
-                    /* only set EOF if there is no pending "open" request!
-                    Otherwise, we might accidentally set EOF after it has been
-                    unset in readsf_open() and the stream would fail silently. */
-                if (x->x_requestcode != REQUEST_OPEN)
-                    x->x_eof = 1;
-                x->x_sf.sf_fd = -1;
-                    /* use cached sf */
-                pthread_mutex_unlock(&x->x_mutex);
-                sys_close(sf.sf_fd);
-                sf.sf_fd = -1;
-                pthread_mutex_lock(&x->x_mutex);
-            }
-            sfread_cond_signal(&x->x_answercondition);
-        }
-        else if (x->x_requestcode == REQUEST_CLOSE)
+    /* wake an I/O thread.  As with sfthread_wake(), this is safe to call
+    from the perform routine. */
+#define sfstream_wake() sys_semaphore_post(sfstream_wakeup)
+
+    /* get a buffer for a stream that's about to play (main thread only) */
+static void sfstream_getbuf(t_readsf *x)
+{
+    t_sfbuf **bp;
+    if (x->x_buf)
+        return;
+    for (bp = &sfstream_spare; *bp; bp = &(*bp)->b_next)
+        if ((*bp)->b_size == x->x_bufsize)
+    {
+        x->x_buf = (char *)*bp;
+        *bp = (*bp)->b_next;
+        sfstream_nspare--;
+        return;
+    }
+    x->x_buf = getbytes(x->x_bufsize);
+}
+
+    /* give a stream's buffer back when it's done playing.  This may be
+    called from an I/O thread, so we don't free anything here. */
+static void sfstream_putbuf(t_readsf *x)
+{
+    t_sfbuf *b = (t_sfbuf *)x->x_buf;
+    if (!b)
+        return;
+    b->b_size = x->x_bufsize;
+    b->b_next = sfstream_spare;
+    sfstream_spare = b;
+    sfstream_nspare++;
+    x->x_buf = 0;
+}
+
+    /* free spare buffers beyond SFSTREAM_MAXSPARE (main thread only) */
+static void sfstream_trim(void)
+{
+    while (sfstream_nspare > SFSTREAM_MAXSPARE)
+    {
+        t_sfbuf *b = sfstream_spare;
+        sfstream_spare = b->b_next;
+        sfstream_nspare--;
+        freebytes(b, b->b_size);
+    }
+}
+
+    /* close the file with the mutex released */
+static void sfstream_closefile(t_readsf *x)
+{
+    int fd = x->x_iosf.sf_fd;
+    t_sfconvert *convert = x->x_convert;
+    x->x_iosf.sf_fd = x->x_sf.sf_fd = -1;
+    x->x_convert = 0;
+    pthread_mutex_unlock(&sfstream_mutex);
+    sys_close(fd);
+    if (convert)
+        sfconvert_free(convert);
+    pthread_mutex_lock(&sfstream_mutex);
+}
+
+static void sfstream_open(t_readsf *x)
+{
+        /* copy file stuff out of the data structure so we can
+        relinquish the mutex while we're in open_soundfile_via_path() */
+    size_t onsetframes = x->x_onsetframes;
+    const char *filename = x->x_filename;
+    const char *dirname = canvas_getdir(x->x_canvas)->s_name;
+    int resample = x->x_resample;
+    t_float dsprate = x->x_dsprate;
+    t_sfconvert *convert = 0;
+    t_soundfile sf;
+    int err;
+        /* alter the request code so that an ensuing "open" will get
+        noticed. */
+    x->x_requestcode = REQUEST_BUSY;
+    x->x_fileerror = 0;
+
+        /* if there's already a file open, close it */
+    if (x->x_iosf.sf_fd >= 0)
+    {
+        sfstream_closefile(x);
+        if (x->x_requestcode != REQUEST_BUSY)
+            return;
+    }
+        /* cache sf *after* closing as x->sf's type
+            may have changed in readsf_open() */
+    soundfile_copy(&sf, &x->x_sf);
+
+        /* open the soundfile with the mutex unlocked */
+    pthread_mutex_unlock(&sfstream_mutex);
+    open_soundfile_via_namelist(dirname, filename, x->x_namelist,
+        &sf, onsetframes);
+    err = errno;
+        /* this takes a moment for the filter design, so do it here too */
+    if (sf.sf_fd >= 0 && resample >= 0)
+        convert = sfconvert_new(&sf, sf.sf_nchannels, dsprate, resample);
+    pthread_mutex_lock(&sfstream_mutex);
+    soundfile_copy(&x->x_iosf, &sf);
+    x->x_convert = convert;
+        /* check if another request has been made; if so, it will take care
+        of the file we just opened */
+    if (x->x_requestcode != REQUEST_BUSY)
+        return;
+    if (sf.sf_fd < 0)
+    {
+        x->x_fileerror = err;
+        x->x_requestcode = REQUEST_NOTHING;
+        atomic_int_store(&x->x_eof, 1);
+        return;
+    }
+        /* copy back into the instance structure.  If we're resampling,
+        the fifo holds the converted frames as native floats. */
+    soundfile_copy(&x->x_sf, &sf);
+    if (convert)
+    {
+        x->x_sf.sf_samplerate = dsprate;
+        x->x_sf.sf_bytespersample = 4;
+        x->x_sf.sf_bigendian = sys_isbigendian();
+        x->x_sf.sf_bytesperframe = 4 * sf.sf_nchannels;
+    }
+    atomic_int_store(&x->x_fifohead, 0);
+        /* set fifosize from bufsize.  fifosize must be a
+        multiple of the number of bytes eaten for each DSP
+        tick.  We pessimistically assume MAXVECSIZE samples
+        per tick since that could change.  There could be a
+        problem here if the vector size increases while a
+        soundfile is being played...  */
+    x->x_fifosize = x->x_bufsize - (x->x_bufsize %
+        (x->x_sf.sf_bytesperframe * MAXVECSIZE));
+        /* arrange for the I/O threads to be woken 16 times per buffer */
+    x->x_sigcountdown = x->x_sigperiod = (x->x_fifosize /
+        (16 * x->x_sf.sf_bytesperframe * x->x_vecsize));
+}
+
+    /* how much we can read into the fifo in one go, or zero if it's too
+    full to bother yet */
+static size_t sfstream_wantbytes(t_readsf *x)
+{
+    int fifosize = x->x_fifosize,
+        fifohead = atomic_int_load(&x->x_fifohead),
+        fifotail = atomic_int_load(&x->x_fifotail);
+    size_t wantbytes;
+    if (fifohead >= fifotail)
+    {
+            /* if the head is >= the tail, we can immediately read
+            to the end of the fifo.  Unless, that is, we would
+            read all the way to the end of the buffer and the
+            "tail" is zero; this would fill the buffer completely
+            which isn't allowed because you can't tell a completely
+            full buffer from an empty one. */
+        if (fifotail)
+            wantbytes = fifosize - fifohead;
+        else if (fifosize - fifohead > READSIZE)
+            wantbytes = (fifosize - fifohead - 1) / READSIZE * READSIZE;
+        else return (0);
+    }
+        /* otherwise check if there are at least READSIZE bytes to read. */
+    else if ((wantbytes = fifotail - fifohead - 1) < READSIZE)
+        return (0);
+    if (wantbytes > SFSTREAM_MAXREAD)
+        wantbytes = SFSTREAM_MAXREAD;
+        /* converting takes longer than reading; do less at a time so the
+        first data get there sooner */
+    if (x->x_convert && wantbytes > READSIZE)
+        wantbytes = READSIZE;
+    if (!x->x_convert && x->x_iosf.sf_bytelimit >= 0 &&
+        wantbytes > (size_t)x->x_iosf.sf_bytelimit)
+            wantbytes = x->x_iosf.sf_bytelimit;
+    return (wantbytes);
+}
+
+    /* how full the buffer is, from 0 to 1 */
+static double sfstream_fill(t_readsf *x)
+{
+    int used = atomic_int_load(&x->x_fifohead) -
+        atomic_int_load(&x->x_fifotail);
+    if (used < 0)
+        used += x->x_fifosize;
+    return ((double)used / x->x_fifosize);
+}
+
+    /* the same for a file we're resampling: read, decode, and convert with
+    the mutex released, and put whole frames of native floats in the fifo */
+static void sfstream_convert(t_readsf *x, size_t wantbytes)
+{
+    t_sfconvert *c = x->x_convert;
+    int fifohead = atomic_int_load(&x->x_fifohead),
+        nchannels = c->c_nchannels, eof = 0, n, i, k;
+    size_t nframes = wantbytes / (nchannels * sizeof(float)), done = 0;
+    float *fp = (float *)(x->x_buf + fifohead);
+    pthread_mutex_unlock(&sfstream_mutex);
+    while (done < nframes)
+    {
+        size_t want = nframes - done;
+        if (!(n = sfconvert_pull(c, &x->x_iosf,
+            (want > SFCONVFRAMES ? SFCONVFRAMES : (int)want))))
         {
-            if (sf.sf_fd >= 0)
-            {
-                x->x_sf.sf_fd = -1;
-                    /* use cached sf */
-                pthread_mutex_unlock(&x->x_mutex);
-                sys_close(sf.sf_fd);
-                sf.sf_fd = -1;
-                pthread_mutex_lock(&x->x_mutex);
-            }
-            if (x->x_requestcode == REQUEST_CLOSE)
-                x->x_requestcode = REQUEST_NOTHING;
-            sfread_cond_signal(&x->x_answercondition);
+            eof = 1;
+            break;
         }
-        else if (x->x_requestcode == REQUEST_QUIT)
+        for (k = 0; k < n; k++)
+            for (i = 0; i < nchannels; i++)
+                *fp++ = c->c_out[i][k];
+        done += n;
+    }
+    pthread_mutex_lock(&sfstream_mutex);
+    if (x->x_requestcode != REQUEST_BUSY)
+        return;
+    if (done)
+    {
+        fifohead += done * nchannels * sizeof(float);
+        if (fifohead == x->x_fifosize)
+            fifohead = 0;
+        atomic_int_store(&x->x_fifohead, fifohead);
+    }
+    if (!eof)
+        return;
+    if (c->c_error)
+        x->x_fileerror = c->c_error;
+    x->x_requestcode = REQUEST_NOTHING;
+    atomic_int_store(&x->x_eof, 1);
+    sfstream_closefile(x);
+}
+
+static void sfstream_read(t_readsf *x, size_t wantbytes)
+{
+    int fifohead = atomic_int_load(&x->x_fifohead), err;
+    ssize_t bytesread;
+    if (x->x_convert)
+    {
+        sfstream_convert(x, wantbytes);
+        return;
+    }
+    pthread_mutex_unlock(&sfstream_mutex);
+    bytesread = read(x->x_iosf.sf_fd, x->x_buf + fifohead, wantbytes);
+    err = errno;
+    pthread_mutex_lock(&sfstream_mutex);
+    if (x->x_requestcode != REQUEST_BUSY)
+        return;
+    if (bytesread > 0)
+    {
+            /* publish the new data to the perform routine */
+        fifohead += bytesread;
+        x->x_iosf.sf_bytelimit -= bytesread;
+        if (fifohead == x->x_fifosize)
+            fifohead = 0;
+        atomic_int_store(&x->x_fifohead, fifohead);
+        if (x->x_iosf.sf_bytelimit > 0)
+            return;
+    }
+    else if (bytesread < 0)
+        x->x_fileerror = err;
+        /* end of file or error: close the file and stop */
+    x->x_requestcode = REQUEST_NOTHING;
+    atomic_int_store(&x->x_eof, 1);
+    sfstream_closefile(x);
+}
+
+static void *sfstream_threadmain(void *dummy)
+{
+    pthread_mutex_lock(&sfstream_mutex);
+    while (1)
+    {
+        t_readsf *x, *best = 0;
+        size_t wantbytes = 0, n;
+        double fill, bestfill = 2;
+        for (x = sfstream_list; x; x = x->x_next)
         {
-            if (sf.sf_fd >= 0)
+            if (x->x_busy || x->x_requestcode == REQUEST_NOTHING ||
+                x->x_requestcode == REQUEST_QUIT)
+                    continue;
+            if (x->x_requestcode != REQUEST_BUSY)
             {
-                x->x_sf.sf_fd = -1;
-                    /* use cached sf */
-                pthread_mutex_unlock(&x->x_mutex);
-                sys_close(sf.sf_fd);
-                sf.sf_fd = -1;
-                pthread_mutex_lock(&x->x_mutex);
+                best = x;
+                break;
             }
-            x->x_requestcode = REQUEST_NOTHING;
-            sfread_cond_signal(&x->x_answercondition);
-            break;
+            if ((n = sfstream_wantbytes(x)) &&
+                (fill = sfstream_fill(x)) < bestfill)
+                    best = x, bestfill = fill, wantbytes = n;
         }
-        else
+        if (!best)
         {
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: 13\n");
+            pthread_mutex_unlock(&sfstream_mutex);
+            sys_semaphore_wait(sfstream_wakeup);
+            pthread_mutex_lock(&sfstream_mutex);
+            continue;
+        }
+        best->x_busy = 1;
+#ifdef PDINSTANCE
+        pd_this = best->x_pd_this;
 #endif
+        if (best->x_requestcode == REQUEST_OPEN)
+            sfstream_open(best);
+        else if (best->x_requestcode == REQUEST_CLOSE)
+        {
+            if (best->x_iosf.sf_fd >= 0)
+                sfstream_closefile(best);
+            if (best->x_requestcode == REQUEST_CLOSE)
+            {
+                best->x_requestcode = REQUEST_NOTHING;
+                sfstream_putbuf(best);
+            }
         }
+        else sfstream_read(best, wantbytes);
+        best->x_busy = 0;
+        sfread_cond_broadcast(&sfstream_answercondition);
     }
-#ifdef DEBUG_SOUNDFILE_THREADS
-    fprintf(stderr, "readsf~: thread exit\n");
-#endif
-    pthread_mutex_unlock(&x->x_mutex);
-    return 0;
+    return (0);
+}
+
+    /* start the I/O threads the first time a readsf~ is made */
+static int sfstream_start(void)
+{
+    pthread_t thread;
+    pthread_mutex_lock(&sfstream_mutex);
+    if (!sfstream_wakeup)
+        sfstream_wakeup = sys_semaphore_create();
+    while (sfstream_nthreads < SFSTREAM_NTHREADS &&
+        !pthread_create(&thread, 0, sfstream_threadmain, 0))
+    {
+        pthread_detach(thread);
+        sfstream_nthreads++;
+    }
+    pthread_mutex_unlock(&sfstream_mutex);
+    return (sfstream_nthreads > 0);
 }
 
 /* ----- the object proper runs in the calling (parent) thread ----- */
@@ -2107,7 +3036,6 @@ static void *readsf_new(t_symbol *s, int argc, t_atom *argv)
 {
     t_readsf *x;
     int nchannels, bufsize, i, multi = 0;
-    char *buf;
 
         /* [-m] [nchans] [bufsize] */
     if (argc && argv[0].a_type == A_SYMBOL &&
@@ -2128,8 +3056,11 @@ static void *readsf_new(t_symbol *s, int argc, t_atom *argv)
         bufsize = MINBUFSIZE;
     else if (bufsize > MAXBUFSIZE)
         bufsize = MAXBUFSIZE;
-    buf = getbytes(bufsize);
-    if (!buf) return 0;
+    if (!sfstream_start())
+    {
+        pd_error(0, "readsf~: couldn't start I/O thread");
+        return 0;
+    }
 
     x = (t_readsf *)pd_new(readsf_class);
     if (multi) /* create a single (multichannel) outlet */
@@ -2139,9 +3070,6 @@ static void *readsf_new(t_symbol *s, int argc, t_atom *argv)
             outlet_new(&x->x_obj, gensym("signal"));
     x->x_nchannels = nchannels;
     x->x_bangout = outlet_new(&x->x_obj, &s_bang);
-    pthread_mutex_init(&x->x_mutex, 0);
-    pthread_cond_init(&x->x_requestcondition, 0);
-    pthread_cond_init(&x->x_answercondition, 0);
     x->x_vecsize = MAXVECSIZE;
     x->x_state = STATE_IDLE;
     x->x_clock = clock_new(x, (t_method)readsf_tick);
@@ -2151,22 +3079,62 @@ static void *readsf_new(t_symbol *s, int argc, t_atom *argv)
     x->x_sf.sf_bytespersample = 2;
     x->x_sf.sf_nchannels = 1;
     x->x_sf.sf_bytesperframe = 2;
-    x->x_buf = buf;
+    soundfile_clear(&x->x_iosf);
+    x->x_resample = -1;
+    x->x_dsprate = sys_getsr();
+    x->x_gotdata = 0;
+    x->x_convert = 0;
+    x->x_buf = 0;   /* we get one from the pool when a file is opened */
     x->x_bufsize = bufsize;
-    x->x_fifosize = x->x_fifohead = x->x_fifotail = x->x_requestcode = 0;
+    x->x_fifosize = x->x_requestcode = x->x_busy = 0;
+    atomic_int_store(&x->x_fifohead, 0);
+    atomic_int_store(&x->x_fifotail, 0);
+    atomic_int_store(&x->x_eof, 0);
+    x->x_xruns = 0;
     x->x_namelist = 0;
 #ifdef PDINSTANCE
     x->x_pd_this = pd_this;
 #endif
-    pthread_create(&x->x_childthread, 0, readsf_child_main, x);
+    pthread_mutex_lock(&sfstream_mutex);
+    x->x_next = sfstream_list;
+    sfstream_list = x;
+    pthread_mutex_unlock(&sfstream_mutex);
     return x;
 }
 
+    /* called after the perform routine hits the end of the file: send a
+    bang and, if the I/O threads are done with it too, give the buffer back */
 static void readsf_tick(t_readsf *x)
 {
+    pthread_mutex_lock(&sfstream_mutex);
+    if (x->x_state == STATE_IDLE && x->x_requestcode == REQUEST_NOTHING &&
+        !x->x_busy)
+    {
+        sfstream_putbuf(x);
+        sfstream_trim();
+    }
+    pthread_mutex_unlock(&sfstream_mutex);
     outlet_bang(x->x_bangout);
 }
 
+    /* in batch mode, wait for the child thread to bring in a block's worth
+    of data or to hit the end of the file */
+static void readsf_waitfordata(t_readsf *x, int vecsize)
+{
+    pthread_mutex_lock(&sfstream_mutex);
+    while (!atomic_int_load(&x->x_eof))
+    {
+        int fifohead = atomic_int_load(&x->x_fifohead),
+            fifotail = atomic_int_load(&x->x_fifotail);
+        if (fifohead < fifotail || (fifohead > fifotail &&
+            fifohead - fifotail >= vecsize * x->x_sf.sf_bytesperframe))
+                break;
+        sfstream_wake();
+        sfread_cond_wait(&sfstream_answercondition, &sfstream_mutex);
+    }
+    pthread_mutex_unlock(&sfstream_mutex);
+}
+
 static t_int *readsf_perform(t_int *w)
 {
     t_readsf *x = (t_readsf *)(w[1]);
@@ -2175,45 +3143,47 @@ static t_int *readsf_perform(t_int *w)
     t_sample *fp;
     if (x->x_state == STATE_STREAM)
     {
-        int wantbytes;
-        t_soundfile sf = {0};
-        pthread_mutex_lock(&x->x_mutex);
-            /* copy with mutex locked! */
-        soundfile_copy(&sf, &x->x_sf);
-        wantbytes = vecsize * sf.sf_bytesperframe;
-        while (!x->x_eof && x->x_fifohead >= x->x_fifotail &&
-                x->x_fifohead < x->x_fifotail + wantbytes-1)
-        {
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: wait...\n");
-#endif
-            sfread_cond_signal(&x->x_requestcondition);
-            sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
-                /* resync local variables -- bug fix thanks to Shahrokh */
-            vecsize = x->x_vecsize;
-            soundfile_copy(&sf, &x->x_sf);
-            wantbytes = vecsize * sf.sf_bytesperframe;
-#ifdef DEBUG_SOUNDFILE_THREADS
-            fprintf(stderr, "readsf~: ... done\n");
-#endif
-        }
-        if (x->x_eof && x->x_fifohead >= x->x_fifotail &&
-            x->x_fifohead < x->x_fifotail + wantbytes-1)
-        {
-            int xfersize;
+        int wantbytes, fifohead, eof, xfersize = 0,
+            fifotail = atomic_int_load(&x->x_fifotail);
+        if (sys_batch)
+            readsf_waitfordata(x, vecsize);
+            /* check for EOF first: once it's set, the head doesn't move */
+        eof = atomic_int_load(&x->x_eof);
+        fifohead = atomic_int_load(&x->x_fifohead);
+            /* the child thread fills in x_sf before it first advances the
+            head, so we can't look at it before there's data */
+        if (fifohead != fifotail)
+        {
+            wantbytes = vecsize * x->x_sf.sf_bytesperframe;
+            x->x_gotdata = 1;
+        }
+        else wantbytes = 0;
+        if (!wantbytes ||
+            (fifohead > fifotail && fifohead - fifotail < wantbytes))
+        {
+            if (!eof)
+            {
+                    /* the disk didn't keep up; output zeros and try again
+                    on the next block.  Until the first data come in (as
+                    when "start" follows "open" right away) that's just
+                    startup, not an underrun. */
+                if (x->x_gotdata)
+                    x->x_xruns++;
+                sfstream_wake();
+                goto zero;
+            }
             if (x->x_fileerror)
                 object_sferror(x, "[readsf~]", x->x_filename,
                     x->x_fileerror, &x->x_sf);
                 /* if there's a partial buffer left, copy it out */
-            xfersize = (x->x_fifohead - x->x_fifotail + 1) /
-                       sf.sf_bytesperframe;
+            if (wantbytes)
+                xfersize = (fifohead - fifotail) / x->x_sf.sf_bytesperframe;
             if (xfersize)
             {
-                soundfile_xferin_sample(&sf, nchans, x->x_vec, 0,
-                    (unsigned char *)(x->x_buf + x->x_fifotail), xfersize);
+                soundfile_xferin_sample(&x->x_sf, nchans, x->x_vec, 0,
+                    (unsigned char *)(x->x_buf + fifotail), xfersize);
                 vecsize -= xfersize;
             }
-            pthread_mutex_unlock(&x->x_mutex);
                 /* send bang and zero out the (rest of the) output */
             clock_delay(x->x_clock, 0);
             x->x_state = STATE_IDLE;
@@ -2223,25 +3193,24 @@ static t_int *readsf_perform(t_int *w)
             return w + 2;
         }
 
-        soundfile_xferin_sample(&sf, nchans, x->x_vec, 0,
-            (unsigned char *)(x->x_buf + x->x_fifotail), vecsize);
+        soundfile_xferin_sample(&x->x_sf, nchans, x->x_vec, 0,
+            (unsigned char *)(x->x_buf + fifotail), vecsize);
 
-        x->x_fifotail += wantbytes;
-        if (x->x_fifotail >= x->x_fifosize)
-            x->x_fifotail = 0;
+        fifotail += wantbytes;
+        if (fifotail >= x->x_fifosize)
+            fifotail = 0;
+        atomic_int_store(&x->x_fifotail, fifotail);
         if ((--x->x_sigcountdown) <= 0)
         {
-            sfread_cond_signal(&x->x_requestcondition);
+            sfstream_wake();
             x->x_sigcountdown = x->x_sigperiod;
         }
-        pthread_mutex_unlock(&x->x_mutex);
-    }
-    else
-    {
-        for (i = 0; i < nchans; i++)
-            for (j = vecsize, fp = x->x_vec[i]; j--;)
-                *fp++ = 0;
+        return w + 2;
     }
+zero:
+    for (i = 0; i < nchans; i++)
+        for (j = vecsize, fp = x->x_vec[i]; j--;)
+            *fp++ = 0;
     return w + 2;
 }
 
@@ -2257,11 +3226,11 @@ static void readsf_start(t_readsf *x)
     /** LATER rethink whether you need the mutex just to set a variable? */
 static void readsf_stop(t_readsf *x)
 {
-    pthread_mutex_lock(&x->x_mutex);
+    pthread_mutex_lock(&sfstream_mutex);
     x->x_state = STATE_IDLE;
     x->x_requestcode = REQUEST_CLOSE;
-    sfread_cond_signal(&x->x_requestcondition);
-    pthread_mutex_unlock(&x->x_mutex);
+    sfstream_wake();
+    pthread_mutex_unlock(&sfstream_mutex);
 }
 
 static void readsf_float(t_readsf *x, t_floatarg f)
@@ -2287,13 +3256,24 @@ static void readsf_open(t_readsf *x, t_symbol *s, int argc, t_atom *argv)
     t_symbol *filesym, *endian;
     t_float onsetframes, headersize, nchannels, bytespersample;
     t_soundfile_type *type = NULL;
+    int resample = -1;
 
     while (argc > 0 && argv->a_type == A_SYMBOL &&
         *argv->a_w.w_symbol->s_name == '-')
     {
-            /* check for type by name */
         const char *flag = argv->a_w.w_symbol->s_name + 1;
-        if (!(type = soundfile_findtype(flag)))
+        if (!strcmp(flag, "resample"))
+        {
+                /* optionally followed by the quality */
+            resample = SFRESAMPLE_DEFQUALITY;
+            if (argc >= 2 && argv[1].a_type == A_FLOAT)
+            {
+                resample = argv[1].a_w.w_float;
+                argc--; argv++;
+            }
+        }
+            /* check for type by name */
+        else if (!(type = soundfile_findtype(flag)))
             goto usage; /* unknown flag */
         argc -= 1; argv += 1;
     }
@@ -2306,7 +3286,9 @@ static void readsf_open(t_readsf *x, t_symbol *s, int argc, t_atom *argv)
     if (!*filesym->s_name)
         return; /* no filename */
 
-    pthread_mutex_lock(&x->x_mutex);
+    pthread_mutex_lock(&sfstream_mutex);
+    sfstream_getbuf(x);
+    sfstream_trim();
     if (x->x_namelist)
         namelist_free(x->x_namelist), x->x_namelist = 0;
         /* see open_soundfile_via_namelist() */
@@ -2325,8 +3307,8 @@ static void readsf_open(t_readsf *x, t_symbol *s, int argc, t_atom *argv)
     soundfile_clear(&x->x_sf);
     x->x_requestcode = REQUEST_OPEN;
     x->x_filename = filesym->s_name;
-    x->x_fifotail = 0;
-    x->x_fifohead = 0;
+    atomic_int_store(&x->x_fifotail, 0);
+    atomic_int_store(&x->x_fifohead, 0);
     if (*endian->s_name == 'b')
          x->x_sf.sf_bigendian = 1;
     else if (*endian->s_name == 'l')
@@ -2335,6 +3317,7 @@ static void readsf_open(t_readsf *x, t_symbol *s, int argc, t_atom *argv)
         pd_error(x, "[readsf~] open: endianness neither 'b' nor 'l'");
     else x->x_sf.sf_bigendian = sys_isbigendian();
     x->x_onsetframes = (onsetframes > 0 ? onsetframes : 0);
+    x->x_resample = resample;
     x->x_sf.sf_headersize = (headersize > 0 ? headersize :
         (headersize == 0 ? -1 : 0));
     x->x_sf.sf_nchannels = (nchannels >= 1 ? nchannels : 1);
@@ -2347,16 +3330,18 @@ static void readsf_open(t_readsf *x, t_symbol *s, int argc, t_atom *argv)
     }
     else
         x->x_sf.sf_type = type;
-    x->x_eof = 0;
+    atomic_int_store(&x->x_eof, 0);
     x->x_fileerror = 0;
+    x->x_xruns = 0;
+    x->x_gotdata = 0;
     x->x_state = STATE_STARTUP;
-    sfread_cond_signal(&x->x_requestcondition);
-    pthread_mutex_unlock(&x->x_mutex);
+    sfstream_wake();
+    pthread_mutex_unlock(&sfstream_mutex);
     return;
 usage:
     pd_error(x, "[readsf~]: usage; open [flags] filename [onset] [headersize]...");
     pd_error(0, "[nchannels] [bytespersample] [endian (b or l)]");
-    post("flags: %s", sf_typeargs);
+    post("flags: %s -resample [<quality 0-2>]", sf_typeargs);
 }
 
 static void readsf_channels(t_readsf *x, t_floatarg f)
@@ -2373,7 +3358,7 @@ static void readsf_channels(t_readsf *x, t_floatarg f)
         if (nchans != x->x_nchannels)
         {
             x->x_nchannels = nchans;
-            canvas_update_dsp();
+            canvas_update_dsp_local(x->x_canvas);
         }
     }
     else pd_error(x,
@@ -2383,9 +3368,11 @@ static void readsf_channels(t_readsf *x, t_floatarg f)
 static void readsf_dsp(t_readsf *x, t_signal **sp)
 {
     int i, nchans = x->x_nchannels;
-    pthread_mutex_lock(&x->x_mutex);
+    pthread_mutex_lock(&sfstream_mutex);
     x->x_vecsize = sp[0]->s_length;
-    x->x_sigperiod = x->x_fifosize / (x->x_sf.sf_bytesperframe * x->x_vecsize);
+    x->x_dsprate = sp[0]->s_sr;
+    x->x_sigperiod = x->x_fifosize /
+        (16 * x->x_sf.sf_bytesperframe * x->x_vecsize);
     if (x->x_multi) /* multichannel mode */
     {
         signal_setmultiout(&sp[0], nchans);
@@ -2400,40 +3387,40 @@ static void readsf_dsp(t_readsf *x, t_signal **sp)
             x->x_vec[i] = sp[i]->s_vec;
         }
     }
-    pthread_mutex_unlock(&x->x_mutex);
+    pthread_mutex_unlock(&sfstream_mutex);
     dsp_add(readsf_perform, 1, x);
 }
 
 static void readsf_print(t_readsf *x)
 {
     post("state %d", x->x_state);
-    post("fifo head %d", x->x_fifohead);
-    post("fifo tail %d", x->x_fifotail);
+    post("fifo head %d", atomic_int_load(&x->x_fifohead));
+    post("fifo tail %d", atomic_int_load(&x->x_fifotail));
     post("fifo size %d", x->x_fifosize);
     post("fd %d", x->x_sf.sf_fd);
-    post("eof %d", x->x_eof);
+    post("eof %d", atomic_int_load(&x->x_eof));
+    post("underruns %d", x->x_xruns);
 }
 
-    /** request QUIT and wait for acknowledge */
+    /** wait until the I/O threads leave us alone, and take us out of
+        their list */
 static void readsf_free(t_readsf *x)
 {
-    void *threadrtn;
-    pthread_mutex_lock(&x->x_mutex);
+    t_readsf **xp;
+    pthread_mutex_lock(&sfstream_mutex);
     x->x_requestcode = REQUEST_QUIT;
-    sfread_cond_signal(&x->x_requestcondition);
-    while (x->x_requestcode != REQUEST_NOTHING)
-    {
-        sfread_cond_signal(&x->x_requestcondition);
-        sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
-    }
-    pthread_mutex_unlock(&x->x_mutex);
-    if (pthread_join(x->x_childthread, &threadrtn))
-        pd_error(x, "[readsf~] free: join failed");
-
-    pthread_cond_destroy(&x->x_requestcondition);
-    pthread_cond_destroy(&x->x_answercondition);
-    pthread_mutex_destroy(&x->x_mutex);
-    freebytes(x->x_buf, x->x_bufsize);
+    while (x->x_busy)
+        sfread_cond_wait(&sfstream_answercondition, &sfstream_mutex);
+    for (xp = &sfstream_list; *xp != x; xp = &(*xp)->x_next)
+        ;
+    *xp = x->x_next;
+    if (x->x_iosf.sf_fd >= 0)
+        sfstream_closefile(x);
+    sfstream_putbuf(x);
+    sfstream_trim();
+    pthread_mutex_unlock(&sfstream_mutex);
+    if (x->x_namelist)
+        namelist_free(x->x_namelist);
     clock_free(x->x_clock);
 }
 
@@ -2442,6 +3429,7 @@ static void readsf_setup(void)
     readsf_class = class_new(gensym("readsf~"),
         (t_newmethod)readsf_new, (t_method)readsf_free,
         sizeof(t_readsf), CLASS_MULTICHANNEL, A_GIMME, 0);
+    class_setdspshared(readsf_class);
     class_addfloat(readsf_class, (t_method)readsf_float);
     class_addmethod(readsf_class, (t_method)readsf_start, gensym("start"), 0);
     class_addmethod(readsf_class, (t_method)readsf_stop, gensym("stop"), 0);
@@ -2485,7 +3473,7 @@ static void *writesf_child_main(void *zz)
             fprintf(stderr, "writesf~: wait 2\n");
 #endif
             sfread_cond_signal(&x->x_answercondition);
-            sfread_cond_wait(&x->x_requestcondition, &x->x_mutex);
+            sfthread_wait(x);
 #ifdef DEBUG_SOUNDFILE_THREADS
             fprintf(stderr, "writesf~: 3\n");
 #endif
@@ -2545,8 +3533,8 @@ static void *writesf_child_main(void *zz)
             if (sf.sf_fd < 0)
             {
                 x->x_sf.sf_fd = -1;
-                x->x_eof = 1;
                 x->x_fileerror = errno;
+                atomic_int_store(&x->x_eof, 1);
 #ifdef DEBUG_SOUNDFILE_THREADS
                 fprintf(stderr, "writesf~: open failed %s\n", filename);
 #endif
@@ -2560,15 +3548,18 @@ static void *writesf_child_main(void *zz)
 #endif
                 /* copy back into the instance structure. */
             soundfile_copy(&x->x_sf, &sf);
-            x->x_fifotail = 0;
+            atomic_int_store(&x->x_fifotail, 0);
             x->x_frameswritten = 0;
                 /* in a loop, wait for the fifo to have data and write it
                     to disk */
             while (x->x_requestcode == REQUEST_BUSY ||
                 (x->x_requestcode == REQUEST_CLOSE &&
-                    x->x_fifohead != x->x_fifotail))
+                    atomic_int_load(&x->x_fifohead) !=
+                        atomic_int_load(&x->x_fifotail)))
             {
-                int fifosize = x->x_fifosize, fifotail, updated;
+                int fifosize = x->x_fifosize, updated;
+                int fifohead = atomic_int_load(&x->x_fifohead),
+                    fifotail = atomic_int_load(&x->x_fifotail);
                 char *buf = x->x_buf;
                 off_t sought;
 #ifdef DEBUG_SOUNDFILE_THREADS
@@ -2578,13 +3569,12 @@ static void *writesf_child_main(void *zz)
                     from tail to end of fifo to disk; otherwise we hold off
                     writing until there are at least WRITESIZE bytes in the
                     buffer */
-                if (x->x_fifohead < x->x_fifotail ||
-                    x->x_fifohead >= x->x_fifotail + WRITESIZE
+                if (fifohead < fifotail || fifohead >= fifotail + WRITESIZE
                     || (x->x_requestcode == REQUEST_CLOSE &&
-                        x->x_fifohead != x->x_fifotail))
+                        fifohead != fifotail))
                 {
-                    writebytes = (x->x_fifohead < x->x_fifotail ?
-                        fifosize : x->x_fifohead) - x->x_fifotail;
+                    writebytes = (fifohead < fifotail ?
+                        fifosize : fifohead) - fifotail;
                     if (writebytes > READSIZE)
                         writebytes = READSIZE;
                 }
@@ -2594,11 +3584,7 @@ static void *writesf_child_main(void *zz)
                     fprintf(stderr, "writesf~: wait 7a...\n");
 #endif
                     sfread_cond_signal(&x->x_answercondition);
-#ifdef DEBUG_SOUNDFILE_THREADS
-                    fprintf(stderr, "writesf~: signaled...\n");
-#endif
-                    sfread_cond_wait(&x->x_requestcondition,
-                        &x->x_mutex);
+                    sfthread_wait(x);
 #ifdef DEBUG_SOUNDFILE_THREADS
                     fprintf(stderr, "writesf~: 7a ... done\n");
 #endif
@@ -2607,7 +3593,6 @@ static void *writesf_child_main(void *zz)
 #ifdef DEBUG_SOUNDFILE_THREADS
                 fprintf(stderr, "writesf~: 8\n");
 #endif
-                fifotail = x->x_fifotail;
                 soundfile_copy(&sf, &x->x_sf);
                 pthread_mutex_unlock(&x->x_mutex);
                 byteswritten = write(sf.sf_fd, buf + fifotail, writebytes);
@@ -2625,9 +3610,11 @@ static void *writesf_child_main(void *zz)
                 }
                 else
                 {
-                    x->x_fifotail += byteswritten;
-                    if (x->x_fifotail == fifosize)
-                        x->x_fifotail = 0;
+                        /* hand the space back to the perform routine */
+                    fifotail += byteswritten;
+                    if (fifotail == fifosize)
+                        fifotail = 0;
+                    atomic_int_store(&x->x_fifotail, fifotail);
                 }
                 x->x_frameswritten += byteswritten / sf.sf_bytesperframe;
                 pthread_mutex_unlock(&x->x_mutex);
@@ -2650,7 +3637,7 @@ static void *writesf_child_main(void *zz)
                 }
 #ifdef DEBUG_SOUNDFILE_THREADS
                 fprintf(stderr, "writesf~: after head %d tail %d written %ld\n",
-                    x->x_fifohead, x->x_fifotail, x->x_frameswritten);
+                    fifohead, fifotail, x->x_frameswritten);
 #endif
                     /* signal parent in case it's waiting for data */
                 sfread_cond_signal(&x->x_answercondition);
@@ -2667,7 +3654,7 @@ static void *writesf_child_main(void *zz)
                      sys_close(sf.sf_fd);
                      sf.sf_fd = -1;
                      pthread_mutex_lock(&x->x_mutex);
-                     x->x_eof = 1;
+                     atomic_int_store(&x->x_eof, 1);
                      x->x_sf.sf_fd = -1;
                  }
                  sfread_cond_signal(&x->x_answercondition);
@@ -2738,7 +3725,7 @@ static void *writesf_new(t_floatarg fnchannels, t_floatarg fbufsize)
     x->x_f = 0;
     x->x_nchannels = x->x_ninlets = nchannels;
     pthread_mutex_init(&x->x_mutex, 0);
-    pthread_cond_init(&x->x_requestcondition, 0);
+    x->x_wakeup = sys_semaphore_create();
     pthread_cond_init(&x->x_answercondition, 0);
     x->x_vecsize = MAXVECSIZE;
     x->x_insamplerate = 0;
@@ -2749,9 +3736,14 @@ static void *writesf_new(t_floatarg fnchannels, t_floatarg fbufsize)
     x->x_sf.sf_nchannels = nchannels;
     x->x_sf.sf_bytespersample = 2;
     x->x_sf.sf_bytesperframe = nchannels * 2;
+    soundfile_copy(&x->x_dspsf, &x->x_sf);
     x->x_buf = buf;
     x->x_bufsize = bufsize;
-    x->x_fifosize = x->x_fifohead = x->x_fifotail = x->x_requestcode = 0;
+    x->x_fifosize = x->x_requestcode = 0;
+    atomic_int_store(&x->x_fifohead, 0);
+    atomic_int_store(&x->x_fifotail, 0);
+    atomic_int_store(&x->x_eof, 0);
+    x->x_xruns = 0;
 #ifdef PDINSTANCE
     x->x_pd_this = pd_this;
 #endif
@@ -2759,61 +3751,68 @@ static void *writesf_new(t_floatarg fnchannels, t_floatarg fbufsize)
     return x;
 }
 
+    /* room left in the fifo, keeping one byte free so that we can tell a
+    full fifo from an empty one */
+static int writesf_room(t_writesf *x)
+{
+    int room = atomic_int_load(&x->x_fifotail) -
+        atomic_int_load(&x->x_fifohead);
+    if (room <= 0)
+        room += x->x_fifosize;
+    return (room - 1);
+}
+
 static t_int *writesf_perform(t_int *w)
 {
     t_writesf *x = (t_writesf *)(w[1]);
     if (x->x_state == STATE_STREAM)
     {
-        size_t roominfifo;
-        size_t wantbytes;
-        int vecsize = x->x_vecsize;
-        t_soundfile sf = {0};
-        pthread_mutex_lock(&x->x_mutex);
-            /* copy with mutex locked! */
-        soundfile_copy(&sf, &x->x_sf);
-        wantbytes = vecsize * sf.sf_bytesperframe;
-        roominfifo = x->x_fifotail - x->x_fifohead;
-        if (roominfifo <= 0)
-            roominfifo += x->x_fifosize;
-        while (!x->x_eof && roominfifo < wantbytes + 1)
-        {
-            fprintf(stderr, "writesf waiting for disk write..\n");
-            fprintf(stderr, "(head %d, tail %d, room %d, want %ld)\n",
-                (int)x->x_fifohead, (int)x->x_fifotail,
-                (int)roominfifo, (long)wantbytes);
-            sfread_cond_signal(&x->x_requestcondition);
-            sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
-            fprintf(stderr, "... done waiting.\n");
-            roominfifo = x->x_fifotail - x->x_fifohead;
-            if (roominfifo <= 0)
-                roominfifo += x->x_fifosize;
+        int vecsize = x->x_vecsize, fifohead,
+            wantbytes = vecsize * x->x_dspsf.sf_bytesperframe;
+        if (sys_batch && !atomic_int_load(&x->x_eof) &&
+            writesf_room(x) < wantbytes)
+        {
+                /* in batch mode we can afford to wait for the disk */
+            pthread_mutex_lock(&x->x_mutex);
+            while (!atomic_int_load(&x->x_eof) && writesf_room(x) < wantbytes)
+            {
+                sfthread_wake(x);
+                sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
+            }
+            pthread_mutex_unlock(&x->x_mutex);
         }
-        if (x->x_eof)
+        if (atomic_int_load(&x->x_eof))
         {
             if (x->x_fileerror)
                 object_sferror(x, "[writesf~]", x->x_filename,
-                    x->x_fileerror, &x->x_sf);
+                    x->x_fileerror, &x->x_dspsf);
             x->x_state = STATE_IDLE;
-            sfread_cond_signal(&x->x_requestcondition);
-            pthread_mutex_unlock(&x->x_mutex);
+            sfthread_wake(x);
             return w + 2;
         }
+        if (writesf_room(x) < wantbytes)
+        {
+                /* the disk didn't keep up; drop this block */
+            x->x_xruns++;
+            sfthread_wake(x);
+            return w + 2;
+        }
+        fifohead = atomic_int_load(&x->x_fifohead);
+        soundfile_xferout_sample(&x->x_dspsf, x->x_nchannels, x->x_vec,
+            (unsigned char *)(x->x_buf + fifohead), vecsize, 0, 1.);
 
-        soundfile_xferout_sample(&sf, x->x_nchannels, x->x_vec,
-            (unsigned char *)(x->x_buf + x->x_fifohead), vecsize, 0, 1.);
-
-        x->x_fifohead += wantbytes;
-        if (x->x_fifohead >= x->x_fifosize)
-            x->x_fifohead = 0;
+        fifohead += wantbytes;
+        if (fifohead >= x->x_fifosize)
+            fifohead = 0;
+        atomic_int_store(&x->x_fifohead, fifohead);
         if ((--x->x_sigcountdown) <= 0)
         {
 #ifdef DEBUG_SOUNDFILE_THREADS
             fprintf(stderr, "writesf~: signal 1\n");
 #endif
-            sfread_cond_signal(&x->x_requestcondition);
+            sfthread_wake(x);
             x->x_sigcountdown = x->x_sigperiod;
         }
-        pthread_mutex_unlock(&x->x_mutex);
     }
     return w + 2;
 }
@@ -2837,13 +3836,13 @@ static void writesf_stop(t_writesf *x)
 #ifdef DEBUG_SOUNDFILE_THREADS
     fprintf(stderr, "writesf~: signal 2\n");
 #endif
-    sfread_cond_signal(&x->x_requestcondition);
+    sfthread_wake(x);
     if (sys_batch)
     {
             /* if we're running batch, wait for child to finish */
         while (x->x_requestcode != REQUEST_NOTHING)
         {
-            sfread_cond_signal(&x->x_requestcondition);
+            sfthread_wake(x);
             sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
         }
     }
@@ -2857,7 +3856,8 @@ static void writesf_open(t_writesf *x, t_symbol *s, int argc, t_atom *argv)
     t_soundfiler_writeargs wa = {0};
     if (x->x_state != STATE_IDLE)
         writesf_stop(x);
-    if (soundfiler_parsewriteargs(x, &argc, &argv, &wa) || wa.wa_ascii)
+    if (soundfiler_parsewriteargs(x, &argc, &argv, &wa) || wa.wa_ascii ||
+        wa.wa_async)
     {
         pd_error(x, "[writesf~]: usage; open [flags] filename...");
         post("flags: -bytes <n> %s -big -little -rate <n>", sf_typeargs);
@@ -2871,7 +3871,7 @@ static void writesf_open(t_writesf *x, t_symbol *s, int argc, t_atom *argv)
         /* make sure that the child thread has finished writing */
     while (x->x_requestcode != REQUEST_NOTHING)
     {
-        sfread_cond_signal(&x->x_requestcondition);
+        sfthread_wake(x);
         sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
     }
     x->x_filename = wa.wa_filesym->s_name;
@@ -2886,12 +3886,14 @@ static void writesf_open(t_writesf *x, t_symbol *s, int argc, t_atom *argv)
         (wa.wa_bytespersample > 2 ? wa.wa_bytespersample : 2);
     x->x_sf.sf_bigendian = wa.wa_bigendian;
     x->x_sf.sf_bytesperframe = x->x_sf.sf_nchannels * x->x_sf.sf_bytespersample;
+    soundfile_copy(&x->x_dspsf, &x->x_sf);
     x->x_frameswritten = 0;
     x->x_requestcode = REQUEST_OPEN;
-    x->x_fifotail = 0;
-    x->x_fifohead = 0;
-    x->x_eof = 0;
+    atomic_int_store(&x->x_fifotail, 0);
+    atomic_int_store(&x->x_fifohead, 0);
+    atomic_int_store(&x->x_eof, 0);
     x->x_fileerror = 0;
+    x->x_xruns = 0;
     x->x_state = STATE_STARTUP;
         /* set fifosize from bufsize.  fifosize must be a
         multiple of the number of bytes eaten for each DSP
@@ -2902,7 +3904,7 @@ static void writesf_open(t_writesf *x, t_symbol *s, int argc, t_atom *argv)
             times per buffer */
     x->x_sigcountdown = x->x_sigperiod = (x->x_fifosize /
             (16 * (x->x_sf.sf_bytesperframe * x->x_vecsize)));
-    sfread_cond_signal(&x->x_requestcondition);
+    sfthread_wake(x);
     pthread_mutex_unlock(&x->x_mutex);
 }
 
@@ -2932,11 +3934,12 @@ static void writesf_dsp(t_writesf *x, t_signal **sp)
 static void writesf_print(t_writesf *x)
 {
     post("state %d", x->x_state);
-    post("fifo head %d", x->x_fifohead);
-    post("fifo tail %d", x->x_fifotail);
+    post("fifo head %d", atomic_int_load(&x->x_fifohead));
+    post("fifo tail %d", atomic_int_load(&x->x_fifotail));
     post("fifo size %d", x->x_fifosize);
     post("fd %d", x->x_sf.sf_fd);
-    post("eof %d", x->x_eof);
+    post("eof %d", atomic_int_load(&x->x_eof));
+    post("dropped blocks %d", x->x_xruns);
 }
 
     /** request QUIT and wait for acknowledge */
@@ -2948,13 +3951,12 @@ static void writesf_free(t_writesf *x)
 #ifdef DEBUG_SOUNDFILE_THREADS
     fprintf(stderr, "writesf~: stopping thread...\n");
 #endif
-    sfread_cond_signal(&x->x_requestcondition);
     while (x->x_requestcode != REQUEST_NOTHING)
     {
 #ifdef DEBUG_SOUNDFILE_THREADS
         fprintf(stderr, "writesf~: signaling...\n");
 #endif
-        sfread_cond_signal(&x->x_requestcondition);
+        sfthread_wake(x);
         sfread_cond_wait(&x->x_answercondition, &x->x_mutex);
     }
     pthread_mutex_unlock(&x->x_mutex);
@@ -2964,7 +3966,7 @@ static void writesf_free(t_writesf *x)
     fprintf(stderr, "writesf~: ... done\n");
 #endif
 
-    pthread_cond_destroy(&x->x_requestcondition);
+    sys_semaphore_destroy(x->x_wakeup);
     pthread_cond_destroy(&x->x_answercondition);
     pthread_mutex_destroy(&x->x_mutex);
     freebytes(x->x_buf, x->x_bufsize);
@@ -186,3 +186,64 @@ void swapstring4(char *foo, int doit);
 
     /** swap an 8 byte string in place if doit = 1, otherwise do nothing */
 void swapstring8(char *foo, int doit);
+
+/* ----- memory-mapped soundfiles ----- */
+
+    /** converts one sample at p to a float */
+typedef t_sample (*t_sfmapgetfn)(const unsigned char *p);
+
+    /** one channel of a soundfile mapped into memory by "soundfiler read
+        -map", bound to a name like an array; tabread~, tabread4~ and
+        tabplay~ fall back to it if there's no array by that name */
+typedef struct _sfmap
+{
+    t_pd m_pd;
+    t_symbol *m_name;            /**< the name it's bound to             */
+    struct _sfmapfile *m_file;   /**< the mapping, shared by channels    */
+    const unsigned char *m_data; /**< first sample of this channel       */
+    int m_stride;                /**< bytes from one frame to the next   */
+    int m_n;                     /**< number of frames                   */
+    t_sfmapgetfn m_get;          /**< sample format converter            */
+} t_sfmap;
+
+    /** changes whenever a mapped soundfile is added or removed, so that
+        anyone holding on to a t_sfmap knows to look it up again */
+extern int sfmap_valid;
+
+    /** returns the mapped soundfile channel bound to s, or NULL */
+t_sfmap *sfmap_find(t_symbol *s);
+
+    /** get sample i (0 <= i < m_n) */
+#define sfmap_get(m, i) \
+    ((m)->m_get((m)->m_data + (size_t)(i) * (size_t)(m)->m_stride))
+
+/* ----- sample rate conversion ----- */
+
+    /** a windowed-sinc resampler for any number of channels, used by
+        "soundfiler read -resample" and readsf~ (see d_soundfile_resample.c) */
+typedef struct _sfresample t_sfresample;
+
+#define SFRESAMPLE_NQUALITY 3   /**< qualities are 0 (fastest) to 2 (best) */
+#define SFRESAMPLE_DEFQUALITY 2 /**< quality if none is given               */
+
+    /** returns a new resampler or NULL if a rate isn't positive */
+t_sfresample *sfresample_new(int nchannels, double inrate, double outrate,
+    int quality);
+
+void sfresample_free(t_sfresample *x);
+
+    /** returns the number of frames nframes frames convert to */
+size_t sfresample_nframes(size_t nframes, double inrate, double outrate);
+
+    /** returns the number of input frames sfresample_write() can take */
+int sfresample_room(t_sfresample *x);
+
+    /** add n frames of input, one vector per channel */
+void sfresample_write(t_sfresample *x, t_sample **in, int n);
+
+    /** say that there's no more input */
+void sfresample_finish(t_sfresample *x);
+
+    /** get up to n frames of output, one vector per channel, returns the
+        number of frames; 0 after sfresample_finish() means we're done */
+int sfresample_read(t_sfresample *x, t_sample **out, int n);
@@ -0,0 +1,295 @@
+/* Copyright (c) 2026 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* sample rate conversion for "soundfiler read -resample" and for readsf~'s
+"open -resample".  This is a polyphase FIR filter: a windowed sinc (with a
+Kaiser window) sampled at "nphases" fractional delays.  If both rates are
+whole numbers whose ratio reduces to at most SFRESAMPLE_MAXPHASES output
+samples for some number of input samples (44100 to 48000 is 160 for 147)
+each output sample is one dot product with one of the phases.  Otherwise we
+use SFRESAMPLE_INTERPPHASES phases and interpolate linearly between the two
+nearest.  The dot products are done by the "dot" SIMD kernel (d_simd.c),
+which gives the same answer in every instruction set.
+
+The quality (0 to 2) sets the number of filter taps and the window, and so
+the stopband attenuation and the width of the transition band, which we put
+just below the lower of the two Nyquist frequencies: about 54 dB and 60% of
+the band passed for quality 0, 81 dB and 79% for 1, and 104 dB and 90% for
+2.  When the rate goes down the filter gets proportionally longer.
+
+Input and output are in separate (per-channel) vectors.  The caller writes
+input with sfresample_write() whenever sfresample_room() says there's room,
+reads output with sfresample_read(), and calls sfresample_finish() at the
+end of the input, after which sfresample_read() gives the rest of the
+output, as many samples as sfresample_nframes() said there would be.  The
+first output sample lines up with the first input sample. */
+
+#include "d_soundfile.h"
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+extern t_sample (*simd_dot)(const t_sample *in1, const t_sample *in2, int n);
+
+#define SFRESAMPLE_MAXPHASES 1024       /* most phases for an exact ratio */
+#define SFRESAMPLE_INTERPPHASES 256     /* phases if we have to interpolate */
+#define SFRESAMPLE_MAXTAPS 1024         /* longest filter we'll make */
+#define SFRESAMPLE_BLOCK 4096           /* input buffer size beyond that */
+
+    /* taps (for rates going up) and Kaiser window parameter per quality */
+static const struct
+{
+    int q_ntaps;
+    double q_beta;
+} sfresample_quality[SFRESAMPLE_NQUALITY] =
+{
+    {16, 5.0},
+    {48, 8.0},
+    {128, 10.5}
+};
+
+struct _sfresample
+{
+    int r_nchannels;
+    double r_inrate;
+    double r_outrate;
+    int r_ntaps;            /* taps per phase, a multiple of 16 */
+    int r_nphases;
+    int r_step;             /* exact ratio: input step per output, in phases */
+    double r_ratio;         /* otherwise: input frames per output frame */
+    t_sample *r_coefs;      /* (r_nphases + 1) phases of r_ntaps taps */
+    t_sample **r_buf;       /* input history, one vector per channel */
+    int r_bufsize;          /* size of each in frames */
+    int r_fill;             /* frames in it */
+    int r_start;            /* where the taps for the next output start */
+    int r_phase;            /* exact ratio: phase of the next output */
+    double r_frac;          /* otherwise: fractional part of its position */
+    size_t r_nin;           /* frames written */
+    size_t r_nout;          /* frames read */
+    int r_finished;         /* sfresample_finish() was called */
+    int r_pad;              /* zeros still to append after that */
+};
+
+    /* zeroth-order modified Bessel function of the first kind */
+static double sfresample_i0(double x)
+{
+    double sum = 1, term = 1, y = x * x / 4;
+    int k;
+    for (k = 1; k < 100 && term > sum * 1e-12; k++)
+    {
+        term *= y / ((double)k * k);
+        sum += term;
+    }
+    return (sum);
+}
+
+static int sfresample_gcd(int a, int b)
+{
+    while (b)
+    {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return (a);
+}
+
+size_t sfresample_nframes(size_t nframes, double inrate, double outrate)
+{
+    double n = ceil((double)nframes * outrate / inrate);
+    return (n >= (double)SFMAXFRAMES ? SFMAXFRAMES : (size_t)n);
+}
+
+t_sfresample *sfresample_new(int nchannels, double inrate, double outrate,
+    int quality)
+{
+    t_sfresample *x;
+    double scale, cutoff, beta, width, atten, norm;
+    int ntaps, half, p, k, i;
+    if (nchannels < 1 || inrate <= 0 || outrate <= 0)
+        return (0);
+    if (quality < 0)
+        quality = 0;
+    else if (quality >= SFRESAMPLE_NQUALITY)
+        quality = SFRESAMPLE_NQUALITY - 1;
+    x = (t_sfresample *)getbytes(sizeof(*x));
+    x->r_nchannels = nchannels;
+    x->r_inrate = inrate;
+    x->r_outrate = outrate;
+
+        /* an exact ratio if there's a small enough one */
+    x->r_step = 0;
+    if (inrate == (int)inrate && outrate == (int)outrate)
+    {
+        int g = sfresample_gcd((int)inrate, (int)outrate);
+        if ((int)outrate / g <= SFRESAMPLE_MAXPHASES)
+        {
+            x->r_nphases = (int)outrate / g;
+            x->r_step = (int)inrate / g;
+        }
+    }
+    if (!x->r_step)
+    {
+        x->r_nphases = SFRESAMPLE_INTERPPHASES;
+        x->r_ratio = inrate / outrate;
+    }
+
+        /* the filter: more taps when going down, up to a point */
+    scale = (outrate < inrate ? outrate / inrate : 1);
+    ntaps = (int)ceil(sfresample_quality[quality].q_ntaps / scale);
+    ntaps = (ntaps + 15) & ~15;
+    if (ntaps > SFRESAMPLE_MAXTAPS)
+        ntaps = SFRESAMPLE_MAXTAPS;
+    x->r_ntaps = ntaps;
+    half = ntaps / 2;
+
+        /* transition band width for this window and length (Kaiser's
+        formula), as a fraction of the lower Nyquist frequency */
+    beta = sfresample_quality[quality].q_beta;
+    atten = beta / 0.1102 + 8.7;
+    width = (atten - 8) / (2.285 * 2 * M_PI * ntaps * scale);
+    cutoff = scale * (width < 0.5 ? 1 - width : 0.5);
+    norm = 1. / sfresample_i0(beta);
+
+    x->r_coefs = (t_sample *)getbytes(
+        (x->r_nphases + 1) * ntaps * sizeof(t_sample));
+    for (p = 0; p <= x->r_nphases; p++)
+    {
+        t_sample *h = x->r_coefs + p * ntaps;
+        double sum = 0;
+        for (k = 0; k < ntaps; k++)
+        {
+                /* distance from the output point, in input samples */
+            double d = k - (half - 1) - (double)p / x->r_nphases,
+                r = d / half, t = M_PI * cutoff * d, f;
+            if (r <= -1 || r >= 1)
+                f = 0;
+            else f = (t == 0 ? cutoff : cutoff * sin(t) / t) *
+                sfresample_i0(beta * sqrt(1 - r * r)) * norm;
+            h[k] = f;
+            sum += f;
+        }
+            /* unity gain at DC for every phase */
+        if (sum != 0)
+            for (k = 0; k < ntaps; k++)
+                h[k] /= sum;
+    }
+
+    x->r_bufsize = ntaps + SFRESAMPLE_BLOCK;
+    x->r_buf = (t_sample **)getbytes(nchannels * sizeof(t_sample *));
+    for (i = 0; i < nchannels; i++)
+        x->r_buf[i] = (t_sample *)getbytes(x->r_bufsize * sizeof(t_sample));
+        /* start with zeros so the first output is centered on the first
+        input */
+    x->r_fill = half - 1;
+    x->r_start = x->r_phase = 0;
+    x->r_frac = 0;
+    x->r_nin = x->r_nout = 0;
+    x->r_finished = 0;
+    x->r_pad = half;
+    return (x);
+}
+
+void sfresample_free(t_sfresample *x)
+{
+    int i;
+    for (i = 0; i < x->r_nchannels; i++)
+        freebytes(x->r_buf[i], x->r_bufsize * sizeof(t_sample));
+    freebytes(x->r_buf, x->r_nchannels * sizeof(t_sample *));
+    freebytes(x->r_coefs, (x->r_nphases + 1) * x->r_ntaps * sizeof(t_sample));
+    freebytes(x, sizeof(*x));
+}
+
+    /* move what we still need to the front of the buffer */
+static void sfresample_compact(t_sfresample *x)
+{
+    int i;
+    if (!x->r_start)
+        return;
+    for (i = 0; i < x->r_nchannels; i++)
+        memmove(x->r_buf[i], x->r_buf[i] + x->r_start,
+            (x->r_fill - x->r_start) * sizeof(t_sample));
+    x->r_fill -= x->r_start;
+    x->r_start = 0;
+}
+
+int sfresample_room(t_sfresample *x)
+{
+    if (x->r_finished)
+        return (0);
+    sfresample_compact(x);
+    return (x->r_bufsize - x->r_fill);
+}
+
+void sfresample_write(t_sfresample *x, t_sample **in, int n)
+{
+    int i;
+    if (n > sfresample_room(x))
+        n = sfresample_room(x);
+    for (i = 0; i < x->r_nchannels; i++)
+        memcpy(x->r_buf[i] + x->r_fill, in[i], n * sizeof(t_sample));
+    x->r_fill += n;
+    x->r_nin += n;
+}
+
+void sfresample_finish(t_sfresample *x)
+{
+    x->r_finished = 1;
+}
+
+int sfresample_read(t_sfresample *x, t_sample **out, int n)
+{
+    int ntaps = x->r_ntaps, nout = 0, i;
+    size_t maxout = (x->r_finished ?
+        sfresample_nframes(x->r_nin, x->r_inrate, x->r_outrate) : SFMAXFRAMES);
+    while (nout < n && x->r_nout < maxout)
+    {
+        if (x->r_start + ntaps > x->r_fill)
+        {
+                /* out of input; at the end, pad with zeros */
+            int npad;
+            if (!x->r_finished || !x->r_pad)
+                break;
+            sfresample_compact(x);
+            npad = x->r_bufsize - x->r_fill;
+            if (npad > x->r_pad)
+                npad = x->r_pad;
+            for (i = 0; i < x->r_nchannels; i++)
+                memset(x->r_buf[i] + x->r_fill, 0, npad * sizeof(t_sample));
+            x->r_fill += npad;
+            x->r_pad -= npad;
+            continue;
+        }
+        if (x->r_step)
+        {
+            const t_sample *h = x->r_coefs + x->r_phase * ntaps;
+            for (i = 0; i < x->r_nchannels; i++)
+                out[i][nout] = (*simd_dot)(h, x->r_buf[i] + x->r_start, ntaps);
+            x->r_phase += x->r_step;
+            x->r_start += x->r_phase / x->r_nphases;
+            x->r_phase %= x->r_nphases;
+        }
+        else
+        {
+            double pos = x->r_frac * x->r_nphases, whole;
+            int phase = (int)pos;
+            t_sample frac = pos - phase;
+            const t_sample *h = x->r_coefs + phase * ntaps;
+            for (i = 0; i < x->r_nchannels; i++)
+            {
+                const t_sample *in = x->r_buf[i] + x->r_start;
+                t_sample a = (*simd_dot)(h, in, ntaps),
+                    b = (*simd_dot)(h + ntaps, in, ntaps);
+                out[i][nout] = a + frac * (b - a);
+            }
+            x->r_frac = modf(x->r_frac + x->r_ratio, &whole);
+            x->r_start += (int)whole;
+        }
+        nout++;
+        x->r_nout++;
+    }
+    return (nout);
+}
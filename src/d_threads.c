@@ -0,0 +1,336 @@
+/* Copyright (c) 2026 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/*  A small work-stealing thread pool for running the DSP chain on several
+    cores.  The caller hands us a task graph (a list of tasks, each with a
+    count of predecessors and a list of successors) and a function to run a
+    task; we run the whole graph once and return when every task is done.
+    The calling thread takes part as worker number zero, so a pool of "n"
+    threads only creates n-1 extra ones.
+
+    Each worker owns a Chase-Lev style deque of task numbers.  Workers pop
+    from their own deque and steal from the others when it runs dry; a task
+    whose last predecessor finishes is pushed on the deque of the worker that
+    finished it.  Since every task is pushed exactly once per run, each deque
+    only needs room for all the tasks and never wraps around; we reset the
+    deques at the start of each run while no worker is looking at them.
+
+    Between runs the workers spin for a short while and then go to sleep on a
+    condition variable.  The caller only takes the mutex to wake them up if
+    somebody is actually asleep. */
+
+#include "m_pd.h"
+#include "m_imp.h"
+#include "m_private_utils.h"
+#include <pthread.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+    /* how many times we look for work before yielding, and how many
+    times we wait for the next run before going to sleep */
+#define DSPTHREADS_SPIN 64
+#define DSPTHREADS_IDLESPIN 4096
+
+typedef void (*t_dsptaskfn)(void *owner, int task);
+
+typedef struct _dspdeque
+{
+    atomic_int d_top;           /* thieves take from here */
+    atomic_int d_bottom;        /* owner pushes and pops here */
+    atomic_int *d_buf;
+    char d_pad[64];             /* keep deques on separate cache lines */
+} t_dspdeque;
+
+typedef struct _dspworker
+{
+    struct _dspthreads *w_owner;
+    int w_index;
+    pthread_t w_thread;
+} t_dspworker;
+
+typedef struct _dspthreads
+{
+    int x_nthreads;             /* number of workers including the caller */
+    t_dspworker *x_workers;
+    t_dspdeque *x_deques;
+    atomic_int *x_pending;      /* per task: predecessors not yet done */
+    int x_maxtasks;             /* allocated size of the above */
+        /* the graph we're currently running */
+    int x_ntasks;
+    const int *x_succonset;
+    const int *x_succ;
+    t_dsptaskfn x_fn;
+    void *x_taskowner;
+    t_pdinstance *x_instance;
+        /* synchronization */
+    atomic_int x_ndone;         /* number of tasks finished in this run */
+    atomic_int x_running;       /* true while a run is in progress */
+    atomic_int x_nactive;       /* number of helper threads inside a run */
+    atomic_int x_generation;    /* incremented for every run */
+    atomic_int x_nsleeping;     /* number of helpers waiting on x_cond */
+    atomic_int x_quit;
+    pthread_mutex_t x_mutex;
+    pthread_cond_t x_cond;
+} t_dspthreads;
+
+static void dspthreads_relax(void)
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+/* --------------------- work-stealing deque ------------------------ */
+
+    /* only the owner pushes (or the caller, before the run starts) */
+static void dspdeque_push(t_dspdeque *d, int task)
+{
+    int b = atomic_int_load(&d->d_bottom);
+    atomic_int_store(&d->d_buf[b], task);
+    atomic_int_store(&d->d_bottom, b + 1);
+}
+
+    /* the owner pops from the bottom; returns -1 if empty */
+static int dspdeque_pop(t_dspdeque *d)
+{
+    int b = atomic_int_load(&d->d_bottom) - 1, t, task;
+    atomic_int_store(&d->d_bottom, b);
+    t = atomic_int_load(&d->d_top);
+    if (t > b)
+    {
+        atomic_int_store(&d->d_bottom, b + 1);
+        return (-1);
+    }
+    task = atomic_int_load(&d->d_buf[b]);
+    if (t == b)
+    {
+            /* last one: race against thieves for it */
+        if (!atomic_int_compare_exchange(&d->d_top, &t, t + 1))
+            task = -1;
+        atomic_int_store(&d->d_bottom, b + 1);
+    }
+    return (task);
+}
+
+    /* anyone else steals from the top; returns -1 if empty or if we lost
+    a race (in which case the caller just tries again later.) */
+static int dspdeque_steal(t_dspdeque *d)
+{
+    int t = atomic_int_load(&d->d_top), b = atomic_int_load(&d->d_bottom),
+        task;
+    if (t >= b)
+        return (-1);
+    task = atomic_int_load(&d->d_buf[t]);
+    if (!atomic_int_compare_exchange(&d->d_top, &t, t + 1))
+        return (-1);
+    return (task);
+}
+
+/* ------------------------- the pool -------------------------------- */
+
+    /* run tasks until the whole graph is done */
+static void dspthreads_work(t_dspthreads *x, int me)
+{
+    int nthreads = x->x_nthreads, spins = 0;
+    t_dspdeque *mydeque = &x->x_deques[me];
+    while (atomic_int_load(&x->x_ndone) < x->x_ntasks)
+    {
+        int task = dspdeque_pop(mydeque), i;
+        for (i = 1; task < 0 && i < nthreads; i++)
+            task = dspdeque_steal(&x->x_deques[(me + i) % nthreads]);
+        if (task < 0)
+        {
+            if (++spins >= DSPTHREADS_SPIN)
+                dspthreads_relax(), spins = 0;
+            continue;
+        }
+        spins = 0;
+        (*x->x_fn)(x->x_taskowner, task);
+        for (i = x->x_succonset[task]; i < x->x_succonset[task+1]; i++)
+        {
+            int next = x->x_succ[i];
+            if (atomic_int_fetch_sub(&x->x_pending[next], 1) == 1)
+                dspdeque_push(mydeque, next);
+        }
+        atomic_int_fetch_add(&x->x_ndone, 1);
+    }
+}
+
+static void *dspthreads_threadfn(void *z)
+{
+    t_dspworker *w = (t_dspworker *)z;
+    t_dspthreads *x = w->w_owner;
+    int generation = 0;
+    while (1)
+    {
+        int spins = 0;
+            /* wait for the next run */
+        while (atomic_int_load(&x->x_generation) == generation &&
+            !atomic_int_load(&x->x_quit))
+        {
+            if (++spins < DSPTHREADS_IDLESPIN)
+            {
+                if (!(spins % DSPTHREADS_SPIN))
+                    dspthreads_relax();
+                continue;
+            }
+            pthread_mutex_lock(&x->x_mutex);
+            atomic_int_fetch_add(&x->x_nsleeping, 1);
+            while (atomic_int_load(&x->x_generation) == generation &&
+                !atomic_int_load(&x->x_quit))
+                    pthread_cond_wait(&x->x_cond, &x->x_mutex);
+            atomic_int_fetch_sub(&x->x_nsleeping, 1);
+            pthread_mutex_unlock(&x->x_mutex);
+        }
+        if (atomic_int_load(&x->x_quit))
+            break;
+        generation = atomic_int_load(&x->x_generation);
+            /* announce ourselves before checking that the run is still on,
+            so that the caller can't reset the deques under our feet. */
+        atomic_int_fetch_add(&x->x_nactive, 1);
+        if (atomic_int_load(&x->x_running))
+        {
+#ifdef PDINSTANCE
+            pd_setinstance(x->x_instance);
+#endif
+            dspthreads_work(x, w->w_index);
+        }
+        atomic_int_fetch_sub(&x->x_nactive, 1);
+    }
+    return (0);
+}
+
+t_dspthreads *dspthreads_new(int nthreads)
+{
+    t_dspthreads *x = (t_dspthreads *)getbytes(sizeof(*x));
+    int i;
+    if (nthreads < 1)
+        nthreads = 1;
+    x->x_nthreads = nthreads;
+    x->x_workers = (t_dspworker *)getbytes(nthreads * sizeof(*x->x_workers));
+    x->x_deques = (t_dspdeque *)getbytes(nthreads * sizeof(*x->x_deques));
+    x->x_pending = 0;
+    x->x_maxtasks = 0;
+    x->x_ntasks = 0;
+    atomic_int_store(&x->x_ndone, 0);
+    atomic_int_store(&x->x_running, 0);
+    atomic_int_store(&x->x_nactive, 0);
+    atomic_int_store(&x->x_generation, 0);
+    atomic_int_store(&x->x_nsleeping, 0);
+    atomic_int_store(&x->x_quit, 0);
+    pthread_mutex_init(&x->x_mutex, 0);
+    pthread_cond_init(&x->x_cond, 0);
+    for (i = 0; i < nthreads; i++)
+    {
+        x->x_workers[i].w_owner = x;
+        x->x_workers[i].w_index = i;
+        x->x_deques[i].d_buf = 0;
+    }
+        /* worker zero is whoever calls dspthreads_run() */
+    for (i = 1; i < nthreads; i++)
+    {
+        if (pthread_create(&x->x_workers[i].w_thread, 0,
+            dspthreads_threadfn, &x->x_workers[i]))
+        {
+            pd_error(0, "DSP threads: couldn't create thread %d", i);
+            x->x_nthreads = i;
+            break;
+        }
+    }
+    return (x);
+}
+
+void dspthreads_free(t_dspthreads *x)
+{
+    int i;
+    pthread_mutex_lock(&x->x_mutex);
+    atomic_int_store(&x->x_quit, 1);
+    pthread_cond_broadcast(&x->x_cond);
+    pthread_mutex_unlock(&x->x_mutex);
+    for (i = 1; i < x->x_nthreads; i++)
+        pthread_join(x->x_workers[i].w_thread, 0);
+    pthread_mutex_destroy(&x->x_mutex);
+    pthread_cond_destroy(&x->x_cond);
+    for (i = 0; i < x->x_nthreads; i++)
+        if (x->x_deques[i].d_buf)
+            freebytes(x->x_deques[i].d_buf,
+                x->x_maxtasks * sizeof(*x->x_deques[i].d_buf));
+    if (x->x_pending)
+        freebytes(x->x_pending, x->x_maxtasks * sizeof(*x->x_pending));
+    freebytes(x->x_deques, x->x_nthreads * sizeof(*x->x_deques));
+    freebytes(x->x_workers, x->x_nthreads * sizeof(*x->x_workers));
+    freebytes(x, sizeof(*x));
+}
+
+int dspthreads_getnthreads(t_dspthreads *x)
+{
+    return (x->x_nthreads);
+}
+
+    /* make room for a graph of "ntasks" tasks.  Call this while the pool
+    is idle (i.e., when the DSP chain is rebuilt) so that running the graph
+    never needs to allocate memory. */
+void dspthreads_reserve(t_dspthreads *x, int ntasks)
+{
+    int i;
+    if (ntasks <= x->x_maxtasks)
+        return;
+    for (i = 0; i < x->x_nthreads; i++)
+        x->x_deques[i].d_buf = (atomic_int *)resizebytes(x->x_deques[i].d_buf,
+            x->x_maxtasks * sizeof(atomic_int), ntasks * sizeof(atomic_int));
+    x->x_pending = (atomic_int *)resizebytes(x->x_pending,
+        x->x_maxtasks * sizeof(atomic_int), ntasks * sizeof(atomic_int));
+    x->x_maxtasks = ntasks;
+}
+
+    /* run a task graph to completion.  "npred" gives the number of
+    predecessors of each task; the successors of task "n" are
+    succ[succonset[n]] ... succ[succonset[n+1]-1]. */
+void dspthreads_run(t_dspthreads *x, int ntasks, const int *npred,
+    const int *succonset, const int *succ, t_dsptaskfn fn, void *owner)
+{
+    int i, nroots = 0, nthreads = x->x_nthreads;
+    if (ntasks > x->x_maxtasks)
+    {
+        bug("dspthreads_run");
+        return;
+    }
+    x->x_ntasks = ntasks;
+    x->x_succonset = succonset;
+    x->x_succ = succ;
+    x->x_fn = fn;
+    x->x_taskowner = owner;
+    x->x_instance = pd_this;
+    for (i = 0; i < nthreads; i++)
+    {
+        atomic_int_store(&x->x_deques[i].d_top, 0);
+        atomic_int_store(&x->x_deques[i].d_bottom, 0);
+    }
+        /* hand out the tasks that are ready to go */
+    for (i = 0; i < ntasks; i++)
+    {
+        atomic_int_store(&x->x_pending[i], npred[i]);
+        if (!npred[i])
+            dspdeque_push(&x->x_deques[(nroots++) % nthreads], i);
+    }
+    atomic_int_store(&x->x_ndone, 0);
+    atomic_int_store(&x->x_running, 1);
+    atomic_int_fetch_add(&x->x_generation, 1);
+    if (atomic_int_load(&x->x_nsleeping))
+    {
+        pthread_mutex_lock(&x->x_mutex);
+        pthread_cond_broadcast(&x->x_cond);
+        pthread_mutex_unlock(&x->x_mutex);
+    }
+    dspthreads_work(x, 0);
+        /* wait for the helpers to leave before anyone touches the deques */
+    atomic_int_store(&x->x_running, 0);
+    while (atomic_int_load(&x->x_nactive))
+        ;
+}
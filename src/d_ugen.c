@@ -14,7 +14,11 @@
 #include "m_pd.h"
 #include "m_imp.h"
 #include "g_canvas.h"
+#include "s_stuff.h"
+#include "m_private_utils.h"
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 #define DEFDACBLKSIZE 64    /* from s_stuff.h - LATER make this dynamic */
 
 extern t_class *vinlet_class, *voutlet_class, *canvas_class, *text_class;
@@ -32,6 +36,39 @@ void voutlet_dspepilog(struct _voutlet *x, t_signal **parentsigs,
     int myvecsize, int phase, int period, int frequency,
     int downsample, int upsample, int reblock, int switched);
 
+    /* thread pool, in d_threads.c */
+typedef void (*t_dsptaskfn)(void *owner, int task);
+struct _dspthreads *dspthreads_new(int nthreads);
+void dspthreads_free(struct _dspthreads *x);
+int dspthreads_getnthreads(struct _dspthreads *x);
+void dspthreads_reserve(struct _dspthreads *x, int ntasks);
+void dspthreads_run(struct _dspthreads *x, int ntasks, const int *npred,
+    const int *succonset, const int *succ, t_dsptaskfn fn, void *owner);
+
+    /* kernels for the perf8 routines, chosen according to the CPU in
+    d_simd.c */
+extern void (*simd_plus)(const t_sample *in1, const t_sample *in2,
+    t_sample *out, int n);
+extern void (*simd_copy)(const t_sample *in, t_sample *out, int n);
+extern void (*simd_zero)(t_sample *out, int n);
+
+static void ugen_taskuse(t_signal *s, int write);
+struct _dspgraph;
+static void dspgraph_free(struct _dspgraph *x);
+struct _dspsegment;
+struct _dspsubsegment;
+struct _block;
+struct _dspcontext;
+static void ugen_freesegments(void);
+static void ugen_endsegment(void);
+static void ugen_segmentblock(struct _block *x);
+static void ugen_fuseentries(int *nruns, int *nops);
+static void ugen_fusefrom(int from, int *nruns, int *nops);
+static void ugen_fusecount(int *nruns, int *nops);
+static void ugen_subsegment(struct _dspcontext *dc, struct _block *blk);
+struct _dspprofile;
+static void dspprofile_free(struct _dspprofile *p);
+
 struct _instanceugen
 {
     t_int *u_dspchain;         /* DSP chain */
@@ -45,6 +82,39 @@ struct _instanceugen
     int u_phase;
     int u_loud;
     struct _dspcontext *u_context;
+    int u_nthreads;            /* number of DSP threads, 0 or 1 for none */
+    struct _dspthreads *u_threads;  /* thread pool if u_nthreads > 1 */
+    struct _dspgraph *u_graph; /* DSP chain split into tasks for the pool */
+    struct _dspsegment *u_segments; /* chain code for each toplevel canvas */
+    int u_nsegments;
+    int u_segmentsize;
+    int u_cursegment;          /* segment being sorted, or -1 */
+    struct _dspsubsegment *u_subsegs;   /* reblocked or switched subpatches */
+    int u_nsubsegs;
+    int u_subsegsize;
+    void **u_loose;            /* links made outside of sorting */
+    int u_nloose;
+    int u_loosesize;
+    int u_nlinkcalls;          /* count of links made while sorting */
+    t_signal *u_pinned;        /* outputs that must stay put, see below */
+    int u_npinned;
+    int u_pinclaims;
+    int u_pinfailed;
+    int u_profiled;            /* true if the chain was sorted for profiling */
+    int u_nsorted;             /* ugens sorted in the last DSP update */
+    int u_incremental;         /* 1 if toplevel canvases were re-sorted,
+                                2 for one subpatch, 0 for everything */
+    int u_nresorted;           /* how many toplevel canvases, if 1 */
+    struct _sigchunk *u_arena; /* memory for signal vectors */
+    size_t u_arenaused;        /* bytes of it handed out */
+    size_t u_arenapeak;        /* most we've ever needed */
+    size_t u_arenahint;        /* size for the first chunk next time */
+    size_t u_arenabase;        /* bytes in use after the last full sort */
+    int u_fuse;                /* true to fuse runs of elementwise routines */
+    int *u_entries;            /* chain onsets of code added since last fused */
+    int u_nentries;
+    int u_entriessize;
+    struct _dspprofile *u_profile;  /* per-object timing, if ever turned on */
 };
 
 #define THIS (pd_this->pd_ugen)
@@ -55,10 +125,41 @@ void d_ugen_newpdinstance(void)
     THIS->u_dspchain = 0;
     THIS->u_dspchainsize = 0;
     THIS->u_signals = 0;
+    THIS->u_nthreads = 0;
+    THIS->u_threads = 0;
+    THIS->u_graph = 0;
+    THIS->u_segments = 0;
+    THIS->u_nsegments = THIS->u_segmentsize = 0;
+    THIS->u_cursegment = -1;
+    THIS->u_subsegs = 0;
+    THIS->u_nsubsegs = THIS->u_subsegsize = 0;
+    THIS->u_loose = 0;
+    THIS->u_nloose = THIS->u_loosesize = 0;
+    THIS->u_nlinkcalls = 0;
+    THIS->u_pinned = 0;
+    THIS->u_npinned = THIS->u_pinclaims = THIS->u_pinfailed = 0;
+    THIS->u_profiled = 0;
+    THIS->u_nsorted = THIS->u_incremental = THIS->u_nresorted = 0;
+    THIS->u_arena = 0;
+    THIS->u_arenaused = THIS->u_arenapeak = THIS->u_arenahint = 0;
+    THIS->u_arenabase = 0;
+    THIS->u_fuse = 1;
+    THIS->u_entries = 0;
+    THIS->u_nentries = THIS->u_entriessize = 0;
+    THIS->u_profile = 0;
 }
 
 void d_ugen_freepdinstance(void)
 {
+    if (THIS->u_graph)
+        dspgraph_free(THIS->u_graph);
+    if (THIS->u_threads)
+        dspthreads_free(THIS->u_threads);
+    ugen_freesegments();
+    if (THIS->u_entries)
+        freebytes(THIS->u_entries, THIS->u_entriessize * sizeof(int));
+    if (THIS->u_profile)
+        dspprofile_free(THIS->u_profile);
     freebytes(THIS, sizeof(*THIS));
 }
 
@@ -72,20 +173,7 @@ t_int *zero_perform(t_int *w)   /* zero out a vector */
 
 t_int *zero_perf8(t_int *w)
 {
-    t_sample *out = (t_sample *)(w[1]);
-    int n = (int)(w[2]);
-
-    for (; n; n -= 8, out += 8)
-    {
-        out[0] = 0;
-        out[1] = 0;
-        out[2] = 0;
-        out[3] = 0;
-        out[4] = 0;
-        out[5] = 0;
-        out[6] = 0;
-        out[7] = 0;
-    }
+    (*simd_zero)((t_sample *)(w[1]), (int)(w[2]));
     return (w+3);
 }
 
@@ -148,6 +236,7 @@ typedef struct _block
     int x_downsample;   /* downsampling-factor */
     int x_offset;       /* offset block calculation */
     int x_return;       /* stop right after this block (for one-shots) */
+    t_canvas *x_canvas; /* canvas we're in */
 } t_block;
 
 static void block_set(t_block *x, t_floatarg fvecsize, t_floatarg foverlap,
@@ -162,6 +251,7 @@ static void *block_new(t_floatarg fvecsize, t_floatarg foverlap,
     x->x_frequency = 1;
     x->x_switched = 0;
     x->x_switchon = 1;
+    x->x_canvas = canvas_getcurrent();
     block_set(x, fvecsize, foverlap, fupsample, foffset);
     return (x);
 }
@@ -372,6 +462,978 @@ void block_tilde_setup(void)
     class_addbang(block_class, block_bang);
 }
 
+/* ------------------ DSP profiler ----------------------- */
+
+/* "pd dsp-profile 1" makes the DSP chain time each perform routine and
+charge it to the object that added it.  While we sort we keep track of which
+object's "dsp" method is running (the objects inside a subpatch or
+abstraction run inside the canvas's own method, which tells us the canvas
+each object belongs to), and remember the owner of each chain onset.  Then
+dsp_tick() runs the chain through dspprofile_run() instead of the usual loop,
+reading a cycle counter between routines.  The counts are kept per chain
+onset: each routine is only ever run by one thread at a time, so DSP threads
+can add to them without locking, and we only add them up per object and
+canvas for the report.
+
+A full DSP update starts the profile over.  When only part of the chain is
+re-sorted (see ugen_resort()) the owners of the code it replaced are marked
+gone and new ones added, and the counts start over.  Fused runs of routines are
+charged to the first object in the run ("pd dsp-fuse 0" to see them
+separately); code run by "bang" to switch~ isn't counted. */
+
+#define PROFILE_MAXLABEL 60
+
+typedef struct _profowner
+{
+    char *o_label;          /* box text, or the name of a toplevel canvas */
+    t_symbol *o_class;      /* class name */
+    int o_parent;           /* owning canvas, or -1 */
+    unsigned int o_iscanvas:1;
+    unsigned int o_gone:1;  /* its code was re-sorted away */
+    uint64_t o_cycles;      /* these three are filled in for reports */
+    uint64_t o_calls;
+    uint64_t o_total;       /* including everything inside a canvas */
+} t_profowner;
+
+typedef struct _dspprofile
+{
+    int p_on;
+    int p_current;          /* object whose code is being added, or -1 */
+    t_profowner *p_owners;
+    int p_nowners;
+    int p_ownersize;
+    int p_ngone;            /* owners marked gone */
+    int *p_owner;           /* owner of the routine at each onset, or -1 */
+    uint64_t *p_cycles;     /* time in the routine at each onset */
+    uint64_t *p_calls;      /* times it was called */
+    int p_size;             /* size of the three arrays above */
+    int p_nticks;
+    uint64_t p_startcycles; /* cycle counter and real time when we began */
+    double p_starttime;
+} t_dspprofile;
+
+void sys_sethist(int on);
+int sys_gethist(double *seconds, const char **names, int max);
+
+    /* make the per-onset arrays at least "n" long */
+static void dspprofile_reserve(t_dspprofile *p, int n)
+{
+    int newsize, i;
+    if (n <= p->p_size)
+        return;
+    for (newsize = (p->p_size ? 2 * p->p_size : 1024); newsize < n; )
+        newsize *= 2;
+    p->p_owner = (int *)resizebytes(p->p_owner,
+        p->p_size * sizeof(int), newsize * sizeof(int));
+    p->p_cycles = (uint64_t *)resizebytes(p->p_cycles,
+        p->p_size * sizeof(uint64_t), newsize * sizeof(uint64_t));
+    p->p_calls = (uint64_t *)resizebytes(p->p_calls,
+        p->p_size * sizeof(uint64_t), newsize * sizeof(uint64_t));
+    for (i = p->p_size; i < newsize; i++)
+        p->p_owner[i] = -1;
+    p->p_size = newsize;
+}
+
+static void dspprofile_clearcounts(t_dspprofile *p)
+{
+    if (p->p_size)
+    {
+        memset(p->p_cycles, 0, p->p_size * sizeof(uint64_t));
+        memset(p->p_calls, 0, p->p_size * sizeof(uint64_t));
+    }
+    p->p_nticks = 0;
+    p->p_startcycles = PD_CYCLES();
+    p->p_starttime = sys_getrealtime();
+}
+
+    /* forget everything, for a new DSP chain */
+static void dspprofile_reset(t_dspprofile *p)
+{
+    int i;
+    for (i = 0; i < p->p_nowners; i++)
+        freebytes(p->p_owners[i].o_label,
+            strlen(p->p_owners[i].o_label) + 1);
+    p->p_nowners = p->p_ngone = 0;
+    p->p_current = -1;
+    for (i = 0; i < p->p_size; i++)
+        p->p_owner[i] = -1;
+    dspprofile_clearcounts(p);
+}
+
+static void dspprofile_free(t_dspprofile *p)
+{
+    dspprofile_reset(p);
+    if (p->p_owners)
+        freebytes(p->p_owners, p->p_ownersize * sizeof(t_profowner));
+    if (p->p_size)
+    {
+        freebytes(p->p_owner, p->p_size * sizeof(int));
+        freebytes(p->p_cycles, p->p_size * sizeof(uint64_t));
+        freebytes(p->p_calls, p->p_size * sizeof(uint64_t));
+    }
+    freebytes(p, sizeof(*p));
+}
+
+    /* add an owner under the current one.  We copy the box text now since
+    the object might be gone by the time we report. */
+static int dspprofile_newowner(t_dspprofile *p, t_object *ob,
+    const char *name)
+{
+    t_profowner *o;
+    char *buf = 0;
+    int length = 0, buflength = 0;
+    if (p->p_nowners == p->p_ownersize)
+    {
+        int newsize = (p->p_ownersize ? 2 * p->p_ownersize : 256);
+        p->p_owners = (t_profowner *)resizebytes(p->p_owners,
+            p->p_ownersize * sizeof(t_profowner),
+                newsize * sizeof(t_profowner));
+        p->p_ownersize = newsize;
+    }
+    o = p->p_owners + p->p_nowners;
+    if (!name && ob->ob_binbuf)
+        binbuf_gettext(ob->ob_binbuf, &buf, &buflength);
+    length = buflength;
+    if (!name && !length)
+        name = class_getname(pd_class(&ob->ob_pd));
+    if (name)
+        length = (int)strlen(name);
+    if (length > PROFILE_MAXLABEL)
+        length = PROFILE_MAXLABEL;
+    o->o_label = (char *)getbytes(length + 1);
+    memcpy(o->o_label, (name ? name : buf), length);
+    o->o_label[length] = 0;
+    if (buf)
+        freebytes(buf, buflength);
+    o->o_class = pd_class(&ob->ob_pd)->c_name;
+    o->o_parent = p->p_current;
+    o->o_iscanvas = (pd_class(&ob->ob_pd) == canvas_class);
+    o->o_gone = 0;
+    return (p->p_nowners++);
+}
+
+    /* mark "n" owners starting at "first" as gone after a partial re-sort */
+static void dspprofile_retire(t_dspprofile *p, int first, int n)
+{
+    int i;
+    for (i = first; i < first + n && i < p->p_nowners; i++)
+        if (!p->p_owners[i].o_gone)
+            p->p_owners[i].o_gone = 1, p->p_ngone++;
+}
+
+    /* forget owners added since there were "n", when a re-sort fails */
+static void dspprofile_truncate(t_dspprofile *p, int n)
+{
+    int i;
+    for (i = n; i < p->p_nowners; i++)
+    {
+        freebytes(p->p_owners[i].o_label,
+            strlen(p->p_owners[i].o_label) + 1);
+        if (p->p_owners[i].o_gone)
+            p->p_ngone--;
+    }
+    if (n < p->p_nowners)
+        p->p_nowners = n;
+}
+
+    /* called around each object's "dsp" method */
+static int dspprofile_enter(t_object *ob)
+{
+    t_dspprofile *p = THIS->u_profile;
+    int was;
+    if (!p || !p->p_on)
+        return (-1);
+    was = p->p_current;
+    p->p_current = dspprofile_newowner(p, ob, 0);
+    return (was);
+}
+
+static void dspprofile_leave(int was)
+{
+    t_dspprofile *p = THIS->u_profile;
+    if (p && p->p_on)
+        p->p_current = was;
+}
+
+    /* called as each toplevel canvas is about to be sorted */
+static void dspprofile_toplevel(t_canvas *x)
+{
+    t_dspprofile *p = THIS->u_profile;
+    if (!p || !p->p_on)
+        return;
+    p->p_current = -1;
+    p->p_current = dspprofile_newowner(p, &x->gl_obj, x->gl_name->s_name);
+}
+
+    /* called for each perform routine as it's added to the chain */
+static void dspprofile_addentry(int onset)
+{
+    t_dspprofile *p = THIS->u_profile;
+    if (!p || !p->p_on || onset < 0)
+        return;
+    dspprofile_reserve(p, onset + 1);
+    p->p_owner[onset] = p->p_current;
+}
+
+    /* run the chain from "ip" up to "end" (or to the end if zero) */
+static void dspprofile_run(t_dspprofile *p, t_int *chain, t_int *ip,
+    t_int *end)
+{
+    uint64_t t0 = PD_CYCLES(), t1;
+    while (ip && (!end || ip < end))
+    {
+        t_int *next = (*(t_perfroutine)(*ip))(ip);
+        int onset = (int)(ip - chain);
+        t1 = PD_CYCLES();
+        p->p_cycles[onset] += t1 - t0;
+        p->p_calls[onset]++;
+        t0 = t1;
+        ip = next;
+    }
+}
+
+    /* the full name of an owner, with the canvases it's in */
+static void dspprofile_path(t_dspprofile *p, int k, char *buf, int size)
+{
+    int length;
+    if (p->p_owners[k].o_parent >= 0)
+    {
+        dspprofile_path(p, p->p_owners[k].o_parent, buf, size);
+        length = (int)strlen(buf);
+        if (length < size - 1)
+            buf[length++] = '/';
+        buf[length] = 0;
+    }
+    else length = 0, *buf = 0;
+    strncpy(buf + length, p->p_owners[k].o_label, size - length - 1);
+    buf[size - 1] = 0;
+}
+
+    /* add up the counts per owner and canvas; returns the total */
+static uint64_t dspprofile_sum(t_dspprofile *p, uint64_t *other)
+{
+    int i, k;
+    uint64_t total = 0;
+    *other = 0;
+    for (i = 0; i < p->p_nowners; i++)
+        p->p_owners[i].o_cycles = p->p_owners[i].o_calls =
+            p->p_owners[i].o_total = 0;
+    for (i = 0; i < p->p_size; i++)
+    {
+        if (!p->p_calls[i])
+            continue;
+        total += p->p_cycles[i];
+        if ((k = p->p_owner[i]) < 0)
+        {
+            *other += p->p_cycles[i];
+            continue;
+        }
+        p->p_owners[k].o_cycles += p->p_cycles[i];
+        p->p_owners[k].o_calls += p->p_calls[i];
+        for (; k >= 0; k = p->p_owners[k].o_parent)
+            p->p_owners[k].o_total += p->p_cycles[i];
+    }
+    return (total);
+}
+
+typedef struct _profsort
+{
+    uint64_t s_cost;
+    int s_index;
+} t_profsort;
+
+static int dspprofile_cmp(const void *a, const void *b)
+{
+    uint64_t x = ((const t_profsort *)a)->s_cost,
+        y = ((const t_profsort *)b)->s_cost;
+    return (x < y ? 1 : (x > y ? -1 :
+        ((const t_profsort *)a)->s_index - ((const t_profsort *)b)->s_index));
+}
+
+    /* cycles per second, measured over the time we've been profiling */
+static double dspprofile_rate(t_dspprofile *p)
+{
+    double elapsed = sys_getrealtime() - p->p_starttime;
+    uint64_t cycles = PD_CYCLES() - p->p_startcycles;
+    return (elapsed > 0 && cycles ? cycles / elapsed : 1e9);
+}
+
+static void dspprofile_print(t_dspprofile *p, int nprint)
+{
+    t_profsort *sorted;
+    uint64_t total, other;
+    double rate = dspprofile_rate(p), tickusec, budget, hist[8];
+    const char *histnames[8];
+    char path[MAXPDSTRING];
+    int i, n, nhist;
+    if (!p->p_nticks)
+    {
+        post("DSP profile: no DSP ticks yet");
+        return;
+    }
+    total = dspprofile_sum(p, &other);
+    tickusec = 1e6 / (rate * p->p_nticks);
+    budget = 1e6 * DEFDACBLKSIZE / sys_getsr();
+    post("DSP profile: %d ticks, %.2f usec per tick (%.1f%% of %.1f)",
+        p->p_nticks, total * tickusec, 100. * total * tickusec / budget,
+            budget);
+    sorted = (t_profsort *)getbytes((p->p_nowners + 1) * sizeof(*sorted));
+    for (i = n = 0; i < p->p_nowners; i++)
+        if ((p->p_owners[i].o_iscanvas || p->p_owners[i].o_parent < 0) &&
+            p->p_owners[i].o_total)
+                sorted[n].s_cost = p->p_owners[i].o_total,
+                    sorted[n++].s_index = i;
+    qsort(sorted, n, sizeof(*sorted), dspprofile_cmp);
+    post("canvases, with everything in them (usec per tick, %% of DSP):");
+    for (i = 0; i < n && i < nprint; i++)
+    {
+        dspprofile_path(p, sorted[i].s_index, path, MAXPDSTRING);
+        post("%10.2f %6.2f%%  %s", sorted[i].s_cost * tickusec,
+            100. * sorted[i].s_cost / total, path);
+    }
+    for (i = n = 0; i < p->p_nowners; i++)
+        if (p->p_owners[i].o_calls)
+            sorted[n].s_cost = p->p_owners[i].o_cycles,
+                sorted[n++].s_index = i;
+    qsort(sorted, n, sizeof(*sorted), dspprofile_cmp);
+    post("objects (usec per tick, %% of DSP, calls per tick):");
+    for (i = 0; i < n && i < nprint; i++)
+    {
+        t_profowner *o = p->p_owners + sorted[i].s_index;
+        dspprofile_path(p, sorted[i].s_index, path, MAXPDSTRING);
+        post("%10.2f %6.2f%% %5.2f  %s", sorted[i].s_cost * tickusec,
+            100. * sorted[i].s_cost / total,
+                (double)o->o_calls / p->p_nticks, path);
+    }
+    if (other)
+        post("%10.2f %6.2f%%        (chain overhead)", other * tickusec,
+            100. * other / total);
+    freebytes(sorted, (p->p_nowners + 1) * sizeof(*sorted));
+    if ((nhist = sys_gethist(hist, histnames, 8)))
+    {
+        double sum = 0;
+        for (i = 0; i < nhist; i++)
+            sum += hist[i];
+        if (sum > 0)
+        {
+            post("scheduler (%% of %.2f seconds):", sum);
+            for (i = 0; i < nhist; i++)
+                if (*histnames[i])
+                    post("%10.2f%%  %s", 100. * hist[i] / sum, histnames[i]);
+        }
+    }
+}
+
+    /* write everything as tab separated values, one line per object */
+static void dspprofile_dump(t_dspprofile *p, const char *filename)
+{
+    FILE *fd;
+    uint64_t total, other;
+    double rate = dspprofile_rate(p), tickusec, hist[8];
+    const char *histnames[8];
+    char path[MAXPDSTRING];
+    int i, nhist;
+    if (!(fd = sys_fopen(filename, "w")))
+    {
+        pd_error(0, "%s: can't create", filename);
+        return;
+    }
+    total = dspprofile_sum(p, &other);
+    tickusec = (p->p_nticks ? 1e6 / (rate * p->p_nticks) : 0);
+    fprintf(fd, "# ticks %d blocksize %d samplerate %g\n",
+        p->p_nticks, DEFDACBLKSIZE, sys_getsr());
+    fprintf(fd, "kind\tid\tparent\tusec\ttotalusec\tcalls\tpath\n");
+    for (i = 0; i < p->p_nowners; i++)
+    {
+        t_profowner *o = p->p_owners + i;
+        if (o->o_gone)
+            continue;
+        dspprofile_path(p, i, path, MAXPDSTRING);
+        fprintf(fd, "%s\t%d\t%d\t%.4f\t%.4f\t%.4f\t%s\n",
+            (o->o_iscanvas || o->o_parent < 0 ? "canvas" : "object"),
+            i, o->o_parent, o->o_cycles * tickusec, o->o_total * tickusec,
+            (p->p_nticks ? (double)o->o_calls / p->p_nticks : 0), path);
+    }
+    fprintf(fd, "other\t-1\t-1\t%.4f\t%.4f\t0\t(chain overhead)\n",
+        other * tickusec, total * tickusec);
+    nhist = sys_gethist(hist, histnames, 8);
+    for (i = 0; i < nhist; i++)
+        if (*histnames[i])
+            fprintf(fd, "scheduler\t%d\t-1\t%.6f\t0\t0\t%s\n",
+                i, hist[i], histnames[i]);
+    sys_fclose(fd);
+}
+
+    /* add up time (nsec per DSP tick) and calls per tick for each class, for
+    "pd bench".  Canvases are charged for their block prologs and epilogs
+    and the chain's own overhead goes under "(chain)".  Returns the number
+    of classes filled in (at most "max"), or 0 if we aren't profiling. */
+int dspprofile_getclasses(t_profclass *vec, int max)
+{
+    t_dspprofile *p = THIS->u_profile;
+    uint64_t other;
+    double nsec;
+    int i, j, n = 0;
+    if (!p || !p->p_on || !p->p_nticks)
+        return (0);
+    dspprofile_sum(p, &other);
+    nsec = 1e9 / (dspprofile_rate(p) * p->p_nticks);
+    for (i = 0; i <= p->p_nowners; i++)
+    {
+        t_symbol *c = (i < p->p_nowners ?
+            p->p_owners[i].o_class : gensym("(chain)"));
+        uint64_t cycles = (i < p->p_nowners ? p->p_owners[i].o_cycles : other),
+            calls = (i < p->p_nowners ? p->p_owners[i].o_calls : 0);
+        if (!cycles && !calls)
+            continue;
+        for (j = 0; j < n && vec[j].pc_class != c; j++)
+            ;
+        if (j == n)
+        {
+            if (n == max)
+                continue;
+            vec[n].pc_class = c;
+            vec[n].pc_nsec = vec[n].pc_calls = 0;
+            vec[n++].pc_nobjects = 0;
+        }
+        vec[j].pc_nsec += cycles * nsec;
+        vec[j].pc_calls += (double)calls / p->p_nticks;
+        vec[j].pc_nobjects += (i < p->p_nowners);
+    }
+    return (n);
+}
+
+    /* "dsp-profile 1" (or 0) to start (or stop), "dsp-profile print [n]"
+    for the n most expensive canvases and objects, "dsp-profile dump file"
+    for all of them, and "dsp-profile clear" to start counting again. */
+void glob_dspprofile(void *dummy, t_symbol *s, int argc, t_atom *argv)
+{
+    t_dspprofile *p = THIS->u_profile;
+    t_symbol *what = atom_getsymbolarg(0, argc, argv);
+    if (argc && argv->a_type == A_FLOAT)
+    {
+        int on = (argv->a_w.w_float != 0);
+        if (on && !p)
+        {
+            p = THIS->u_profile = (t_dspprofile *)getbytes(sizeof(*p));
+            p->p_current = -1;
+        }
+        if (!p || on == p->p_on)
+            return;
+        p->p_on = on;
+        sys_sethist(on);
+        if (on)     /* sort again, remembering who added what */
+        {
+            dspprofile_reset(p);
+            canvas_update_dsp();
+        }
+    }
+    else if (!p)
+        pd_error(0, "dsp-profile: not started (send 'dsp-profile 1')");
+    else if (!argc || what == gensym("print"))
+        dspprofile_print(p, (argc > 1 ? atom_getfloatarg(1, argc, argv) : 20));
+    else if (what == gensym("dump") && argc > 1)
+        dspprofile_dump(p, atom_getsymbolarg(1, argc, argv)->s_name);
+    else if (what == gensym("clear"))
+    {
+        dspprofile_clearcounts(p);
+        sys_sethist(0);
+        sys_sethist(p->p_on);
+    }
+    else pd_error(0, "dsp-profile: unknown argument '%s'", what->s_name);
+}
+
+/* ------------------ DSP threads ----------------------- */
+
+/* If more than one DSP thread is asked for (via "pd dsp-threads" or the
+"-dspthreads" startup flag), we split the DSP chain into "tasks" while
+sorting it.  Each unit generator in a toplevel canvas becomes a task
+(including all the code for a subpatch or abstraction, which stays in the task
+of the box that holds it), and so does each addition of two signals converging
+on a toplevel inlet.  We note which signal buffers each task reads and
+writes, and make it wait for the previous tasks that wrote (and, if it
+writes, also read) the same buffers.  This covers both signal connections
+and reuse of buffers from the free lists.  Tasks containing objects that
+share state with others (see class_setdspshared()) also run in their
+original order with respect to one another.  Any code outside of a task
+(such as the prolog and epilog of a reblocked toplevel canvas, which we
+don't try to split up) becomes a "barrier" that runs after everything
+before it and before everything after it.  Since this is a partial order
+compatible with the original chain, and the perform routines don't change,
+the output is the same as running the chain serially. */
+
+#define MAXDSPTHREADS 64
+#define DSPBUFHASH 1024
+
+typedef struct _dsptask
+{
+    int t_onset;            /* range in the DSP chain */
+    int t_end;
+    int t_npred;            /* tasks that have to be done first */
+    int t_predsize;
+    int *t_pred;
+    int t_nsucc;
+    int t_run;              /* index after merging */
+    unsigned int t_shared:1;    /* contains a "dspshared" object */
+} t_dsptask;
+
+typedef struct _dspbufuse   /* last writer and later readers of a buffer */
+{
+    t_sample *b_vec;
+    int b_writer;
+    int b_nreaders;
+    int b_readersize;
+    int *b_readers;
+    struct _dspbufuse *b_next;
+} t_dspbufuse;
+
+typedef struct _dspgraph
+{
+        /* tasks as we find them while sorting */
+    t_dsptask *g_tasks;
+    int g_ntasks;
+    int g_tasksize;
+    int g_current;          /* task being recorded, or -1 */
+    int g_lastshared;       /* last task with shared state, or -1 */
+    int g_lastbarrier;      /* last barrier, or -1 */
+    int g_chainend;         /* where the last task ended in the chain */
+    int g_suspend;          /* true in a reblocked toplevel canvas */
+    int g_nosplit;          /* nonzero inside reblocked or switched canvases */
+    int g_fork;             /* task before parallel branches, or -1 */
+    t_signal *g_stash[MAXLOGSIG+1];     /* free lists set aside meanwhile */
+    t_dspbufuse *g_bufuse[DSPBUFHASH];
+        /* the final graph after merging linear chains of tasks */
+    int g_nrun;
+    int *g_npred;           /* number of predecessors for each */
+    int *g_succonset;       /* successors of n are g_succ[g_succonset[n]]... */
+    int *g_succ;
+    int g_nsucc;
+    int *g_rangeonset;      /* chain ranges for n are at g_rangeonset[n]... */
+    int *g_ranges;          /* onset/end pairs */
+    int g_nranges;
+    t_int *g_chain;
+    t_dspprofile *g_profile;    /* profiler to run the tasks with, if any */
+} t_dspgraph;
+
+static t_dspgraph *dspgraph_new(void)
+{
+    t_dspgraph *x = (t_dspgraph *)getbytes(sizeof(*x));
+    x->g_current = x->g_lastshared = x->g_lastbarrier = x->g_fork = -1;
+    return (x);
+}
+
+    /* free what we only need while sorting.  We keep the tasks themselves
+    so that a re-sort can copy those of the canvases it leaves alone. */
+static void dspgraph_freebuild(t_dspgraph *x)
+{
+    int i;
+    for (i = 0; i < DSPBUFHASH; i++)
+    {
+        t_dspbufuse *b, *b2;
+        for (b = x->g_bufuse[i]; b; b = b2)
+        {
+            b2 = b->b_next;
+            if (b->b_readers)
+                freebytes(b->b_readers, b->b_readersize * sizeof(int));
+            freebytes(b, sizeof(*b));
+        }
+        x->g_bufuse[i] = 0;
+    }
+}
+
+static void dspgraph_free(t_dspgraph *x)
+{
+    int i;
+    dspgraph_freebuild(x);
+    for (i = 0; i < x->g_ntasks; i++)
+        if (x->g_tasks[i].t_pred)
+            freebytes(x->g_tasks[i].t_pred,
+                x->g_tasks[i].t_predsize * sizeof(int));
+    if (x->g_tasks)
+        freebytes(x->g_tasks, x->g_tasksize * sizeof(*x->g_tasks));
+    if (x->g_npred)
+        freebytes(x->g_npred, x->g_nrun * sizeof(int));
+    if (x->g_succonset)
+        freebytes(x->g_succonset, (x->g_nrun + 1) * sizeof(int));
+    if (x->g_succ)
+        freebytes(x->g_succ, x->g_nsucc * sizeof(int));
+    if (x->g_rangeonset)
+        freebytes(x->g_rangeonset, (x->g_nrun + 1) * sizeof(int));
+    if (x->g_ranges)
+        freebytes(x->g_ranges, 2 * x->g_nranges * sizeof(int));
+    freebytes(x, sizeof(*x));
+}
+
+static void dspgraph_adddep(t_dspgraph *x, int task, int pred)
+{
+    t_dsptask *t = x->g_tasks + task;
+    int i;
+    if (pred < 0 || pred == task)
+        return;
+    for (i = t->t_npred; i--; )
+        if (t->t_pred[i] == pred)
+            return;
+    if (t->t_npred == t->t_predsize)
+    {
+        int newsize = (t->t_predsize ? 2 * t->t_predsize : 4);
+        t->t_pred = (int *)resizebytes(t->t_pred,
+            t->t_predsize * sizeof(int), newsize * sizeof(int));
+        t->t_predsize = newsize;
+    }
+    t->t_pred[t->t_npred++] = pred;
+}
+
+static int dspgraph_newtask(t_dspgraph *x, int onset)
+{
+    t_dsptask *t;
+    if (x->g_ntasks == x->g_tasksize)
+    {
+        int newsize = (x->g_tasksize ? 2 * x->g_tasksize : 64);
+        x->g_tasks = (t_dsptask *)resizebytes(x->g_tasks,
+            x->g_tasksize * sizeof(*x->g_tasks),
+                newsize * sizeof(*x->g_tasks));
+        x->g_tasksize = newsize;
+    }
+    t = x->g_tasks + x->g_ntasks;
+    t->t_onset = t->t_end = onset;
+    t->t_npred = t->t_predsize = t->t_nsucc = t->t_run = 0;
+    t->t_pred = 0;
+    t->t_shared = 0;
+    dspgraph_adddep(x, x->g_ntasks, x->g_lastbarrier);
+    return (x->g_ntasks++);
+}
+
+    /* code between "onset" and "end" that doesn't belong to any task */
+static void dspgraph_barrier(t_dspgraph *x, int onset, int end)
+{
+    int task = dspgraph_newtask(x, onset), i;
+    t_dsptask *t;
+    for (i = x->g_lastbarrier + 1; i < task; i++)
+        dspgraph_adddep(x, task, i);
+    t = x->g_tasks + task;
+    t->t_end = x->g_chainend = end;
+    x->g_lastbarrier = task;
+}
+
+    /* copy task "i" of an old graph, moved by "shift" in the chain, for a
+    toplevel canvas a re-sort leaves alone.  "map" holds the new index of
+    each old task copied so far, or -1; dependencies on the others are
+    taken care of by the barriers around the canvases we did re-sort. */
+static void dspgraph_copytask(t_dspgraph *x, t_dspgraph *old, int i,
+    int shift, int *map)
+{
+    t_dsptask *from = old->g_tasks + i;
+    int task = dspgraph_newtask(x, from->t_onset + shift), j;
+    x->g_tasks[task].t_end = from->t_end + shift;
+    x->g_tasks[task].t_shared = from->t_shared;
+    for (j = 0; j < from->t_npred; j++)
+        dspgraph_adddep(x, task, map[from->t_pred[j]]);
+    map[i] = task;
+}
+
+    /* move tasks and ranges by "shift" from "end" on, after the code
+    before "end" in a subpatch grew or shrank */
+static void dspgraph_shift(t_dspgraph *x, int end, int shift)
+{
+    int i;
+    for (i = 0; i < x->g_ntasks; i++)
+    {
+        if (x->g_tasks[i].t_onset >= end)
+            x->g_tasks[i].t_onset += shift;
+        if (x->g_tasks[i].t_end >= end)
+            x->g_tasks[i].t_end += shift;
+    }
+    for (i = 0; i < 2 * x->g_nranges; i++)
+        if (x->g_ranges[i] >= end)
+            x->g_ranges[i] += shift;
+    x->g_chain = THIS->u_dspchain;
+}
+
+static void ugen_taskbegin(void)
+{
+    t_dspgraph *x = THIS->u_graph;
+    int onset = THIS->u_dspchainsize - 1;
+    if (!x || x->g_suspend)
+        return;
+    if (x->g_current >= 0)
+        bug("ugen_taskbegin");
+    if (onset > x->g_chainend)
+        dspgraph_barrier(x, x->g_chainend, onset);
+    x->g_current = dspgraph_newtask(x, onset);
+}
+
+static void ugen_taskend(void)
+{
+    t_dspgraph *x = THIS->u_graph;
+    t_dsptask *t;
+    if (!x || x->g_current < 0)
+        return;
+    t = x->g_tasks + x->g_current;
+    t->t_end = x->g_chainend = THIS->u_dspchainsize - 1;
+    if (t->t_shared)
+    {
+        dspgraph_adddep(x, x->g_current, x->g_lastshared);
+        x->g_lastshared = x->g_current;
+    }
+    x->g_current = -1;
+}
+
+    /* note that the current task reads or writes a signal's buffer */
+static void ugen_taskuse(t_signal *s, int write)
+{
+    t_dspgraph *x = THIS->u_graph;
+    t_dspbufuse *b, **bp;
+    int task, i;
+    if (!x || (task = x->g_current) < 0 || !s->s_vec || s->s_isscalar)
+        return;
+    bp = &x->g_bufuse[((size_t)s->s_vec >> 6) % DSPBUFHASH];
+    for (b = *bp; b; b = b->b_next)
+        if (b->b_vec == s->s_vec)
+            break;
+    if (!b)
+    {
+        b = (t_dspbufuse *)getbytes(sizeof(*b));
+        b->b_vec = s->s_vec;
+        b->b_writer = -1;
+        b->b_next = *bp;
+        *bp = b;
+    }
+    dspgraph_adddep(x, task, b->b_writer);
+    if (write)
+    {
+        for (i = 0; i < b->b_nreaders; i++)
+            dspgraph_adddep(x, task, b->b_readers[i]);
+        b->b_writer = task;
+        b->b_nreaders = 0;
+    }
+    else if (!b->b_nreaders || b->b_readers[b->b_nreaders-1] != task)
+    {
+        if (b->b_nreaders == b->b_readersize)
+        {
+            int newsize = (b->b_readersize ? 2 * b->b_readersize : 4);
+            b->b_readers = (int *)resizebytes(b->b_readers,
+                b->b_readersize * sizeof(int), newsize * sizeof(int));
+            b->b_readersize = newsize;
+        }
+        b->b_readers[b->b_nreaders++] = task;
+    }
+}
+
+static void ugen_taskshared(void)
+{
+    t_dspgraph *x = THIS->u_graph;
+    if (x && x->g_current >= 0)
+        x->g_tasks[x->g_current].t_shared = 1;
+}
+
+    /* An object that runs several independent subpatches (clone) can ask to
+put each of them in a task of its own, as long as we aren't inside a reblocked
+or switched canvas whose DSP code jumps around.  Each branch starts with empty
+free lists, so that no two branches share a signal buffer; buffers freed in
+the branches only become available again after the join.  The caller then
+names the signals the join task will read (or that were read in the
+branches), so that whoever reuses those buffers waits for all branches. */
+int ugen_forkbranches(void)
+{
+    t_dspgraph *x = THIS->u_graph;
+    if (!x || x->g_suspend || x->g_nosplit || x->g_current < 0 ||
+        x->g_fork >= 0)
+            return (0);
+    x->g_fork = x->g_current;
+    ugen_taskend();
+    return (1);
+}
+
+static void ugen_stashfreelists(t_dspgraph *x)
+{
+    int i;
+    for (i = 0; i <= MAXLOGSIG; i++)
+    {
+        t_signal *s = THIS->u_freelist[i];
+        if (!s)
+            continue;
+        while (s->s_nextfree)
+            s = s->s_nextfree;
+        s->s_nextfree = x->g_stash[i];
+        x->g_stash[i] = THIS->u_freelist[i];
+        THIS->u_freelist[i] = 0;
+    }
+}
+
+    /* start the next branch, ending the previous one */
+void ugen_branch(void)
+{
+    t_dspgraph *x = THIS->u_graph;
+    if (!x || x->g_fork < 0)
+    {
+        bug("ugen_branch");
+        return;
+    }
+    if (x->g_current >= 0)
+        ugen_taskend();
+    ugen_stashfreelists(x);
+    ugen_taskbegin();
+    dspgraph_adddep(x, x->g_current, x->g_fork);
+}
+
+void ugen_joinbranches(int nsig, t_signal **sigs)
+{
+    t_dspgraph *x = THIS->u_graph;
+    int i, fork;
+    if (!x || (fork = x->g_fork) < 0)
+    {
+        bug("ugen_joinbranches");
+        return;
+    }
+    if (x->g_current >= 0)
+        ugen_taskend();
+    ugen_stashfreelists(x);
+    for (i = 0; i <= MAXLOGSIG; i++)
+        THIS->u_freelist[i] = x->g_stash[i], x->g_stash[i] = 0;
+    x->g_fork = -1;
+    ugen_taskbegin();
+    for (i = fork + 1; i < x->g_current; i++)
+        dspgraph_adddep(x, x->g_current, i);
+    for (i = 0; i < nsig; i++)
+        ugen_taskuse(sigs[i], 0);
+}
+
+static int dspgraph_edgecmp(const void *a, const void *b)
+{
+    const int *e1 = (const int *)a, *e2 = (const int *)b;
+    if (e1[0] != e2[0])
+        return (e1[0] < e2[0] ? -1 : 1);
+    return (e1[1] < e2[1] ? -1 : (e1[1] > e2[1]));
+}
+
+    /* done sorting: merge chains of tasks that can only run one after the
+    other anyway, and make the arrays the thread pool wants. */
+static void dspgraph_finish(t_dspgraph *x)
+{
+    int chainend = THIS->u_dspchainsize - 1, i, j, n, nedges, *edges;
+    t_dsptask *t;
+    if (chainend > x->g_chainend)
+        dspgraph_barrier(x, x->g_chainend, chainend);
+    for (i = 0, t = x->g_tasks; i < x->g_ntasks; i++, t++)
+        for (j = 0; j < t->t_npred; j++)
+            x->g_tasks[t->t_pred[j]].t_nsucc++;
+        /* a task whose only predecessor has no other successor joins it */
+    for (i = n = nedges = 0, t = x->g_tasks; i < x->g_ntasks; i++, t++)
+    {
+        if (t->t_npred == 1 && x->g_tasks[t->t_pred[0]].t_nsucc == 1)
+            t->t_run = x->g_tasks[t->t_pred[0]].t_run;
+        else t->t_run = n++, nedges += t->t_npred;
+    }
+    x->g_nrun = n;
+    x->g_npred = (int *)getbytes(n * sizeof(int));
+    x->g_succonset = (int *)getbytes((n + 1) * sizeof(int));
+    x->g_rangeonset = (int *)getbytes((n + 1) * sizeof(int));
+        /* chain ranges, merging adjacent ones */
+    for (i = 0, t = x->g_tasks; i < x->g_ntasks; i++, t++)
+        if (t->t_end > t->t_onset)
+            x->g_rangeonset[t->t_run + 1]++;
+    for (i = 0; i < n; i++)
+        x->g_rangeonset[i + 1] += x->g_rangeonset[i];
+    x->g_nranges = x->g_rangeonset[n];
+    x->g_ranges = (int *)getbytes(2 * (x->g_nranges ? x->g_nranges : 1) *
+        sizeof(int));
+    {
+        int *fill = (int *)getbytes(n * sizeof(int));
+        for (i = 0, t = x->g_tasks; i < x->g_ntasks; i++, t++)
+            if (t->t_end > t->t_onset)
+        {
+            int k = x->g_rangeonset[t->t_run] + fill[t->t_run];
+            if (fill[t->t_run] && x->g_ranges[2*k-1] == t->t_onset)
+                x->g_ranges[2*k-1] = t->t_end;
+            else
+            {
+                x->g_ranges[2*k] = t->t_onset;
+                x->g_ranges[2*k+1] = t->t_end;
+                fill[t->t_run]++;
+            }
+        }
+            /* close up the gaps left by merged ranges */
+        for (i = j = 0; i < n; i++)
+        {
+            int k, onset = x->g_rangeonset[i];
+            x->g_rangeonset[i] = j;
+            for (k = 0; k < fill[i]; k++, j++)
+            {
+                x->g_ranges[2*j] = x->g_ranges[2*(onset+k)];
+                x->g_ranges[2*j+1] = x->g_ranges[2*(onset+k)+1];
+            }
+        }
+        x->g_rangeonset[n] = j;
+        freebytes(fill, n * sizeof(int));
+    }
+        /* dependencies between merged tasks, without duplicates */
+    edges = (int *)getbytes(2 * (nedges ? nedges : 1) * sizeof(int));
+    for (i = j = 0, t = x->g_tasks; i < x->g_ntasks; i++, t++)
+    {
+        int k;
+        for (k = 0; k < t->t_npred; k++)
+            if (x->g_tasks[t->t_pred[k]].t_run != t->t_run)
+        {
+            edges[2*j] = x->g_tasks[t->t_pred[k]].t_run;
+            edges[2*j+1] = t->t_run;
+            j++;
+        }
+    }
+    qsort(edges, j, 2 * sizeof(int), dspgraph_edgecmp);
+    x->g_succ = (int *)getbytes((j ? j : 1) * sizeof(int));
+    for (i = 0, x->g_nsucc = 0; i < j; i++)
+    {
+        if (i && edges[2*i] == edges[2*i-2] && edges[2*i+1] == edges[2*i-1])
+            continue;
+        x->g_succ[x->g_nsucc++] = edges[2*i+1];
+        x->g_succonset[edges[2*i] + 1]++;
+        x->g_npred[edges[2*i+1]]++;
+    }
+    x->g_succ = (int *)resizebytes(x->g_succ, (j ? j : 1) * sizeof(int),
+        x->g_nsucc * sizeof(int));
+    for (i = 0; i < n; i++)
+        x->g_succonset[i + 1] += x->g_succonset[i];
+    freebytes(edges, 2 * (nedges ? nedges : 1) * sizeof(int));
+    logpost(0, PD_VERBOSE, "DSP threads: %d tasks (%d after merging)",
+        x->g_ntasks, x->g_nrun);
+    dspgraph_freebuild(x);
+    x->g_chain = THIS->u_dspchain;
+    dspthreads_reserve(THIS->u_threads, x->g_nrun);
+}
+
+static void dspgraph_runtask(void *z, int task)
+{
+    t_dspgraph *x = (t_dspgraph *)z;
+    int i;
+    for (i = x->g_rangeonset[task]; i < x->g_rangeonset[task+1]; i++)
+    {
+        t_int *ip = x->g_chain + x->g_ranges[2*i],
+            *end = x->g_chain + x->g_ranges[2*i+1];
+        if (x->g_profile)
+            dspprofile_run(x->g_profile, x->g_chain, ip, end);
+        else while (ip && ip < end)
+            ip = (*(t_perfroutine)(*ip))(ip);
+    }
+}
+
+    /* set the number of DSP threads; 0 or 1 means run the chain serially */
+void glob_dspthreads(void *dummy, t_floatarg f)
+{
+    int n = f, dspstate;
+    if (n < 0)
+        n = 0;
+    if (n > MAXDSPTHREADS)
+        n = MAXDSPTHREADS;
+    dspstate = canvas_suspend_dsp();
+    THIS->u_nthreads = n;
+    if (THIS->u_threads && dspthreads_getnthreads(THIS->u_threads) != n)
+    {
+        dspthreads_free(THIS->u_threads);
+        THIS->u_threads = 0;
+    }
+    canvas_resume_dsp(dspstate);
+}
+
 /* ------------------ DSP call list ----------------------- */
 
 static t_int dsp_done(t_int *w)
@@ -379,6 +1441,21 @@ static t_int dsp_done(t_int *w)
     return (0);
 }
 
+    /* remember where each routine starts so we can look for runs to fuse.
+    An onset of -1 marks a place (such as a jump target) no run may cross. */
+static void ugen_addentry(int onset)
+{
+    if (THIS->u_nentries == THIS->u_entriessize)
+    {
+        int newsize = (THIS->u_entriessize ? 2 * THIS->u_entriessize : 256);
+        THIS->u_entries = (int *)resizebytes(THIS->u_entries,
+            THIS->u_entriessize * sizeof(int), newsize * sizeof(int));
+        THIS->u_entriessize = newsize;
+    }
+    THIS->u_entries[THIS->u_nentries++] = onset;
+    dspprofile_addentry(onset);
+}
+
 void dsp_add(t_perfroutine f, int n, ...)
 {
     int newsize = THIS->u_dspchainsize + n+1, i;
@@ -386,6 +1463,7 @@ void dsp_add(t_perfroutine f, int n, ...)
 
     THIS->u_dspchain = t_resizebytes(THIS->u_dspchain,
         THIS->u_dspchainsize * sizeof (t_int), newsize * sizeof (t_int));
+    ugen_addentry(THIS->u_dspchainsize-1);
     THIS->u_dspchain[THIS->u_dspchainsize-1] = (t_int)f;
     if (THIS->u_loud)
         post("add to chain: %lx",
@@ -403,28 +1481,362 @@ void dsp_add(t_perfroutine f, int n, ...)
     THIS->u_dspchainsize = newsize;
 }
 
-    /* at Guenter's suggestion, here's a vectorized version */
-void dsp_addv(t_perfroutine f, int n, t_int *vec)
+    /* at Guenter's suggestion, here's a vectorized version */
+void dsp_addv(t_perfroutine f, int n, t_int *vec)
+{
+    int newsize = THIS->u_dspchainsize + n+1, i;
+
+    THIS->u_dspchain = t_resizebytes(THIS->u_dspchain,
+        THIS->u_dspchainsize * sizeof (t_int), newsize * sizeof (t_int));
+    ugen_addentry(THIS->u_dspchainsize-1);
+    THIS->u_dspchain[THIS->u_dspchainsize-1] = (t_int)f;
+    for (i = 0; i < n; i++)
+        THIS->u_dspchain[THIS->u_dspchainsize + i] = vec[i];
+    THIS->u_dspchain[newsize-1] = (t_int)dsp_done;
+    THIS->u_dspchainsize = newsize;
+}
+
+void dsp_tick(void)
+{
+    if (THIS->u_dspchain)
+    {
+        t_dspgraph *x = THIS->u_graph;
+        t_dspprofile *p = THIS->u_profile;
+        if (p && p->p_on)
+        {
+            dspprofile_reserve(p, THIS->u_dspchainsize);
+            p->p_nticks++;
+        }
+        else p = 0;
+        if (x && x->g_nrun > 1)
+        {
+            x->g_profile = p;
+            dspthreads_run(THIS->u_threads, x->g_nrun, x->g_npred,
+                x->g_succonset, x->g_succ, dspgraph_runtask, x);
+        }
+        else if (p)
+            dspprofile_run(p, THIS->u_dspchain, THIS->u_dspchain, 0);
+        else
+        {
+            t_int *ip;
+            for (ip = THIS->u_dspchain; ip; )
+                ip = (*(t_perfroutine)(*ip))(ip);
+        }
+        THIS->u_phase++;
+    }
+}
+
+/* ------------------ fused perform routines ----------------------- */
+
+/* After each toplevel canvas is sorted we look for runs of adjacent
+elementwise perform routines (the arithmetic binops and clip~) that all
+work on the same number of points, and rewrite each run in place as a single
+call to fuse_perform().  That routine goes through the run a tile of points
+at a time, so the output of one operation is passed on to the next in a
+local buffer instead of being read back from memory, and we make one call
+instead of one per operation.  Every operation still writes its output
+vector, since something later in the chain may use it.  Since the
+operations are elementwise and all buffers in a run either coincide or don't
+overlap at all, this computes exactly the same thing as the original code.
+
+The fused code is shorter than what it replaces, so it fits in the same
+place; the rest of the chain and all jump offsets stay where they were.
+The code for a run is a header (fuse_perform, number of points) followed by
+one record per operation: the operation code (with FUSE_LAST set for the
+last one), the first input, the second input or a pointer to a scalar, the
+output, and for clip~ a pointer to the upper limit. */
+
+#define FUSE_PLUS 0
+#define FUSE_MINUS 1
+#define FUSE_TIMES 2
+#define FUSE_SCALARPLUS 3
+#define FUSE_SCALARMINUS 4
+#define FUSE_REVERSESCALARMINUS 5
+#define FUSE_SCALARTIMES 6
+#define FUSE_CLIP 7
+#define FUSE_OPMASK 15
+#define FUSE_LAST 16
+
+#define FUSETILE 64     /* points per pass through the operations */
+#define FUSEMAXOPS 64   /* longest run we make */
+
+    /* perform routines we know about, from d_arithmetic.c and d_math.c */
+t_int *minus_perform(t_int *w);
+t_int *minus_perf8(t_int *w);
+t_int *times_perform(t_int *w);
+t_int *times_perf8(t_int *w);
+t_int *scalarplus_perform(t_int *w);
+t_int *scalarplus_perf8(t_int *w);
+t_int *scalarminus_perform(t_int *w);
+t_int *scalarminus_perf8(t_int *w);
+t_int *reversescalarminus_perform(t_int *w);
+t_int *reversescalarminus_perf8(t_int *w);
+t_int *scalartimes_perform(t_int *w);
+t_int *scalartimes_perf8(t_int *w);
+t_int *clip_perform(t_int *w);
+t_int *clip_perform8(t_int *w);
+
+static const struct _fusable
+{
+    t_perfroutine f_routine;
+    int f_op;
+} fusables[] =
+{
+    {plus_perform, FUSE_PLUS},
+    {plus_perf8, FUSE_PLUS},
+    {minus_perform, FUSE_MINUS},
+    {minus_perf8, FUSE_MINUS},
+    {times_perform, FUSE_TIMES},
+    {times_perf8, FUSE_TIMES},
+    {scalarplus_perform, FUSE_SCALARPLUS},
+    {scalarplus_perf8, FUSE_SCALARPLUS},
+    {scalarminus_perform, FUSE_SCALARMINUS},
+    {scalarminus_perf8, FUSE_SCALARMINUS},
+    {reversescalarminus_perform, FUSE_REVERSESCALARMINUS},
+    {reversescalarminus_perf8, FUSE_REVERSESCALARMINUS},
+    {scalartimes_perform, FUSE_SCALARTIMES},
+    {scalartimes_perf8, FUSE_SCALARTIMES},
+    {clip_perform, FUSE_CLIP},
+    {clip_perform8, FUSE_CLIP},
+};
+
+#define NFUSABLES (sizeof(fusables)/sizeof(*fusables))
+
+    /* size of an operation's record in fused code; the original call took
+    one more slot for the function pointer */
+#define FUSE_RECSIZE(op) ((op) == FUSE_CLIP ? 5 : 4)
+
+static t_int *fuse_perform(t_int *w)
+{
+    int n = (int)(w[1]), onset, m, i, code;
+    t_sample buf[FUSETILE];
+    t_int *ip, *end;
+        /* find the end of the original code */
+    for (ip = w + 2, end = w; ; ip += FUSE_RECSIZE(code & FUSE_OPMASK))
+    {
+        code = (int)ip[0];
+        end += FUSE_RECSIZE(code & FUSE_OPMASK) + 1;
+        if (code & FUSE_LAST)
+            break;
+    }
+    for (onset = 0; onset < n; onset += FUSETILE)
+    {
+        t_sample *prev = 0;
+        m = (n - onset < FUSETILE ? n - onset : FUSETILE);
+        for (ip = w + 2; ; ip += FUSE_RECSIZE(code & FUSE_OPMASK))
+        {
+            t_sample *in1 = (t_sample *)(ip[1]), *out = (t_sample *)(ip[3]),
+                *a = (in1 == prev ? buf : in1 + onset), *b;
+            t_sample f, lo, hi;
+            code = (int)ip[0];
+            switch (code & FUSE_OPMASK)
+            {
+            case FUSE_PLUS:
+            case FUSE_MINUS:
+            case FUSE_TIMES:
+                b = (t_sample *)(ip[2]);
+                b = (b == prev ? buf : b + onset);
+                if ((code & FUSE_OPMASK) == FUSE_PLUS)
+                    for (i = 0; i < m; i++)
+                        buf[i] = a[i] + b[i];
+                else if ((code & FUSE_OPMASK) == FUSE_MINUS)
+                    for (i = 0; i < m; i++)
+                        buf[i] = a[i] - b[i];
+                else for (i = 0; i < m; i++)
+                    buf[i] = a[i] * b[i];
+                break;
+            case FUSE_SCALARPLUS:
+                f = *(t_float *)(ip[2]);
+                for (i = 0; i < m; i++)
+                    buf[i] = a[i] + f;
+                break;
+            case FUSE_SCALARMINUS:
+                f = *(t_float *)(ip[2]);
+                for (i = 0; i < m; i++)
+                    buf[i] = a[i] - f;
+                break;
+            case FUSE_REVERSESCALARMINUS:
+                f = *(t_float *)(ip[2]);
+                for (i = 0; i < m; i++)
+                    buf[i] = f - a[i];
+                break;
+            case FUSE_SCALARTIMES:
+                f = *(t_float *)(ip[2]);
+                for (i = 0; i < m; i++)
+                    buf[i] = a[i] * f;
+                break;
+            case FUSE_CLIP:
+                lo = *(t_float *)(ip[2]);
+                hi = *(t_float *)(ip[4]);
+                for (i = 0; i < m; i++)
+                {
+                    f = a[i];
+                    buf[i] = (f < lo ? lo : f > hi ? hi : f);
+                }
+                break;
+            }
+            memcpy(out + onset, buf, m * sizeof(t_sample));
+            prev = out;
+            if (code & FUSE_LAST)
+                break;
+        }
+    }
+    return (end);
+}
+
+static int fuse_getop(t_int routine)
+{
+    unsigned int i;
+    for (i = 0; i < NFUSABLES; i++)
+        if ((t_int)fusables[i].f_routine == routine)
+            return (fusables[i].f_op);
+    return (-1);
+}
+
+typedef struct _fuseop
+{
+    int o_op;
+    t_int o_n;
+    t_sample *o_in1;
+    t_sample *o_in2;        /* zero if a scalar */
+    t_float *o_scalar;      /* scalar input or lower limit for clip~ */
+    t_float *o_hi;
+    t_sample *o_out;
+} t_fuseop;
+
+static void fuse_decode(t_int *w, int op, t_fuseop *o)
+{
+    o->o_op = op;
+    o->o_in2 = 0;
+    o->o_scalar = o->o_hi = 0;
+    if (op == FUSE_CLIP)
+    {
+        o->o_in1 = (t_sample *)(w[1]);
+        o->o_out = (t_sample *)(w[2]);
+        o->o_n = w[3];
+        o->o_scalar = (t_float *)(w[4]);
+        o->o_hi = (t_float *)(w[5]);
+    }
+    else
+    {
+        o->o_in1 = (t_sample *)(w[1]);
+        if (op <= FUSE_TIMES)
+            o->o_in2 = (t_sample *)(w[2]);
+        else o->o_scalar = (t_float *)(w[2]);
+        o->o_out = (t_sample *)(w[3]);
+        o->o_n = w[4];
+    }
+}
+
+    /* two vectors of n points have to be either the same or disjoint */
+static int fuse_vecok(t_sample *v1, t_sample *v2, t_int n)
+{
+    return (!v1 || !v2 || v1 == v2 || v1 + n <= v2 || v2 + n <= v1);
+}
+
+static int fuse_scalarok(t_float *f, t_sample *v, t_int n)
+{
+    return (!f || (char *)f + sizeof(t_float) <= (char *)v ||
+        (char *)(v + n) <= (char *)f);
+}
+
+    /* check whether operation "o" can join the run "ops" */
+static int fuse_canjoin(t_fuseop *ops, int nops, t_fuseop *o)
+{
+    int i;
+    t_int n = o->o_n;
+    if (!nops)
+        return (1);
+    if (nops >= FUSEMAXOPS || n != ops[0].o_n || n < 1)
+        return (0);
+    for (i = 0; i < nops; i++)
+    {
+        t_fuseop *p = &ops[i];
+        if (!fuse_vecok(o->o_in1, p->o_out, n) ||
+            !fuse_vecok(o->o_in2, p->o_out, n) ||
+            !fuse_vecok(o->o_out, p->o_out, n) ||
+            !fuse_vecok(o->o_out, p->o_in1, n) ||
+            !fuse_vecok(o->o_out, p->o_in2, n) ||
+            !fuse_scalarok(o->o_scalar, p->o_out, n) ||
+            !fuse_scalarok(o->o_hi, p->o_out, n) ||
+            !fuse_scalarok(p->o_scalar, o->o_out, n) ||
+            !fuse_scalarok(p->o_hi, o->o_out, n))
+                return (0);
+    }
+    return (1);
+}
+
+    /* rewrite a run of operations starting at chain onset "onset" */
+static void fuse_write(int onset, t_fuseop *ops, int nops)
+{
+    t_int *ip = THIS->u_dspchain + onset;
+    int i;
+    *ip++ = (t_int)fuse_perform;
+    *ip++ = ops[0].o_n;
+    for (i = 0; i < nops; i++)
+    {
+        *ip++ = ops[i].o_op | (i == nops - 1 ? FUSE_LAST : 0);
+        *ip++ = (t_int)ops[i].o_in1;
+        *ip++ = (ops[i].o_in2 ? (t_int)ops[i].o_in2 : (t_int)ops[i].o_scalar);
+        *ip++ = (t_int)ops[i].o_out;
+        if (ops[i].o_op == FUSE_CLIP)
+            *ip++ = (t_int)ops[i].o_hi;
+    }
+}
+
+    /* fuse the code added since entry number "from".  Reports the number of
+    runs made and of the operations in them. */
+static void ugen_fusefrom(int from, int *nruns, int *nops)
+{
+    t_fuseop ops[FUSEMAXOPS];
+    int i, n = 0, runonset = -1;
+    *nruns = *nops = 0;
+    if (!THIS->u_fuse || THIS->u_graph)
+    {
+        THIS->u_nentries = from;
+        return;
+    }
+    for (i = from; i <= THIS->u_nentries; i++)
+    {
+        int onset = (i < THIS->u_nentries ? THIS->u_entries[i] : -1),
+            op = (onset >= 0 ? fuse_getop(THIS->u_dspchain[onset]) : -1);
+        t_fuseop o;
+        if (op >= 0)
+        {
+            fuse_decode(THIS->u_dspchain + onset, op, &o);
+            if (fuse_canjoin(ops, n, &o))
+            {
+                if (!n)
+                    runonset = onset;
+                ops[n++] = o;
+                continue;
+            }
+        }
+        if (n > 1)
+        {
+            fuse_write(runonset, ops, n);
+            (*nruns)++;
+            *nops += n;
+        }
+        n = 0;
+        if (op >= 0)
+            ops[n++] = o, runonset = onset;
+    }
+    THIS->u_nentries = from;
+}
+
+    /* fuse the code added since we were last called */
+static void ugen_fuseentries(int *nruns, int *nops)
 {
-    int newsize = THIS->u_dspchainsize + n+1, i;
-
-    THIS->u_dspchain = t_resizebytes(THIS->u_dspchain,
-        THIS->u_dspchainsize * sizeof (t_int), newsize * sizeof (t_int));
-    THIS->u_dspchain[THIS->u_dspchainsize-1] = (t_int)f;
-    for (i = 0; i < n; i++)
-        THIS->u_dspchain[THIS->u_dspchainsize + i] = vec[i];
-    THIS->u_dspchain[newsize-1] = (t_int)dsp_done;
-    THIS->u_dspchainsize = newsize;
+    ugen_fusefrom(0, nruns, nops);
 }
 
-void dsp_tick(void)
+    /* turn fusing on or off */
+void glob_dspfuse(void *dummy, t_floatarg f)
 {
-    if (THIS->u_dspchain)
-    {
-        t_int *ip;
-        for (ip = THIS->u_dspchain; ip; ) ip = (*(t_perfroutine)(*ip))(ip);
-        THIS->u_phase++;
-    }
+    int dspstate = canvas_suspend_dsp();
+    THIS->u_fuse = (f != 0);
+    canvas_resume_dsp(dspstate);
 }
 
 /* ---------------- signals ---------------------------- */
@@ -443,17 +1855,84 @@ int ilog2(int n)
 
 
     /* call this when DSP is stopped to free all the signals */
+/* Signal vectors are carved out of an "arena" of big chunks of memory,
+aligned to SIGALIGN bytes and rounded up to a multiple of that size (rather
+than to a power of two as they used to be.)  As the DSP graph is sorted, a
+signal is freed as soon as the last object to read it has been scheduled, and
+its vector goes on a free list to be reused by the next signal that fits; so
+vectors whose lifetimes along the DSP chain don't overlap share space.  The
+whole arena is freed when DSP is restarted, and the first chunk is then made
+big enough to hold everything we needed last time, so that normally all
+signal vectors end up in one contiguous block. */
+
+#define SIGALIGN 64         /* alignment of signal vectors in bytes */
+#define SIGCHUNK 65536      /* smallest arena chunk in bytes */
+#define SIGALIGNPOINTS (SIGALIGN / sizeof(t_sample))
+
+typedef struct _sigchunk
+{
+    struct _sigchunk *c_next;
+    char *c_mem;            /* as allocated */
+    char *c_base;           /* aligned */
+    size_t c_size;          /* usable size after alignment */
+    size_t c_used;
+} t_sigchunk;
+
+static t_sample *signal_arenaalloc(int npoints)
+{
+    size_t nbytes = npoints * sizeof(t_sample);
+    t_sigchunk *c = THIS->u_arena;
+    t_sample *ret;
+    if (!c || c->c_used + nbytes > c->c_size)
+    {
+        size_t size = (THIS->u_arenahint > nbytes ? THIS->u_arenahint : nbytes);
+        if (size < SIGCHUNK)
+            size = SIGCHUNK;
+        c = (t_sigchunk *)getbytes(sizeof(*c));
+        c->c_mem = (char *)getbytes(size + SIGALIGN);
+        c->c_base = (char *)(((size_t)c->c_mem + (SIGALIGN - 1)) &
+            ~(size_t)(SIGALIGN - 1));
+        c->c_size = size;
+        c->c_used = 0;
+        c->c_next = THIS->u_arena;
+        THIS->u_arena = c;
+        THIS->u_arenahint = 0;
+    }
+    ret = (t_sample *)(c->c_base + c->c_used);
+    c->c_used += nbytes;
+    THIS->u_arenaused += nbytes;
+    if (THIS->u_arenaused > THIS->u_arenapeak)
+        THIS->u_arenapeak = THIS->u_arenaused;
+    return (ret);
+}
+
+    /* which free list a vector of "npoints" points goes on */
+static int signal_sizeclass(int npoints)
+{
+    int logn = ilog2(npoints);
+    if ((1<<logn) < npoints)
+        logn++;
+    return (logn);
+}
+
 static void signal_cleanup(void)
 {
     t_signal *sig;
+    t_sigchunk *c;
     int i;
     while ((sig = THIS->u_signals))
     {
         THIS->u_signals = sig->s_nextused;
-        if (!sig->s_isborrowed && !sig->s_isscalar)
-            t_freebytes(sig->s_vec, sig->s_nalloc * sizeof (*sig->s_vec));
         t_freebytes(sig, sizeof *sig);
     }
+    while ((c = THIS->u_arena))
+    {
+        THIS->u_arena = c->c_next;
+        freebytes(c->c_mem, c->c_size + SIGALIGN);
+        freebytes(c, sizeof(*c));
+    }
+    THIS->u_arenahint = THIS->u_arenaused;
+    THIS->u_arenaused = 0;
     for (i = 0; i <= MAXLOGSIG; i++)
         THIS->u_freelist[i] = 0;
     THIS->u_freeborrowed = 0;
@@ -473,7 +1952,7 @@ static void signal_dereference(t_signal *s)
     /* mark the signal "reusable." */
 void signal_makereusable(t_signal *sig)
 {
-    int logn = ilog2(sig->s_nalloc);
+    int logn = signal_sizeclass(sig->s_nalloc);
 #if 0
     t_signal *s5;
     for (s5 = THIS->u_freeborrowed; s5; s5 = s5->s_nextfree)
@@ -528,35 +2007,49 @@ void signal_makereusable(t_signal *sig)
 t_signal *signal_new(int length, int nchans, t_float sr, t_sample *scalarptr)
 {
     int allocsize = 0;
-    t_signal *ret, **whichlist;
+    t_signal *ret, **whichlist, **sp;
     if (sr < 1)
         bug("signal_new: 'sr' cannot be less than 1");
     if (nchans < 1)
         bug("signal_new: 'nchans' cannot be less than 1");
     if (length && !scalarptr)
     {
-            /* figure out which free list to use, depending on size of vector */
-        int logn = ilog2(length*nchans);
-            /* round up to a power of two */
-        if ((1<<logn) < length*nchans)
-            logn++;
-        allocsize = 1<<logn;
+            /* round up to the alignment and figure out which free list to
+            use, depending on size of vector */
+        int logn;
+        allocsize = ((length * nchans + SIGALIGNPOINTS - 1) /
+            SIGALIGNPOINTS) * SIGALIGNPOINTS;
+        logn = signal_sizeclass(allocsize);
         if (logn > MAXLOGSIG)
             bug("signal buffer too large");
-        whichlist = THIS->u_freelist + logn;
+            /* take the smallest one that's big enough; the most recently
+            freed one if there's a tie so that we can often work in place */
+        for (whichlist = 0, sp = THIS->u_freelist + logn; *sp;
+            sp = &(*sp)->s_nextfree)
+                if ((*sp)->s_nalloc >= allocsize && (!whichlist ||
+                    (*sp)->s_nalloc < (*whichlist)->s_nalloc))
+        {
+            whichlist = sp;
+            if ((*sp)->s_nalloc == allocsize)
+                break;
+        }
     }
     else /* scalar or borrowed signal */
         whichlist = &THIS->u_freeborrowed;
 
         /* try to reclaim one from the free list */
-    if ((ret = *whichlist))
+    if (whichlist && (ret = *whichlist))
+    {
         *whichlist = ret->s_nextfree;
+        if (allocsize)
+            allocsize = ret->s_nalloc;
+    }
     else
     {
                  /* LATER figure out what to do if we ran out of space */
         ret = (t_signal *)t_getbytes(sizeof *ret);
         if (allocsize)
-            ret->s_vec = (t_sample *)getbytes(allocsize * sizeof (*ret->s_vec));
+            ret->s_vec = signal_arenaalloc(allocsize);
         ret->s_nextused = THIS->u_signals;
         THIS->u_signals = ret;
     }
@@ -581,6 +2074,8 @@ t_signal *signal_new(int length, int nchans, t_float sr, t_sample *scalarptr)
     ret->s_overlap = 0;
     ret->s_refcount = 0;
     ret->s_borrowedfrom = 0;
+    if (allocsize)
+        ugen_taskuse(ret, 1);
     if (THIS->u_loud) post("new %lx: %lx", ret, ret->s_vec);
     return (ret);
 }
@@ -614,7 +2109,19 @@ void signal_setborrowed(t_signal *sig, t_signal *sig2)
     on output signal - we assume it's currently a pointer to the null signal */
 void signal_setmultiout(t_signal **sig, int nchans)
 {
-    int overlap = (*sig)->s_overlap;
+    int overlap = (*sig)->s_overlap, i;
+        /* when re-sorting a subpatch by itself, its outputs have to stay
+        where they were, see ugen_resortsub() */
+    for (i = 0; i < THIS->u_npinned; i++)
+        if (*sig == THIS->u_pinned + i)
+    {
+        if ((*sig)->s_nchans == nchans)
+        {
+            THIS->u_pinclaims++;
+            return;
+        }
+        THIS->u_pinfailed = 1;
+    }
     if (nchans > 0)
         *sig = signal_new((*sig)->s_length, nchans, (*sig)->s_sr, 0);
     else
@@ -682,6 +2189,12 @@ struct _dspcontext
     unsigned int dc_reblock:1;      /* true if we have to reblock in/outlets */
     unsigned int dc_switched:1;     /* true if we're switched */
     unsigned int dc_warnedmulti:1;  /* already warned about bad multi input */
+    int dc_onset;               /* where our code starts in the DSP chain */
+    int dc_nsorted;             /* counts when we started, for subsegments */
+    int dc_nentries;
+    int dc_nlinkcalls;
+    int dc_firstowner;
+    int dc_profowner;
 };
 #define DC_LENGTH(x) ((x)->dc_nullsignal.s_length)
 #define DC_SR(x) ((x)->dc_nullsignal.s_sr)
@@ -721,6 +2234,12 @@ void ugen_stop(void)
             THIS->u_dspchainsize * sizeof (t_int));
         THIS->u_dspchain = 0;
     }
+    if (THIS->u_graph)
+    {
+        dspgraph_free(THIS->u_graph);
+        THIS->u_graph = 0;
+    }
+    ugen_freesegments();
     signal_cleanup();
 
 }
@@ -733,7 +2252,826 @@ void ugen_start(void)
     THIS->u_dspchain = (t_int *)getbytes(sizeof(*THIS->u_dspchain));
     THIS->u_dspchain[0] = (t_int)dsp_done;
     THIS->u_dspchainsize = 1;
+    THIS->u_nsorted = THIS->u_incremental = 0;
+    THIS->u_nentries = 0;
+    THIS->u_profiled = (THIS->u_profile && THIS->u_profile->p_on);
+    if (THIS->u_profiled)
+        dspprofile_reset(THIS->u_profile);
     if (THIS->u_context) bug("ugen_start");
+    if (THIS->u_nthreads > 1)
+    {
+        if (!THIS->u_threads)
+            THIS->u_threads = dspthreads_new(THIS->u_nthreads);
+        THIS->u_graph = dspgraph_new();
+    }
+}
+
+    /* called after all toplevel canvases are sorted */
+void ugen_finish(void)
+{
+    int nruns, nops;
+    ugen_endsegment();
+    if (THIS->u_graph)
+        dspgraph_finish(THIS->u_graph);
+    THIS->u_arenabase = THIS->u_arenaused;
+    ugen_fusecount(&nruns, &nops);
+    if (nruns)
+        logpost(0, PD_VERBOSE, "DSP: fused %d perform routines into %d",
+            nops, nruns);
+}
+
+/* ------------------ incremental DSP update ----------------------- */
+
+/* We remember which part of the DSP chain belongs to each toplevel canvas (a
+"segment") and to each reblocked or switched subpatch in it (a "subsegment"),
+so that after an edit we can re-sort only the smallest of these that contains
+it and keep everyone else's code.  The code itself doesn't depend on where it
+is in the chain, except for the onsets of block~ objects, which we keep track
+of here so we can move them, and the task graph for DSP threads, whose tasks
+we move or copy.
+
+A toplevel canvas is sorted again into a new chain and can take any buffers
+from the free lists, since signal buffers never carry data from one toplevel
+canvas to the next; the others' code is copied over.  For DSP threads, a
+barrier before and after it stands in for the buffer dependencies we lose.
+
+A subpatch is sorted again in place, against copies of the signals it got and
+put out last time and with fresh buffers, as those on the free lists may be in
+use around it.  Its outputs have to end up where they were (see
+signal_setmultiout()), or else we give up and try a bigger piece.  Its code
+stays inside whatever task held it.
+
+Objects that find others by name or hold on to an array tell us what they
+looked up (ugen_dsplink()).  Toplevel canvases that looked up the same thing
+are re-sorted together, and so are those that looked up something that
+changed (see canvas_update_dsp_links()); a subpatch with such objects is
+re-sorted with its toplevel canvas.  Lookups made outside of sorting, and
+externals, which might be linked to anything, make the caller start DSP over.
+So does anything else that doesn't match what we remember. */
+
+typedef struct _segblock
+{
+    struct _block *sb_block;
+    int sb_onset;           /* its x_chainonset, as the block may be gone */
+} t_segblock;
+
+typedef struct _dspsegment
+{
+    t_canvas *sg_canvas;
+    int sg_onset;           /* where the code starts in the DSP chain */
+    int sg_size;
+    int sg_nugens;          /* number of ugens sorted */
+    int sg_nblocks;         /* block~ objects that store an onset */
+    t_segblock *sg_blocks;
+    int sg_nfuseruns;       /* runs of perform routines fused */
+    int sg_nfuseops;        /* and routines in them */
+    void **sg_links;        /* what its objects looked up */
+    int sg_nlinks;
+    int sg_linksize;
+    int sg_firsttask;       /* its tasks for DSP threads */
+    int sg_ntasks;
+    int sg_firstowner;      /* profiler owners added while sorting it */
+    int sg_nowners;
+    unsigned int sg_linked:1;   /* contains a "dsplinked" object */
+} t_dspsegment;
+
+typedef struct _dspsubsegment
+{
+    t_canvas *ss_canvas;
+    struct _block *ss_block;
+    int ss_toplevel;        /* segment it's in */
+    int ss_onset;
+    int ss_size;
+    int ss_nugens;          /* including those in subpatches */
+    int ss_nfuseruns;       /* fused here but not in a subsegment inside */
+    int ss_nfuseops;
+    int ss_firstowner;
+    int ss_nowners;
+    int ss_profowner;       /* profiler owner of the box, or -1 */
+    t_float ss_sr;          /* sample rate, block size and overlap outside */
+    int ss_length;
+    int ss_overlap;
+    int ss_nin;
+    int ss_nout;
+    t_signal *ss_io;        /* copies of the signals in and out */
+    unsigned int ss_linked:1;   /* can't be re-sorted by itself */
+} t_dspsubsegment;
+
+static void ugen_freesubsegment(t_dspsubsegment *ss)
+{
+    freebytes(ss->ss_io, (ss->ss_nin + ss->ss_nout) * sizeof(t_signal));
+}
+
+static void ugen_freesegments(void)
+{
+    int i;
+    for (i = 0; i < THIS->u_nsegments; i++)
+    {
+        t_dspsegment *sg = THIS->u_segments + i;
+        if (sg->sg_blocks)
+            freebytes(sg->sg_blocks, sg->sg_nblocks * sizeof(*sg->sg_blocks));
+        if (sg->sg_links)
+            freebytes(sg->sg_links, sg->sg_linksize * sizeof(void *));
+    }
+    if (THIS->u_segments)
+        freebytes(THIS->u_segments,
+            THIS->u_segmentsize * sizeof(*THIS->u_segments));
+    THIS->u_segments = 0;
+    THIS->u_nsegments = THIS->u_segmentsize = 0;
+    THIS->u_cursegment = -1;
+    for (i = 0; i < THIS->u_nsubsegs; i++)
+        ugen_freesubsegment(THIS->u_subsegs + i);
+    if (THIS->u_subsegs)
+        freebytes(THIS->u_subsegs,
+            THIS->u_subsegsize * sizeof(*THIS->u_subsegs));
+    THIS->u_subsegs = 0;
+    THIS->u_nsubsegs = THIS->u_subsegsize = 0;
+    if (THIS->u_loose)
+        freebytes(THIS->u_loose, THIS->u_loosesize * sizeof(void *));
+    THIS->u_loose = 0;
+    THIS->u_nloose = THIS->u_loosesize = 0;
+}
+
+static int ugen_haskey(void **vec, int n, void *key)
+{
+    while (n--)
+        if (vec[n] == key)
+            return (1);
+    return (0);
+}
+
+    /* add "key" to a list unless it's already there; returns 1 if added */
+static int ugen_addkey(void ***vec, int *n, int *size, void *key)
+{
+    if (ugen_haskey(*vec, *n, key))
+        return (0);
+    if (*n == *size)
+    {
+        int newsize = (*size ? 2 * *size : 8);
+        *vec = (void **)resizebytes(*vec, *size * sizeof(void *),
+            newsize * sizeof(void *));
+        *size = newsize;
+    }
+    (*vec)[(*n)++] = key;
+    return (1);
+}
+
+    /* called by objects that look something up by name, or hold on to an
+    array, when their "dsp" method runs (or later) */
+void ugen_dsplink(void *key)
+{
+    if (THIS->u_context)
+    {
+        THIS->u_nlinkcalls++;
+        if (THIS->u_cursegment >= 0)
+        {
+            t_dspsegment *sg = THIS->u_segments + THIS->u_cursegment;
+            ugen_addkey(&sg->sg_links, &sg->sg_nlinks, &sg->sg_linksize, key);
+        }
+    }
+    else if (THIS->u_dspchain)
+        ugen_addkey(&THIS->u_loose, &THIS->u_nloose, &THIS->u_loosesize, key);
+}
+
+    /* start recording segment "k" */
+static void ugen_opensegment(int k)
+{
+    t_dspsegment *sg = THIS->u_segments + k;
+    t_dspprofile *p = THIS->u_profile;
+    sg->sg_onset = THIS->u_dspchainsize - 1;
+    sg->sg_size = sg->sg_nugens = 0;
+    sg->sg_nfuseruns = sg->sg_nfuseops = 0;
+    sg->sg_nlinks = 0;
+    sg->sg_linked = 0;
+    sg->sg_firsttask = (THIS->u_graph ? THIS->u_graph->g_ntasks : 0);
+    sg->sg_ntasks = 0;
+    sg->sg_firstowner = (p && p->p_on ? p->p_nowners : 0);
+    sg->sg_nowners = 0;
+    THIS->u_cursegment = k;
+    THIS->u_nentries = 0;
+    dspprofile_toplevel(sg->sg_canvas);
+}
+
+static void ugen_endsegment(void)
+{
+    t_dspsegment *sg;
+    t_dspgraph *g = THIS->u_graph;
+    t_dspprofile *p = THIS->u_profile;
+    int nruns, nops, end = THIS->u_dspchainsize - 1;
+    ugen_fuseentries(&nruns, &nops);
+    if (THIS->u_cursegment < 0)
+        return;
+    sg = THIS->u_segments + THIS->u_cursegment;
+    sg->sg_nfuseruns += nruns;
+    sg->sg_nfuseops += nops;
+    sg->sg_size = end - sg->sg_onset;
+    if (g)
+    {
+            /* cover any code after the last task, so that the segment's
+            tasks cover its code and nobody else's */
+        if (g->g_chainend < end)
+            dspgraph_barrier(g, g->g_chainend, end);
+        sg->sg_ntasks = g->g_ntasks - sg->sg_firsttask;
+    }
+    if (p && p->p_on)
+        sg->sg_nowners = p->p_nowners - sg->sg_firstowner;
+    THIS->u_cursegment = -1;
+}
+
+    /* called before each toplevel canvas is sorted */
+void ugen_beginsegment(t_canvas *x)
+{
+    t_dspsegment *sg;
+    ugen_endsegment();
+    if (THIS->u_nsegments == THIS->u_segmentsize)
+    {
+        int newsize = (THIS->u_segmentsize ? 2 * THIS->u_segmentsize : 16);
+        THIS->u_segments = (t_dspsegment *)resizebytes(THIS->u_segments,
+            THIS->u_segmentsize * sizeof(*THIS->u_segments),
+                newsize * sizeof(*THIS->u_segments));
+        THIS->u_segmentsize = newsize;
+    }
+    sg = THIS->u_segments + THIS->u_nsegments;
+    sg->sg_canvas = x;
+    sg->sg_nblocks = 0;
+    sg->sg_blocks = 0;
+    sg->sg_links = 0;
+    sg->sg_linksize = 0;
+    ugen_opensegment(THIS->u_nsegments++);
+}
+
+static void ugen_segmentblock(struct _block *x)
+{
+    t_dspsegment *sg;
+    if (THIS->u_cursegment < 0)
+        return;
+    sg = THIS->u_segments + THIS->u_cursegment;
+    sg->sg_blocks = (t_segblock *)resizebytes(sg->sg_blocks,
+        sg->sg_nblocks * sizeof(*sg->sg_blocks),
+            (sg->sg_nblocks + 1) * sizeof(*sg->sg_blocks));
+    sg->sg_blocks[sg->sg_nblocks].sb_block = x;
+    sg->sg_blocks[sg->sg_nblocks++].sb_onset = x->x_chainonset;
+}
+
+    /* called at the end of sorting a reblocked or switched subpatch */
+static void ugen_subsegment(t_dspcontext *dc, struct _block *blk)
+{
+    t_dspprofile *p = (THIS->u_profiled ? THIS->u_profile : 0);
+    t_dspcontext *parent = dc->dc_parentcontext;
+    t_dspsubsegment *ss;
+    t_dspsegment *sg;
+    int nruns, nops, i, n = dc->dc_ninlets + dc->dc_noutlets;
+    if (THIS->u_cursegment < 0)
+        return;
+    sg = THIS->u_segments + THIS->u_cursegment;
+        /* fuse its code by itself so that a re-sort can do the same */
+    ugen_fusefrom(dc->dc_nentries, &nruns, &nops);
+    ugen_addentry(-1);
+    sg->sg_nfuseruns += nruns;
+    sg->sg_nfuseops += nops;
+    if (THIS->u_nsubsegs == THIS->u_subsegsize)
+    {
+        int newsize = (THIS->u_subsegsize ? 2 * THIS->u_subsegsize : 16);
+        THIS->u_subsegs = (t_dspsubsegment *)resizebytes(THIS->u_subsegs,
+            THIS->u_subsegsize * sizeof(*THIS->u_subsegs),
+                newsize * sizeof(*THIS->u_subsegs));
+        THIS->u_subsegsize = newsize;
+    }
+    ss = THIS->u_subsegs + THIS->u_nsubsegs++;
+    ss->ss_canvas = blk->x_canvas;
+    ss->ss_block = blk;
+    ss->ss_toplevel = THIS->u_cursegment;
+    ss->ss_onset = dc->dc_onset;
+    ss->ss_size = THIS->u_dspchainsize - 1 - dc->dc_onset;
+    ss->ss_nugens = THIS->u_nsorted - dc->dc_nsorted;
+    ss->ss_nfuseruns = nruns;
+    ss->ss_nfuseops = nops;
+    ss->ss_firstowner = dc->dc_firstowner;
+    ss->ss_nowners = (p ? p->p_nowners - dc->dc_firstowner : 0);
+    ss->ss_profowner = dc->dc_profowner;
+    ss->ss_sr = DC_SR(parent);
+    ss->ss_length = DC_LENGTH(parent);
+    ss->ss_overlap = DC_OVERLAP(parent);
+    ss->ss_nin = dc->dc_ninlets;
+    ss->ss_nout = dc->dc_noutlets;
+    ss->ss_io = (t_signal *)getbytes(n * sizeof(t_signal));
+    ss->ss_linked = (THIS->u_nlinkcalls != dc->dc_nlinkcalls ||
+        !dc->dc_iosigs);
+    for (i = 0; i < n && dc->dc_iosigs; i++)
+    {
+        if (dc->dc_iosigs[i])
+            ss->ss_io[i] = *dc->dc_iosigs[i];
+        else ss->ss_linked = 1;
+    }
+}
+
+    /* total fused code in all segments */
+static void ugen_fusecount(int *nruns, int *nops)
+{
+    int i;
+    for (i = *nruns = *nops = 0; i < THIS->u_nsegments; i++)
+    {
+        *nruns += THIS->u_segments[i].sg_nfuseruns;
+        *nops += THIS->u_segments[i].sg_nfuseops;
+    }
+}
+
+void canvas_dodsp(t_canvas *x, int toplevel, t_signal **sp);
+
+    /* check that what we remember still fits */
+static int ugen_canresort(void)
+{
+    t_dspprofile *p = THIS->u_profile;
+    t_canvas *y;
+    int i;
+    if (!THIS->u_dspchain || THIS->u_context || THIS->u_cursegment >= 0 ||
+        THIS->u_profiled != (p && p->p_on))
+            return (0);
+        /* don't let retired profiler owners or signal buffers pile up */
+    if (THIS->u_profiled && p->p_ngone > p->p_nowners - p->p_ngone)
+        return (0);
+    if (THIS->u_arenaused > 2 * THIS->u_arenabase + SIGCHUNK)
+        return (0);
+        /* the toplevel canvases have to be the same ones as last time */
+    for (y = pd_getcanvaslist(), i = 0; y; y = y->gl_next, i++)
+        if (i >= THIS->u_nsegments || THIS->u_segments[i].sg_canvas != y)
+            return (0);
+    return (i == THIS->u_nsegments);
+}
+
+    /* put signals we set aside back on the free lists */
+static void ugen_unstash(t_signal **stash)
+{
+    int i;
+    for (i = 0; i <= MAXLOGSIG; i++)
+    {
+        t_signal *s = stash[i];
+        if (!s)
+            continue;
+        while (s->s_nextfree)
+            s = s->s_nextfree;
+        s->s_nextfree = THIS->u_freelist[i];
+        THIS->u_freelist[i] = stash[i];
+    }
+}
+
+    /* take any of the "n" signals at "vec" off a free list; returns 1 if
+    there were any */
+static int ugen_unfree(t_signal **list, t_signal *vec, int n)
+{
+    int i, found = 0;
+    while (*list)
+    {
+        for (i = 0; i < n && *list != vec + i; i++)
+            ;
+        if (i < n)
+            *list = (*list)->s_nextfree, found = 1;
+        else list = &(*list)->s_nextfree;
+    }
+    return (found);
+}
+
+    /* sort subsegment "k" again in place.  Returns 0, with everything as it
+    was, if it doesn't come out so that it fits back in. */
+static int ugen_resortsub(int k)
+{
+    t_dspsubsegment *ss = THIS->u_subsegs + k;
+    t_dspsegment *sg = THIS->u_segments + ss->ss_toplevel;
+    t_dspprofile *p = (THIS->u_profiled ? THIS->u_profile : 0);
+    t_canvas *x = ss->ss_canvas;
+    t_int *oldchain = THIS->u_dspchain;
+    int oldsize = THIS->u_dspchainsize, onset = ss->ss_onset,
+        end = onset + ss->ss_size, nin = ss->ss_nin, nout = ss->ss_nout,
+        oldnugens = ss->ss_nugens, oldnblocks = sg->sg_nblocks,
+        oldnlinks = sg->sg_nlinks, oldnsubsegs = THIS->u_nsubsegs,
+        oldnlinkcalls = THIS->u_nlinkcalls,
+        oldnowners = (p ? p->p_nowners : 0), wasnugens = sg->sg_nugens,
+        wasfuseruns = sg->sg_nfuseruns, wasfuseops = sg->sg_nfuseops,
+        waslinked = sg->sg_linked, *wasowner = 0, size, shift, i, j, ok;
+    t_signal *stash[MAXLOGSIG+1], *fakes, **sigs;
+    t_dspcontext parent;
+    t_gobj *y;
+
+    if (ss->ss_linked || obj_nsiginlets(&x->gl_obj) != nin ||
+        obj_nsigoutlets(&x->gl_obj) != nout)
+            return (0);
+        /* the block~ has to be the one we sorted it with */
+    for (y = x->gl_list; y && y != (t_gobj *)ss->ss_block; y = y->g_next)
+        ;
+    if (!y)
+        return (0);
+    if (p)
+    {
+        wasowner = (int *)getbytes((oldsize - onset) * sizeof(int));
+        dspprofile_reserve(p, oldsize);
+        memcpy(wasowner, p->p_owner + onset,
+            (oldsize - onset) * sizeof(int));
+        for (i = onset; i < oldsize; i++)
+            p->p_owner[i] = -1;
+    }
+    for (i = 0; i <= MAXLOGSIG; i++)
+        stash[i] = THIS->u_freelist[i], THIS->u_freelist[i] = 0;
+    THIS->u_dspchain = (t_int *)getbytes((onset + 1) * sizeof(t_int));
+    memcpy(THIS->u_dspchain, oldchain, onset * sizeof(t_int));
+    THIS->u_dspchain[onset] = (t_int)dsp_done;
+    THIS->u_dspchainsize = onset + 1;
+    fakes = (t_signal *)getbytes((nin + nout) * sizeof(t_signal));
+    sigs = (t_signal **)getbytes((nin + nout) * sizeof(t_signal *));
+    for (i = 0; i < nin + nout; i++)
+    {
+        fakes[i] = ss->ss_io[i];
+        fakes[i].s_refcount = 1;
+        fakes[i].s_isborrowed = 0;
+        fakes[i].s_borrowedfrom = fakes[i].s_nextfree = 0;
+        sigs[i] = fakes + i;
+    }
+    THIS->u_pinned = fakes + nin;
+    THIS->u_npinned = nout;
+    THIS->u_pinclaims = THIS->u_pinfailed = 0;
+    memset(&parent, 0, sizeof(parent));
+    parent.dc_nullsignal.s_sr = ss->ss_sr;
+    parent.dc_nullsignal.s_length = ss->ss_length;
+    parent.dc_nullsignal.s_overlap = ss->ss_overlap;
+    parent.dc_nullsignal.s_nchans = -1;
+    THIS->u_context = &parent;
+    THIS->u_cursegment = ss->ss_toplevel;
+    THIS->u_nsorted = THIS->u_nentries = 0;
+    if (p)
+        p->p_current = ss->ss_profowner;
+
+    canvas_dodsp(x, 0, sigs);
+
+    THIS->u_context = 0;
+    THIS->u_cursegment = -1;
+    THIS->u_pinned = 0;
+    THIS->u_npinned = THIS->u_nentries = 0;
+    if (p)
+        p->p_current = -1;
+        /* it has to have come out whole, with its outputs in place */
+    for (j = THIS->u_nsubsegs; j-- > oldnsubsegs; )
+        if (THIS->u_subsegs[j].ss_canvas == x &&
+            THIS->u_subsegs[j].ss_onset == onset)
+                break;
+    ok = (j >= oldnsubsegs && !THIS->u_pinfailed &&
+        THIS->u_pinclaims == nout && THIS->u_nlinkcalls == oldnlinkcalls);
+    for (i = 0; i < nout; i++)
+        if (sigs[nin + i] != fakes + nin + i)
+            ok = 0;
+    for (i = 0; i <= MAXLOGSIG; i++)
+        if (ugen_unfree(&THIS->u_freelist[i], fakes, nin + nout))
+            ok = 0;
+    if (ugen_unfree(&THIS->u_freeborrowed, fakes, nin + nout))
+        ok = 0;
+    freebytes(fakes, (nin + nout) * sizeof(t_signal));
+    freebytes(sigs, (nin + nout) * sizeof(t_signal *));
+    ugen_unstash(stash);
+    if (!ok)
+    {
+        freebytes(THIS->u_dspchain, THIS->u_dspchainsize * sizeof(t_int));
+        if (p)
+        {
+            dspprofile_truncate(p, oldnowners);
+            dspprofile_reserve(p, THIS->u_dspchainsize);
+            for (i = oldsize; i < THIS->u_dspchainsize; i++)
+                p->p_owner[i] = -1;
+            memcpy(p->p_owner + onset, wasowner,
+                (oldsize - onset) * sizeof(int));
+            freebytes(wasowner, (oldsize - onset) * sizeof(int));
+        }
+        THIS->u_dspchain = oldchain;
+        THIS->u_dspchainsize = oldsize;
+        for (i = oldnsubsegs; i < THIS->u_nsubsegs; i++)
+            ugen_freesubsegment(THIS->u_subsegs + i);
+        THIS->u_nsubsegs = oldnsubsegs;
+        sg->sg_blocks = (t_segblock *)resizebytes(sg->sg_blocks,
+            sg->sg_nblocks * sizeof(*sg->sg_blocks),
+                oldnblocks * sizeof(*sg->sg_blocks));
+        sg->sg_nblocks = oldnblocks;
+        sg->sg_nlinks = oldnlinks;
+        sg->sg_nugens = wasnugens;
+        sg->sg_nfuseruns = wasfuseruns;
+        sg->sg_nfuseops = wasfuseops;
+        sg->sg_linked = waslinked;
+        return (0);
+    }
+        /* put the code after it back and move everything from there on */
+    size = THIS->u_dspchainsize - 1 - onset;
+    shift = size - (end - onset);
+    THIS->u_dspchain = (t_int *)resizebytes(THIS->u_dspchain,
+        THIS->u_dspchainsize * sizeof(t_int),
+            (oldsize + shift) * sizeof(t_int));
+    memcpy(THIS->u_dspchain + onset + size, oldchain + end,
+        (oldsize - end) * sizeof(t_int));
+    THIS->u_dspchainsize = oldsize + shift;
+    freebytes(oldchain, oldsize * sizeof(t_int));
+    for (i = j = 0; i < sg->sg_nblocks; i++)
+    {
+        t_segblock *b = sg->sg_blocks + i;
+        if (i < oldnblocks)
+        {
+            if (b->sb_onset >= onset && b->sb_onset < end)
+                continue;
+            else if (b->sb_onset >= end)
+                b->sb_block->x_chainonset = (b->sb_onset += shift);
+                /* a block around it: its code runs from the prolog to just
+                after the epilog */
+            else if (b->sb_onset - PROLOGCALL + b->sb_block->x_blocklength
+                >= end)
+                    b->sb_block->x_blocklength += shift;
+        }
+        sg->sg_blocks[j++] = *b;
+    }
+    sg->sg_blocks = (t_segblock *)resizebytes(sg->sg_blocks,
+        sg->sg_nblocks * sizeof(*sg->sg_blocks), j * sizeof(*sg->sg_blocks));
+    sg->sg_nblocks = j;
+    for (i = ss->ss_toplevel + 1; i < THIS->u_nsegments; i++)
+    {
+        t_dspsegment *sg2 = THIS->u_segments + i;
+        sg2->sg_onset += shift;
+        for (j = 0; j < sg2->sg_nblocks; j++)
+            sg2->sg_blocks[j].sb_block->x_chainonset =
+                (sg2->sg_blocks[j].sb_onset += shift);
+    }
+    sg->sg_size += shift;
+    sg->sg_nugens -= oldnugens;
+    for (i = j = 0; i < THIS->u_nsubsegs; i++)
+    {
+        t_dspsubsegment *s2 = THIS->u_subsegs + i;
+        if (i < oldnsubsegs)
+        {
+            if (s2->ss_onset >= onset && s2->ss_onset < end)
+            {
+                if (p)
+                    dspprofile_retire(p, s2->ss_firstowner, s2->ss_nowners);
+                sg->sg_nfuseruns -= s2->ss_nfuseruns;
+                sg->sg_nfuseops -= s2->ss_nfuseops;
+                ugen_freesubsegment(s2);
+                continue;
+            }
+            else if (s2->ss_onset >= end)
+                s2->ss_onset += shift;
+            else if (s2->ss_onset + s2->ss_size >= end)
+            {
+                s2->ss_size += shift;
+                s2->ss_nugens += THIS->u_nsorted - oldnugens;
+            }
+        }
+        THIS->u_subsegs[j++] = *s2;
+    }
+    THIS->u_nsubsegs = j;
+    if (THIS->u_graph)
+        dspgraph_shift(THIS->u_graph, end, shift);
+    if (p)
+    {
+        dspprofile_reserve(p, oldsize + shift);
+        memcpy(p->p_owner + onset + size, wasowner + (end - onset),
+            (oldsize - end) * sizeof(int));
+        for (i = oldsize + shift; i < oldsize; i++)
+            p->p_owner[i] = -1;
+        freebytes(wasowner, (oldsize - onset) * sizeof(int));
+        dspprofile_clearcounts(p);
+    }
+    THIS->u_incremental = 2;
+    return (1);
+}
+
+    /* toplevel canvases to re-sort, and what they looked up */
+typedef struct _resort
+{
+    char *r_marked;
+    void **r_keys;
+    int r_nkeys;
+    int r_keysize;
+    int r_next;             /* those before this one are done */
+} t_resort;
+
+static int ugen_markkey(t_resort *r, void *key);
+
+    /* mark segment "k" for re-sorting.  Returns 0 if we can't. */
+static int ugen_marksegment(t_resort *r, int k)
+{
+    t_dspsegment *sg = THIS->u_segments + k;
+    int i;
+    if (r->r_marked[k])
+        return (1);
+    if (k < r->r_next || sg->sg_linked)
+        return (0);
+    r->r_marked[k] = 1;
+    for (i = 0; i < sg->sg_nlinks; i++)
+        if (!ugen_markkey(r, sg->sg_links[i]))
+            return (0);
+    return (1);
+}
+
+    /* ... and all the segments that looked up "key" */
+static int ugen_markkey(t_resort *r, void *key)
+{
+    int i;
+    if (!ugen_addkey(&r->r_keys, &r->r_nkeys, &r->r_keysize, key))
+        return (1);
+    if (ugen_haskey(THIS->u_loose, THIS->u_nloose, key))
+        return (0);
+    for (i = 0; i < THIS->u_nsegments; i++)
+        if (!r->r_marked[i] && ugen_haskey(THIS->u_segments[i].sg_links,
+            THIS->u_segments[i].sg_nlinks, key) && !ugen_marksegment(r, i))
+                return (0);
+    return (1);
+}
+
+    /* forget the code of segment "k", which we're about to sort again */
+static void ugen_dropsegment(int k)
+{
+    t_dspsegment *sg = THIS->u_segments + k;
+    t_dspprofile *p = (THIS->u_profiled ? THIS->u_profile : 0);
+    int i, j;
+    if (sg->sg_blocks)
+        freebytes(sg->sg_blocks, sg->sg_nblocks * sizeof(*sg->sg_blocks));
+    sg->sg_blocks = 0;
+    sg->sg_nblocks = 0;
+    if (p)
+        dspprofile_retire(p, sg->sg_firstowner, sg->sg_nowners);
+    for (i = j = 0; i < THIS->u_nsubsegs; i++)
+    {
+        t_dspsubsegment *ss = THIS->u_subsegs + i;
+        if (ss->ss_toplevel == k)
+        {
+            if (p)
+                dspprofile_retire(p, ss->ss_firstowner, ss->ss_nowners);
+            ugen_freesubsegment(ss);
+        }
+        else THIS->u_subsegs[j++] = *ss;
+    }
+    THIS->u_nsubsegs = j;
+}
+
+    /* re-sort toplevel segment "dirty" (if not -1) and those that looked up
+    any of the "nkeys" keys, and any sharing keys with those.  Returns 0 if
+    we can't, in which case the caller has to start DSP over. */
+static int ugen_resorttop(int dirty, int nkeys, void **keys)
+{
+    t_resort r;
+    t_dspgraph *oldgraph = THIS->u_graph, *g = 0;
+    t_dspprofile *p = (THIS->u_profiled ? THIS->u_profile : 0);
+    t_int *oldchain = THIS->u_dspchain;
+    int oldsize = THIS->u_dspchainsize, *wasowner = 0, *map = 0,
+        ntasks = (oldgraph ? oldgraph->g_ntasks : 0), nmarked = 0,
+        nlinked = 0, ok = 1, i, j;
+
+    r.r_marked = (char *)getbytes(THIS->u_nsegments);
+    r.r_keys = 0;
+    r.r_nkeys = r.r_keysize = r.r_next = 0;
+    if (dirty >= 0)
+        ok = ugen_marksegment(&r, dirty);
+    for (i = 0; ok && i < nkeys; i++)
+        ok = ugen_markkey(&r, keys[i]);
+    for (i = 0; i < THIS->u_nsegments; i++)
+        nmarked += r.r_marked[i], nlinked += THIS->u_segments[i].sg_linked;
+        /* externals might have found our objects by name */
+    if (r.r_nkeys && nlinked)
+        ok = 0;
+    if (!ok || !nmarked)
+        goto done;
+    if (p)
+    {
+        wasowner = (int *)getbytes(oldsize * sizeof(int));
+        dspprofile_reserve(p, oldsize);
+        memcpy(wasowner, p->p_owner, oldsize * sizeof(int));
+        for (i = 0; i < oldsize; i++)
+            p->p_owner[i] = -1;
+    }
+    if (oldgraph)
+    {
+        g = THIS->u_graph = dspgraph_new();
+        map = (int *)getbytes((ntasks + 1) * sizeof(int));
+        for (i = 0; i < ntasks; i++)
+            map[i] = -1;
+    }
+    THIS->u_sortno++;
+    THIS->u_dspchain = (t_int *)getbytes(sizeof(*THIS->u_dspchain));
+    THIS->u_dspchain[0] = (t_int)dsp_done;
+    THIS->u_dspchainsize = 1;
+    THIS->u_nsorted = 0;
+    for (i = 0; ok && i < THIS->u_nsegments; i++)
+    {
+        t_dspsegment *sg = THIS->u_segments + i;
+        int onset = THIS->u_dspchainsize - 1;
+        r.r_next = i;
+        if (r.r_marked[i])
+        {
+            ugen_dropsegment(i);
+            ugen_opensegment(i);
+            if (g)
+            {
+                dspgraph_freebuild(g);
+                g->g_lastshared = -1;
+                dspgraph_barrier(g, onset, onset);
+            }
+            canvas_dodsp(sg->sg_canvas, 1, 0);
+            ugen_endsegment();
+            if (g)
+            {
+                dspgraph_barrier(g, onset + sg->sg_size, onset + sg->sg_size);
+                sg->sg_ntasks++;
+            }
+            if (sg->sg_linked)
+                ok = 0;
+                /* anyone after us who looked up the same things goes too */
+            for (j = 0; ok && j < sg->sg_nlinks; j++)
+                ok = ugen_markkey(&r, sg->sg_links[j]);
+        }
+        else
+        {
+            int shift = onset - sg->sg_onset, first = (g ? g->g_ntasks : 0);
+            THIS->u_dspchain = (t_int *)resizebytes(THIS->u_dspchain,
+                THIS->u_dspchainsize * sizeof(t_int),
+                    (THIS->u_dspchainsize + sg->sg_size) * sizeof(t_int));
+            memcpy(THIS->u_dspchain + onset, oldchain + sg->sg_onset,
+                sg->sg_size * sizeof(t_int));
+            THIS->u_dspchainsize += sg->sg_size;
+            THIS->u_dspchain[THIS->u_dspchainsize - 1] = (t_int)dsp_done;
+            for (j = 0; j < sg->sg_nblocks; j++)
+                sg->sg_blocks[j].sb_block->x_chainonset =
+                    (sg->sg_blocks[j].sb_onset += shift);
+            for (j = 0; j < THIS->u_nsubsegs; j++)
+                if (THIS->u_subsegs[j].ss_toplevel == i)
+                    THIS->u_subsegs[j].ss_onset += shift;
+            if (p)
+            {
+                dspprofile_reserve(p, THIS->u_dspchainsize);
+                memcpy(p->p_owner + onset, wasowner + sg->sg_onset,
+                    sg->sg_size * sizeof(int));
+            }
+            if (g)
+            {
+                for (j = 0; j < sg->sg_ntasks; j++)
+                    dspgraph_copytask(g, oldgraph, sg->sg_firsttask + j,
+                        shift, map);
+                sg->sg_firsttask = first;
+                g->g_chainend = onset + sg->sg_size;
+            }
+            sg->sg_onset = onset;
+        }
+    }
+    if (ok && r.r_nkeys && nlinked)
+        ok = 0;
+    if (ok)
+    {
+        if (g)
+        {
+            dspgraph_finish(g);
+            dspgraph_free(oldgraph);
+        }
+        if (p)
+            dspprofile_clearcounts(p);
+        for (i = nmarked = 0; i < THIS->u_nsegments; i++)
+            nmarked += r.r_marked[i];
+        THIS->u_incremental = 1;
+        THIS->u_nresorted = nmarked;
+    }
+        /* if not, DSP is about to start over; just drop the old stuff */
+    else if (oldgraph)
+        dspgraph_free(oldgraph);
+    freebytes(oldchain, oldsize * sizeof(t_int));
+    if (wasowner)
+        freebytes(wasowner, oldsize * sizeof(int));
+    if (map)
+        freebytes(map, (ntasks + 1) * sizeof(int));
+done:
+    freebytes(r.r_marked, THIS->u_nsegments);
+    if (r.r_keys)
+        freebytes(r.r_keys, r.r_keysize * sizeof(void *));
+    return (ok);
+}
+
+    /* re-sort after a change in the glist "x": the innermost reblocked or
+    switched subpatch it's in that we can, or else its toplevel canvas.
+    Returns 0 if that's impossible, in which case the caller has to start
+    DSP over. */
+int ugen_resort(t_glist *x)
+{
+    t_glist *y;
+    int i;
+    if (!ugen_canresort())
+        return (0);
+    for (y = x; y; y = y->gl_owner)
+    {
+        for (i = THIS->u_nsubsegs; i--; )
+            if (THIS->u_subsegs[i].ss_canvas == y)
+                break;
+        if (i >= 0 && ugen_resortsub(i))
+            return (1);
+        if (!y->gl_owner)
+            for (i = 0; i < THIS->u_nsegments; i++)
+                if (THIS->u_segments[i].sg_canvas == y)
+                    return (ugen_resorttop(i, 0, 0));
+    }
+    return (0);
+}
+
+    /* re-sort the toplevel canvases that looked up any of these */
+int ugen_resortlinks(int nkeys, void **keys)
+{
+    return (ugen_canresort() && ugen_resorttop(-1, nkeys, keys));
 }
 
 int ugen_getsortno(void)
@@ -741,11 +3079,21 @@ int ugen_getsortno(void)
     return (THIS->u_sortno);
 }
 
-#if 0
 void glob_ugen_printstate(void *dummy, t_symbol *s, int argc, t_atom *argv)
 {
     int i, count;
     t_signal *sig;
+    for (i = count = 0; i < THIS->u_nsegments; i++)
+        count += THIS->u_segments[i].sg_nugens;
+    if (THIS->u_incremental == 2)
+        post("last DSP update sorted %d of %d unit generators "
+            "(one reblocked or switched subpatch)", THIS->u_nsorted, count);
+    else if (THIS->u_incremental)
+        post("last DSP update sorted %d of %d unit generators "
+            "(%d of %d toplevel canvases)", THIS->u_nsorted, count,
+                THIS->u_nresorted, THIS->u_nsegments);
+    else post("last DSP update sorted %d of %d unit generators",
+        THIS->u_nsorted, count);
     for (count = 0, sig = THIS->u_signals; sig;
         count++, sig = sig->s_nextused)
             ;
@@ -756,16 +3104,29 @@ void glob_ugen_printstate(void *dummy, t_symbol *s, int argc, t_atom *argv)
             count++, sig = sig->s_nextfree)
                 ;
         if (count)
-            post("size %d: free %d", (1 << i), count);
+            post("size <= %d: free %d", (1 << i), count);
     }
     for (count = 0, sig = THIS->u_freeborrowed; sig;
         count++, sig = sig->s_nextfree)
             ;
     post("free borrowed %d", count);
+    {
+        int nruns, nops;
+        ugen_fusecount(&nruns, &nops);
+        post("fusing %s: %d perform routines fused into %d",
+            (THIS->u_fuse ? "on" : "off"), nops, nruns);
+    }
+    {
+        t_sigchunk *c;
+        for (count = 0, c = THIS->u_arena; c; c = c->c_next)
+            count++;
+        post("signal arena %lu bytes in %d chunk(s), peak %lu bytes",
+            (unsigned long)THIS->u_arenaused, count,
+                (unsigned long)THIS->u_arenapeak);
+    }
 
     THIS->u_loud = argc;
 }
-#endif
 
     /* start building the graph for a canvas */
 t_dspcontext *ugen_start_graph(int toplevel, t_signal **sp,
@@ -786,6 +3147,12 @@ t_dspcontext *ugen_start_graph(int toplevel, t_signal **sp,
     dc->dc_ninlets = ninlets;
     dc->dc_noutlets = noutlets;
     dc->dc_warnedmulti = 0;
+    dc->dc_onset = THIS->u_dspchainsize - 1;
+    dc->dc_nsorted = THIS->u_nsorted;
+    dc->dc_nentries = THIS->u_nentries;
+    dc->dc_nlinkcalls = THIS->u_nlinkcalls;
+    dc->dc_firstowner = (THIS->u_profiled ? THIS->u_profile->p_nowners : 0);
+    dc->dc_profowner = (THIS->u_profiled ? THIS->u_profile->p_current : -1);
     dc->dc_parentcontext = THIS->u_context;
     THIS->u_context = dc;
     return (dc);
@@ -874,6 +3241,8 @@ extern t_class *clone_class;
 static const t_sample ugen_scalarzero;  /* zero for scalar-to-vector copying */
 
 extern int class_getdspflags(const t_class *c);
+extern int class_isdspshared(const t_class *c);
+extern int class_isdsplinked(const t_class *c);
 
     /* put a ugenbox on the chain, recursively putting any others on that
     this one might uncover. */
@@ -885,7 +3254,7 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
     t_class *class = pd_class(&u->u_obj->ob_pd);
     t_signal *freelater = 0, *stmp;
     int flags = class_getdspflags(class);
-    int i, n;
+    int i, n, owner;
         /* suppress creating new signals for the outputs of signal
         inlets for non-reblocked canvases -- those will be borrowed. */
     int nonewsigs = ((class == vinlet_class) && !dc->dc_reblock);
@@ -896,6 +3265,8 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
         ((class == voutlet_class) &&  !(dc->dc_reblock || dc->dc_switched)));
     t_signal **insig, **outsig, **sig, *s1, *s2, *s3;
     t_ugenbox *u2;
+        /* in a toplevel canvas, each ugen is a task for DSP threads */
+    int toplevel = !dc->dc_parentcontext;
 
         /* if CLASS_MULTICHANNEL isn't set, check that all input signals
         are one-channel, and if not, just return without doing anything. */
@@ -912,6 +3283,19 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
 
     if (THIS->u_loud) post("doit %s %d %d", class_getname(class), nofreesigs,
         nonewsigs);
+    if (toplevel)
+        ugen_taskbegin();
+    if (class_isdspshared(class))
+        ugen_taskshared();
+    THIS->u_nsorted++;
+    if (THIS->u_cursegment >= 0)
+        THIS->u_segments[THIS->u_cursegment].sg_nugens++;
+    if (class_isdsplinked(class))
+    {
+        THIS->u_nlinkcalls++;
+        if (THIS->u_cursegment >= 0)
+            THIS->u_segments[THIS->u_cursegment].sg_linked = 1;
+    }
 
         /* Fill in unconnected inlets.  Normally we create a signal for it and
         add a scalar-to-vector copy to the DSP chain to fill it in from the
@@ -947,6 +3331,7 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
     for (sig = insig, uin = u->u_in, i = u->u_nin; i--; sig++, uin++)
     {
         *sig = uin->i_signal;
+        ugen_taskuse(*sig, 0);
         if (1)
         {
                 /* if scalar or borrowed, put on free-after-dsp-call list -
@@ -989,7 +3374,11 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
         /* now call the DSP scheduling routine for the ugen.  This
         routine must fill in "borrowed" signal outputs in case it's either
         a subcanvas or a signal inlet. */
+    owner = dspprofile_enter(u->u_obj);
     mess1(&u->u_obj->ob_pd, gensym("dsp"), insig);
+    dspprofile_leave(owner);
+    if (toplevel)
+        ugen_taskend();
 
     for (sig = outsig, uout = u->u_out, i = u->u_nout; i--; sig++, uout++)
     {
@@ -1038,6 +3427,12 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
             {
                 s1->s_refcount--;
                 s2->s_refcount--;
+                if (toplevel)
+                {
+                    ugen_taskbegin();
+                    ugen_taskuse(s1, 0);
+                    ugen_taskuse(s2, 0);
+                }
                 s3 = signal_newlike(s1);
                 if (s1->s_nchans != s2->s_nchans ||
                     s1->s_length != s2->s_length)
@@ -1057,6 +3452,8 @@ static void ugen_doit(t_dspcontext *dc, t_ugenbox *u)
                     dsp_add_plus(s1->s_vec, s2->s_vec, s3->s_vec,
                         s1->s_length * s1->s_nchans);
                 }
+                if (toplevel)
+                    ugen_taskend();
                 uin->i_signal = s3;
                 s3->s_refcount = 1;
                 if (!s1->s_refcount) signal_makereusable(s1);
@@ -1304,7 +3701,15 @@ void ugen_done_graph(t_dspcontext *dc)
     {
         dsp_add(block_prolog, 1, blk);
         blk->x_chainonset = THIS->u_dspchainsize - 1;
+        ugen_segmentblock(blk);
     }
+        /* we don't split up a reblocked toplevel canvas for DSP threads */
+    if (!parent_context && blk && THIS->u_graph)
+        THIS->u_graph->g_suspend = 1;
+
+    if (parent_context && blk && (reblock || switched) && THIS->u_graph)
+        THIS->u_graph->g_nosplit++;
+
         /* Initialize for sorting */
     for (u = dc->dc_ugenlist; u; u = u->u_next)
     {
@@ -1377,12 +3782,17 @@ void ugen_done_graph(t_dspcontext *dc)
     }
 
     chainafterall = THIS->u_dspchainsize;
+    ugen_addentry(-1);      /* block_epilog() may jump here; don't fuse across */
+    if (parent_context && blk && (reblock || switched) && THIS->u_graph)
+        THIS->u_graph->g_nosplit--;
     if (blk)
     {
         blk->x_blocklength = chainblockend - chainblockbegin;
         blk->x_epiloglength = chainafterall - chainblockend;
         blk->x_reblock = reblock;
     }
+    if (parent_context && blk && (reblock || switched))
+        ugen_subsegment(dc, blk);
 
     if (THIS->u_loud)
     {
@@ -1395,6 +3805,8 @@ void ugen_done_graph(t_dspcontext *dc)
     }
         /* now delete everything. */
  cleanup:
+    if (!parent_context && THIS->u_graph)
+        THIS->u_graph->g_suspend = 0;
     while (dc->dc_ugenlist)
     {
         for (uout = dc->dc_ugenlist->u_out, n = dc->dc_ugenlist->u_nout;
@@ -1444,21 +3856,8 @@ t_int *plus_perform(t_int *w)
 
 t_int *plus_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *in2 = (t_sample *)(w[2]);
-    t_sample *out = (t_sample *)(w[3]);
-    int n = (int)(w[4]);
-    for (; n; n -= 8, in1 += 8, in2 += 8, out += 8)
-    {
-        t_sample f0 = in1[0], f1 = in1[1], f2 = in1[2], f3 = in1[3];
-        t_sample f4 = in1[4], f5 = in1[5], f6 = in1[6], f7 = in1[7];
-
-        t_sample g0 = in2[0], g1 = in2[1], g2 = in2[2], g3 = in2[3];
-        t_sample g4 = in2[4], g5 = in2[5], g6 = in2[6], g7 = in2[7];
-
-        out[0] = f0 + g0; out[1] = f1 + g1; out[2] = f2 + g2; out[3] = f3 + g3;
-        out[4] = f4 + g4; out[5] = f5 + g5; out[6] = f6 + g6; out[7] = f7 + g7;
-    }
+    (*simd_plus)((t_sample *)(w[1]), (t_sample *)(w[2]),
+        (t_sample *)(w[3]), (int)(w[4]));
     return (w+5);
 }
 
@@ -1481,30 +3880,7 @@ t_int *copy_perform(t_int *w)
 
 t_int *copy_perf8(t_int *w)
 {
-    t_sample *in1 = (t_sample *)(w[1]);
-    t_sample *out = (t_sample *)(w[2]);
-    int n = (int)(w[3]);
-
-    for (; n; n -= 8, in1 += 8, out += 8)
-    {
-        t_sample f0 = in1[0];
-        t_sample f1 = in1[1];
-        t_sample f2 = in1[2];
-        t_sample f3 = in1[3];
-        t_sample f4 = in1[4];
-        t_sample f5 = in1[5];
-        t_sample f6 = in1[6];
-        t_sample f7 = in1[7];
-
-        out[0] = f0;
-        out[1] = f1;
-        out[2] = f2;
-        out[3] = f3;
-        out[4] = f4;
-        out[5] = f5;
-        out[6] = f6;
-        out[7] = f7;
-    }
+    (*simd_copy)((t_sample *)(w[1]), (t_sample *)(w[2]), (int)(w[3]));
     return (w+4);
 }
 
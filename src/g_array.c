@@ -9,6 +9,8 @@
 #include "g_undo.h"
 #include <math.h>
 
+void ugen_dsplink(void *key);           /* in d_ugen.c */
+
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -292,6 +294,7 @@ t_garray *graph_array(t_glist *gl, t_symbol *s, t_symbol *templateargsym,
     t_garray *x;
     t_template *template, *ztemplate;
     t_symbol *templatesym;
+    void *key;
     int flags = fflags;
     int filestyle = ((flags & GRAPH_ARRAY_PLOTSTYLE) >> 1);
     int style = (filestyle == 0 ? PLOTSTYLE_POLY :
@@ -348,7 +351,9 @@ t_garray *graph_array(t_glist *gl, t_symbol *s, t_symbol *templateargsym,
         saved file or copy buffer */
     pd_bind(&x->x_gobj.g_pd, asym);
     garray_fittograph(x, n, style);
-    canvas_update_dsp();
+        /* only objects that looked for us by name need to know */
+    key = x->x_realname;
+    canvas_update_dsp_links(1, &key);
     return (x);
 }
 
@@ -391,9 +396,10 @@ void garray_properties(t_garray *x)
 
 static void garray_deleteit(t_garray *x) {
     int wasused = x->x_usedindsp;
+    void *key = x;
     glist_delete(x->x_glist, &x->x_gobj);
     if (wasused)
-        canvas_update_dsp();
+        canvas_update_dsp_links(1, &key);
 }
 
     /* this is called back from the dialog window to create a garray.
@@ -460,6 +466,7 @@ void garray_arraydialog(t_garray *x, t_symbol *name, t_floatarg fsize,
     t_float stylewas = template_getfloat(
         template_findbyname(x->x_scalar->sc_template),
             gensym("style"), x->x_scalar->sc_vec, 1);
+    void *keys[3];
 
     name = garray_unescapit(name);
     if(!*name->s_name) {
@@ -502,9 +509,11 @@ void garray_arraydialog(t_garray *x, t_symbol *name, t_floatarg fsize,
               garray_arrayviewlist_close(x);
             }
             /* } jsarlo */
+            keys[0] = x;
+            keys[1] = x->x_realname;
             x->x_name = name;
             pd_unbind(&x->x_gobj.g_pd, x->x_realname);
-            x->x_realname = canvas_realizedollar(x->x_glist, name);
+            keys[2] = x->x_realname = canvas_realizedollar(x->x_glist, name);
             pd_bind(&x->x_gobj.g_pd, x->x_realname);
                 /* redraw the whole glist, just so the name change shows up */
             if (x->x_glist->gl_havewindow)
@@ -516,7 +525,7 @@ void garray_arraydialog(t_garray *x, t_symbol *name, t_floatarg fsize,
             }
                 /* see garray_rename() */
             garray_getarray(x)->a_valid = ++glist_valid;
-            canvas_update_dsp();
+            canvas_update_dsp_links(3, keys);
         }
         size = fsize;
         if (size < 1)
@@ -833,6 +842,7 @@ const t_widgetbehavior garray_widgetbehavior =
 void garray_usedindsp(t_garray *x)
 {
     x->x_usedindsp = 1;
+    ugen_dsplink(x);
 }
 
 static void garray_doredraw(t_gobj *client, t_glist *glist)
@@ -1238,13 +1248,16 @@ static void garray_vis_msg(t_garray *x, t_floatarg fvis)
     /* change the name of a garray. */
 static void garray_rename(t_garray *x, t_symbol *s)
 {
-    int wasused = x->x_usedindsp;
+    void *keys[3];
     /* jsarlo { */
     if (x->x_listviewing)
     {
         garray_arrayviewlist_close(x);
     }
     /* } jsarlo */
+    keys[0] = x;
+    keys[1] = x->x_realname;
+    keys[2] = s;
     pd_unbind(&x->x_gobj.g_pd, x->x_realname);
     pd_bind(&x->x_gobj.g_pd, x->x_realname = x->x_name = s);
     glist_redraw(x->x_glist);
@@ -1252,8 +1265,8 @@ static void garray_rename(t_garray *x, t_symbol *s)
         trigger an error message in table DSP objects that are currently
         bound to this array, see dsparray_get_array() in d_array.c */
     garray_getarray(x)->a_valid = ++glist_valid;
-    if (wasused)
-        canvas_update_dsp();
+        /* objects that looked for the new name should find us now */
+    canvas_update_dsp_links(3, keys);
 }
 
 static void garray_read(t_garray *x, t_symbol *filename)
@@ -1336,7 +1349,50 @@ void garray_resize_long(t_garray *x, long n)
             gensym("style"), x->x_scalar->sc_vec, 1));
     array_resize_and_redraw(array, x->x_glist, (int)n);
     if (x->x_usedindsp)
-        canvas_update_dsp();
+    {
+        void *key = x;
+        canvas_update_dsp_links(1, &key);
+    }
+}
+
+    /* replace the contents of a float array with "vec", "n" points long,
+    which must have come from getbytes(n * sizeof(t_word)).  The array
+    takes it over and frees the old vector, so nothing is copied; "soundfiler
+    read -async" uses this to hand over a vector it filled in another
+    thread.  Returns 0 (and leaves "vec" to the caller) if the array isn't
+    a plain float array. */
+int garray_swapfloatwords(t_garray *x, long n, t_word *vec)
+{
+    t_array *array = garray_getarray(x), *a2 = array;
+    int yonset, elemsize, vis = glist_isvisible(x->x_glist);
+    char *oldvec;
+    long oldn;
+    if (!garray_getarray_floatonly(x, &yonset, &elemsize) ||
+        elemsize != sizeof(t_word) || n < 1)
+            return (0);
+    while (a2->a_gp.gp_stub->gs_which == GP_ARRAY)
+        a2 = a2->a_gp.gp_stub->gs_un.gs_array;
+    if (n != array->a_n)
+        garray_fittograph(x, (int)n, template_getfloat(
+            template_findbyname(x->x_scalar->sc_template),
+                gensym("style"), x->x_scalar->sc_vec, 1));
+    if (vis)
+        gobj_vis(&a2->a_gp.gp_un.gp_scalar->sc_gobj, x->x_glist, 0);
+    oldvec = array->a_vec;
+    oldn = array->a_n;
+    array->a_vec = (char *)vec;
+    array->a_n = (int)n;
+    array->a_valid = ++glist_valid;
+    freebytes(oldvec, oldn * elemsize);
+    if (vis)
+        gobj_vis(&a2->a_gp.gp_un.gp_scalar->sc_gobj, x->x_glist, 1);
+        /* DSP objects hold on to the old vector */
+    if (x->x_usedindsp)
+    {
+        void *key = x;
+        canvas_update_dsp_links(1, &key);
+    }
+    return (1);
 }
 
     /* float version to use as Pd method */
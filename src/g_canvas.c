@@ -1075,7 +1075,8 @@ void canvas_deletelinesfor(t_canvas *x, t_text *text)
         if (t.tr_ob == text || t.tr_ob2 == text)
         {
             _canvas_delete_line(x, oc);
-            obj_disconnect(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+            obj_glistdisconnect(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno,
+                x);
         }
     }
 }
@@ -1093,7 +1094,8 @@ void canvas_deletelinesforio(t_canvas *x, t_text *text,
             (t.tr_ob2 == text && t.tr_inlet == inp))
         {
             _canvas_delete_line(x, oc);
-            obj_disconnect(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+            obj_glistdisconnect(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno,
+                x);
         }
     }
 }
@@ -1412,6 +1414,10 @@ EXTERN_STRUCT _dspcontext;
 
 void ugen_start(void);
 void ugen_stop(void);
+void ugen_finish(void);
+void ugen_beginsegment(t_canvas *x);
+int ugen_resort(t_glist *x);
+int ugen_resortlinks(int nkeys, void **keys);
 
 t_dspcontext *ugen_start_graph(int toplevel, t_signal **sp,
     int ninlets, int noutlets);
@@ -1482,7 +1488,11 @@ static void canvas_start_dsp(void)
     ugen_start();
 
     for (x = pd_getcanvaslist(); x; x = x->gl_next)
+    {
+        ugen_beginsegment(x);
         canvas_dodsp(x, 1, 0);
+    }
+    ugen_finish();
 
     canvas_dspstate = THISGUI->i_dspstate = 1;
     if (gensym("pd-dsp-started")->s_thing)
@@ -1528,6 +1538,61 @@ void canvas_update_dsp(void)
     }
 }
 
+    /* try to re-sort only part of the DSP chain.  As in a full update, DSP
+    reads as off while we sort. */
+static int canvas_resort(t_glist *x, int nkeys, void **keys)
+{
+    int ok;
+    if (!x && !nkeys)
+        return (0);
+    canvas_dspstate = THISGUI->i_dspstate = 0;
+    ok = (x ? ugen_resort(x) : ugen_resortlinks(nkeys, keys));
+    canvas_dspstate = THISGUI->i_dspstate = 1;
+    return (ok);
+}
+
+    /* like canvas_update_dsp(), but for changes local to the glist "x", so
+    that we can try to re-sort only the subpatch or toplevel canvas it's in. */
+void canvas_update_dsp_local(t_glist *x)
+{
+    if (THISGUI->i_dspstate && !canvas_resort(x, 0, 0))
+        canvas_update_dsp();
+}
+
+    /* and for changes to things that objects look up by name or hold on to,
+    such as arrays; see ugen_dsplink() */
+void canvas_update_dsp_links(int nkeys, void **keys)
+{
+    if (THISGUI->i_dspstate && !canvas_resort(0, nkeys, keys))
+        canvas_update_dsp();
+}
+
+static t_glist *glist_findowner(t_glist *x, t_gobj *y)
+{
+    t_gobj *g;
+    t_glist *gl;
+    for (g = x->gl_list; g; g = g->g_next)
+    {
+        if (g == y)
+            return (x);
+        if (pd_class(&g->g_pd) == canvas_class &&
+            (gl = glist_findowner((t_glist *)g, y)))
+                return (gl);
+    }
+    return (0);
+}
+
+    /* the name of the canvas the object "y" is in, or 0 if there's none.
+    This searches everything, so it's only for occasional use. */
+t_symbol *canvas_findownername(t_gobj *y)
+{
+    t_canvas *x, *gl;
+    for (x = pd_getcanvaslist(); x; x = x->gl_next)
+        if ((gl = glist_findowner(x, y)))
+            return (gl->gl_name);
+    return (0);
+}
+
 /* the "dsp" message to pd starts and stops DSP computation, and, if
 appropriate, also opens and closes the audio device. On exclusive-access
 APIs such as ALSA, MMIO, and ASIO (I think) it's appropriate to close the
@@ -1921,14 +1986,16 @@ typedef struct _canvasopen
     char **nameresult;
     unsigned int size;
     int bin;
+    int isclass;
     int fd;
 } t_canvasopen;
 
 static int canvas_open_iter(const char *path, t_canvasopen *co)
 {
     int fd;
-    if ((fd = sys_trytoopenit(path, co->name, co->ext,
-        co->dirresult, co->nameresult, co->size, co->bin, 1)) >= 0)
+    if ((fd = (co->isclass ? sys_trytoopenclass : sys_trytoopenit)(path,
+        co->name, co->ext, co->dirresult, co->nameresult, co->size, co->bin,
+            1)) >= 0)
     {
         co->fd = fd;
         return 0;
@@ -1948,8 +2015,9 @@ static int canvas_open_iter(const char *path, t_canvasopen *co)
     attempted, otherwise ASCII (this only matters on Microsoft.)
     If "x" is zero, the file is sought in the directory "." or in the
     global path.*/
-int canvas_open(const t_canvas *x, const char *name, const char *ext,
-    char *dirresult, char **nameresult, unsigned int size, int bin)
+static int canvas_doopen(const t_canvas *x, const char *name,
+    const char *ext, char *dirresult, char **nameresult, unsigned int size,
+    int bin, int isclass)
 {
     int fd = -1;
     t_canvasopen co;
@@ -1965,6 +2033,7 @@ int canvas_open(const t_canvas *x, const char *name, const char *ext,
     co.nameresult = nameresult;
     co.size = size;
     co.bin = bin;
+    co.isclass = isclass;
     co.fd = -1;
 
     canvas_path_iterate(x, (t_canvas_path_iterator)canvas_open_iter, &co);
@@ -1972,6 +2041,18 @@ int canvas_open(const t_canvas *x, const char *name, const char *ext,
     return (co.fd);
 }
 
+int canvas_open(const t_canvas *x, const char *name, const char *ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin)
+{
+    return (canvas_doopen(x, name, ext, dirresult, nameresult, size, bin, 0));
+}
+
+int canvas_open_class(const t_canvas *x, const char *name, const char *ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin)
+{
+    return (canvas_doopen(x, name, ext, dirresult, nameresult, size, bin, 1));
+}
+
 /*
  * Iterate over all search-paths for <x> calling <fun> with the user-supplied
  * <data>.  The function is called with two arguments: a pathname to try to
@@ -526,6 +526,9 @@ EXTERN void canvas_setcurrent(t_canvas *x);
 EXTERN void canvas_unsetcurrent(t_canvas *x);
 EXTERN t_symbol *canvas_realizedollar(t_canvas *x, t_symbol *s);
 EXTERN t_canvas *canvas_getrootfor(t_canvas *x);
+EXTERN void canvas_update_dsp_local(t_glist *x);
+EXTERN void canvas_update_dsp_links(int nkeys, void **keys);
+EXTERN t_symbol *canvas_findownername(t_gobj *y);
 EXTERN void canvas_dirty(t_canvas *x, t_floatarg n);
 typedef int (*t_canvasapply)(t_canvas *x, t_int x1, t_int x2, t_int x3);
 
@@ -571,6 +574,9 @@ EXTERN t_glist *pd_checkglist(t_pd *x);
 typedef int (*t_canvas_path_iterator)(const char *path, void *user_data);
 EXTERN int canvas_path_iterate(const t_canvas *x, t_canvas_path_iterator fun,
     void *user_data);
+    /* canvas_open() for looking up abstractions (see s_path.c) */
+int canvas_open_class(const t_canvas *x, const char *name, const char *ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin);
 
 /* check string for untitled canvas filename prefix */
 #define UNTITLED_STRNCMP(s) strncmp(s, "PDUNTITLED", 10)
@@ -593,6 +599,7 @@ EXTERN void linetraverser_skipobject(t_linetraverser *t);
 /* --------- functions on garrays (graphical arrays) -------------------- */
 
 EXTERN t_template *garray_template(t_garray *x);
+EXTERN int garray_swapfloatwords(t_garray *x, long n, t_word *vec);
 
 /* -------------------- arrays --------------------- */
 #define GRAPH_ARRAY_SAVE 1      /* flags for graph_array() below */
@@ -58,6 +58,7 @@ typedef struct _clone
     unsigned int x_distributein:1;  /* distribute input signals across clones */
     unsigned int x_packout:1;       /* pack output signals */
     unsigned int x_dynamicvoices:1; /* resize according to multichannel signals */
+    unsigned int x_parallel:1;      /* run copies on DSP threads if possible */
 } t_clone;
 
 int clone_match(t_pd *z, t_symbol *name, t_symbol *dir)
@@ -435,6 +436,120 @@ static void clone_loadbang(t_clone *x, t_floatarg f)
 void canvas_dodsp(t_canvas *x, int toplevel, t_signal **sp);
 t_signal *signal_newfromcontext(int borrowed, int nchans);
 void signal_makereusable(t_signal *sig);
+int ugen_forkbranches(void);
+void ugen_branch(void);
+void ugen_joinbranches(int nsig, t_signal **sigs);
+
+    /* schedule one copy, leaving its outputs in tempio[nin] ... */
+static void clone_dspcopy(t_clone *x, t_signal **sp, t_signal **tempio,
+    int j, int nin, int nout)
+{
+    int i;
+        /* load input signals into signal vector to send subpatches */
+    for (i = 0; i < nin; i++)
+    {
+        if (x->x_distributein)
+        {
+                /* distribute multi-channel signal over instances;
+                wrap around if channel count is lower than instance count */
+            int offset = j % sp[i]->s_nchans;
+            tempio[i] = signal_new(0, 1, sp[i]->s_sr, 0);
+            signal_setborrowed(tempio[i], sp[i]);
+            tempio[i]->s_nchans = 1;
+            tempio[i]->s_vec = sp[i]->s_vec + offset * sp[i]->s_length;
+            tempio[i]->s_refcount = 1;
+        }
+        else
+            tempio[i] = sp[i];
+    }
+    for (i = 0; i < nout; i++)
+        tempio[nin + i] = signal_newfromcontext(1, 1);
+    canvas_dodsp(x->x_vec[j].c_gl, 0, tempio);
+    if (x->x_distributein)
+    {
+        for (i = 0; i < nin; i++)
+        {
+            if (!--tempio[i]->s_refcount)
+                signal_makereusable(tempio[i]);
+            else
+                bug("clone 1: %d", tempio[i]->s_refcount);
+        }
+    }
+}
+
+    /* collect the outputs of copy number j into our own output signals */
+static void clone_dspout(t_clone *x, t_signal **sp, t_signal **out,
+    int j, int nin, int nout, int *noutchans)
+{
+    int i;
+    if (x->x_packout)   /* pack individual mono outputs to a multichannel one */
+    {
+        for (i = 0; i < nout; i++)
+        {
+            int nchans = out[i]->s_nchans;
+            int length = out[i]->s_length;
+            t_sample *to, *from = out[i]->s_vec;
+            if (j == 0) /* now we can the create the output signal */
+            {
+                signal_setmultiout(&sp[nin + i], nchans * x->x_n);
+                noutchans[i] = nchans;
+            }
+                /* NB: it is possible for instances to have different
+                output channel counts. In this case we always take the
+                channel count of the first instance. */
+            to = sp[nin + i]->s_vec + j * length * noutchans[i];
+            if (nchans == noutchans[i])
+                dsp_add_copy(from, to, length * nchans);
+            else
+            {
+                if (nchans > noutchans[i]) /* ignore extra channels */
+                    dsp_add_copy(from, to, noutchans[i] * length);
+                else /* fill missing channels with zeros */
+                {
+                    dsp_add_copy(from, to, nchans * length);
+                    dsp_add_zero(to + length * nchans,
+                        length * (noutchans[i] - nchans));
+                }
+            #if 1
+                pd_error(x, "warning: clone instance %d: channel count "
+                    "of outlet %d (%d) does not match first instance (%d)",
+                        j, i, nchans, noutchans[i]);
+            #endif
+            }
+            signal_makereusable(out[i]);
+        }
+    }
+    else    /* otherwise add the individual outputs */
+    {
+        for (i = 0; i < nout; i++)
+        {
+            int nchans = out[i]->s_nchans;
+            int length = out[i]->s_length;
+            if (j == 0)
+            {
+                    /* first instance: create output signal and copy content */
+                signal_setmultiout(&sp[nin + i], nchans);
+                dsp_add_copy(out[i]->s_vec,
+                    sp[nin + i]->s_vec, length * nchans);
+                noutchans[i] = nchans;
+            }
+            else /* add to existing signal */
+            {
+                int nsamples = nchans > noutchans[i] ?
+                    noutchans[i] * length : nchans * length;
+            #if 1
+                if (nchans != noutchans[i])
+                    pd_error(x, "warning: clone instance %d: channel count "
+                        "of outlet %d (%d) does not match first instance (%d)",
+                            j, i, nchans, noutchans[i]);
+            #endif
+                dsp_add_plus(out[i]->s_vec, sp[nin + i]->s_vec,
+                    sp[nin + i]->s_vec, nsamples);
+            }
+            signal_makereusable(out[i]);
+        }
+    }
+}
 
 static void clone_dsp(t_clone *x, t_signal **sp)
 {
@@ -482,138 +597,31 @@ static void clone_dsp(t_clone *x, t_signal **sp)
     tempio = (nin + nout) > 0 ?
         (t_signal **)alloca((nin + nout) * sizeof(*tempio)) : 0;
     noutchans = nout > 0 ? (int *)alloca(nout * sizeof(*noutchans)) : 0;
-        /* load input signals into signal vector to send subpatches */
-    if (x->x_packout)   /* pack individual mono outputs to a multichannel one */
+    if (x->x_parallel && x->x_n > 1 && ugen_forkbranches())
     {
+            /* let the DSP threads run each copy as a separate task.  We
+            hold on to all their outputs and collect them afterward in
+            the same order as below, so the result is the same. */
+        int nsig = x->x_n * nout + nin;
+        t_signal **outs = (t_signal **)getbytes(nsig * sizeof(*outs));
         for (j = 0; j < x->x_n; j++)
         {
-            for (i = 0; i < nin; i++)
-            {
-                if (x->x_distributein)
-                {
-                        /* distribute multi-channel signal over instances;
-                        wrap around if channel count is lower than instance
-                        count */
-                    int offset = j % sp[i]->s_nchans;
-                    tempio[i] = signal_new(0, 1, sp[i]->s_sr, 0);
-                    signal_setborrowed(tempio[i], sp[i]);
-                    tempio[i]->s_nchans = 1;
-                    tempio[i]->s_vec = sp[i]->s_vec + offset * sp[i]->s_length;
-                    tempio[i]->s_refcount = 1;
-                }
-                else
-                    tempio[i] = sp[i];
-            }
+            ugen_branch();
+            clone_dspcopy(x, sp, tempio, j, nin, nout);
             for (i = 0; i < nout; i++)
-                tempio[nin + i] = signal_newfromcontext(1, 1);
-            canvas_dodsp(x->x_vec[j].c_gl, 0, tempio);
-            if (x->x_distributein)
-            {
-                for (i = 0; i < nin; i++)
-                {
-                    if (!--tempio[i]->s_refcount)
-                        signal_makereusable(tempio[i]);
-                    else
-                        bug("clone 1: %d", tempio[i]->s_refcount);
-                }
-            }
-            for (i = 0; i < nout; i++)
-            {
-                int nchans = tempio[nin + i]->s_nchans;
-                int length = tempio[nin + i]->s_length;
-                t_sample *to, *from = tempio[nin + i]->s_vec;
-                if (j == 0) /* now we can the create the output signal */
-                {
-                    signal_setmultiout(&sp[nin + i], nchans * x->x_n);
-                    noutchans[i] = nchans;
-                }
-                    /* NB: it is possible for instances to have different
-                    output channel counts. In this case we always take the
-                    channel count of the first instance. */
-                to = sp[nin + i]->s_vec + j * length * noutchans[i];
-                if (nchans == noutchans[i])
-                    dsp_add_copy(from, to, length * nchans);
-                else
-                {
-                    if (nchans > noutchans[i]) /* ignore extra channels */
-                        dsp_add_copy(from, to, noutchans[i] * length);
-                    else /* fill missing channels with zeros */
-                    {
-                        dsp_add_copy(from, to, nchans * length);
-                        dsp_add_zero(to + length * nchans,
-                            length * (noutchans[i] - nchans));
-                    }
-                #if 1
-                    pd_error(x, "warning: clone instance %d: channel count "
-                        "of outlet %d (%d) does not match first instance (%d)",
-                            j, i, nchans, noutchans[i]);
-                #endif
-                }
-                signal_makereusable(tempio[nin + i]);
-            }
+                outs[j * nout + i] = tempio[nin + i];
         }
+        for (i = 0; i < nin; i++)
+            outs[x->x_n * nout + i] = sp[i];
+        ugen_joinbranches(nsig, outs);
+        for (j = 0; j < x->x_n; j++)
+            clone_dspout(x, sp, outs + j * nout, j, nin, nout, noutchans);
+        freebytes(outs, nsig * sizeof(*outs));
     }
-    else    /* otherwise add the individual outputs */
+    else for (j = 0; j < x->x_n; j++)
     {
-        for (j = 0; j < x->x_n; j++)
-        {
-            for (i = 0; i < nin; i++)
-            {
-                if (x->x_distributein)
-                {
-                        /* distribute multi-channel signal over instances;
-                        wrap around if channel count is lower than instance count */
-                    int offset = j % sp[i]->s_nchans;
-                    tempio[i] = signal_new(0, 1, sp[i]->s_sr, 0);
-                    signal_setborrowed(tempio[i], sp[i]);
-                    tempio[i]->s_nchans = 1;
-                    tempio[i]->s_vec = sp[i]->s_vec + offset * sp[i]->s_length;
-                    tempio[i]->s_refcount = 1;
-                }
-                else
-                    tempio[i] = sp[i];
-            }
-            for (i = 0; i < nout; i++)
-                tempio[nin + i] = signal_newfromcontext(1, 1);
-            canvas_dodsp(x->x_vec[j].c_gl, 0, tempio);
-            if (x->x_distributein)
-            {
-                for (i = 0; i < nin; i++)
-                {
-                    if (!--tempio[i]->s_refcount)
-                        signal_makereusable(tempio[i]);
-                    else
-                        bug("clone 2: %d", tempio[i]->s_refcount);
-                }
-            }
-            for (i = 0; i < nout; i++)
-            {
-                int nchans = tempio[nin + i]->s_nchans;
-                int length = tempio[nin + i]->s_length;
-                if (j == 0)
-                {
-                        /* first instance: create output signal and copy content */
-                    signal_setmultiout(&sp[nin + i], nchans);
-                    dsp_add_copy(tempio[nin + i]->s_vec,
-                        sp[nin + i]->s_vec, length * nchans);
-                    noutchans[i] = nchans;
-                }
-                else /* add to existing signal */
-                {
-                    int nsamples = nchans > noutchans[i] ?
-                        noutchans[i] * length : nchans * length;
-                #if 1
-                    if (nchans != noutchans[i])
-                        pd_error(x, "warning: clone instance %d: channel count "
-                            "of outlet %d (%d) does not match first instance (%d)",
-                                j, i, nchans, noutchans[i]);
-                #endif
-                    dsp_add_plus(tempio[nin + i]->s_vec, sp[nin + i]->s_vec,
-                        sp[nin + i]->s_vec, nsamples);
-                }
-                signal_makereusable(tempio[nin + i]);
-            }
-        }
+        clone_dspcopy(x, sp, tempio, j, nin, nout);
+        clone_dspout(x, sp, tempio + nin, j, nin, nout, noutchans);
     }
     for (i = 0; i < nin; i++)
     {
@@ -636,6 +644,7 @@ static void *clone_new(t_symbol *s, int argc, t_atom *argv)
     x->x_distributein = 0;
     x->x_packout = 0;
     x->x_dynamicvoices = 0;
+    x->x_parallel = 0;
     clone_voicetovis = -1;
     if (argc == 0)
     {
@@ -661,6 +670,8 @@ static void *clone_new(t_symbol *s, int argc, t_atom *argv)
             x->x_distributein = 1, argc--, argv++;
         else if (!strcmp(argv[0].a_w.w_symbol->s_name, "-do"))
             x->x_packout = 1, argc--, argv++;
+        else if (!strcmp(argv[0].a_w.w_symbol->s_name, "-parallel"))
+            x->x_parallel = 1, argc--, argv++;
         else goto usage;
     }
     if (argc >= 2 && (wantn = atom_getfloatarg(0, argc, argv)) >= 0
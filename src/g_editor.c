@@ -469,7 +469,8 @@ void canvas_disconnect(t_canvas *x,
                 sprintf(tag, "l%p", oc);
                 pdgui_vmess("pdtk_canvas_delete", "cs", x, tag);
             }
-            obj_disconnect(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno);
+            obj_glistdisconnect(t.tr_ob, t.tr_outno, t.tr_ob2, t.tr_inno,
+                x);
             break;
         }
     }
@@ -2765,7 +2766,7 @@ static int tryconnect(t_canvas*x, t_object *src, int nout,
 {
     if(canconnect(x, src, nout, sink, nin))
     {
-        t_outconnect *oc = obj_connect(src, nout, sink, nin);
+        t_outconnect *oc = obj_glistconnect(src, nout, sink, nin, x);
         if(oc)
         {
             int iow = IOWIDTH * x->gl_zoom;
@@ -4683,7 +4684,8 @@ void canvas_connect(t_canvas *x, t_floatarg fwhoout, t_floatarg foutno,
         while (inno >= obj_ninlets(objsink))
             inlet_new(objsink, &objsink->ob_pd, 0, 0);
 
-    if (!(oc = obj_connect(objsrc, outno, objsink, inno))) goto bad;
+    if (!(oc = obj_glistconnect(objsrc, outno, objsink, inno, x)))
+        goto bad;
     if (glist_isvisible(x) && x->gl_havewindow)
     {
         char tag[128];
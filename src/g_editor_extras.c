@@ -61,10 +61,10 @@ static void dereconnect(t_glist*cnv, t_object*org, t_object*replace)
                 if(dest!=org)
                     continue;
                 dest_i = canvas_getindex(cnv, o2g(dest));
-                obj_disconnect(obj, nout, dest, which);
+                obj_glistdisconnect(obj, nout, dest, which, cnv);
                 canvas_undo_add(cnv, UNDO_DISCONNECT, "disconnect",
                     canvas_undo_set_disconnect(cnv, obj_i, nout, dest_i, which));
-                obj_connect(obj, nout, replace, which);
+                obj_glistconnect(obj, nout, replace, which, cnv);
                 canvas_undo_add(cnv, UNDO_CONNECT, "connect",
                     canvas_undo_set_connect(cnv, obj_i, nout, replace_i, which));
             }
@@ -106,10 +106,10 @@ static void stack_conn(t_glist*x, t_object*new, int*newoutlet, t_object*org,
     new_i = canvas_getindex(x, o2g(new));
     org_i = canvas_getindex(x, o2g(org));
     dest_i = canvas_getindex(x, o2g(dest));
-    obj_disconnect(org, orgoutlet, dest, which);
+    obj_glistdisconnect(org, orgoutlet, dest, which, x);
     canvas_undo_add(x, UNDO_DISCONNECT, "disconnect",
         canvas_undo_set_disconnect(x, org_i, orgoutlet, dest_i, which));
-    obj_connect(new, *newoutlet, dest, which);
+    obj_glistconnect(new, *newoutlet, dest, which, x);
     canvas_undo_add(x, UNDO_CONNECT, "connect",
         canvas_undo_set_connect(x, new_i, *newoutlet, dest_i, which));
     (*newoutlet)++;
@@ -223,10 +223,10 @@ static void triggerize_defanout(t_glist*x, int count, t_outconnect*conn,
     triggerize_defanout(x, count-1, conn, obj, trigger, nout);
 
     dest_i = canvas_getindex(x, o2g(dest));
-    obj_disconnect(obj, nout, dest, which);
+    obj_glistdisconnect(obj, nout, dest, which, x);
     canvas_undo_add(x, UNDO_DISCONNECT, "disconnect",
         canvas_undo_set_disconnect(x, obj_i, nout, dest_i, which));
-    obj_connect(trigger, count, dest, which);
+    obj_glistconnect(trigger, count, dest, which, x);
     canvas_undo_add(x, UNDO_CONNECT, "connect",
         canvas_undo_set_connect(x, trigger_i, count, dest_i, which));
 }
@@ -306,7 +306,7 @@ static int triggerize_fanout(t_glist*x, t_object*obj)
             stub_i = canvas_getindex(x, o2g(stub));
             conn=obj_starttraverseoutlet(obj, &out, nout);
             triggerize_defanout(x, count-1, conn, obj, stub, nout);
-            obj_connect(obj, nout, stub, 0);
+            obj_glistconnect(obj, nout, stub, 0, x);
             canvas_undo_add(x, UNDO_CONNECT, "connect",
                 canvas_undo_set_connect(x, obj_i, nout, stub_i, 0));
             glist_select(x, o2g(stub));
@@ -426,15 +426,15 @@ static int triggerize_line(t_glist*x, t_triggerize_return*tr)
     new_obj = canvas_getindex(x, &stub->ob_g);
     binbuf_free(b);b=0;
 
-    obj_disconnect(g2o(src), src_out, g2o(dst), dst_in);
+    obj_glistdisconnect(g2o(src), src_out, g2o(dst), dst_in, x);
     canvas_undo_add(x, UNDO_DISCONNECT, "disconnect",
         canvas_undo_set_disconnect(x, src_obj, src_out, dst_obj, dst_in));
 
-    obj_connect(g2o(src), src_out, stub, 0);
+    obj_glistconnect(g2o(src), src_out, stub, 0, x);
     canvas_undo_add(x, UNDO_CONNECT, "connect",
         canvas_undo_set_connect(x, src_obj, src_out, new_obj, 0));
 
-    obj_connect(stub, 0, g2o(dst), dst_in);
+    obj_glistconnect(stub, 0, g2o(dst), dst_in, x);
     canvas_undo_add(x, UNDO_CONNECT, "connect",
         canvas_undo_set_connect(x, new_obj, 0, dst_obj, dst_in));
 
@@ -506,10 +506,10 @@ static int minimize_trigger(t_glist*cnv, t_object*obj)
             t_inlet *in =0;
             conn=obj_nexttraverseoutlet(conn, &dest, &in, &which);
             dest_i = canvas_getindex(cnv, o2g(dest));
-            obj_disconnect(obj, nout, dest, which);
+            obj_glistdisconnect(obj, nout, dest, which, cnv);
             canvas_undo_add(cnv, UNDO_DISCONNECT, "disconnect",
                 canvas_undo_set_disconnect(cnv, obj_i, nout, dest_i, which));
-            obj_connect(stub, count, dest, which);
+            obj_glistconnect(stub, count, dest, which, cnv);
             canvas_undo_add(cnv, UNDO_CONNECT, "connect",
                 canvas_undo_set_connect(cnv, stub_i, count, dest_i, which));
         }
@@ -552,10 +552,10 @@ static int expand_trigger(t_glist*cnv, t_object*obj)
             int dest_i;
             conn=obj_nexttraverseoutlet(conn, &dest, &in, &which);
             dest_i = canvas_getindex(cnv, o2g(dest));
-            obj_disconnect(obj, nout, dest, which);
+            obj_glistdisconnect(obj, nout, dest, which, cnv);
             canvas_undo_add(cnv, UNDO_DISCONNECT, "disconnect",
                 canvas_undo_set_disconnect(cnv, obj_i, nout, dest_i, which));
-            obj_connect(stub, nout+1, dest, which);
+            obj_glistconnect(stub, nout+1, dest, which, cnv);
             canvas_undo_add(cnv, UNDO_CONNECT, "connect",
                 canvas_undo_set_connect(cnv, stub_i, nout+1, dest_i, which));
         }
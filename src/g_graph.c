@@ -8,7 +8,7 @@ to this file... */
 
 #include <stdlib.h>
 #include "m_pd.h"
-
+#include "m_imp.h"
 #include "g_canvas.h"
 #include <stdio.h>
 
@@ -137,6 +137,10 @@ void glist_delete(t_glist *x, t_gobj *y)
         performance hit.  Thanks to Ben and Iohannes for spotting this. */
     if (glist_getcanvas(x)->gl_editor && (ob = pd_checkobject(&y->g_pd)))
         rtext = glist_getrtext(x, ob, 1);
+        /* let the message profiler label the object while we know where
+        it is */
+    if ((ob = pd_checkobject(&y->g_pd)))
+        msgprofile_objfree(ob, x->gl_name);
     if (x->gl_list == y) x->gl_list = y->g_next;
     else for (g = x->gl_list; g; g = g->g_next)
         if (g->g_next == y)
@@ -156,7 +160,7 @@ void glist_delete(t_glist *x, t_gobj *y)
     pd_free(&y->g_pd);
     if (rtext)
         rtext_free(rtext);
-    if (chkdsp) canvas_update_dsp();
+    if (chkdsp) canvas_update_dsp_local(x);
     if (drawcommand)
         canvas_redrawdataforthis(x, 1);
     canvas_setdeleting(canvas, wasdeleting);
@@ -9,6 +9,7 @@
 #include "g_canvas.h"
 #include <stdio.h>
 #include <errno.h>
+#include <sys/stat.h>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -17,6 +18,8 @@
 #endif
 #include <string.h>
 #include <stdarg.h>
+#include <float.h>
+#include <time.h>
 
 #include "m_private_utils.h"
 
@@ -29,10 +32,14 @@ static const char *str_dollar(const char *s)
     return s;
 }
 
+typedef struct _dollsymcache t_dollsymcache;
+
 struct _binbuf
 {
     int b_n;
     t_atom *b_vec;
+    int b_ndollsym;                 /* size of b_dollsym */
+    t_dollsymcache *b_dollsym;      /* see binbuf_evaldollsym() */
 };
 
 t_binbuf *binbuf_new(void)
@@ -43,8 +50,11 @@ t_binbuf *binbuf_new(void)
     return (x);
 }
 
+static void binbuf_freedollsym(t_binbuf *x);
+
 void binbuf_free(t_binbuf *x)
 {
+    binbuf_freedollsym(x);
     t_freebytes(x->b_vec, x->b_n * sizeof(*x->b_vec));
     t_freebytes(x,  sizeof(*x));
 }
@@ -64,130 +74,204 @@ void binbuf_clear(t_binbuf *x)
     x->b_n = 0;
 }
 
-    /* convert text to a binbuf */
-void binbuf_text(t_binbuf *x, const char *text, size_t size)
+    /* character classes for binbuf_text().  An atom is a run of characters
+    that are neither white space nor BB_BREAK.  If it has no BB_SLOW ones in
+    it either we can take it straight out of the text, without running it
+    through the escape and dollar sign logic or copying it first. */
+#define BB_WHITE 1      /* space, tab, newline, return */
+#define BB_BREAK 2      /* comma, semicolon */
+#define BB_SLOW 4       /* backslash, dollar sign, null */
+#define BB_ENDATOM (BB_WHITE | BB_BREAK | BB_SLOW)
+
+    /* classes for recognizing floats */
+#define BB_FOTHER 0
+#define BB_FDIGIT 1
+#define BB_FDOT 2
+#define BB_FMINUS 3
+#define BB_FPLUS 4
+#define BB_FEXPON 5
+
+static unsigned char bb_class[256], bb_floatclass[256];
+
+    /* the state machine that decides whether an atom is a float.  States
+    are: 0 beginning, 1 got minus, 2 got digits, 3 got '.' without digits,
+    4 got '.' after digits, 5 got digits after '.', 6 got 'e', 7 got plus or
+    minus after 'e', 8 got digits after that; -1 means it's not a float. */
+static const signed char bb_floatstate[9][6] =
+{
+    /* other digit '.' '-' '+' 'e' */
+    {   -1,   2,    3,  1, -1, -1},
+    {   -1,   2,    3, -1, -1, -1},
+    {   -1,   2,    4, -1, -1,  6},
+    {   -1,   5,   -1, -1, -1, -1},
+    {   -1,   5,   -1, -1, -1,  6},
+    {   -1,   5,   -1, -1, -1,  6},
+    {   -1,   8,   -1,  7,  7, -1},
+    {   -1,   8,   -1, -1, -1, -1},
+    {   -1,   8,   -1, -1, -1, -1},
+};
+
+#define BB_ISFLOAT(state) \
+    ((state) == 2 || (state) == 4 || (state) == 5 || (state) == 8)
+
+static void binbuf_initclasses(void)
+{
+    int i;
+    if (bb_class[0])
+        return;
+    bb_class[(unsigned char)' '] = bb_class[(unsigned char)'\t'] =
+        bb_class[(unsigned char)'\n'] = bb_class[(unsigned char)'\r'] =
+            BB_WHITE;
+    bb_class[(unsigned char)','] = bb_class[(unsigned char)';'] = BB_BREAK;
+    bb_class[(unsigned char)'\\'] = bb_class[(unsigned char)'$'] = BB_SLOW;
+    for (i = '0'; i <= '9'; i++)
+        bb_floatclass[i] = BB_FDIGIT;
+    bb_floatclass[(unsigned char)'.'] = BB_FDOT;
+    bb_floatclass[(unsigned char)'-'] = BB_FMINUS;
+    bb_floatclass[(unsigned char)'+'] = BB_FPLUS;
+    bb_floatclass[(unsigned char)'e'] = bb_floatclass[(unsigned char)'E'] =
+        BB_FEXPON;
+        /* last, since it's what says we're initialized */
+    bb_class[0] = BB_SLOW;
+}
+
+    /* convert a float atom the fast path found to a number.  If it has at
+    most 15 significant digits and 22 after the point, and no exponent, the
+    digits and the power of ten are both exact doubles, and one division
+    then rounds correctly, just as atof() does.  (Not so where intermediate
+    results are kept in more precision than double, so we don't try there.)
+    Anything else goes through atof(), via "buf" to get a null on the end. */
+static double binbuf_atof(const char *s, const char *e, char *buf)
+{
+#if FLT_EVAL_METHOD == 0
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    uint64_t mantissa = 0;
+    int ndigits = 0, nfrac = 0, afterdot = 0;
+    const char *p = s + (*s == '-');
+    for (; p != e; p++)
+    {
+        if (*p == '.')
+            afterdot = 1;
+        else if (*p >= '0' && *p <= '9')
+        {
+            if (mantissa || *p != '0')
+                ndigits++;
+            mantissa = mantissa * 10 + (*p - '0');
+            nfrac += afterdot;
+        }
+        else break;     /* exponent */
+    }
+    if (p == e && ndigits <= 15 && nfrac <= 22)
+    {
+        double f = (double)mantissa / pow10[nfrac];
+        return (*s == '-' ? -f : f);
+    }
+#endif
+    memcpy(buf, s, e - s);
+    buf[e - s] = 0;
+    return (atof(buf));
+}
+
+    /* parse text into atoms.  If "fast" is zero every atom is copied, one
+    character at a time, through the escape and dollar sign logic; otherwise
+    only the ones that need it are.  Both ways give the same atoms; "pd
+    parse-bench" below compares them. */
+static void binbuf_dotext(t_binbuf *x, const char *text, size_t size,
+    int fast)
 {
     char buf[MAXPDSTRING+1], *bufp, *ebuf = buf+MAXPDSTRING;
     const char *textp = text, *etext = text+size;
     t_atom *ap;
     int nalloc = 16, natom = 0;
     binbuf_clear(x);
+    binbuf_initclasses();
     if (!binbuf_resize(x, nalloc)) return;
     ap = x->b_vec;
     while (1)
     {
-        int type;
             /* skip leading space */
-        while ((textp != etext) && (*textp == ' ' || *textp == '\n'
-            || *textp == '\r' || *textp == '\t')) textp++;
+        while ((textp != etext) &&
+            bb_class[(unsigned char)*textp] == BB_WHITE)
+                textp++;
         if (textp == etext) break;
         if (*textp == ';') SETSEMI(ap), textp++;
         else if (*textp == ',') SETCOMMA(ap), textp++;
         else
         {
                 /* it's an atom other than a comma or semi */
-            char c;
-            int floatstate = 0, slash = 0, lastslash = 0, dollar = 0;
-            bufp = buf;
-            do
+            const char *atomend = textp;
+            int floatstate = 0;
+            if (fast)
+                while (atomend != etext &&
+                    !(bb_class[(unsigned char)*atomend] & BB_ENDATOM))
+                        atomend++;
+            if (fast && (atomend == etext ||
+                !(bb_class[(unsigned char)*atomend] & BB_SLOW)) &&
+                    atomend - textp < MAXPDSTRING)
             {
-                c = *bufp = *textp++;
-                lastslash = slash;
-                slash = (c == '\\');
-
-                if (floatstate >= 0)
+                    /* nothing to unescape: it's a float or a symbol that
+                    we can make directly from the text */
+                const char *s;
+                for (s = textp; s != atomend && floatstate >= 0; s++)
+                    floatstate = bb_floatstate[floatstate]
+                        [bb_floatclass[(unsigned char)*s]];
+                if (BB_ISFLOAT(floatstate))
+                    SETFLOAT(ap, binbuf_atof(textp, atomend, buf));
+                else SETSYMBOL(ap, gensymn(textp, atomend - textp));
+                textp = atomend;
+            }
+            else
+            {
+                char c;
+                int slash = 0, lastslash = 0, dollar = 0;
+                bufp = buf;
+                do
                 {
-                    int digit = (c >= '0' && c <= '9'),
-                        dot = (c == '.'), minus = (c == '-'),
-                        plusminus = (minus || (c == '+')),
-                        expon = (c == 'e' || c == 'E');
-                    if (floatstate == 0)    /* beginning */
-                    {
-                        if (minus) floatstate = 1;
-                        else if (digit) floatstate = 2;
-                        else if (dot) floatstate = 3;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 1)   /* got minus */
-                    {
-                        if (digit) floatstate = 2;
-                        else if (dot) floatstate = 3;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 2)   /* got digits */
-                    {
-                        if (dot) floatstate = 4;
-                        else if (expon) floatstate = 6;
-                        else if (!digit) floatstate = -1;
-                    }
-                    else if (floatstate == 3)   /* got '.' without digits */
+                    c = *bufp = *textp++;
+                    lastslash = slash;
+                    slash = (c == '\\');
+                    if (floatstate >= 0)
+                        floatstate = bb_floatstate[floatstate]
+                            [bb_floatclass[(unsigned char)c]];
+                    if (!lastslash && c == '$' && (textp != etext &&
+                        textp[0] >= '0' && textp[0] <= '9'))
+                            dollar = 1;
+                    if (!slash) bufp++;
+                    else if (lastslash)
                     {
-                        if (digit) floatstate = 5;
-                        else floatstate = -1;
+                        bufp++;
+                        slash = 0;
                     }
-                    else if (floatstate == 4)   /* got '.' after digits */
-                    {
-                        if (digit) floatstate = 5;
-                        else if (expon) floatstate = 6;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 5)   /* got digits after . */
-                    {
-                        if (expon) floatstate = 6;
-                        else if (!digit) floatstate = -1;
-                    }
-                    else if (floatstate == 6)   /* got 'e' */
-                    {
-                        if (plusminus) floatstate = 7;
-                        else if (digit) floatstate = 8;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 7)   /* got plus or minus */
-                    {
-                        if (digit) floatstate = 8;
-                        else floatstate = -1;
-                    }
-                    else if (floatstate == 8)   /* got digits */
-                    {
-                        if (!digit) floatstate = -1;
-                    }
-                }
-                if (!lastslash && c == '$' && (textp != etext &&
-                    textp[0] >= '0' && textp[0] <= '9'))
-                        dollar = 1;
-                if (!slash) bufp++;
-                else if (lastslash)
-                {
-                    bufp++;
-                    slash = 0;
                 }
-            }
-            while (textp != etext && bufp != ebuf &&
-                (slash || (*textp != ' ' && *textp != '\n' && *textp != '\r'
-                    && *textp != '\t' &&*textp != ',' && *textp != ';')));
-            *bufp = 0;
+                while (textp != etext && bufp != ebuf &&
+                    (slash || !(bb_class[(unsigned char)*textp] &
+                        (BB_WHITE | BB_BREAK))));
+                *bufp = 0;
 #if 0
-            post("binbuf_text: buf %s", buf);
+                post("binbuf_text: buf %s", buf);
 #endif
-            if (floatstate == 2 || floatstate == 4 || floatstate == 5 ||
-                floatstate == 8)
-                    SETFLOAT(ap, atof(buf));
-                /* LATER try to figure out how to mix "$" and "\$" correctly;
-                here, the backslashes were already stripped so we assume all
-                "$" chars are real dollars.  In fact, we only know at least one
-                was. */
-            else if (dollar)
-            {
-                if (buf[0] != '$')
-                    dollar = 0;
-                for (bufp = buf+1; *bufp; bufp++)
-                    if (*bufp < '0' || *bufp > '9')
+                if (BB_ISFLOAT(floatstate))
+                        SETFLOAT(ap, atof(buf));
+                    /* LATER try to figure out how to mix "$" and "\$"
+                    correctly; here, the backslashes were already stripped so
+                    we assume all "$" chars are real dollars.  In fact, we
+                    only know at least one was. */
+                else if (dollar)
+                {
+                    if (buf[0] != '$')
                         dollar = 0;
-                if (dollar)
-                    SETDOLLAR(ap, atoi(buf+1));
-                else SETDOLLSYM(ap, gensym(buf));
+                    for (bufp = buf+1; *bufp; bufp++)
+                        if (*bufp < '0' || *bufp > '9')
+                            dollar = 0;
+                    if (dollar)
+                        SETDOLLAR(ap, atoi(buf+1));
+                    else SETDOLLSYM(ap, gensym(buf));
+                }
+                else SETSYMBOL(ap, gensym(buf));
             }
-            else SETSYMBOL(ap, gensym(buf));
         }
         ap++;
         natom++;
@@ -203,6 +287,112 @@ void binbuf_text(t_binbuf *x, const char *text, size_t size)
     binbuf_resize(x, natom);
 }
 
+    /* convert text to a binbuf */
+void binbuf_text(t_binbuf *x, const char *text, size_t size)
+{
+    binbuf_dotext(x, text, size, 1);
+}
+
+static int binbuf_sameatoms(const t_binbuf *x, const t_binbuf *y)
+{
+    int i;
+    if (x->b_n != y->b_n)
+        return (0);
+    for (i = 0; i < x->b_n; i++)
+    {
+        const t_atom *a = x->b_vec + i, *b = y->b_vec + i;
+        if (a->a_type != b->a_type)
+            return (0);
+        if (a->a_type == A_DOLLAR && a->a_w.w_index != b->a_w.w_index)
+            return (0);
+        else if (a->a_type == A_FLOAT)
+        {
+            if (memcmp(&a->a_w.w_float, &b->a_w.w_float,
+                sizeof(a->a_w.w_float)))
+                    return (0);
+        }
+        else if ((a->a_type == A_SYMBOL || a->a_type == A_DOLLSYM) &&
+            a->a_w.w_symbol != b->a_w.w_symbol)
+                return (0);
+    }
+    return (1);
+}
+
+    /* "pd parse-bench [count] file ...": parse each file "count" times
+    both with and without binbuf_text()'s fast path and report the speeds,
+    checking that both come out with the same atoms. */
+void glob_parsebench(void *dummy, t_symbol *s, int argc, t_atom *argv)
+{
+    t_binbuf *b[2];
+    int n = 10, nfiles = 0, natoms = 0, nbad = 0, i, j, k;
+    double elapsed[2] = {0, 0}, nbytes = 0;
+    if (argc && argv->a_type == A_FLOAT)
+    {
+        if ((n = atom_getfloat(argv)) < 1)
+            n = 1;
+        argc--, argv++;
+    }
+    b[0] = binbuf_new();
+    b[1] = binbuf_new();
+    for (i = 0; i < argc; i++)
+    {
+        const char *filename = atom_getsymbol(argv + i)->s_name;
+        FILE *fd = sys_fopen(filename, "rb");
+        long length;
+        char *buf;
+        if (!fd)
+        {
+            pd_error(0, "parse-bench: %s: %s", filename, strerror(errno));
+            continue;
+        }
+        if (fseek(fd, 0, SEEK_END) < 0 || (length = ftell(fd)) < 0 ||
+            fseek(fd, 0, SEEK_SET) < 0 || !(buf = getbytes(length + 1)))
+        {
+            pd_error(0, "parse-bench: %s: can't read", filename);
+            sys_fclose(fd);
+            continue;
+        }
+        if ((long)fread(buf, 1, length, fd) != length)
+        {
+            pd_error(0, "parse-bench: %s: can't read", filename);
+            freebytes(buf, length + 1);
+            sys_fclose(fd);
+            continue;
+        }
+        sys_fclose(fd);
+        for (j = 0; j < 2; j++)
+        {
+            double starttime = sys_getrealtime();
+            for (k = 0; k < n; k++)
+                binbuf_dotext(b[j], buf, length, !j);
+            elapsed[j] += sys_getrealtime() - starttime;
+        }
+        if (!binbuf_sameatoms(b[0], b[1]))
+        {
+            pd_error(0, "parse-bench: %s: fast and slow parsers disagree",
+                filename);
+            nbad++;
+        }
+        natoms += b[0]->b_n;
+        nbytes += length;
+        nfiles++;
+        freebytes(buf, length + 1);
+    }
+    binbuf_free(b[0]);
+    binbuf_free(b[1]);
+    if (!nfiles)
+    {
+        pd_error(0, "parse-bench: no files to parse");
+        return;
+    }
+    post("parse-bench: %d files, %.0f bytes, %d atoms, %d times each",
+        nfiles, nbytes, natoms, n);
+    post("... fast %.2f MB/sec, slow %.2f MB/sec, %s",
+        (elapsed[0] > 0 ? nbytes * n / (elapsed[0] * 1e6) : 0),
+        (elapsed[1] > 0 ? nbytes * n / (elapsed[1] * 1e6) : 0),
+        (nbad ? "MISMATCH" : "identical"));
+}
+
     /* convert a binbuf to text; no null termination. */
 void binbuf_gettext(const t_binbuf *x, char **bufp, int *lengthp)
 {
@@ -582,6 +772,153 @@ done:
     return (gensym(buf2));
 }
 
+/* Message boxes and the like evaluate the same binbuf over and over, and
+realizing a dollar symbol such as "$0-foo" or "$1-$2" means formatting a
+string and looking it up with gensym() every time.  So each binbuf keeps,
+for each dollar symbol it has evaluated, the numbers of the arguments the
+symbol depends on (parsed once) and the last few symbols it was realized
+as, keyed by the values of those arguments.  The result only depends on
+those values, $0 and "tonew", so a hit gives exactly what
+binbuf_realizedollsym() would.  Since the atoms can be changed behind our
+back through binbuf_getvec(), each entry also remembers the atom it was
+made for and the template symbol, and is redone if those don't match. */
+
+#define DOLLSYMMAXARGS 4    /* don't cache symbols with more '$'s */
+#define DOLLSYMNCACHE 4     /* realized symbols to keep for each */
+
+typedef struct _dollsymkey
+{
+    t_symbol *k_result;     /* zero if unused */
+    int k_tonew;
+    t_atom k_args[DOLLSYMMAXARGS];
+} t_dollsymkey;
+
+struct _dollsymcache
+{
+    int dc_index;           /* onset of the atom in b_vec */
+    t_symbol *dc_template;  /* the A_DOLLSYM it was made for */
+    int dc_nargs;           /* number of '$'s, or -1 if too many to cache */
+    int dc_argno[DOLLSYMMAXARGS];
+    int dc_next;            /* next key to replace */
+    t_dollsymkey dc_keys[DOLLSYMNCACHE];
+};
+
+static void binbuf_freedollsym(t_binbuf *x)
+{
+    if (x->b_dollsym)
+        t_freebytes(x->b_dollsym, x->b_ndollsym * sizeof(*x->b_dollsym));
+    x->b_dollsym = 0;
+    x->b_ndollsym = 0;
+}
+
+    /* find out which arguments a dollar symbol refers to, stepping through
+    it just as binbuf_realizedollsym() does. */
+static void dollsymcache_init(t_dollsymcache *dc, int index, t_symbol *s)
+{
+    const char *str = s->s_name, *substr;
+    char *cs;
+    int i;
+    dc->dc_index = index;
+    dc->dc_template = s;
+    dc->dc_nargs = 0;
+    dc->dc_next = 0;
+    for (i = 0; i < DOLLSYMNCACHE; i++)
+        dc->dc_keys[i].k_result = 0;
+    if (!(substr = strchr(str, '$')) || substr - str >= MAXPDSTRING)
+        return;
+    while (substr)
+    {
+        int argno = (int)strtol(substr + 1, &cs, 10);
+        if (cs != substr + 1)
+        {
+            if (dc->dc_nargs == DOLLSYMMAXARGS)
+            {
+                dc->dc_nargs = -1;
+                return;
+            }
+            dc->dc_argno[dc->dc_nargs++] = argno;
+        }
+        substr = strchr(cs, '$');
+    }
+}
+
+    /* the value an argument has for this evaluation, or A_NULL if it's
+    out of range */
+static void dollsymcache_getarg(int argno, t_atom *dollar0, int ac,
+    const t_atom *av, t_atom *value)
+{
+    if (argno < 0 || argno > ac)
+    {
+        value->a_type = A_NULL;
+        value->a_w.w_index = 0;
+    }
+    else *value = (argno ? av[argno-1] : *dollar0);
+}
+
+static int dollsymcache_sameatom(const t_atom *a, const t_atom *b)
+{
+    if (a->a_type != b->a_type)
+        return (0);
+    switch (a->a_type)
+    {
+        /* compare floats bitwise since 0 and -0 print differently */
+    case A_FLOAT: return (!memcmp(&a->a_w.w_float, &b->a_w.w_float,
+        sizeof(t_float)));
+    case A_SYMBOL: return (a->a_w.w_symbol == b->a_w.w_symbol);
+    case A_POINTER: return (a->a_w.w_gpointer == b->a_w.w_gpointer);
+    default: return (a->a_w.w_index == b->a_w.w_index);
+    }
+}
+
+    /* realize the A_DOLLSYM at "at", the "*dsi"th one in this evaluation */
+static t_symbol *binbuf_evaldollsym(const t_binbuf *cx, const t_atom *at,
+    int *dsi, int ac, const t_atom *av, int tonew)
+{
+    t_binbuf *x = (t_binbuf *)cx;   /* the cache isn't part of the value */
+    t_dollsymcache *dc;
+    t_dollsymkey *key;
+    t_atom dollar0, args[DOLLSYMMAXARGS];
+    int i, j, index = (int)(at - x->b_vec), n = (*dsi)++;
+    t_symbol *s = at->a_w.w_symbol, *result;
+    if (n >= x->b_ndollsym)
+    {
+        x->b_dollsym = (t_dollsymcache *)t_resizebytes(x->b_dollsym,
+            x->b_ndollsym * sizeof(*x->b_dollsym),
+                (n + 1) * sizeof(*x->b_dollsym));
+        for (i = x->b_ndollsym; i <= n; i++)
+            x->b_dollsym[i].dc_template = 0;
+        x->b_ndollsym = n + 1;
+    }
+    dc = &x->b_dollsym[n];
+    if (dc->dc_template != s || dc->dc_index != index)
+        dollsymcache_init(dc, index, s);
+    if (dc->dc_nargs < 0)
+        return (binbuf_realizedollsym(s, ac, av, tonew));
+    SETFLOAT(&dollar0, canvas_getdollarzero());
+    for (i = 0; i < dc->dc_nargs; i++)
+        dollsymcache_getarg(dc->dc_argno[i], &dollar0, ac, av, &args[i]);
+    for (j = 0, key = dc->dc_keys; j < DOLLSYMNCACHE; j++, key++)
+    {
+        if (!key->k_result || key->k_tonew != tonew)
+            continue;
+        for (i = 0; i < dc->dc_nargs; i++)
+            if (!dollsymcache_sameatom(&key->k_args[i], &args[i]))
+                break;
+        if (i == dc->dc_nargs)
+            return (key->k_result);
+    }
+    if ((result = binbuf_realizedollsym(s, ac, av, tonew)))
+    {
+        key = &dc->dc_keys[dc->dc_next];
+        dc->dc_next = (dc->dc_next + 1) % DOLLSYMNCACHE;
+        key->k_result = result;
+        key->k_tonew = tonew;
+        for (i = 0; i < dc->dc_nargs; i++)
+            key->k_args[i] = args[i];
+    }
+    return (result);
+}
+
 #define SMALLMSG 5
 #define HUGEMSG 1000
 
@@ -590,7 +927,7 @@ void binbuf_eval(const t_binbuf *x, t_pd *target, int argc, const t_atom *argv)
     t_atom smallstack[SMALLMSG], *mstack, *msp;
     const t_atom *at = x->b_vec;
     int ac = x->b_n;
-    int nargs, maxnargs = 0;
+    int nargs, maxnargs = 0, dsi = 0;
     t_pd *initial_target = target;
 
     if (ac <= SMALLMSG)
@@ -662,8 +999,7 @@ void binbuf_eval(const t_binbuf *x, t_pd *target, int argc, const t_atom *argv)
             }
             else if (at->a_type == A_DOLLSYM)
             {
-                if (!(s = binbuf_realizedollsym(at->a_w.w_symbol,
-                    argc, argv, 0)))
+                if (!(s = binbuf_evaldollsym(x, at, &dsi, argc, argv, 0)))
                 {
                     pd_error(initial_target, "$%s: not enough arguments supplied",
                         at->a_w.w_symbol->s_name);
@@ -737,7 +1073,7 @@ void binbuf_eval(const t_binbuf *x, t_pd *target, int argc, const t_atom *argv)
                 }
                 break;
             case A_DOLLSYM:
-                s9 = binbuf_realizedollsym(at->a_w.w_symbol, argc, argv,
+                s9 = binbuf_evaldollsym(x, at, &dsi, argc, argv,
                     target == &pd_objectmaker);
                 if (!s9)
                 {
@@ -911,6 +1247,7 @@ int binbuf_read_via_path(t_binbuf *b, const char *filename, const char *dirname,
 
 #define WBUFSIZE 4096
 static t_binbuf *binbuf_convert(const t_binbuf *oldb, int maxtopd);
+static void patchcache_forget(const char *path);
 
     /* write a binbuf to a text file.  If "crflag" is set we suppress
     semicolons. */
@@ -937,6 +1274,7 @@ int binbuf_write(const t_binbuf *x, const char *filename, const char *dir,
         z = y;
     }
 
+    patchcache_forget(fbuf);
     if (!(f = sys_fopen(fbuf, "w")))
         goto fail;
     for (ap = z->b_vec, indx = z->b_n; indx--; ap++)
@@ -1470,17 +1808,420 @@ static t_binbuf *binbuf_convert(const t_binbuf *oldb, int maxtopd)
     return (newb);
 }
 
+/* ------------------- cache of parsed patch files ---------------------- */
+
+/* Patch files, and above all abstractions, which are read again for every
+copy of them, are parsed once and the binbuf is kept, keyed by the file's
+full pathname and checked against its size and modification time (to the
+nanosecond where the file system keeps it) whenever it's asked for again.
+binbuf_write() drops the entry for any file it writes, and files modified
+in the last couple of seconds aren't cached at all, in case the time is too
+coarse to show a change made by some other program.  Symbols belong to a Pd
+instance, so each instance has its own cache.
+
+If a directory is given (the "-patchcache" flag or "pd patch-cache-dir"),
+the atoms are also saved there, one file per patch, so that Pd can skip
+parsing the text the next time it starts.  The file starts with a header
+that names the patch and says how big it was and when it was modified; if
+any of that (or the byte order or float size) doesn't match, or the file is
+cut short, we just read the patch instead and write the file again. */
+
+typedef struct _patchentry
+{
+    t_symbol *pe_path;              /* full pathname */
+    long long pe_size;              /* size and mtime when we read it */
+    long long pe_mtime;
+    t_binbuf *pe_binbuf;
+    int pe_busy;                    /* being evaluated */
+    struct _patchentry *pe_next;
+} t_patchentry;
+
+struct _patchcache
+{
+    t_patchentry *pc_list;
+    t_symbol *pc_dir;               /* directory for saved atoms, or 0 */
+    int pc_nhit;                    /* found in memory */
+    int pc_ndiskhit;                /* loaded from pc_dir */
+    int pc_nmiss;                   /* had to parse */
+};
+
+#define PATCHCACHE_MAGIC "PDC2"
+#define PATCHCACHE_MINAGE 2         /* seconds since a file was modified */
+
+#if defined(__APPLE__)
+#define PATCHCACHE_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#elif defined(_WIN32)
+#define PATCHCACHE_NSEC(st) 0
+#else
+#define PATCHCACHE_NSEC(st) ((st).st_mtim.tv_nsec)
+#endif
+#define PATCHCACHE_BYTEORDER 0x01020304
+
+static t_patchcache *patchcache_get(void)
+{
+    if (!STUFF->st_patchcache)
+    {
+        STUFF->st_patchcache =
+            (t_patchcache *)getbytes(sizeof(*STUFF->st_patchcache));
+        STUFF->st_patchcache->pc_list = 0;
+        STUFF->st_patchcache->pc_dir = 0;
+        STUFF->st_patchcache->pc_nhit = STUFF->st_patchcache->pc_ndiskhit =
+            STUFF->st_patchcache->pc_nmiss = 0;
+    }
+    return (STUFF->st_patchcache);
+}
+
+static void patchcache_clear(t_patchcache *x)
+{
+    t_patchentry *pe, *next, **pp = &x->pc_list;
+    for (pe = x->pc_list; pe; pe = next)
+    {
+        next = pe->pe_next;
+        if (pe->pe_busy)
+        {
+            *pp = pe;
+            pp = &pe->pe_next;
+            continue;
+        }
+        binbuf_free(pe->pe_binbuf);
+        freebytes(pe, sizeof(*pe));
+    }
+    *pp = 0;
+}
+
+    /* called when the Pd instance is freed */
+void patchcache_free(void)
+{
+    if (STUFF->st_patchcache)
+    {
+        patchcache_clear(STUFF->st_patchcache);
+        freebytes(STUFF->st_patchcache, sizeof(*STUFF->st_patchcache));
+        STUFF->st_patchcache = 0;
+    }
+}
+
+    /* forget a file we're about to overwrite */
+static void patchcache_forget(const char *path)
+{
+    t_patchentry *pe, **pp;
+    if (!STUFF->st_patchcache)
+        return;
+    for (pp = &STUFF->st_patchcache->pc_list; (pe = *pp);
+        pp = &pe->pe_next)
+    {
+        if (!strcmp(pe->pe_path->s_name, path))
+        {
+            if (pe->pe_busy)
+                pe->pe_size = -1;   /* never matches; replaced when done */
+            else
+            {
+                *pp = pe->pe_next;
+                binbuf_free(pe->pe_binbuf);
+                freebytes(pe, sizeof(*pe));
+            }
+            return;
+        }
+    }
+}
+
+    /* get a file's size and modification time in nanoseconds; returns 0 if
+    it can't be opened or was modified too recently to go in the cache */
+static int patchcache_stat(const char *path, long long *size,
+    long long *mtime)
+{
+    struct stat statbuf;
+    int fd = sys_open(path, 0);
+    if (fd < 0)
+        return (0);
+    if (fstat(fd, &statbuf) < 0)
+    {
+        close(fd);
+        return (0);
+    }
+    close(fd);
+    if (time(0) - statbuf.st_mtime < PATCHCACHE_MINAGE)
+        return (0);
+    *size = (long long)statbuf.st_size;
+    *mtime = (long long)statbuf.st_mtime * 1000000000LL +
+        PATCHCACHE_NSEC(statbuf);
+    return (1);
+}
+
+    /* name of the file in the cache directory that holds a patch's atoms */
+static void patchcache_diskname(t_patchcache *x, t_symbol *path, char *buf)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;      /* FNV-1a */
+    const unsigned char *s;
+    for (s = (const unsigned char *)path->s_name; *s; s++)
+        hash = (hash ^ *s) * 0x100000001b3ULL;
+    pd_snprintf(buf, MAXPDSTRING, "%s/%08x%08x.pdc", x->pc_dir->s_name,
+        (unsigned int)(hash >> 32), (unsigned int)hash);
+}
+
+static void patchcache_putint(FILE *fd, int32_t i)
+{
+    fwrite(&i, sizeof(i), 1, fd);
+}
+
+static void patchcache_putstring(FILE *fd, const char *s)
+{
+    int32_t length = (int32_t)strlen(s);
+    patchcache_putint(fd, length);
+    fwrite(s, 1, length, fd);
+}
+
+static void patchcache_writedisk(t_patchcache *x, t_symbol *path,
+    long long size, long long mtime, const t_binbuf *b)
+{
+    char filename[MAXPDSTRING];
+    FILE *fd;
+    int i;
+    int64_t size64 = size, mtime64 = mtime;
+    patchcache_diskname(x, path, filename);
+    if (!(fd = sys_fopen(filename, "wb")))
+    {
+        logpost(0, PD_VERBOSE, "patch cache: %s: %s", filename,
+            strerror(errno));
+        return;
+    }
+    fwrite(PATCHCACHE_MAGIC, 1, 4, fd);
+    patchcache_putint(fd, PATCHCACHE_BYTEORDER);
+    patchcache_putint(fd, (int32_t)sizeof(t_float));
+    fwrite(&size64, sizeof(size64), 1, fd);
+    fwrite(&mtime64, sizeof(mtime64), 1, fd);
+    patchcache_putstring(fd, path->s_name);
+    patchcache_putint(fd, b->b_n);
+    for (i = 0; i < b->b_n; i++)
+    {
+        const t_atom *ap = b->b_vec + i;
+        unsigned char type = (unsigned char)ap->a_type;
+        fwrite(&type, 1, 1, fd);
+        if (ap->a_type == A_FLOAT)
+            fwrite(&ap->a_w.w_float, sizeof(t_float), 1, fd);
+        else if (ap->a_type == A_SYMBOL || ap->a_type == A_DOLLSYM)
+            patchcache_putstring(fd, ap->a_w.w_symbol->s_name);
+        else if (ap->a_type == A_DOLLAR)
+            patchcache_putint(fd, ap->a_w.w_index);
+    }
+    if (ferror(fd))
+        logpost(0, PD_VERBOSE, "patch cache: %s: write failed", filename);
+    sys_fclose(fd);
+}
+
+    /* read a patch's atoms from the cache directory into "b" if they're
+    there and up to date; return 1 if so. */
+static int patchcache_readdisk(t_patchcache *x, t_symbol *path,
+    long long size, long long mtime, t_binbuf *b)
+{
+    char filename[MAXPDSTRING], *buf = 0, *bp, *ep;
+    FILE *fd;
+    long length;
+    int32_t i32, natom, i;
+    int64_t i64;
+    t_atom *ap;
+    patchcache_diskname(x, path, filename);
+    if (!(fd = sys_fopen(filename, "rb")))
+        return (0);
+    if (fseek(fd, 0, SEEK_END) < 0 || (length = ftell(fd)) < 0 ||
+        fseek(fd, 0, SEEK_SET) < 0 || !(buf = getbytes(length + 1)) ||
+            (long)fread(buf, 1, length, fd) != length)
+    {
+        sys_fclose(fd);
+        if (buf)
+            freebytes(buf, length + 1);
+        return (0);
+    }
+    sys_fclose(fd);
+    bp = buf;
+    ep = buf + length;
+#define PC_GET(p, n) if (ep - bp < (long)(n)) goto bad; \
+    memcpy((p), bp, (n)); bp += (n)
+    if (length < 4 || memcmp(bp, PATCHCACHE_MAGIC, 4))
+        goto bad;
+    bp += 4;
+    PC_GET(&i32, 4);
+    if (i32 != PATCHCACHE_BYTEORDER)
+        goto bad;
+    PC_GET(&i32, 4);
+    if (i32 != (int32_t)sizeof(t_float))
+        goto bad;
+    PC_GET(&i64, 8);
+    if (i64 != size)
+        goto bad;
+    PC_GET(&i64, 8);
+    if (i64 != mtime)
+        goto bad;
+    PC_GET(&i32, 4);
+    if (i32 != (int32_t)strlen(path->s_name) || ep - bp < i32 ||
+        memcmp(bp, path->s_name, i32))
+            goto bad;
+    bp += i32;
+    PC_GET(&natom, 4);
+    if (natom < 0 || natom > ep - bp || !binbuf_resize(b, natom))
+        goto bad;
+    for (i = 0, ap = b->b_vec; i < natom; i++, ap++)
+    {
+        unsigned char type;
+        PC_GET(&type, 1);
+        switch (type)
+        {
+        case A_FLOAT:
+            PC_GET(&ap->a_w.w_float, sizeof(t_float));
+            ap->a_type = A_FLOAT;
+            break;
+        case A_SYMBOL: case A_DOLLSYM:
+            PC_GET(&i32, 4);
+            if (i32 < 0 || ep - bp < i32 || memchr(bp, 0, i32))
+                goto bad;
+            ap->a_type = type;
+            ap->a_w.w_symbol = gensymn(bp, i32);
+            bp += i32;
+            break;
+        case A_DOLLAR:
+            PC_GET(&i32, 4);
+            SETDOLLAR(ap, i32);
+            break;
+        case A_SEMI:
+            SETSEMI(ap);
+            break;
+        case A_COMMA:
+            SETCOMMA(ap);
+            break;
+        default:
+            goto bad;
+        }
+    }
+#undef PC_GET
+    if (bp != ep)
+        goto bad;
+    freebytes(buf, length + 1);
+    return (1);
+bad:
+    logpost(0, PD_VERBOSE, "patch cache: ignoring %s", filename);
+    binbuf_clear(b);
+    freebytes(buf, length + 1);
+    return (0);
+}
+
+    /* get the binbuf for a patch file, from the cache if we can.  If "*pep"
+    comes back nonzero the binbuf belongs to the cache and patchcache_done()
+    has to be called when we're through with it; otherwise the caller frees
+    it.  Returns 0 if the file can't be read. */
+static t_binbuf *patchcache_read(t_symbol *name, t_symbol *dir, int import,
+    t_patchentry **pep)
+{
+    t_patchcache *x = patchcache_get();
+    t_patchentry *pe;
+    t_symbol *path;
+    t_binbuf *b;
+    char namebuf[MAXPDSTRING];
+    long long size, mtime;
+    *pep = 0;
+    if (*dir->s_name)
+        pd_snprintf(namebuf, MAXPDSTRING-1, "%s/%s", dir->s_name,
+            name->s_name);
+    else pd_snprintf(namebuf, MAXPDSTRING-1, "%s", name->s_name);
+    namebuf[MAXPDSTRING-1] = 0;
+    if (!patchcache_stat(namebuf, &size, &mtime))
+        path = 0;
+    else
+    {
+        path = gensym(namebuf);
+        for (pe = x->pc_list; pe; pe = pe->pe_next)
+            if (pe->pe_path == path)
+                break;
+        if (pe && pe->pe_size == size && pe->pe_mtime == mtime)
+        {
+            x->pc_nhit++;
+                /* a patch that's still being evaluated can't share it */
+            if (pe->pe_busy)
+                return (binbuf_duplicate(pe->pe_binbuf));
+            pe->pe_busy = 1;
+            *pep = pe;
+            return (pe->pe_binbuf);
+        }
+    }
+    b = binbuf_new();
+    if (path && x->pc_dir && patchcache_readdisk(x, path, size, mtime, b))
+        x->pc_ndiskhit++;
+    else
+    {
+        if (binbuf_read(b, name->s_name, dir->s_name, BINBUF_SHEBANG))
+        {
+            binbuf_free(b);
+            return (0);
+        }
+        if (import)
+        {
+            t_binbuf *newb = binbuf_convert(b, 1);
+            binbuf_free(b);
+            b = newb;
+        }
+        x->pc_nmiss++;
+        if (path && x->pc_dir)
+            patchcache_writedisk(x, path, size, mtime, b);
+    }
+    if (!path || (pe && pe->pe_busy))
+        return (b);
+    if (!pe)
+    {
+        pe = (t_patchentry *)getbytes(sizeof(*pe));
+        pe->pe_path = path;
+        pe->pe_next = x->pc_list;
+        x->pc_list = pe;
+    }
+    else binbuf_free(pe->pe_binbuf);
+    pe->pe_size = size;
+    pe->pe_mtime = mtime;
+    pe->pe_binbuf = b;
+    pe->pe_busy = 1;
+    *pep = pe;
+    return (b);
+}
+
+static void patchcache_done(t_patchentry *pe)
+{
+    pe->pe_busy = 0;
+}
+
+    /* "pd patch-cache-dir [dir]": save parsed patches in a directory so
+    they needn't be parsed again next time.  No directory turns it off. */
+void glob_patchcachedir(void *dummy, t_symbol *s)
+{
+    patchcache_get()->pc_dir = (*s->s_name ? s : 0);
+}
+
+    /* "pd patch-cache-stats" */
+void glob_patchcachestats(void *dummy)
+{
+    t_patchcache *x = patchcache_get();
+    t_patchentry *pe;
+    int n = 0, natom = 0;
+    for (pe = x->pc_list; pe; pe = pe->pe_next)
+        n++, natom += pe->pe_binbuf->b_n;
+    post("patch cache: %d files, %d atoms; %d hits, %d from %s, %d parsed",
+        n, natom, x->pc_nhit, x->pc_ndiskhit,
+            (x->pc_dir ? x->pc_dir->s_name : "disk (off)"), x->pc_nmiss);
+}
+
+    /* "pd patch-cache-clear" */
+void glob_patchcacheclear(void *dummy)
+{
+    patchcache_clear(patchcache_get());
+}
+
 /* LATER make this evaluate the file on-the-fly. */
 /* LATER figure out how to log errors */
 void binbuf_evalfile(t_symbol *name, t_symbol *dir)
 {
-    t_binbuf *b = binbuf_new();
+    t_binbuf *b;
+    t_patchentry *pe;
     int import = !strcmp(name->s_name + strlen(name->s_name) - 4, ".pat") ||
         !strcmp(name->s_name + strlen(name->s_name) - 4, ".mxt");
     int dspstate = canvas_suspend_dsp();
         /* set filename so that new canvases can pick them up */
     glob_setfilename(0, name, dir);
-    if (binbuf_read(b, name->s_name, dir->s_name, BINBUF_SHEBANG))
+    if (!(b = patchcache_read(name, dir, import, &pe)))
         pd_error(0, "%s: read failed; %s", name->s_name, strerror(errno));
     else
     {
@@ -1488,21 +2229,17 @@ void binbuf_evalfile(t_symbol *name, t_symbol *dir)
         t_pd *bounda = gensym("#A")->s_thing, *boundn = s__N.s_thing;
         gensym("#A")->s_thing = 0;
         s__N.s_thing = &pd_canvasmaker;
-        if (import)
-        {
-            t_binbuf *newb = binbuf_convert(b, 1);
-            binbuf_free(b);
-            b = newb;
-        }
         binbuf_eval(b, 0, 0, 0);
             /* avoid crashing if no canvas was created by binbuf eval */
         if (s__X.s_thing && *s__X.s_thing == canvas_class)
             canvas_initbang((t_canvas *)(s__X.s_thing)); /* JMZ*/
         gensym("#A")->s_thing = bounda;
         s__N.s_thing = boundn;
+        if (pe)
+            patchcache_done(pe);
+        else binbuf_free(b);
     }
     glob_setfilename(0, &s_, &s_);
-    binbuf_free(b);
     canvas_resume_dsp(dspstate);
 }
 
@@ -18,6 +18,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdio.h>
+#include <stddef.h>
 
 #include "m_private_utils.h"
 
@@ -74,6 +75,9 @@ t_pdinstance pd_maininstance;
 
 static t_symbol *dogensym(const char *s, t_symbol *oldsym,
     t_pdinstance *pdinstance);
+#ifdef PDINSTANCE
+static void symname_free(t_symbol *s);
+#endif
 void x_midi_newpdinstance( void);
 void x_midi_freepdinstance( void);
 void s_inter_newpdinstance( void);
@@ -93,11 +97,27 @@ void s_stuff_newpdinstance(void)
     STUFF->st_dacsr = DEFDACSAMPLERATE;
     STUFF->st_printhook = sys_printhook;
     STUFF->st_impdata = NULL;
+    STUFF->st_clockheap = 0;
+    STUFF->st_nclocks = STUFF->st_clockheapsize = 0;
+    STUFF->st_clockseq = 0;
+    STUFF->st_mempool = mempool_new();
+    STUFF->st_patchcache = 0;
+    STUFF->st_pathcache = 0;
 }
 
 void s_stuff_freepdinstance(void)
 {
+    t_mempool *mempool;
+    patchcache_free();
+    sys_pathcache_free();
+    if (STUFF->st_clockheap)
+        freebytes(STUFF->st_clockheap,
+            STUFF->st_clockheapsize * sizeof(*STUFF->st_clockheap));
+    mempool = STUFF->st_mempool;
     freebytes(STUFF, sizeof(*STUFF));
+    STUFF = 0;
+        /* anything allocated from here on comes from the C library */
+    mempool_retire(mempool);
 }
 
 static t_pdinstance *pdinstance_init(t_pdinstance *x)
@@ -110,6 +130,8 @@ static t_pdinstance *pdinstance_init(t_pdinstance *x)
     x->pd_symhash = getbytes(SYMTABHASHSIZE * sizeof(*x->pd_symhash));
     for (i = 0; i < SYMTABHASHSIZE; i++)
         x->pd_symhash[i] = 0;
+    x->pd_symhashsize = SYMTABHASHSIZE;
+    x->pd_nsymbols = 0;
 #ifdef PDINSTANCE
     dogensym("pointer",   &x->pd_s_pointer,  x);
     dogensym("float",     &x->pd_s_float,    x);
@@ -145,11 +167,84 @@ static t_pdinstance *pdinstance_init(t_pdinstance *x)
     return (x);
 }
 
+/* Classes with more than a few methods (most of all pd_objectmaker, which
+has one for every class creator) get a hash table from selector to method
+so that finding a method doesn't mean scanning the whole list.  As with the
+scan, if two methods have the same name the first one wins. */
+
+#define METHODHASH_MIN 8        /* don't bother with fewer methods */
+
+    /* symbols are unique, so we just hash the pointer */
+#define METHODHASH(s, size) ((unsigned int)(((uint64_t)(size_t)(s) * \
+    0x9E3779B97F4A7C15ULL) >> 32) & ((size) - 1))
+
+static void methodhash_insert(t_methodhash *h, t_methodentry *mlist, int i)
+{
+    unsigned int j;
+    if (!mlist[i].me_name)
+        return;
+    for (j = METHODHASH(mlist[i].me_name, h->mh_size); h->mh_vec[j] >= 0;
+        j = (j + 1) & (h->mh_size - 1))
+            if (mlist[h->mh_vec[j]].me_name == mlist[i].me_name)
+                return;
+    h->mh_vec[j] = i;
+}
+
+static void methodhash_rebuild(t_methodhash *h, t_methodentry *mlist,
+    int nmethod)
+{
+    int i, size = 0;
+    if (nmethod >= METHODHASH_MIN)
+        for (size = 2 * METHODHASH_MIN; size < 2 * nmethod; size *= 2)
+            ;
+    if (size != h->mh_size)
+    {
+        h->mh_vec = (int *)resizebytes(h->mh_vec,
+            h->mh_size * sizeof(int), size * sizeof(int));
+        h->mh_size = size;
+    }
+    for (i = 0; i < size; i++)
+        h->mh_vec[i] = -1;
+    if (size)
+        for (i = 0; i < nmethod; i++)
+            methodhash_insert(h, mlist, i);
+}
+
+static void methodhash_free(t_methodhash *h)
+{
+    if (h->mh_vec)
+        freebytes(h->mh_vec, h->mh_size * sizeof(int));
+    h->mh_vec = 0;
+    h->mh_size = 0;
+}
+
+    /* find the method for a selector, or return 0 */
+static t_methodentry *methodhash_find(const t_methodhash *h,
+    t_methodentry *mlist, int nmethod, t_symbol *s)
+{
+    if (h->mh_size)
+    {
+        unsigned int j;
+        for (j = METHODHASH(s, h->mh_size); h->mh_vec[j] >= 0;
+            j = (j + 1) & (h->mh_size - 1))
+                if (mlist[h->mh_vec[j]].me_name == s)
+                    return (&mlist[h->mh_vec[j]]);
+    }
+    else
+    {
+        t_methodentry *m;
+        for (m = mlist; nmethod--; m++)
+            if (m->me_name == s)
+                return (m);
+    }
+    return (0);
+}
+
 static void class_addmethodtolist(t_class *c, t_methodentry **methodlist,
-    int nmethod, t_gotfn fn, t_symbol *sel, unsigned char *args,
-        t_pdinstance *pdinstance)
+    t_methodhash *hash, int nmethod, t_gotfn fn, t_symbol *sel,
+        unsigned char *args, t_pdinstance *pdinstance)
 {
-    int i;
+    int i, renamed = 0;
     t_methodentry *m;
     for (i = 0; i < nmethod; i++)
         if (sel && (*methodlist)[i].me_name == sel)
@@ -158,6 +253,7 @@ static void class_addmethodtolist(t_class *c, t_methodentry **methodlist,
         pd_snprintf(nbuf, 80, "%s_aliased", sel->s_name);
         nbuf[79] = 0;
         (*methodlist)[i].me_name = dogensym(nbuf, 0, pdinstance);
+        renamed = 1;
         if (c == pd_objectmaker)
             logpost(NULL, PD_VERBOSE, "warning: class '%s' overwritten; old one renamed '%s'",
                 sel->s_name, nbuf);
@@ -171,6 +267,12 @@ static void class_addmethodtolist(t_class *c, t_methodentry **methodlist,
     m->me_name = sel;
     m->me_fun = (t_gotfn)fn;
     memcpy(m->me_arg, args, MAXPDARG+1);
+        /* just add the new method to the hash table unless it's time to
+        grow it or an old method got renamed */
+    if (hash->mh_size && !renamed && 2 * (nmethod + 1) <= hash->mh_size)
+        methodhash_insert(hash, *methodlist, nmethod);
+    else if (nmethod + 1 >= METHODHASH_MIN)
+        methodhash_rebuild(hash, *methodlist, nmethod + 1);
 }
 
 #ifdef PDINSTANCE
@@ -215,8 +317,14 @@ t_pdinstance *pdinstance_new(void)
             pd_ninstances * sizeof(*c->c_methods),
                 (pd_ninstances + 1) * sizeof(*c->c_methods));
         c->c_methods[pd_ninstances] = t_getbytes(0);
+        c->c_methodhash = (t_methodhash *)t_resizebytes(c->c_methodhash,
+            pd_ninstances * sizeof(*c->c_methodhash),
+                (pd_ninstances + 1) * sizeof(*c->c_methodhash));
+        c->c_methodhash[pd_ninstances].mh_vec = 0;
+        c->c_methodhash[pd_ninstances].mh_size = 0;
         for (i = 0; i < c->c_nmethod; i++)
-            class_addmethodtolist(c, &c->c_methods[pd_ninstances], i,
+            class_addmethodtolist(c, &c->c_methods[pd_ninstances],
+                &c->c_methodhash[pd_ninstances], i,
                 c->c_methods[0][i].me_fun,
                 dogensym(c->c_methods[0][i].me_name->s_name, 0, x),
                     c->c_methods[0][i].me_arg, x);
@@ -260,21 +368,26 @@ void pdinstance_free(t_pdinstance *x)
         if (c->c_methods[instanceno])
             freebytes(c->c_methods[instanceno],
                 c->c_nmethod * sizeof(**c->c_methods));
+        methodhash_free(&c->c_methodhash[instanceno]);
         if (c->c_data[instanceno].freefn)
             c->c_data[instanceno].freefn(c->c_data[instanceno].data);
         for (i = instanceno; i < pd_ninstances-1; i++)
         {
             c->c_methods[i] = c->c_methods[i+1];
+            c->c_methodhash[i] = c->c_methodhash[i+1];
             c->c_data[i] = c->c_data[i+1];
         }
         c->c_methods = (t_methodentry **)t_resizebytes(c->c_methods,
             pd_ninstances * sizeof(*c->c_methods),
                 (pd_ninstances - 1) * sizeof(*c->c_methods));
+        c->c_methodhash = (t_methodhash *)t_resizebytes(c->c_methodhash,
+            pd_ninstances * sizeof(*c->c_methodhash),
+                (pd_ninstances - 1) * sizeof(*c->c_methodhash));
         c->c_data = (t_class_data *)t_resizebytes(c->c_data,
             pd_ninstances * sizeof(*c->c_data),
                 (pd_ninstances - 1) * sizeof(*c->c_data));
     }
-    for (i = 0; i < SYMTABHASHSIZE; i++)
+    for (i = 0; i < x->pd_symhashsize; i++)
     {
         while ((s = x->pd_symhash[i]))
         {
@@ -292,12 +405,12 @@ void pdinstance_free(t_pdinstance *x)
                s != &x->pd_s_y &&
                s != &x->pd_s_)
             {
-                freebytes((void *)s->s_name, strlen(s->s_name)+1);
+                symname_free(s);
                 freebytes(s, sizeof(*s));
             }
         }
     }
-    freebytes(x->pd_symhash, SYMTABHASHSIZE * sizeof (*x->pd_symhash));
+    freebytes(x->pd_symhash, x->pd_symhashsize * sizeof (*x->pd_symhash));
     x_midi_freepdinstance();
     g_canvas_freepdinstance();
     d_ugen_freepdinstance();
@@ -545,6 +658,8 @@ t_class *class_donew(t_symbol *s, t_newmethod newmethod, t_method freemethod,
     c->c_multichannel = (flags & CLASS_MULTICHANNEL) != 0;
     c->c_nopromotesig = (flags & CLASS_NOPROMOTESIG) != 0;
     c->c_nopromoteleft = (flags & CLASS_NOPROMOTELEFT) != 0;
+    c->c_dspshared = 0;
+    c->c_dsplinked = 0;
     c->c_drawcommand = 0;
     c->c_floatsignalin = 0;
     c->c_externdir = class_extern_dir;
@@ -555,6 +670,13 @@ t_class *class_donew(t_symbol *s, t_newmethod newmethod, t_method freemethod,
         pd_ninstances * sizeof(*c->c_methods));
     for (i = 0; i < pd_ninstances; i++)
         c->c_methods[i] = t_getbytes(0);
+    c->c_methodhash = (t_methodhash *)t_getbytes(
+        pd_ninstances * sizeof(*c->c_methodhash));
+    for (i = 0; i < pd_ninstances; i++)
+    {
+        c->c_methodhash[i].mh_vec = 0;
+        c->c_methodhash[i].mh_size = 0;
+    }
     c->c_data = (t_class_data *)t_getbytes(
         pd_ninstances * sizeof(*c->c_data));
     for (i = 0; i < pd_ninstances; i++)
@@ -566,6 +688,8 @@ t_class *class_donew(t_symbol *s, t_newmethod newmethod, t_method freemethod,
     class_list = c;
 #else
     c->c_methods = t_getbytes(0);
+    c->c_methodhash.mh_vec = 0;
+    c->c_methodhash.mh_size = 0;
     c->c_data.data = 0;
     c->c_data.freefn = 0;
 #endif
@@ -634,11 +758,14 @@ void class_free(t_class *c)
         if(c->c_methods[i])
             freebytes(c->c_methods[i], c->c_nmethod * sizeof(*c->c_methods[i]));
         c->c_methods[i] = NULL;
+        methodhash_free(&c->c_methodhash[i]);
     }
     freebytes(c->c_methods, pd_ninstances * sizeof(*c->c_methods));
+    freebytes(c->c_methodhash, pd_ninstances * sizeof(*c->c_methodhash));
     freebytes(c->c_data, pd_ninstances * sizeof(*c->c_data));
 #else
     freebytes(c->c_methods, c->c_nmethod * sizeof(*c->c_methods));
+    methodhash_free(&c->c_methodhash);
 #endif
     freebytes(c, sizeof(*c));
 }
@@ -770,13 +897,13 @@ void class_doaddmethod(t_class *c, t_method fn, t_symbol *sel,
 #ifdef PDINSTANCE
         for (i = 0; i < pd_ninstances; i++)
         {
-            class_addmethodtolist(c, &c->c_methods[i], c->c_nmethod,
-                (t_gotfn)fn, sel?dogensym(sel->s_name, 0, pd_instances[i]):0,
+            class_addmethodtolist(c, &c->c_methods[i], &c->c_methodhash[i],
+                c->c_nmethod, (t_gotfn)fn, sel?dogensym(sel->s_name, 0, pd_instances[i]):0,
                     argvec, pd_instances[i]);
         }
 #else
-        class_addmethodtolist(c, &c->c_methods, c->c_nmethod,
-            (t_gotfn)fn, sel, argvec, &pd_maininstance);
+        class_addmethodtolist(c, &c->c_methods, &c->c_methodhash,
+            c->c_nmethod, (t_gotfn)fn, sel, argvec, &pd_maininstance);
 #endif
         c->c_nmethod++;
     }
@@ -977,44 +1104,139 @@ t_propertiesfn class_getpropertiesfn(const t_class *c)
 
 /* ---------------- the symbol table ------------------------ */
 
-static t_symbol *dogensym(const char *s, t_symbol *oldsym,
-    t_pdinstance *pdinstance)
+/* Each symbol's name is stored just after its hash value and length, so
+that looking a name up only compares strings whose hash and length already
+match.  The table doubles in size whenever it has as many symbols as
+buckets; the cached hashes make that cheap. */
+
+typedef struct _symname
 {
-    char *symname = 0;
-    t_symbol **symhashloc, *sym2;
-    unsigned int hash = 5381;
-    int length = 0;
-    const char *s2 = s;
-    while (*s2) /* djb2 hash algo */
+    unsigned int sn_hash;
+    unsigned int sn_length;
+    char sn_name[1];        /* actually sn_length + 1 */
+} t_symname;
+
+#define SYMNAME(s) ((t_symname *)((s)->s_name - offsetof(t_symname, sn_name)))
+
+#ifdef PDINSTANCE
+static void symname_free(t_symbol *s)
+{
+    freebytes(SYMNAME(s),
+        offsetof(t_symname, sn_name) + SYMNAME(s)->sn_length + 1);
+}
+#endif
+
+static void symtab_grow(t_pdinstance *pdinstance)
+{
+    int oldsize = pdinstance->pd_symhashsize, newsize = 2 * oldsize, i;
+    t_symbol **oldhash = pdinstance->pd_symhash, **newhash =
+        (t_symbol **)getbytes(newsize * sizeof(*newhash));
+    for (i = 0; i < oldsize; i++)
     {
-        hash = ((hash << 5) + hash) + *s2;
-        length++;
-        s2++;
+        t_symbol *sym = oldhash[i], *next;
+        for (; sym; sym = next)
+        {
+            t_symbol **loc = newhash + (SYMNAME(sym)->sn_hash & (newsize-1));
+            next = sym->s_next;
+            sym->s_next = *loc;
+            *loc = sym;
+        }
     }
-    symhashloc = pdinstance->pd_symhash + (hash & (SYMTABHASHSIZE-1));
+    freebytes(oldhash, oldsize * sizeof(*oldhash));
+    pdinstance->pd_symhash = newhash;
+    pdinstance->pd_symhashsize = newsize;
+}
+
+    /* look up (or add) a symbol whose hash and length are already known.
+    The name needn't be null-terminated. */
+static t_symbol *symtab_find(const char *s, unsigned int hash,
+    unsigned int length, t_symbol *oldsym, t_pdinstance *pdinstance)
+{
+    t_symname *symname;
+    t_symbol **symhashloc, *sym2;
+    symhashloc = pdinstance->pd_symhash +
+        (hash & (pdinstance->pd_symhashsize-1));
     while ((sym2 = *symhashloc))
     {
-        if (!strcmp(sym2->s_name, s))
-            return(sym2);
+        t_symname *sn = SYMNAME(sym2);
+        if (sn->sn_hash == hash && sn->sn_length == length &&
+            !memcmp(sn->sn_name, s, length))
+                return(sym2);
         symhashloc = &sym2->s_next;
     }
     if (oldsym)
         sym2 = oldsym;
     else sym2 = (t_symbol *)t_getbytes(sizeof(*sym2));
-    symname = t_getbytes(length+1);
+    symname = (t_symname *)t_getbytes(
+        offsetof(t_symname, sn_name) + length + 1);
+    symname->sn_hash = hash;
+    symname->sn_length = length;
+    memcpy(symname->sn_name, s, length);
+    symname->sn_name[length] = 0;
     sym2->s_next = 0;
     sym2->s_thing = 0;
-    strcpy(symname, s);
-    sym2->s_name = symname;
+    sym2->s_name = symname->sn_name;
     *symhashloc = sym2;
+    if (++pdinstance->pd_nsymbols > pdinstance->pd_symhashsize)
+        symtab_grow(pdinstance);
     return (sym2);
 }
 
+static t_symbol *dogensym(const char *s, t_symbol *oldsym,
+    t_pdinstance *pdinstance)
+{
+    unsigned int hash = 5381;
+    unsigned int length = 0;
+    const char *s2 = s;
+    while (*s2) /* djb2 hash algo */
+    {
+        hash = ((hash << 5) + hash) + *s2;
+        length++;
+        s2++;
+    }
+    return (symtab_find(s, hash, length, oldsym, pdinstance));
+}
+
+    /* "pd symtab-stats" */
+void glob_symtabstats(void *dummy)
+{
+    int i, nempty = 0, longest = 0;
+    for (i = 0; i < pd_this->pd_symhashsize; i++)
+    {
+        t_symbol *sym;
+        int n = 0;
+        for (sym = pd_this->pd_symhash[i]; sym; sym = sym->s_next)
+            n++;
+        if (!n)
+            nempty++;
+        if (n > longest)
+            longest = n;
+    }
+    post("symbol table: %d symbols in %d buckets (load factor %.2f)",
+        pd_this->pd_nsymbols, pd_this->pd_symhashsize,
+            pd_this->pd_nsymbols / (double)pd_this->pd_symhashsize);
+    post("... %d buckets empty, average chain %.2f, longest %d",
+        nempty, (nempty < pd_this->pd_symhashsize ? pd_this->pd_nsymbols /
+            (double)(pd_this->pd_symhashsize - nempty) : 0), longest);
+}
+
 t_symbol *gensym(const char *s)
 {
     return(dogensym(s, 0, pd_this));
 }
 
+    /* same as gensym() but for the first "length" bytes of "s", which
+    needn't be null-terminated (and mustn't contain a null).  binbuf_text()
+    uses this to make symbols straight out of the text it's parsing. */
+t_symbol *gensymn(const char *s, size_t length)
+{
+    unsigned int hash = 5381;
+    const char *s2 = s, *e = s + length;
+    while (s2 != e)
+        hash = ((hash << 5) + hash) + *s2++;
+    return (symtab_find(s, hash, (unsigned int)length, 0, pd_this));
+}
+
 static t_symbol *addfileextent(t_symbol *s)
 {
     char namebuf[MAXPDSTRING];
@@ -1092,9 +1314,9 @@ void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
 {
     t_method *f;
     t_class *c = *x;
+    const t_methodhash *hash;
     t_methodentry *m, *mlist;
     unsigned char *wp, wanttype;
-    int i;
     t_int ai[MAXPDARG+1], *ap = ai;
     t_floatarg ad[MAXPDARG+1], *dp = ad;
     int niarg = 0;
@@ -1163,11 +1385,12 @@ void pd_typedmess(t_pd *x, t_symbol *s, int argc, t_atom *argv)
     }
 #ifdef PDINSTANCE
     mlist = c->c_methods[pd_this->pd_instanceno];
+    hash = &c->c_methodhash[pd_this->pd_instanceno];
 #else
     mlist = c->c_methods;
+    hash = &c->c_methodhash;
 #endif
-    for (i = c->c_nmethod, m = mlist; i--; m++)
-        if (m->me_name == s)
+    if ((m = methodhash_find(hash, mlist, c->c_nmethod, s)))
     {
         wp = m->me_arg;
         if (*wp == A_GIMME)
@@ -1312,16 +1535,18 @@ void nullfn(void) {}
 t_gotfn getfn(const t_pd *x, t_symbol *s)
 {
     const t_class *c = *x;
+    const t_methodhash *hash;
     t_methodentry *m, *mlist;
-    int i;
 
 #ifdef PDINSTANCE
     mlist = c->c_methods[pd_this->pd_instanceno];
+    hash = &c->c_methodhash[pd_this->pd_instanceno];
 #else
     mlist = c->c_methods;
+    hash = &c->c_methodhash;
 #endif
-    for (i = c->c_nmethod, m = mlist; i--; m++)
-        if (m->me_name == s) return(m->me_fun);
+    if ((m = methodhash_find(hash, mlist, c->c_nmethod, s)))
+        return(m->me_fun);
     pd_error(x, "%s: no method for message '%s'", c->c_name->s_name, s->s_name);
     return((t_gotfn)nullfn);
 }
@@ -1329,19 +1554,57 @@ t_gotfn getfn(const t_pd *x, t_symbol *s)
 t_gotfn zgetfn(const t_pd *x, t_symbol *s)
 {
     const t_class *c = *x;
+    const t_methodhash *hash;
     t_methodentry *m, *mlist;
-    int i;
 
 #ifdef PDINSTANCE
     mlist = c->c_methods[pd_this->pd_instanceno];
+    hash = &c->c_methodhash[pd_this->pd_instanceno];
 #else
     mlist = c->c_methods;
+    hash = &c->c_methodhash;
 #endif
-    for (i = c->c_nmethod, m = mlist; i--; m++)
-        if (m->me_name == s) return(m->me_fun);
+    if ((m = methodhash_find(hash, mlist, c->c_nmethod, s)))
+        return(m->me_fun);
     return(0);
 }
 
+    /* "pd method-bench [n]": look up every object creator n times (10 by
+    default) the way pd_typedmess() does when a patch is loaded, once with
+    the hash table and once scanning the list as we used to. */
+void glob_methodbench(void *dummy, t_floatarg f)
+{
+    t_class *c = pd_objectmaker;
+    t_methodhash nohash = {0, 0}, *hash;
+    t_methodentry *mlist;
+    int n = (f >= 1 ? f : 10), i, j, nfound[2] = {0, 0};
+    double elapsed[2];
+#ifdef PDINSTANCE
+    mlist = c->c_methods[pd_this->pd_instanceno];
+    hash = &c->c_methodhash[pd_this->pd_instanceno];
+#else
+    mlist = c->c_methods;
+    hash = &c->c_methodhash;
+#endif
+    for (j = 0; j < 2; j++)
+    {
+        double starttime = sys_getrealtime();
+        for (i = 0; i < n; i++)
+        {
+            int k;
+            for (k = 0; k < c->c_nmethod; k++)
+                if (methodhash_find((j ? &nohash : hash), mlist,
+                    c->c_nmethod, mlist[k].me_name))
+                        nfound[j]++;
+        }
+        elapsed[j] = sys_getrealtime() - starttime;
+    }
+    post("method-bench: %d creators: hashed %.2f, linear %.2f "
+        "million lookups/sec", c->c_nmethod,
+        (elapsed[0] > 0 ? nfound[0] / (elapsed[0] * 1e6) : 0),
+        (elapsed[1] > 0 ? nfound[1] / (elapsed[1] * 1e6) : 0));
+}
+
 void c_extern(t_externclass *cls, t_newmethod newroutine,
     t_method freeroutine, t_symbol *name, size_t size, int tiny, \
     t_atomtype arg1, ...)
@@ -1392,3 +1655,32 @@ int class_getdspflags(const t_class *c)
             (c->c_nopromotesig ? CLASS_NOPROMOTESIG : 0) |
             (c->c_nopromoteleft ? CLASS_NOPROMOTELEFT : 0) );
 }
+
+    /* Mark a tilde class whose perform routine reads or writes state that
+    other objects also see (delay lines, arrays, the DAC buffers, clocks...)
+    so that the DSP threads run it in its original order with respect to all
+    other such objects.  Also privately shared with d_ugen.c. */
+void class_setdspshared(t_class *c)
+{
+    c->c_dspshared = 1;
+}
+
+    /* we don't know what externals do, so they're always considered shared */
+int class_isdspshared(const t_class *c)
+{
+    return (c->c_dspshared || c->c_externdir != &s_);
+}
+
+    /* Mark a tilde class whose "dsp" method looks up other objects by name
+    without saying which (built-in ones call ugen_dsplink() instead).  Any
+    change to a name then makes us sort the whole DSP chain again.
+    Externals are assumed to do this, since we can't see their links. */
+void class_setdsplinked(t_class *c)
+{
+    c->c_dsplinked = 1;
+}
+
+int class_isdsplinked(const t_class *c)
+{
+    return (c->c_dsplinked || c->c_externdir != &s_);
+}
@@ -18,6 +18,13 @@ void glob_menunew(void *dummy, t_symbol *name, t_symbol *dir);
 void glob_quit(void *dummy, t_floatarg status);
 void glob_verifyquit(void *dummy, t_floatarg f);
 void glob_dsp(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void glob_dspthreads(void *dummy, t_floatarg f);
+void glob_dspfuse(void *dummy, t_floatarg f);
+void glob_dspprofile(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void glob_msgprofile(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void glob_dspsimd(void *dummy, t_symbol *s);
+void glob_dspsimdbench(void *dummy);
+void glob_ugen_printstate(void *dummy, t_symbol *s, int argc, t_atom *argv);
 void glob_key(void *dummy, t_symbol *s, int ac, t_atom *av);
 void glob_audiostatus(void *dummy);
 void glob_finderror(t_pd *dummy);
@@ -42,6 +49,20 @@ void glob_savepreferences(t_pd *dummy, t_symbol *s);
 void glob_forgetpreferences(t_pd *dummy);
 void glob_open(t_pd *ignore, t_symbol *name, t_symbol *dir, t_floatarg f);
 void glob_fastforward(t_pd *ignore, t_floatarg f);
+void glob_clockbench(void *dummy, t_floatarg f);
+void glob_schedtimeline(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void glob_messqueuestats(void *dummy);
+void glob_bench(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void glob_methodbench(void *dummy, t_floatarg f);
+void glob_symtabstats(void *dummy);
+void glob_memstats(void *dummy);
+void glob_parsebench(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void glob_patchcachedir(void *dummy, t_symbol *s);
+void glob_patchcachestats(void *dummy);
+void glob_patchcacheclear(void *dummy);
+void glob_pathcachestats(void *dummy);
+void glob_pathcacheclear(void *dummy);
+void glob_messqueuepolicy(void *dummy, t_symbol *s);
 void glob_settracing(void *dummy, t_floatarg f);
 void glob_vis(void *dummy, t_symbol *s);
 void glob_closesubs(void *dummy);
@@ -152,6 +173,20 @@ void glob_init(void)
         gensym("foo"), A_GIMME, 0);
     class_addmethod(glob_pdobject, (t_method)glob_dsp,
         gensym("dsp"), A_GIMME, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_dspthreads,
+        gensym("dsp-threads"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_dspfuse,
+        gensym("dsp-fuse"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_dspprofile,
+        gensym("dsp-profile"), A_GIMME, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_msgprofile,
+        gensym("msg-profile"), A_GIMME, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_dspsimd,
+        gensym("dsp-simd"), A_DEFSYM, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_dspsimdbench,
+        gensym("dsp-simd-bench"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_ugen_printstate,
+        gensym("dsp-printstate"), A_GIMME, 0);
     class_addmethod(glob_pdobject, (t_method)glob_key,
         gensym("key"), A_GIMME, 0);
     class_addmethod(glob_pdobject, (t_method)glob_audiostatus,
@@ -207,6 +242,34 @@ void glob_init(void)
         gensym("help-intro"), A_GIMME, 0);
     class_addmethod(glob_pdobject, (t_method)glob_fastforward,
          gensym("fast-forward"), A_FLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_clockbench,
+        gensym("clock-bench"), A_DEFFLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_schedtimeline,
+        gensym("sched-timeline"), A_GIMME, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_messqueuestats,
+        gensym("messqueue-stats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_bench,
+        gensym("bench"), A_GIMME, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_messqueuepolicy,
+        gensym("messqueue-policy"), A_SYMBOL, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_methodbench,
+        gensym("method-bench"), A_DEFFLOAT, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_symtabstats,
+        gensym("symtab-stats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_memstats,
+        gensym("mem-stats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_parsebench,
+        gensym("parse-bench"), A_GIMME, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_patchcachedir,
+        gensym("patch-cache-dir"), A_DEFSYM, 0);
+    class_addmethod(glob_pdobject, (t_method)glob_patchcachestats,
+        gensym("patch-cache-stats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_patchcacheclear,
+        gensym("patch-cache-clear"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_pathcachestats,
+        gensym("path-cache-stats"), 0);
+    class_addmethod(glob_pdobject, (t_method)glob_pathcacheclear,
+        gensym("path-cache-clear"), 0);
     class_addmethod(glob_pdobject, (t_method)glob_settracing,
          gensym("set-tracing"), A_FLOAT, 0);
     class_addmethod(glob_pdobject, (t_method)glob_watchdog,
@@ -18,6 +18,13 @@ typedef struct _methodentry
     unsigned char me_arg[MAXPDARG+1];
 } t_methodentry;
 
+    /* hash table from selector to method, for classes with many methods */
+typedef struct _methodhash
+{
+    int *mh_vec;        /* index into the method list, or -1 if empty */
+    int mh_size;        /* size of mh_vec (a power of 2), or 0 if none */
+} t_methodhash;
+
 EXTERN_STRUCT _widgetbehavior;
 
 typedef void (*t_bangmethod)(t_pd *x);
@@ -72,11 +79,15 @@ struct _class
     unsigned int c_multichannel:1;      /* can deal with multichannel sigs */
     unsigned int c_nopromotesig:1;      /* don't promote scalars to signals */
     unsigned int c_nopromoteleft:1;     /* not even the main (left) inlet */
+    unsigned int c_dspshared:1;         /* perform routine uses shared state */
+    unsigned int c_dsplinked:1;         /* dsp method finds others by name */
     t_classfreefn c_classfreefn;        /* function to call before freeing class */
 #ifdef PDINSTANCE
     t_class_data *c_data;               /* per-instance data */
+    t_methodhash *c_methodhash;         /* per-instance hash of c_methods */
 #else
     t_class_data c_data;
+    t_methodhash c_methodhash;
 #endif
 };
 
@@ -98,7 +109,14 @@ EXTERN t_outconnect *obj_connect(t_object *source, int outno,
     t_object *sink, int inno);
 EXTERN void obj_disconnect(t_object *source, int outno, t_object *sink,
     int inno);
+    /* the same for a connection in the glist "gl", so that only what's
+    affected is sorted again if it's a signal connection */
+EXTERN t_outconnect *obj_glistconnect(t_object *source, int outno,
+    t_object *sink, int inno, t_glist *gl);
+EXTERN void obj_glistdisconnect(t_object *source, int outno, t_object *sink,
+    int inno, t_glist *gl);
 EXTERN void outlet_setstacklim(void);
+EXTERN void msgprofile_objfree(t_object *x, t_symbol *canvasname);
 EXTERN int obj_issignalinlet(const t_object *x, int m);
 EXTERN int obj_issignaloutlet(const t_object *x, int m);
 EXTERN int obj_nsiginlets(const t_object *x);
@@ -113,7 +131,7 @@ void pd_globalunlock(void);
 
 /* misc */
 #ifndef SYMTABHASHSIZE  /* set this to, say, 1024 for small memory footprint */
-#define SYMTABHASHSIZE 16384
+#define SYMTABHASHSIZE 16384    /* initial size; the table grows as needed */
 #endif /* SYMTABHASHSIZE */
 
 EXTERN t_pd *glob_evalfile(t_pd *ignore, t_symbol *name, t_symbol *dir);
@@ -5,20 +5,27 @@
 #include <stdlib.h>
 #include <string.h>
 #include "m_pd.h"
+#include "s_stuff.h"
+#include "m_private_utils.h"
 #if (defined LOUD) || (defined DEBUGMEM)
 # include <stdio.h>
 #endif
 
+#ifndef PD_POOLALLOC
+
 /* #define DEBUGMEM */
 #ifdef DEBUGMEM
 static int totalmem = 0;
 #endif
+    /* getbytes() and resizebytes() calls, from any thread */
+static atomic_int mem_nalloc;
 
 void *getbytes(size_t nbytes)
 {
     void *ret;
     if (nbytes < 1) nbytes = 1;
     ret = (void *)calloc(nbytes, 1);
+    atomic_int_fetch_add(&mem_nalloc, 1);
 #ifdef LOUD
     fprintf(stderr, "new  %lx %d\n", (int)ret, nbytes);
 #endif /* LOUD */
@@ -30,26 +37,13 @@ void *getbytes(size_t nbytes)
     return (ret);
 }
 
-void *getzbytes(size_t nbytes)  /* obsolete name */
-{
-    return (getbytes(nbytes));
-}
-
-void *copybytes(const void *src, size_t nbytes)
-{
-    void *ret;
-    ret = getbytes(nbytes);
-    if (nbytes && ret)
-        memcpy(ret, src, nbytes);
-    return (ret);
-}
-
 void *resizebytes(void *old, size_t oldsize, size_t newsize)
 {
     void *ret;
     if (newsize < 1) newsize = 1;
     if (oldsize < 1) oldsize = 1;
     ret = (void *)realloc((char *)old, newsize);
+    atomic_int_fetch_add(&mem_nalloc, 1);
     if (newsize > oldsize && ret)
         memset(((char *)ret) + oldsize, 0, newsize - oldsize);
 #ifdef LOUD
@@ -76,9 +70,364 @@ void freebytes(void *fatso, size_t nbytes)
     free(fatso);
 }
 
+t_mempool *mempool_new(void) { return (0); }
+void mempool_retire(t_mempool *x) {}
+
+    /* number of allocations so far, for "pd bench".  The count wraps at
+    2^32, so only differences between two calls mean anything. */
+size_t mempool_nalloc(void)
+{
+    return ((unsigned int)atomic_int_load(&mem_nalloc));
+}
+
+void glob_memstats(void *dummy)
+{
+    post("memory: using the C library's allocator "
+        "(configure with --enable-pool-allocator for statistics)");
+}
+
 #ifdef DEBUGMEM
 void glob_foo(void *dummy, t_symbol *s, int argc, t_atom *argv)
 {
     fprintf(stderr, "total mem %d\n", totalmem);
 }
 #endif
+
+#else /* PD_POOLALLOC */
+
+/* The pool allocator, selected with "configure --enable-pool-allocator".
+Each Pd instance gets a pool from which blocks of up to 512 bytes (the
+objects, inlets, outlets, connections, symbols and so on that make up a
+patch) are carved out of 16K "slabs", one size class per slab, and
+recycled through a free list per size class.  Bigger blocks, and blocks
+asked for when there's no current instance, come from the C library.
+
+Every block starts with a 16-byte header saying where it came from, so
+that it can be freed (or resized) no matter which instance or thread is
+current, and no matter what size the caller thinks it is.  When an
+instance is freed its pool is "retired": empty slabs are released at
+once, and the rest as their last blocks are freed. */
+
+#include <pthread.h>
+
+#define MEMALIGN 16         /* alignment and size class granularity */
+#define MEMNCLASS 32        /* so the biggest class is 512 bytes */
+#define MEMSLABSIZE 16384
+
+typedef union _memhdr
+{
+    struct
+    {
+        void *h_owner;      /* slab, or pool (or 0) if from the C library */
+        size_t h_size;      /* size if from the C library, else 0 */
+    } h;
+    char h_pad[MEMALIGN];
+} t_memhdr;
+
+typedef struct _memslab
+{
+    t_mempool *s_pool;
+    struct _memslab *s_next;
+    int s_class;
+    int s_nlive;            /* number of blocks in use */
+} t_memslab;
+
+#define MEMSLABHEAD \
+    ((sizeof(t_memslab) + MEMALIGN - 1) & ~(size_t)(MEMALIGN - 1))
+#define MEMCLASSSIZE(c) (((c) + 1) * MEMALIGN)   /* including header */
+
+struct _mempool
+{
+    pthread_mutex_t p_mutex;
+    t_memslab *p_slabs;
+    t_memhdr *p_free[MEMNCLASS];    /* free blocks of each size class */
+    int p_nslabs;
+    int p_retired;          /* instance is gone; free slabs as they empty */
+    size_t p_nlive;         /* blocks now in use */
+    size_t p_livebytes;     /* bytes in those blocks, headers included */
+    size_t p_nalloc;        /* number of getbytes() calls ever */
+    size_t p_nlarge;        /* blocks now in use from the C library */
+    size_t p_largebytes;
+};
+
+static t_mempool *mempool_current(void)
+{
+#ifdef PDINSTANCE
+    if (!pd_this)
+        return (0);
+#endif
+    return (pd_this->pd_stuff ? pd_this->pd_stuff->st_mempool : 0);
+}
+
+t_mempool *mempool_new(void)
+{
+    t_mempool *x = (t_mempool *)calloc(1, sizeof(*x));
+    if (x)
+        pthread_mutex_init(&x->p_mutex, 0);
+    return (x);
+}
+
+static void mempool_destroy(t_mempool *x)
+{
+    t_memslab *slab, *next;
+    for (slab = x->p_slabs; slab; slab = next)
+        next = slab->s_next, free(slab);
+    pthread_mutex_destroy(&x->p_mutex);
+    free(x);
+}
+
+    /* called when the instance owning the pool is freed */
+void mempool_retire(t_mempool *x)
+{
+    t_memslab **sp;
+    int i, destroy;
+    if (!x)
+        return;
+    pthread_mutex_lock(&x->p_mutex);
+    x->p_retired = 1;
+    for (i = 0; i < MEMNCLASS; i++)
+        x->p_free[i] = 0;
+    for (sp = &x->p_slabs; *sp; )
+    {
+        t_memslab *slab = *sp;
+        if (!slab->s_nlive)
+        {
+            *sp = slab->s_next;
+            free(slab);
+            x->p_nslabs--;
+        }
+        else sp = &slab->s_next;
+    }
+    destroy = (x->p_nlive == 0);
+    pthread_mutex_unlock(&x->p_mutex);
+    if (destroy)
+        mempool_destroy(x);
+}
+
+    /* carve a new slab into free blocks of size class c; pool is locked */
+static int mempool_newslab(t_mempool *x, int c)
+{
+    t_memslab *slab = (t_memslab *)malloc(MEMSLABSIZE);
+    char *bp, *ep;
+    if (!slab)
+        return (0);
+    slab->s_pool = x;
+    slab->s_class = c;
+    slab->s_nlive = 0;
+    slab->s_next = x->p_slabs;
+    x->p_slabs = slab;
+    x->p_nslabs++;
+    for (bp = (char *)slab + MEMSLABHEAD,
+        ep = (char *)slab + MEMSLABSIZE - MEMCLASSSIZE(c);
+            bp <= ep; bp += MEMCLASSSIZE(c))
+    {
+        t_memhdr *hdr = (t_memhdr *)bp;
+        hdr->h.h_owner = slab;
+        hdr->h.h_size = 0;
+        *(t_memhdr **)(hdr + 1) = x->p_free[c];
+        x->p_free[c] = hdr;
+    }
+    return (1);
+}
+
+static void *getbytes_large(t_mempool *x, size_t nbytes)
+{
+    t_memhdr *hdr = (t_memhdr *)calloc(1, sizeof(t_memhdr) + nbytes);
+    if (!hdr)
+    {
+        post("pd: getbytes() failed -- out of memory");
+        return (0);
+    }
+    hdr->h.h_owner = x;
+    hdr->h.h_size = nbytes;
+    if (x)
+    {
+        pthread_mutex_lock(&x->p_mutex);
+        x->p_nalloc++;
+        x->p_nlive++;
+        x->p_nlarge++;
+        x->p_livebytes += sizeof(t_memhdr) + nbytes;
+        x->p_largebytes += sizeof(t_memhdr) + nbytes;
+        pthread_mutex_unlock(&x->p_mutex);
+    }
+    return (hdr + 1);
+}
+
+void *getbytes(size_t nbytes)
+{
+    t_mempool *x = mempool_current();
+    t_memhdr *hdr;
+    t_memslab *slab;
+    int c;
+    if (nbytes < 1) nbytes = 1;
+    c = (int)((nbytes + sizeof(t_memhdr) - 1) / MEMALIGN);
+    if (!x || c >= MEMNCLASS)
+        return (getbytes_large(x, nbytes));
+    pthread_mutex_lock(&x->p_mutex);
+    if (!x->p_free[c] && (x->p_retired || !mempool_newslab(x, c)))
+    {
+        pthread_mutex_unlock(&x->p_mutex);
+        return (getbytes_large(0, nbytes));
+    }
+    hdr = x->p_free[c];
+    x->p_free[c] = *(t_memhdr **)(hdr + 1);
+    slab = (t_memslab *)hdr->h.h_owner;
+    slab->s_nlive++;
+    x->p_nalloc++;
+    x->p_nlive++;
+    x->p_livebytes += MEMCLASSSIZE(c);
+    pthread_mutex_unlock(&x->p_mutex);
+    memset(hdr + 1, 0, MEMCLASSSIZE(c) - sizeof(t_memhdr));
+    return (hdr + 1);
+}
+
+void freebytes(void *fatso, size_t nbytes)
+{
+    t_memhdr *hdr;
+    t_mempool *x;
+    int destroy = 0;
+    if (!fatso)
+        return;
+    hdr = (t_memhdr *)fatso - 1;
+    if (hdr->h.h_size)  /* from the C library */
+    {
+        if ((x = (t_mempool *)hdr->h.h_owner))
+        {
+            pthread_mutex_lock(&x->p_mutex);
+            x->p_nlive--;
+            x->p_nlarge--;
+            x->p_livebytes -= sizeof(t_memhdr) + hdr->h.h_size;
+            x->p_largebytes -= sizeof(t_memhdr) + hdr->h.h_size;
+            destroy = (x->p_retired && !x->p_nlive);
+            pthread_mutex_unlock(&x->p_mutex);
+        }
+        free(hdr);
+    }
+    else
+    {
+        t_memslab *slab = (t_memslab *)hdr->h.h_owner;
+        x = slab->s_pool;
+        pthread_mutex_lock(&x->p_mutex);
+        slab->s_nlive--;
+        x->p_nlive--;
+        x->p_livebytes -= MEMCLASSSIZE(slab->s_class);
+        if (!x->p_retired)
+        {
+            *(t_memhdr **)(hdr + 1) = x->p_free[slab->s_class];
+            x->p_free[slab->s_class] = hdr;
+        }
+        else if (!slab->s_nlive)
+        {
+            t_memslab **sp;
+            for (sp = &x->p_slabs; *sp != slab; sp = &(*sp)->s_next)
+                ;
+            *sp = slab->s_next;
+            free(slab);
+            x->p_nslabs--;
+        }
+        destroy = (x->p_retired && !x->p_nlive);
+        pthread_mutex_unlock(&x->p_mutex);
+    }
+    if (destroy)
+        mempool_destroy(x);
+}
+
+void *resizebytes(void *old, size_t oldsize, size_t newsize)
+{
+    t_memhdr *hdr;
+    void *ret;
+    size_t size;
+    if (!old)
+        return (getbytes(newsize));
+    if (newsize < 1) newsize = 1;
+    hdr = (t_memhdr *)old - 1;
+    if ((size = hdr->h.h_size))  /* from the C library: just realloc */
+    {
+        t_mempool *x = (t_mempool *)hdr->h.h_owner;
+        if (!(hdr = (t_memhdr *)realloc(hdr, sizeof(t_memhdr) + newsize)))
+        {
+            post("pd: resizebytes() failed -- out of memory");
+            return (0);
+        }
+        hdr->h.h_size = newsize;
+        if (x)
+        {
+            pthread_mutex_lock(&x->p_mutex);
+            x->p_nalloc++;
+            x->p_livebytes += newsize - size;
+            x->p_largebytes += newsize - size;
+            pthread_mutex_unlock(&x->p_mutex);
+        }
+        ret = hdr + 1;
+        size = newsize;
+    }
+    else
+    {
+        size = MEMCLASSSIZE(((t_memslab *)hdr->h.h_owner)->s_class) -
+            sizeof(t_memhdr);
+        if (newsize <= size)    /* still fits */
+            ret = old;
+        else
+        {
+            if (!(ret = getbytes(newsize)))
+                return (0);
+            memcpy(ret, old, (oldsize < size ? oldsize : size));
+            freebytes(old, oldsize);
+            return (ret);
+        }
+    }
+    if (oldsize < 1) oldsize = 1;
+    if (newsize > oldsize && oldsize < size)
+        memset(((char *)ret) + oldsize, 0,
+            (newsize < size ? newsize : size) - oldsize);
+    return (ret);
+}
+
+    /* number of allocations from this instance's pool so far (getbytes(),
+    and resizebytes() if it had to move or grow the block) */
+size_t mempool_nalloc(void)
+{
+    t_mempool *x = mempool_current();
+    size_t n;
+    if (!x)
+        return (0);
+    pthread_mutex_lock(&x->p_mutex);
+    n = x->p_nalloc;
+    pthread_mutex_unlock(&x->p_mutex);
+    return (n);
+}
+
+    /* "pd mem-stats" */
+void glob_memstats(void *dummy)
+{
+    t_mempool *x = mempool_current();
+    if (!x)
+    {
+        post("memory: no pool for this instance");
+        return;
+    }
+    pthread_mutex_lock(&x->p_mutex);
+    post("memory: %lu bytes live in %lu blocks (%lu allocations so far)",
+        (unsigned long)x->p_livebytes, (unsigned long)x->p_nlive,
+            (unsigned long)x->p_nalloc);
+    post("... %lu bytes in %lu blocks from the C library, "
+        "%d slabs of %d bytes", (unsigned long)x->p_largebytes,
+            (unsigned long)x->p_nlarge, x->p_nslabs, MEMSLABSIZE);
+    pthread_mutex_unlock(&x->p_mutex);
+}
+
+#endif /* PD_POOLALLOC */
+
+void *getzbytes(size_t nbytes)  /* obsolete name */
+{
+    return (getbytes(nbytes));
+}
+
+void *copybytes(const void *src, size_t nbytes)
+{
+    void *ret;
+    ret = getbytes(nbytes);
+    if (nbytes && ret)
+        memcpy(ret, src, nbytes);
+    return (ret);
+}
@@ -13,6 +13,8 @@ behavior for "gobjs" appears at the end of this file.  */
 
 #include "m_private_utils.h"
 
+t_symbol *canvas_findownername(t_gobj *y);     /* in g_canvas.c */
+
 #if defined(_MSC_VER)
 #define INLINE __forceinline
 #elif defined(__GNUC__)
@@ -394,6 +396,472 @@ int sched_geteventno(void)
     return (outlet_eventno);
 }
 
+/* ------- message profiler - time spent in messages from each outlet -------
+
+"pd msg-profile 1" makes every outlet_...() call count itself and time how
+long it takes to deliver its message (including everything that message sets
+off) in a calling-context tree: there's a node for each chain of
+(object, selector) pairs the messages went through, so the same outlet
+called from two places gets two nodes.  We keep a stack of the calls in
+progress so that each node also gets the time spent in it minus the time in
+the calls it made ("self" time).  The tree can be printed by source object
+or dumped as "folded stacks" (one line per node, the chain of frames
+separated by semicolons, then the self time in nanoseconds), which
+flamegraph.pl and similar tools read directly.
+
+Nothing here touches the outlets while profiling is off except one test
+per call.  Nodes are labeled with the object's canvas name and box text only
+when they're printed or dumped, since finding the canvas means searching all
+of them.  When an object is freed (see msgprofile_objfree()) its nodes get
+their labels right away and are marked dead, so that another object that
+gets the same address starts new nodes instead of adding to the old ones. */
+
+#define MSGPROF_MAXDEPTH 1024   /* more than STACKITER, so never reached */
+#define MSGPROF_MAXLABEL 60
+
+typedef struct _msgnode
+{
+    t_object *n_owner;      /* the object and selector... */
+    t_symbol *n_sel;
+    int n_parent;           /* ... and the node that sent to it, or -1 */
+    int n_next;             /* next in hash chain, or -1 */
+    int n_ownernext;        /* next in owner hash chain, or -1 */
+    int n_dead;             /* nonzero once the owner has been freed */
+    int n_depth;
+    char *n_label;          /* made when first needed */
+    uint64_t n_count;       /* messages sent */
+    uint64_t n_total;       /* cycles, including the messages they set off */
+    uint64_t n_self;        /* cycles, not counting those */
+} t_msgnode;
+
+typedef struct _msgframe
+{
+    int f_node;
+    uint64_t f_start;
+    uint64_t f_children;    /* cycles in calls made from this one */
+} t_msgframe;
+
+typedef struct _msgprofile
+{
+    int p_on;
+    t_msgnode *p_nodes;
+    int p_nnodes;
+    int p_nodesize;
+    int *p_hash;            /* first node in each chain, or -1 */
+    int *p_ownerhash;       /* same, hashed by owner alone */
+    int p_hashsize;
+    int p_ndead;            /* owners freed so far */
+    t_msgframe p_frames[MSGPROF_MAXDEPTH];
+    int p_depth;
+    int p_maxdepth;         /* deepest we've been */
+    int p_deepest;          /* node we were in then */
+    uint64_t p_startcycles;
+    double p_starttime;
+} t_msgprofile;
+
+static PERTHREAD t_msgprofile *msgprofile;
+static PERTHREAD int msgprofile_on;     /* copy of p_on for the outlets */
+
+#define MSGPROF_HASH(parent, owner, sel, size) \
+    ((((unsigned int)(parent) * 31u) ^ (unsigned int)((size_t)(owner) >> 4) ^ \
+        (unsigned int)((size_t)(sel) >> 3) * 2654435761u) & ((size) - 1))
+#define MSGPROF_OWNERHASH(owner, size) \
+    (((unsigned int)((size_t)(owner) >> 4) * 2654435761u) & ((size) - 1))
+
+static void msgprofile_rehash(t_msgprofile *p, int size)
+{
+    int i;
+    if (p->p_hash)
+    {
+        freebytes(p->p_hash, p->p_hashsize * sizeof(int));
+        freebytes(p->p_ownerhash, p->p_hashsize * sizeof(int));
+    }
+    p->p_hash = (int *)getbytes(size * sizeof(int));
+    p->p_ownerhash = (int *)getbytes(size * sizeof(int));
+    p->p_hashsize = size;
+    for (i = 0; i < size; i++)
+        p->p_hash[i] = p->p_ownerhash[i] = -1;
+    for (i = 0; i < p->p_nnodes; i++)
+    {
+        t_msgnode *n = p->p_nodes + i;
+        int h = MSGPROF_HASH(n->n_parent, n->n_owner, n->n_sel, size);
+        n->n_next = p->p_hash[h];
+        p->p_hash[h] = i;
+        h = MSGPROF_OWNERHASH(n->n_owner, size);
+        n->n_ownernext = p->p_ownerhash[h];
+        p->p_ownerhash[h] = i;
+    }
+}
+
+static void msgprofile_clear(t_msgprofile *p)
+{
+    int i;
+    for (i = 0; i < p->p_nnodes; i++)
+        p->p_nodes[i].n_count = p->p_nodes[i].n_total =
+            p->p_nodes[i].n_self = 0;
+    p->p_maxdepth = 0;
+    p->p_deepest = -1;
+    p->p_startcycles = PD_CYCLES();
+    p->p_starttime = sys_getrealtime();
+}
+
+    /* forget the whole tree; only while no calls are in progress */
+static void msgprofile_reset(t_msgprofile *p)
+{
+    int i;
+    for (i = 0; i < p->p_nnodes; i++)
+        if (p->p_nodes[i].n_label)
+            freebytes(p->p_nodes[i].n_label,
+                strlen(p->p_nodes[i].n_label) + 1);
+    p->p_nnodes = 0;
+    p->p_ndead = 0;
+    msgprofile_rehash(p, 256);
+    msgprofile_clear(p);
+}
+
+    /* label node "k" as "canvas/box text [selector]" */
+static void msgprofile_makelabel(t_msgprofile *p, int k, t_symbol *canvasname)
+{
+    t_msgnode *n = p->p_nodes + k;
+    char *buf = 0, label[MAXPDSTRING], *s;
+    int length = 0, buflength = 0;
+    if (n->n_owner->ob_binbuf)
+        binbuf_gettext(n->n_owner->ob_binbuf, &buf, &buflength);
+    length = buflength;
+    if (length > MSGPROF_MAXLABEL)
+        length = MSGPROF_MAXLABEL;
+    pd_snprintf(label, MAXPDSTRING, "%s/%.*s [%s]",
+        (canvasname ? canvasname->s_name : "?"),
+        length, (length ? buf : class_getname(pd_class(&n->n_owner->ob_pd))),
+        n->n_sel->s_name);
+    if (buf)
+        freebytes(buf, buflength);
+        /* semicolons separate the frames in folded stacks */
+    for (s = label; *s; s++)
+        if (*s == ';' || *s == '\n')
+            *s = ',';
+    n->n_label = (char *)getbytes(strlen(label) + 1);
+    strcpy(n->n_label, label);
+}
+
+static const char *msgprofile_label(t_msgprofile *p, int k)
+{
+    if (!p->p_nodes[k].n_label)
+        msgprofile_makelabel(p, k,
+            canvas_findownername(&p->p_nodes[k].n_owner->ob_g));
+    return (p->p_nodes[k].n_label);
+}
+
+static int msgprofile_newnode(t_msgprofile *p, int parent, t_object *owner,
+    t_symbol *sel)
+{
+    t_msgnode *n;
+    int h;
+    if (p->p_nnodes == p->p_nodesize)
+    {
+        int newsize = (p->p_nodesize ? 2 * p->p_nodesize : 256);
+        p->p_nodes = (t_msgnode *)resizebytes(p->p_nodes,
+            p->p_nodesize * sizeof(t_msgnode), newsize * sizeof(t_msgnode));
+        p->p_nodesize = newsize;
+    }
+    if (2 * p->p_nnodes >= p->p_hashsize)
+        msgprofile_rehash(p, 2 * p->p_hashsize);
+    n = p->p_nodes + p->p_nnodes;
+    n->n_owner = owner;
+    n->n_sel = sel;
+    n->n_parent = parent;
+    n->n_dead = 0;
+    n->n_depth = (parent >= 0 ? p->p_nodes[parent].n_depth + 1 : 1);
+    n->n_label = 0;
+    n->n_count = n->n_total = n->n_self = 0;
+    h = MSGPROF_HASH(parent, owner, sel, p->p_hashsize);
+    n->n_next = p->p_hash[h];
+    p->p_hash[h] = p->p_nnodes;
+    h = MSGPROF_OWNERHASH(owner, p->p_hashsize);
+    n->n_ownernext = p->p_ownerhash[h];
+    p->p_ownerhash[h] = p->p_nnodes;
+    return (p->p_nnodes++);
+}
+
+    /* called as object "x" is freed, with the name of the canvas it's in if
+    the caller knows it; otherwise we search for it if we need it */
+void msgprofile_objfree(t_object *x, t_symbol *canvasname)
+{
+    t_msgprofile *p = msgprofile;
+    int k, dead = 0;
+    if (!p)
+        return;
+    for (k = p->p_ownerhash[MSGPROF_OWNERHASH(x, p->p_hashsize)];
+        k >= 0; k = p->p_nodes[k].n_ownernext)
+    {
+        t_msgnode *n = p->p_nodes + k;
+        if (n->n_owner != x || n->n_dead)
+            continue;
+        if (!dead)
+        {
+            dead = ++p->p_ndead;
+            if (!canvasname)
+                canvasname = canvas_findownername(&x->ob_g);
+        }
+        if (!n->n_label)
+            msgprofile_makelabel(p, k, canvasname);
+        n->n_dead = dead;
+    }
+}
+
+    /* called as an outlet starts sending; returns zero if we aren't
+    keeping track of this call */
+static int msgprofile_enter(t_outlet *x, t_symbol *sel)
+{
+    t_msgprofile *p = msgprofile;
+    t_object *owner = x->o_owner;
+    t_msgframe *f;
+    int parent, k;
+    if (p->p_depth >= MSGPROF_MAXDEPTH)
+        return (0);
+    parent = (p->p_depth ? p->p_frames[p->p_depth - 1].f_node : -1);
+    for (k = p->p_hash[MSGPROF_HASH(parent, owner, sel, p->p_hashsize)];
+        k >= 0; k = p->p_nodes[k].n_next)
+            if (p->p_nodes[k].n_owner == owner && p->p_nodes[k].n_sel == sel &&
+                p->p_nodes[k].n_parent == parent && !p->p_nodes[k].n_dead)
+                    break;
+    if (k < 0)
+        k = msgprofile_newnode(p, parent, owner, sel);
+    f = p->p_frames + p->p_depth++;
+    if (p->p_depth > p->p_maxdepth)
+        p->p_maxdepth = p->p_depth, p->p_deepest = k;
+    f->f_node = k;
+    f->f_children = 0;
+    f->f_start = PD_CYCLES();
+    return (1);
+}
+
+static void msgprofile_leave(void)
+{
+    t_msgprofile *p = msgprofile;
+    t_msgframe *f = p->p_frames + --p->p_depth;
+    t_msgnode *n = p->p_nodes + f->f_node;
+    uint64_t elapsed = PD_CYCLES() - f->f_start;
+    n->n_count++;
+    n->n_total += elapsed;
+    n->n_self += elapsed - f->f_children;
+    if (p->p_depth)
+        p->p_frames[p->p_depth - 1].f_children += elapsed;
+}
+
+#define MSGPROF_ENTER(x, sel) \
+    int profiled = (msgprofile_on && msgprofile_enter(x, sel))
+#define MSGPROF_LEAVE() \
+    if (profiled) msgprofile_leave()
+
+static double msgprofile_rate(t_msgprofile *p)
+{
+    double elapsed = sys_getrealtime() - p->p_starttime;
+    uint64_t cycles = PD_CYCLES() - p->p_startcycles;
+    return (elapsed > 0 && cycles ? cycles / elapsed : 1e9);
+}
+
+    /* is there a node above "k" for the same object and selector?  Then
+    k's total time is already in that one's. */
+static int msgprofile_isrecursive(t_msgprofile *p, int k)
+{
+    t_msgnode *n = p->p_nodes + k;
+    int j;
+    for (j = n->n_parent; j >= 0; j = p->p_nodes[j].n_parent)
+        if (p->p_nodes[j].n_owner == n->n_owner &&
+            p->p_nodes[j].n_sel == n->n_sel &&
+            p->p_nodes[j].n_dead == n->n_dead)
+                return (1);
+    return (0);
+}
+
+typedef struct _msgsum
+{
+    t_object *s_owner;
+    t_symbol *s_sel;
+    int s_dead;
+    int s_node;             /* first node, for the label */
+    uint64_t s_count;
+    uint64_t s_total;
+    uint64_t s_self;
+} t_msgsum;
+
+static int msgprofile_cmpkey(const void *a, const void *b)
+{
+    const t_msgsum *x = (const t_msgsum *)a, *y = (const t_msgsum *)b;
+    if (x->s_owner != y->s_owner)
+        return ((size_t)x->s_owner < (size_t)y->s_owner ? -1 : 1);
+    if (x->s_sel != y->s_sel)
+        return ((size_t)x->s_sel < (size_t)y->s_sel ? -1 : 1);
+    if (x->s_dead != y->s_dead)
+        return (x->s_dead - y->s_dead);
+    return (x->s_node - y->s_node);
+}
+
+static int msgprofile_cmptotal(const void *a, const void *b)
+{
+    const t_msgsum *x = (const t_msgsum *)a, *y = (const t_msgsum *)b;
+    return (x->s_total < y->s_total ? 1 : (x->s_total > y->s_total ? -1 :
+        x->s_node - y->s_node));
+}
+
+#define MSGPROF_SAME(p, a, b) \
+    ((p)->p_nodes[a].n_owner == (p)->p_nodes[b].n_owner && \
+        (p)->p_nodes[a].n_sel == (p)->p_nodes[b].n_sel && \
+        (p)->p_nodes[a].n_dead == (p)->p_nodes[b].n_dead)
+
+    /* post the chain of messages that led to node "k".  Loops show up as
+    the same few frames over and over, so we post those only once. */
+static void msgprofile_postchain(t_msgprofile *p, int k)
+{
+    int chain[MSGPROF_MAXDEPTH], n = 0, i, j, k2;
+    for (k2 = k; k2 >= 0 && n < MSGPROF_MAXDEPTH; k2 = p->p_nodes[k2].n_parent)
+        n++;
+    for (i = n; i--; k = p->p_nodes[k].n_parent)
+        chain[i] = k;
+    for (i = 0; i < n; )
+    {
+        int period, bestperiod = 1, bestrepeat = 1;
+        for (period = 1; period <= 8; period++)
+        {
+            int repeat = 1;
+            while (i + (repeat + 1) * period <= n)
+            {
+                for (j = 0; j < period; j++)
+                    if (!MSGPROF_SAME(p, chain[i + j],
+                        chain[i + repeat * period + j]))
+                            break;
+                if (j < period)
+                    break;
+                repeat++;
+            }
+            if (repeat > 1 && repeat * period > bestrepeat * bestperiod)
+                bestperiod = period, bestrepeat = repeat;
+        }
+        if (bestrepeat > 1)
+        {
+            post("    %d times:", bestrepeat);
+            for (j = 0; j < bestperiod; j++)
+                post("        %s", msgprofile_label(p, chain[i + j]));
+            i += bestrepeat * bestperiod;
+        }
+        else post("    %s", msgprofile_label(p, chain[i++]));
+    }
+}
+
+static void msgprofile_print(t_msgprofile *p, int nprint)
+{
+    t_msgsum *sums;
+    double usec = 1e6 / msgprofile_rate(p),
+        elapsed = sys_getrealtime() - p->p_starttime;
+    int i, n;
+    if (!p->p_nnodes)
+    {
+        post("message profile: no messages yet");
+        return;
+    }
+    sums = (t_msgsum *)getbytes(p->p_nnodes * sizeof(*sums));
+    for (i = 0; i < p->p_nnodes; i++)
+    {
+        t_msgnode *nd = p->p_nodes + i;
+        sums[i].s_owner = nd->n_owner;
+        sums[i].s_sel = nd->n_sel;
+        sums[i].s_dead = nd->n_dead;
+        sums[i].s_node = i;
+        sums[i].s_count = nd->n_count;
+        sums[i].s_self = nd->n_self;
+        sums[i].s_total = (msgprofile_isrecursive(p, i) ? 0 : nd->n_total);
+    }
+        /* merge the nodes for each object and selector */
+    qsort(sums, p->p_nnodes, sizeof(*sums), msgprofile_cmpkey);
+    for (i = 1, n = 0; i < p->p_nnodes; i++)
+    {
+        if (sums[i].s_owner == sums[n].s_owner &&
+            sums[i].s_sel == sums[n].s_sel && sums[i].s_dead == sums[n].s_dead)
+        {
+            sums[n].s_count += sums[i].s_count;
+            sums[n].s_total += sums[i].s_total;
+            sums[n].s_self += sums[i].s_self;
+        }
+        else sums[++n] = sums[i];
+    }
+    n++;
+    qsort(sums, n, sizeof(*sums), msgprofile_cmptotal);
+    post("message profile over %.2f seconds (usec in total and in self, "
+        "messages):", elapsed);
+    for (i = 0; i < n && i < nprint; i++)
+        if (sums[i].s_count)
+            post("%12.1f %12.1f %10lu  %s", sums[i].s_total * usec,
+                sums[i].s_self * usec, (unsigned long)sums[i].s_count,
+                    msgprofile_label(p, sums[i].s_node));
+    freebytes(sums, p->p_nnodes * sizeof(*sums));
+    if (p->p_deepest >= 0)
+    {
+        post("deepest chain of messages (%d):", p->p_maxdepth);
+        msgprofile_postchain(p, p->p_deepest);
+    }
+}
+
+    /* write folded stacks: the chain of frames, then self time in ns */
+static void msgprofile_dump(t_msgprofile *p, const char *filename)
+{
+    FILE *fd;
+    double nsec = 1e9 / msgprofile_rate(p);
+    int i, chain[MSGPROF_MAXDEPTH];
+    if (!(fd = sys_fopen(filename, "w")))
+    {
+        pd_error(0, "%s: can't create", filename);
+        return;
+    }
+    for (i = 0; i < p->p_nnodes; i++)
+    {
+        int n = 0, k;
+        if (!p->p_nodes[i].n_count)
+            continue;
+        for (k = i; k >= 0 && n < MSGPROF_MAXDEPTH; k = p->p_nodes[k].n_parent)
+            chain[n++] = k;
+        while (n--)
+            fprintf(fd, "%s%c", msgprofile_label(p, chain[n]), (n ? ';' : ' '));
+        fprintf(fd, "%.0f\n", p->p_nodes[i].n_self * nsec);
+    }
+    sys_fclose(fd);
+}
+
+    /* "msg-profile 1" (or 0) to start (or stop), "msg-profile print [n]"
+    for the n busiest objects, "msg-profile dump file" for folded stacks,
+    "msg-profile clear" to start counting again. */
+void glob_msgprofile(void *dummy, t_symbol *s, int argc, t_atom *argv)
+{
+    t_msgprofile *p = msgprofile;
+    t_symbol *what = atom_getsymbolarg(0, argc, argv);
+    if (argc && argv->a_type == A_FLOAT)
+    {
+        int on = (argv->a_w.w_float != 0);
+        if (on && !p)
+        {
+            p = msgprofile = (t_msgprofile *)getbytes(sizeof(*p));
+            msgprofile_reset(p);
+        }
+        if (!p || on == p->p_on)
+            return;
+            /* starting again: throw the old tree out if we can */
+        if (on && !p->p_depth)
+            msgprofile_reset(p);
+        else if (on)
+            msgprofile_clear(p);
+        p->p_on = msgprofile_on = on;
+    }
+    else if (!p)
+        pd_error(0, "msg-profile: not started (send 'msg-profile 1')");
+    else if (!argc || what == gensym("print"))
+        msgprofile_print(p, (argc > 1 ? atom_getfloatarg(1, argc, argv) : 20));
+    else if (what == gensym("dump") && argc > 1)
+        msgprofile_dump(p, atom_getsymbolarg(1, argc, argv)->s_name);
+    else if (what == gensym("clear"))
+        msgprofile_clear(p);
+    else pd_error(0, "msg-profile: unknown argument '%s'", what->s_name);
+}
+
     /* get pointer to connection list for an outlet (for editing/traversing) */
 static t_outconnect **outlet_getconnectionpointer(t_outlet *x)
 {
@@ -575,18 +1043,21 @@ static void outlet_stackerror(t_outlet *x)
 void outlet_bang(t_outlet *x)
 {
     t_outconnect *oc;
+    MSGPROF_ENTER(x, &s_bang);
     if(!stackcount_add())
         outlet_stackerror(x);
     else
         for (oc = x->o_connections; oc; oc = oc->oc_next)
             pd_bang(oc->oc_to);
     stackcount_release();
+    MSGPROF_LEAVE();
 }
 
 void outlet_pointer(t_outlet *x, t_gpointer *gp)
 {
     t_outconnect *oc;
     t_gpointer gpointer;
+    MSGPROF_ENTER(x, &s_pointer);
     if(!stackcount_add())
         outlet_stackerror(x);
     else
@@ -596,50 +1067,59 @@ void outlet_pointer(t_outlet *x, t_gpointer *gp)
             pd_pointer(oc->oc_to, &gpointer);
     }
     stackcount_release();
+    MSGPROF_LEAVE();
 }
 
 void outlet_float(t_outlet *x, t_float f)
 {
     t_outconnect *oc;
+    MSGPROF_ENTER(x, &s_float);
     if(!stackcount_add())
         outlet_stackerror(x);
     else
         for (oc = x->o_connections; oc; oc = oc->oc_next)
             pd_float(oc->oc_to, f);
     stackcount_release();
+    MSGPROF_LEAVE();
 }
 
 void outlet_symbol(t_outlet *x, t_symbol *s)
 {
     t_outconnect *oc;
+    MSGPROF_ENTER(x, &s_symbol);
     if(!stackcount_add())
         outlet_stackerror(x);
     else
         for (oc = x->o_connections; oc; oc = oc->oc_next)
             pd_symbol(oc->oc_to, s);
     stackcount_release();
+    MSGPROF_LEAVE();
 }
 
 void outlet_list(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
 {
     t_outconnect *oc;
+    MSGPROF_ENTER(x, s);
     if(!stackcount_add())
         outlet_stackerror(x);
     else
         for (oc = x->o_connections; oc; oc = oc->oc_next)
             pd_list(oc->oc_to, s, argc, argv);
     stackcount_release();
+    MSGPROF_LEAVE();
 }
 
 void outlet_anything(t_outlet *x, t_symbol *s, int argc, t_atom *argv)
 {
     t_outconnect *oc;
+    MSGPROF_ENTER(x, s);
     if(!stackcount_add())
         outlet_stackerror(x);
     else
         for (oc = x->o_connections; oc; oc = oc->oc_next)
             typedmess(oc->oc_to, s, argc, argv);
     stackcount_release();
+    MSGPROF_LEAVE();
 }
 
     /* get the outlet's declared symbol */
@@ -662,11 +1142,22 @@ void outlet_free(t_outlet *x)
     t_freebytes(x, sizeof(*x));
 }
 
+void canvas_update_dsp_local(t_glist *x);   /* in g_canvas.c */
+
+    /* a signal connection was made or broken.  If the caller told us which
+    glist it's in, only that part of the DSP chain has to be sorted again. */
+static void obj_updatedsp(t_glist *gl)
+{
+    if (gl)
+        canvas_update_dsp_local(gl);
+    else canvas_update_dsp();
+}
+
     /* connect an outlet of one object to an inlet of another.  The receiving
     "pd" is usually a patchable object, but this may be used to add a
     non-patchable pd to an outlet by specifying the 0th inlet. */
-t_outconnect *obj_connect(t_object *source, int outno,
-    t_object *sink, int inno)
+t_outconnect *obj_glistconnect(t_object *source, int outno,
+    t_object *sink, int inno, t_glist *gl)
 {
     t_inlet *i;
     t_outlet *o;
@@ -702,12 +1193,19 @@ doit:
         oc2->oc_next = oc;
     }
     else *ochead = oc;
-    if (o->o_sym == &s_signal) canvas_update_dsp();
+    if (o->o_sym == &s_signal) obj_updatedsp(gl);
 
     return (oc);
 }
 
-void obj_disconnect(t_object *source, int outno, t_object *sink, int inno)
+t_outconnect *obj_connect(t_object *source, int outno,
+    t_object *sink, int inno)
+{
+    return (obj_glistconnect(source, outno, sink, inno, 0));
+}
+
+void obj_glistdisconnect(t_object *source, int outno, t_object *sink,
+    int inno, t_glist *gl)
 {
     t_inlet *i;
     t_outlet *o;
@@ -748,7 +1246,12 @@ doit:
         oc = oc2;
     }
 done:
-    if (o->o_sym == &s_signal) canvas_update_dsp();
+    if (o->o_sym == &s_signal) obj_updatedsp(gl);
+}
+
+void obj_disconnect(t_object *source, int outno, t_object *sink, int inno)
+{
+    obj_glistdisconnect(source, outno, sink, inno, 0);
 }
 
 /* ------ traversal routines for code that can't see our structures ------ */
@@ -36,6 +36,7 @@ void pd_free(t_pd *x)
     if (c->c_freemethod) (*(t_freemethod)(c->c_freemethod))(x);
     if (c->c_patchable)
     {
+        msgprofile_objfree((t_object *)x, 0);
         while (((t_object *)x)->ob_outlet)
             outlet_free(((t_object *)x)->ob_outlet);
         while (((t_object *)x)->ob_inlet)
@@ -56,98 +57,250 @@ void gobj_save(t_gobj *x, t_binbuf *b)
 /* deal with several objects bound to the same symbol.  If more than one, we
 actually bind a collection object to the symbol, which forwards messages sent
 to the symbol.
-CHR: We make a copy of the bindlist before messaging, so we can safely unbind
-symbols while iterating over the bindlist. We only allocate on the stack up
-to a certain limit, above whiche we switch to heap allocation. */
 
-static PERTHREAD int stackcount = 0;
+The receivers are kept oldest first in a vector that we walk backward, so
+that the most recently bound object gets the message first (this has always
+been the order and patches depend on it.)  Unbinding leaves a hole which
+is skipped; once more than half the slots are holes we squeeze them out.
+Bigger lists also get a hash table from receiver to slot so that unbinding
+doesn't have to search.  Both binding and unbinding are thus O(1) on
+average.
 
-#define MAXSTACKSIZE 1024
+The vector is copy-on-write: a message being sent holds a reference to it,
+and if a receiver binds or unbinds something on the same symbol meanwhile,
+that change goes to a fresh copy.  So each message goes to exactly the
+receivers that were bound when it was sent, as it did when we used to copy
+the whole list for each message, and the list can even be freed under us. */
 
-#if DONT_USE_ALLOCA
-#define BINDLIST_ALLOCA(x, n) ((x) = (t_pd **)getbytes((n) * sizeof(t_pd *)))
-#define BINDLIST_FREEA(x, n) (freebytes((x), (n) * sizeof(t_pd *)))
-#else
-#define BINDLIST_ALLOCA(x, n) ((x) = (t_pd **)(stackcount <= MAXSTACKSIZE ?  \
-    alloca((n) * sizeof(t_pd *)) : getbytes((n) * sizeof(t_pd *))))
-#define BINDLIST_FREEA(x, n) ( \
-    (stackcount <= MAXSTACKSIZE || (freebytes((x), (n) * sizeof(t_pd *)), 0)))
-#endif
+static t_class *bindlist_class;
 
-#define BINDLIST_PUSH(x, vec, n) stackcount += n; \
-    BINDLIST_ALLOCA(vec, n); memcpy(vec, x->b_vec, n * sizeof(t_pd *));
+typedef struct _bindvec
+{
+    int bv_refcount;        /* the bindlist plus any messages being sent */
+    int bv_n;               /* slots in use, including holes */
+    int bv_size;            /* slots allocated */
+    t_pd *bv_vec[1];        /* oldest first; holes are zero */
+} t_bindvec;
 
-#define BINDLIST_POP(vec, n) BINDLIST_FREEA(vec, n); stackcount -= n
+#define BINDVEC_BYTES(n) (sizeof(t_bindvec) + ((n) - 1) * sizeof(t_pd *))
 
-static t_class *bindlist_class;
+    /* lists up to this long are searched instead of hashed */
+#define BINDLIST_MAXSEARCH 16
 
 typedef struct _bindlist
 {
     t_pd b_pd;
-    t_pd **b_vec;
-    int b_n;
+    t_bindvec *b_vec;
+    int b_nbound;           /* slots that aren't holes */
+    int b_hashsize;         /* zero, or a power of 2 more than 2 * bv_size */
+    int b_hashused;         /* entries in b_hash that aren't empty */
+    int *b_hash;            /* slot + 1, or 0 if empty, or -1 if deleted */
 } t_bindlist;
 
+#define BINDLIST_HASH(x, size) \
+    (((unsigned int)((size_t)(x) >> 4) * 2654435761u) & ((size) - 1))
+
+static t_bindvec *bindvec_new(int size)
+{
+    t_bindvec *v = (t_bindvec *)getbytes(BINDVEC_BYTES(size));
+    v->bv_refcount = 1;
+    v->bv_n = 0;
+    v->bv_size = size;
+    return (v);
+}
+
+static void bindvec_release(t_bindvec *v)
+{
+    if (!--v->bv_refcount)
+        freebytes(v, BINDVEC_BYTES(v->bv_size));
+}
+
+    /* get a vector with room for "size" slots that we can change without
+    disturbing any message being sent.  If "squeeze" is set, also get rid of
+    the holes.  The hash table has to be rebuilt if slots move or if it's
+    getting too full; we just rebuild it whenever we're called. */
+static void bindlist_resize(t_bindlist *x, int size, int squeeze)
+{
+    t_bindvec *v = x->b_vec, *newv;
+    int i, hashsize;
+    if (v->bv_refcount > 1 || size != v->bv_size || squeeze)
+    {
+        newv = bindvec_new(size);
+        for (i = 0; i < v->bv_n; i++)
+            if (v->bv_vec[i] || !squeeze)
+                newv->bv_vec[newv->bv_n++] = v->bv_vec[i];
+        bindvec_release(v);
+        x->b_vec = v = newv;
+    }
+    if (x->b_hash)
+        freebytes(x->b_hash, x->b_hashsize * sizeof(int));
+    x->b_hash = 0;
+    x->b_hashsize = x->b_hashused = 0;
+    if (v->bv_size > BINDLIST_MAXSEARCH)
+    {
+        for (hashsize = 2 * BINDLIST_MAXSEARCH; hashsize <= 2 * v->bv_size; )
+            hashsize *= 2;
+        x->b_hash = (int *)getbytes(hashsize * sizeof(int));
+        x->b_hashsize = hashsize;
+        for (i = 0; i < v->bv_n; i++)
+            if (v->bv_vec[i])
+        {
+            int h = BINDLIST_HASH(v->bv_vec[i], hashsize);
+            while (x->b_hash[h])
+                h = (h + 1) & (hashsize - 1);
+            x->b_hash[h] = i + 1;
+            x->b_hashused++;
+        }
+    }
+}
+
+static t_bindlist *bindlist_new(t_pd *x1, t_pd *x2)
+{
+    t_bindlist *b = (t_bindlist *)pd_new(bindlist_class);
+    b->b_vec = bindvec_new(4);
+    b->b_vec->bv_vec[0] = x1;
+    b->b_vec->bv_vec[1] = x2;
+    b->b_vec->bv_n = b->b_nbound = 2;
+    b->b_hash = 0;
+    b->b_hashsize = b->b_hashused = 0;
+    return (b);
+}
+
+static void bindlist_free(t_bindlist *x)
+{
+    bindvec_release(x->b_vec);
+    if (x->b_hash)
+        freebytes(x->b_hash, x->b_hashsize * sizeof(int));
+    pd_free(&x->b_pd);
+}
+
+    /* add a receiver, which will be the first to get messages */
+static void bindlist_add(t_bindlist *x, t_pd *y)
+{
+    t_bindvec *v = x->b_vec;
+    int slot;
+    if (v->bv_n == v->bv_size)
+        bindlist_resize(x,
+            2 * x->b_nbound > v->bv_size ? 2 * v->bv_size : v->bv_size, 1);
+    else if (v->bv_refcount > 1)
+        bindlist_resize(x, v->bv_size, 0);
+    v = x->b_vec;
+    slot = v->bv_n++;
+    v->bv_vec[slot] = y;
+    x->b_nbound++;
+    if (x->b_hash)
+    {
+        int h = BINDLIST_HASH(y, x->b_hashsize);
+        while (x->b_hash[h] > 0)
+            h = (h + 1) & (x->b_hashsize - 1);
+        if (!x->b_hash[h])
+            x->b_hashused++;
+        x->b_hash[h] = slot + 1;
+            /* too many deleted entries: clean them out */
+        if (x->b_hashused > 3 * (x->b_hashsize / 4))
+            bindlist_resize(x, v->bv_size, 0);
+    }
+}
+
+    /* find the slot of the most recent binding of y, or -1.  If "hashp" is
+    given, also return where it is in the hash table. */
+static int bindlist_find(t_bindlist *x, t_pd *y, int *hashp)
+{
+    t_bindvec *v = x->b_vec;
+    int slot = -1;
+    if (x->b_hash)
+    {
+        int h = BINDLIST_HASH(y, x->b_hashsize), k;
+        for (; (k = x->b_hash[h]); h = (h + 1) & (x->b_hashsize - 1))
+            if (k > 0 && v->bv_vec[k - 1] == y && k - 1 > slot)
+        {
+            slot = k - 1;
+            if (hashp)
+                *hashp = h;
+        }
+    }
+    else
+    {
+        for (slot = v->bv_n; slot--; )
+            if (v->bv_vec[slot] == y)
+                break;
+    }
+    return (slot);
+}
+
+    /* take out a receiver; return zero if it wasn't there */
+static int bindlist_remove(t_bindlist *x, t_pd *y)
+{
+    t_bindvec *v;
+    int hash = -1, slot = bindlist_find(x, y, &hash);
+    if (slot < 0)
+        return (0);
+    if (x->b_vec->bv_refcount > 1)
+    {
+        bindlist_resize(x, x->b_vec->bv_size, 0);
+        hash = -1;
+    }
+    v = x->b_vec;
+    v->bv_vec[slot] = 0;
+    x->b_nbound--;
+    if (x->b_hash)
+    {
+        if (hash < 0)
+            hash = BINDLIST_HASH(y, x->b_hashsize);
+        while (x->b_hash[hash] != slot + 1)
+            hash = (hash + 1) & (x->b_hashsize - 1);
+        x->b_hash[hash] = -1;
+    }
+    if (slot == v->bv_n - 1)
+        while (v->bv_n && !v->bv_vec[v->bv_n - 1])
+            v->bv_n--;
+    if (v->bv_n > 8 && 2 * x->b_nbound < v->bv_n)
+        bindlist_resize(x, v->bv_size > 4 * x->b_nbound ?
+            v->bv_size / 2 : v->bv_size, 1);
+    return (1);
+}
+
+#define BINDLIST_SEND(x, call) { \
+    t_bindvec *bv = (x)->b_vec; \
+    t_pd *y; \
+    int i; \
+    bv->bv_refcount++; \
+    for (i = bv->bv_n; i--; ) \
+        if ((y = bv->bv_vec[i])) \
+            call; \
+    bindvec_release(bv); \
+}
+
 static void bindlist_bang(t_bindlist *x)
 {
-    t_pd **vec;
-    int i, n = x->b_n;
-    BINDLIST_PUSH(x, vec, n);
-    for (i = 0; i < n; i++)
-        pd_bang(vec[i]);
-    BINDLIST_POP(vec, n);
+    BINDLIST_SEND(x, pd_bang(y));
 }
 
 static void bindlist_float(t_bindlist *x, t_float f)
 {
-    t_pd **vec;
-    int i, n = x->b_n;
-    BINDLIST_PUSH(x, vec, n);
-    for (i = 0; i < n; i++)
-        pd_float(vec[i], f);
-    BINDLIST_POP(vec, n);
+    BINDLIST_SEND(x, pd_float(y, f));
 }
 
 static void bindlist_symbol(t_bindlist *x, t_symbol *s)
 {
-    t_pd **vec;
-    int i, n = x->b_n;
-    BINDLIST_PUSH(x, vec, n);
-    for (i = 0; i < n; i++)
-        pd_symbol(vec[i], s);
-    BINDLIST_POP(vec, n);
+    BINDLIST_SEND(x, pd_symbol(y, s));
 }
 
 static void bindlist_pointer(t_bindlist *x, t_gpointer *gp)
 {
-    t_pd **vec;
-    int i, n = x->b_n;
-    BINDLIST_PUSH(x, vec, n);
-    for (i = 0; i < n; i++)
-        pd_pointer(vec[i], gp);
-    BINDLIST_POP(vec, n);
+    BINDLIST_SEND(x, pd_pointer(y, gp));
 }
 
 static void bindlist_list(t_bindlist *x, t_symbol *s,
     int argc, t_atom *argv)
 {
-    t_pd **vec;
-    int i, n = x->b_n;
-    BINDLIST_PUSH(x, vec, n);
-    for (i = 0; i < n; i++)
-        pd_list(vec[i], s, argc, argv);
-    BINDLIST_POP(vec, n);
+    BINDLIST_SEND(x, pd_list(y, s, argc, argv));
 }
 
 static void bindlist_anything(t_bindlist *x, t_symbol *s,
     int argc, t_atom *argv)
 {
-    t_pd **vec;
-    int i, n = x->b_n;
-    BINDLIST_PUSH(x, vec, n);
-    for (i = 0; i < n; i++)
-        pd_typedmess(vec[i], s, argc, argv);
-    BINDLIST_POP(vec, n);
+    BINDLIST_SEND(x, pd_typedmess(y, s, argc, argv));
 }
 
 void m_pd_setup(void)
@@ -170,23 +323,8 @@ void pd_bind(t_pd *x, t_symbol *s)
     if (s->s_thing)
     {
         if (*s->s_thing == bindlist_class)
-        {
-            t_bindlist *b = (t_bindlist *)s->s_thing;
-            int oldsize = b->b_n++;
-            b->b_vec = (t_pd **)resizebytes(b->b_vec,
-                oldsize * sizeof(t_pd *), b->b_n * sizeof(t_pd *));
-            memmove(b->b_vec + 1, b->b_vec, oldsize * sizeof(t_pd *));
-            b->b_vec[0] = x;
-        }
-        else
-        {
-            t_bindlist *b = (t_bindlist *)pd_new(bindlist_class);
-            b->b_vec = (t_pd **)getbytes(2 * sizeof(t_pd *));
-            b->b_n = 2;
-            b->b_vec[0] = x;
-            b->b_vec[1] = s->s_thing;
-            s->s_thing = &b->b_pd;
-        }
+            bindlist_add((t_bindlist *)s->s_thing, x);
+        else s->s_thing = &bindlist_new(s->s_thing, x)->b_pd;
     }
     else s->s_thing = x;
 }
@@ -207,29 +345,20 @@ void pd_unbind(t_pd *x, t_symbol *s)
             goes down to one, get rid of the bindlist and bind the symbol
             straight to the remaining element. */
         t_bindlist *b = (t_bindlist *)s->s_thing;
-        int i, n = b->b_n;
-        for (i = 0; i < n; i++)
+        if (bindlist_remove(b, x))
         {
-            if (b->b_vec[i] == x)
+            if (b->b_nbound == 1)
             {
-                if (n > 2)
-                {
-                    memmove(&b->b_vec[i], &b->b_vec[i + 1],
-                        (n - i - 1) * sizeof(t_pd *));
-                    b->b_vec = (t_pd **)resizebytes(b->b_vec,
-                        n * sizeof(t_pd *), (n - 1) * sizeof(t_pd *));
-                    b->b_n--;
-                }
-                else if (n == 2)
-                {
-                    s->s_thing = b->b_vec[i == 0 ? 1 : 0];
-                    freebytes(b->b_vec, n * sizeof(t_pd *));
-                    pd_free(&b->b_pd);
-                }
-                else
-                    bug("pd_unbind");
-                return;
+                t_bindvec *v = b->b_vec;
+                int i;
+                for (i = 0; i < v->bv_n; i++)
+                    if (v->bv_vec[i])
+                        s->s_thing = v->bv_vec[i];
+                bindlist_free(b);
             }
+            else if (b->b_nbound < 1)
+                bug("pd_unbind");
+            return;
         }
     }
     pd_error(x, "%s: couldn't unbind", s->s_name);
@@ -243,13 +372,12 @@ t_pd *pd_findbyclass(t_symbol *s, const t_class *c)
     if (*s->s_thing == c) return (s->s_thing);
     if (*s->s_thing == bindlist_class)
     {
-        t_bindlist *b = (t_bindlist *)s->s_thing;
-        int warned = 0, n = b->b_n;
-        t_pd **vec = b->b_vec;
+        t_bindvec *v = ((t_bindlist *)s->s_thing)->b_vec;
+        int warned = 0, n = v->bv_n;
         while (n--)
         {
-            t_pd *obj = *vec++;
-            if (*obj == c)
+            t_pd *obj = v->bv_vec[n];
+            if (obj && *obj == c)
             {
                 if (x && !warned)
                 {
@@ -278,12 +406,13 @@ t_pd *pd_findbyclassname(t_symbol *s, const t_symbol *classname)
 #endif
     if (*s->s_thing == bindlist_class)
     {
-        t_bindlist *b = (t_bindlist *)s->s_thing;
-        int warned = 0, n = b->b_n;
-        t_pd **vec = b->b_vec;
+        t_bindvec *v = ((t_bindlist *)s->s_thing)->b_vec;
+        int warned = 0, n = v->bv_n;
         while (n--)
         {
-            t_pd *obj = *vec++;
+            t_pd *obj = v->bv_vec[n];
+            if (!obj)
+                continue;
         #ifdef PDINSTANCE /* see above */
             if (!strcmp((*obj)->c_name->s_name, classname->s_name))
         #else
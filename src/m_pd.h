@@ -701,7 +701,10 @@ typedef void (*t_messfn)(t_pd *obj, void *data);
 /* send a message to a Pd object from another (helper) thread.
  * 'fn' will be called on the scheduler thread with 'obj' and 'data'.
  * If the message has been canceled, the 'obj' argument is NULL, see
- * pd_queue_cancel() below. NB: do not forget to free the 'data' object! */
+ * pd_queue_cancel() below; the same goes for messages dropped because the
+ * queue was full and "pd messqueue-policy drop" is set.  Either way 'fn'
+ * still runs on the scheduler thread. NB: do not forget to free the 'data'
+ * object! */
 EXTERN void pd_queue_mess(struct _pdinstance *instance, t_pd *obj, void *data, t_messfn fn);
 /* cancel all pending messages for the given object;
  * typically called in the object destructor AFTER joining the helper thread. */
@@ -1061,6 +1064,8 @@ struct _pdinstance
 #if PDTHREADS
     int pd_islocked;
 #endif
+    int pd_symhashsize;         /* number of buckets in pd_symhash */
+    int pd_nsymbols;            /* number of symbols in pd_symhash */
 };
 EXTERN t_pdinstance pd_maininstance;
 
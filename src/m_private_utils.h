@@ -47,7 +47,7 @@
 #define atomic_int_exchange(ptr, value) _InterlockedExchange((volatile long *)(ptr), value)
 static int atomic_int_compare_exchange(volatile int *ptr, int *expected, int desired)
 {
-    long old = _InterlockedCompareExchange((volatile long *)ptr, *expected, desired);
+    long old = _InterlockedCompareExchange((volatile long *)ptr, desired, *expected);
     if (old == *expected)
         return 1;
     else
@@ -175,4 +175,25 @@ static int atomic_int_compare_exchange(volatile int *ptr, int *expected, int des
 # endif
 #endif
 
+/* ----------------------------- cycle counter ------------------------------ */
+/* PD_CYCLES() reads a cheap, steadily increasing counter for the profilers.
+ * Its rate isn't known here: measure it against sys_getrealtime(). */
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define PD_CYCLES() ((uint64_t)__rdtsc())
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+# include <intrin.h>
+# define PD_CYCLES() ((uint64_t)__rdtsc())
+#elif defined(__aarch64__) && defined(__GNUC__)
+static inline uint64_t pd_cycles(void)
+{
+    uint64_t t;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (t));
+    return t;
+}
+# define PD_CYCLES() pd_cycles()
+#else
+# define PD_CYCLES() ((uint64_t)(sys_getrealtime() * 1e9))
+#endif
+
 #endif /* M_PRIVATE_UTILS_H */
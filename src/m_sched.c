@@ -16,6 +16,8 @@
 #endif
 #include <errno.h>
 #include <pthread.h>
+#include <string.h>
+#include <time.h>
 
     /* LATER consider making this variable.  It's now the LCM of all sample
     rates we expect to see: 32000, 44100, 48000, 88200, 96000. */
@@ -50,7 +52,8 @@ struct _clock
     double c_settime;       /* in TIMEUNITS; <0 if unset */
     void *c_owner;
     t_clockmethod c_fn;
-    struct _clock *c_next;
+    uint64_t c_seq;         /* when it was set, to break ties in c_settime */
+    int c_heapindex;        /* where we are in the heap if set */
     t_float c_unit;         /* >0 if in TIMEUNITS; <0 if in samples */
 };
 
@@ -64,24 +67,75 @@ t_clock *clock_new(void *owner, t_method fn)
     x->c_settime = -1;
     x->c_owner = owner;
     x->c_fn = (t_clockmethod)fn;
-    x->c_next = 0;
+    x->c_seq = 0;
+    x->c_heapindex = -1;
     x->c_unit = TIMEUNITPERMSEC;
     return (x);
 }
 
+/* The set clocks are kept in a binary min-heap ordered by the time they're
+set to and, for clocks set to the same time, by the order in which they were
+set, so that they fire in exactly the order the old sorted list gave them.
+Each clock remembers where it is in the heap so that unsetting it is also
+logarithmic.  pd_clock_setlist always points to the clock that will fire
+next. */
+
+#define CLOCK_BEFORE(a, b) ((a)->c_settime < (b)->c_settime || \
+    ((a)->c_settime == (b)->c_settime && (a)->c_seq < (b)->c_seq))
+
+static void clock_heapup(t_clock **heap, int i)
+{
+    t_clock *x = heap[i];
+    while (i > 0)
+    {
+        int parent = (i - 1) >> 1;
+        if (!CLOCK_BEFORE(x, heap[parent]))
+            break;
+        heap[i] = heap[parent];
+        heap[i]->c_heapindex = i;
+        i = parent;
+    }
+    heap[i] = x;
+    x->c_heapindex = i;
+}
+
+static void clock_heapdown(t_clock **heap, int n, int i)
+{
+    t_clock *x = heap[i];
+    while (1)
+    {
+        int child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && CLOCK_BEFORE(heap[child + 1], heap[child]))
+            child++;
+        if (!CLOCK_BEFORE(heap[child], x))
+            break;
+        heap[i] = heap[child];
+        heap[i]->c_heapindex = i;
+        i = child;
+    }
+    heap[i] = x;
+    x->c_heapindex = i;
+}
+
 void clock_unset(t_clock *x)
 {
     if (x->c_settime >= 0)
     {
-        if (x == pd_this->pd_clock_setlist)
-            pd_this->pd_clock_setlist = x->c_next;
-        else
+        t_clock **heap = STUFF->st_clockheap;
+        int i = x->c_heapindex, n = --STUFF->st_nclocks;
+        if (i < n)
         {
-            t_clock *x2 = pd_this->pd_clock_setlist;
-            while (x2->c_next != x) x2 = x2->c_next;
-            x2->c_next = x->c_next;
+            heap[i] = heap[n];
+            heap[i]->c_heapindex = i;
+            if (i > 0 && CLOCK_BEFORE(heap[i], heap[(i - 1) >> 1]))
+                clock_heapup(heap, i);
+            else clock_heapdown(heap, n, i);
         }
+        pd_this->pd_clock_setlist = (n ? heap[0] : 0);
         x->c_settime = -1;
+        x->c_heapindex = -1;
     }
 }
 
@@ -90,24 +144,20 @@ void clock_set(t_clock *x, double setticks)
 {
     if (setticks < pd_this->pd_systime) setticks = pd_this->pd_systime;
     clock_unset(x);
-    x->c_settime = setticks;
-    if (pd_this->pd_clock_setlist &&
-        pd_this->pd_clock_setlist->c_settime <= setticks)
+    if (STUFF->st_nclocks == STUFF->st_clockheapsize)
     {
-        t_clock *cbefore, *cafter;
-        for (cbefore = pd_this->pd_clock_setlist,
-            cafter = pd_this->pd_clock_setlist->c_next;
-                cbefore; cbefore = cafter, cafter = cbefore->c_next)
-        {
-            if (!cafter || cafter->c_settime > setticks)
-            {
-                cbefore->c_next = x;
-                x->c_next = cafter;
-                return;
-            }
-        }
+        int newsize = (STUFF->st_clockheapsize ?
+            2 * STUFF->st_clockheapsize : 64);
+        STUFF->st_clockheap = (t_clock **)resizebytes(STUFF->st_clockheap,
+            STUFF->st_clockheapsize * sizeof(t_clock *),
+                newsize * sizeof(t_clock *));
+        STUFF->st_clockheapsize = newsize;
     }
-    else x->c_next = pd_this->pd_clock_setlist, pd_this->pd_clock_setlist = x;
+    x->c_settime = setticks;
+    x->c_seq = STUFF->st_clockseq++;
+    STUFF->st_clockheap[STUFF->st_nclocks] = x;
+    clock_heapup(STUFF->st_clockheap, STUFF->st_nclocks++);
+    pd_this->pd_clock_setlist = STUFF->st_clockheap[0];
 }
 
     /* set the clock to call back after a delay in msec */
@@ -185,6 +235,92 @@ void clock_free(t_clock *x)
     freebytes(x, sizeof *x);
 }
 
+    /* "pd clock-bench <n>": time setting, resetting, unsetting and firing
+    n clocks (100000 by default) in a heap of their own, and check that they
+    fire in order.  The clock callbacks don't do anything, so this measures
+    the scheduler's own overhead. */
+static void clockbench_tick(void *dummy) {}
+
+#define CLOCKBENCH_NEXT(r) ((r) = (r) * 1664525 + 1013904223)
+
+void glob_clockbench(void *dummy, t_floatarg f)
+{
+    int n = (f >= 1 ? f : 100000), i, nfired = 0, nbad = 0;
+    uint32_t r = 1;
+    double lasttime = -1, starttime, settime, resettime, unsettime, firetime;
+    uint64_t lastseq = 0;
+    t_clock **clocks = (t_clock **)getbytes(n * sizeof(t_clock *)),
+        *saveset = pd_this->pd_clock_setlist;
+    t_clock **saveheap = STUFF->st_clockheap;
+    int savenclocks = STUFF->st_nclocks, saveheapsize = STUFF->st_clockheapsize;
+
+        /* swap in an empty heap so that the patch's own clocks aren't
+        disturbed */
+    STUFF->st_clockheap = 0;
+    STUFF->st_nclocks = STUFF->st_clockheapsize = 0;
+    pd_this->pd_clock_setlist = 0;
+    for (i = 0; i < n; i++)
+        clocks[i] = clock_new(0, (t_method)clockbench_tick);
+
+        /* only 1000 different times so there are lots of ties */
+    starttime = sys_getrealtime();
+    for (i = 0; i < n; i++)
+        clock_set(clocks[i], pd_this->pd_systime +
+            (CLOCKBENCH_NEXT(r) >> 22) * TIMEUNITPERMSEC);
+    settime = sys_getrealtime() - starttime;
+
+    starttime = sys_getrealtime();
+    for (i = 0; i < n; i++)
+        clock_set(clocks[i], pd_this->pd_systime +
+            (CLOCKBENCH_NEXT(r) >> 22) * TIMEUNITPERMSEC);
+    resettime = sys_getrealtime() - starttime;
+
+    starttime = sys_getrealtime();
+    for (i = 0; i < n; i++)
+        clock_unset(clocks[((uint64_t)i * 7919) % n]);
+    unsettime = sys_getrealtime() - starttime;
+
+    for (i = 0; i < n; i++)
+        clock_set(clocks[i], pd_this->pd_systime +
+            (CLOCKBENCH_NEXT(r) >> 22) * TIMEUNITPERMSEC);
+
+        /* fire them the same way sched_tick() does */
+    starttime = sys_getrealtime();
+    while (pd_this->pd_clock_setlist)
+    {
+        t_clock *c = pd_this->pd_clock_setlist;
+        if (c->c_settime < lasttime ||
+            (c->c_settime == lasttime && c->c_seq < lastseq))
+                nbad++;
+        lasttime = c->c_settime;
+        lastseq = c->c_seq;
+        clock_unset(c);
+        (*c->c_fn)(c->c_owner);
+        nfired++;
+    }
+    firetime = sys_getrealtime() - starttime;
+
+    for (i = 0; i < n; i++)
+        clock_free(clocks[i]);
+    freebytes(clocks, n * sizeof(t_clock *));
+    if (STUFF->st_clockheap)
+        freebytes(STUFF->st_clockheap,
+            STUFF->st_clockheapsize * sizeof(t_clock *));
+    STUFF->st_clockheap = saveheap;
+    STUFF->st_nclocks = savenclocks;
+    STUFF->st_clockheapsize = saveheapsize;
+    pd_this->pd_clock_setlist = saveset;
+
+#define CLOCKBENCH_RATE(t) ((t) > 0 ? n / ((t) * 1e6) : 0)
+    post("clock-bench: %d clocks: set %.2f, reset %.2f, unset %.2f, "
+        "fire %.2f million/sec", n, CLOCKBENCH_RATE(settime),
+        CLOCKBENCH_RATE(resettime), CLOCKBENCH_RATE(unsettime),
+            CLOCKBENCH_RATE(firetime));
+    if (nfired != n || nbad)
+        pd_error(0, "clock-bench: %d of %d clocks fired, %d out of order",
+            nfired, n, nbad);
+}
+
 
 void glob_audiostatus(void)
 {
@@ -197,11 +333,312 @@ static int sched_dioredtime;
 static int sched_meterson;
 static int sched_counter;
 
-static void sys_addhist(int n) {}   /* maybe revive this later for profiling */
-static void sys_clearhist(void) {}
+    /* time spent in each phase of the scheduler loop, kept while the DSP
+    profiler is on (see "dsp-profile" in d_ugen.c).  sys_addhist(n) is
+    called as the scheduler enters phase n and charges the time since the
+    last call to the phase we were in. */
+#define NHIST 6
+static int sched_histon;
+static int sched_histphase = -1;
+static double sched_histlast;
+static double sched_hist[NHIST];
+
+static const char *sched_pollhistnames[NHIST] = {"messages and DSP",
+    "GUI and MIDI", "audio I/O", "idle tasks", "sleeping", "waiting for lock"};
+static const char *sched_callbackhistnames[NHIST] = {"messages and DSP",
+    "MIDI", "idle tasks", "between callbacks", "", ""};
+
+static void sys_addhist(int n)
+{
+    double now;
+    if (!sched_histon)
+        return;
+    now = sys_getrealtime();
+    if (sched_histphase >= 0)
+        sched_hist[sched_histphase] += now - sched_histlast;
+    sched_histlast = now;
+    sched_histphase = n;
+}
+
+static void sys_clearhist(void)
+{
+    int i;
+    for (i = 0; i < NHIST; i++)
+        sched_hist[i] = 0;
+    sched_histphase = -1;
+}
+
+void sys_sethist(int on)
+{
+    if (on && !sched_histon)
+        sys_clearhist();
+    sched_histon = on;
+}
+
+    /* report the phases (in seconds) and their names; returns how many */
+int sys_gethist(double *seconds, const char **names, int max)
+{
+    int i, n = (sched_useaudio == SCHED_AUDIO_CALLBACK ? 4 : NHIST);
+    if (n > max)
+        n = max;
+    for (i = 0; i < n; i++)
+    {
+        seconds[i] = sched_hist[i];
+        names[i] = (sched_useaudio == SCHED_AUDIO_CALLBACK ?
+            sched_callbackhistnames[i] : sched_pollhistnames[i]);
+    }
+    return (n);
+}
+
+    /* the scheduler timeline: while on, we keep a ring buffer with a record
+    of each of the last few thousand ticks -- when it started, how long the
+    clock callbacks, the DSP and the GUI/idle polling took, and whether an
+    xrun or an audio I/O error was reported -- to be written to a file on
+    demand ("pd sched-timeline dump <file>") or automatically some time
+    after each xrun, so that dropouts can be looked at after the fact. */
+typedef struct _schedtick
+{
+    double s_start;         /* real time the tick started, in seconds */
+    double s_logical;       /* logical time in msec */
+    double s_clocks;        /* seconds in clock callbacks and queued messages */
+    double s_dsp;           /* seconds in the DSP chain */
+    double s_idle;          /* seconds polling GUI and MIDI and in idle tasks */
+    int s_tick;             /* tick count (sched_counter) */
+    int s_nclocks;          /* number of clock callbacks fired */
+    int s_xrun;             /* samples reported lost by the audio API */
+    int s_error;            /* ERR_xxx reported via sys_log_error() */
+} t_schedtick;
+
+static t_schedtick *sched_timeline;     /* the ring buffer */
+static int sched_timelinesize;          /* its size in ticks */
+static int sched_timelinehead;          /* where the next tick goes */
+static int sched_timelinefill;          /* how many ticks are in it */
+static t_schedtick *sched_timelinenow;  /* the current tick if any */
+static t_symbol *sched_timelineprefix;  /* for automatic dumps, or 0 */
+static int sched_timelinedumpat = -1;   /* tick to dump at, -1 if none */
+static int sched_timelinenextok;        /* no new dump due before this tick */
+static int sched_timelinendumps;
+static volatile int sched_timelinedumpready;
+
+static void sched_timeline_begin(void)
+{
+    t_schedtick *s = sched_timeline + sched_timelinehead;
+    memset(s, 0, sizeof(*s));
+    s->s_start = sys_getrealtime();
+    s->s_logical = pd_this->pd_systime / TIMEUNITPERMSEC;
+    s->s_tick = sched_counter;
+    if (++sched_timelinehead == sched_timelinesize)
+        sched_timelinehead = 0;
+    if (sched_timelinefill < sched_timelinesize)
+        sched_timelinefill++;
+    sched_timelinenow = s;
+}
+
+    /* add the time since "since" (got from sys_getrealtime()) to the idle
+    time of the current tick */
+static void sched_timeline_idle(double since)
+{
+    if (sched_timelinenow)
+        sched_timelinenow->s_idle += sys_getrealtime() - since;
+}
+
+    /* called from sys_log_error() for anything going wrong with audio I/O.
+    If automatic dumps are on, dump when a quarter of the ring buffer has
+    gone by, so that we see what happened both before and after.  Later
+    xruns within the same stretch of time go into the same dump. */
+static void sched_timeline_error(int type)
+{
+    if (!sched_timelinenow)
+        return;
+    sched_timelinenow->s_error = type;
+    if (sched_timelineprefix && sched_timelinedumpat < 0 &&
+        sched_counter >= sched_timelinenextok)
+    {
+        sched_timelinedumpat = sched_counter + sched_timelinesize / 4;
+        sched_timelinenextok = sched_timelinedumpat +
+            sched_timelinesize - sched_timelinesize / 4;
+    }
+}
+
+    /* copy the ring buffer, oldest tick first */
+static t_schedtick *sched_timeline_copy(int *np)
+{
+    t_schedtick *copy;
+    int n = sched_timelinefill, start, i;
+    if (!(*np = n))
+        return (0);
+    start = (sched_timelinehead - n + sched_timelinesize) % sched_timelinesize;
+    copy = (t_schedtick *)getbytes(n * sizeof(*copy));
+    for (i = 0; i < n; i++)
+        copy[i] = sched_timeline[(start + i) % sched_timelinesize];
+    return (copy);
+}
+
+    /* write ticks as tab separated values (times in usec); returns 0 if
+    the file can't be created.  Doesn't post anything so that it can be
+    called without holding the Pd lock. */
+static int sched_timeline_write(const char *filename,
+    const t_schedtick *ticks, int n)
+{
+    FILE *fd;
+    time_t now = time(0);
+    char date[80];
+    int i;
+    if (!(fd = sys_fopen(filename, "w")))
+        return (0);
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    fprintf(fd, "# ticks %d blocksize %d samplerate %g scheduler %s\n",
+        n, STUFF->st_schedblocksize, STUFF->st_dacsr,
+        (sched_useaudio == SCHED_AUDIO_CALLBACK ? "callback" :
+        (sched_useaudio == SCHED_AUDIO_POLL ? "polling" : "none")));
+    fprintf(fd, "# written %s at real time %.6f\n", date, sys_getrealtime());
+    fprintf(fd, "tick\tstart\tlogical\tinterval\ttick_us\tclocks\tclock_us"
+        "\tdsp_us\tidle_us\txrun\terror\n");
+    for (i = 0; i < n; i++)
+    {
+        const t_schedtick *s = ticks + i;
+        fprintf(fd, "%d\t%.6f\t%.3f\t%.1f\t%.1f\t%d\t%.1f\t%.1f\t%.1f\t%d\t%d\n",
+            s->s_tick, s->s_start, s->s_logical,
+            (i ? 1e6 * (s->s_start - s[-1].s_start) : 0),
+            1e6 * (s->s_clocks + s->s_dsp), s->s_nclocks, 1e6 * s->s_clocks,
+            1e6 * s->s_dsp, 1e6 * s->s_idle, s->s_xrun, s->s_error);
+    }
+    sys_fclose(fd);
+    return (1);
+}
+
+    /* write an automatic dump.  This is called from the main thread
+    without the Pd lock, which we take only while copying the ticks, so
+    that in callback mode the audio thread doesn't wait for the file. */
+static void sched_timeline_autodump(void)
+{
+    t_schedtick *ticks;
+    char filename[MAXPDSTRING];
+    int n, ok;
+    sys_lock();
+    sched_timelinedumpready = 0;
+    if (!sched_timelineprefix)
+    {
+        sys_unlock();
+        return;
+    }
+    pd_snprintf(filename, MAXPDSTRING, "%s-%d.txt",
+        sched_timelineprefix->s_name, ++sched_timelinendumps);
+    ticks = sched_timeline_copy(&n);
+    sys_unlock();
+    ok = sched_timeline_write(filename, ticks, n);
+    sys_lock();
+    if (ok)
+        logpost(0, PD_VERBOSE, "sched-timeline: xrun: wrote %s", filename);
+    else pd_error(0, "%s: can't create", filename);
+    sys_unlock();
+    if (ticks)
+        freebytes(ticks, n * sizeof(*ticks));
+}
+
+static void sched_timeline_setsize(int size)
+{
+    if (sched_timeline)
+        freebytes(sched_timeline, sched_timelinesize * sizeof(t_schedtick));
+    sched_timeline = (size > 0 ?
+        (t_schedtick *)getbytes(size * sizeof(t_schedtick)) : 0);
+    sched_timelinesize = (size > 0 ? size : 0);
+    sched_timelinehead = sched_timelinefill = 0;
+    sched_timelinenow = 0;
+    sched_timelinedumpat = -1;
+    sched_timelinenextok = 0;
+}
+
+static void sched_timeline_print(void)
+{
+    t_schedtick *ticks;
+    int n, i, maxtick = 0, maxinterval = 0, nxruns = 0, nerrors = 0;
+    double sumtick = 0, sumdsp = 0, maxdsp = 0, maxidle = 0, interval = 0;
+    if (!(ticks = sched_timeline_copy(&n)))
+    {
+        post("sched-timeline: no ticks yet");
+        return;
+    }
+    for (i = 0; i < n; i++)
+    {
+        t_schedtick *s = ticks + i;
+        double t = s->s_clocks + s->s_dsp;
+        sumtick += t;
+        sumdsp += s->s_dsp;
+        if (t > ticks[maxtick].s_clocks + ticks[maxtick].s_dsp)
+            maxtick = i;
+        if (s->s_dsp > maxdsp)
+            maxdsp = s->s_dsp;
+        if (s->s_idle > maxidle)
+            maxidle = s->s_idle;
+        if (i && s->s_start - s[-1].s_start > interval)
+            interval = s->s_start - s[-1].s_start, maxinterval = i;
+        nxruns += (s->s_xrun != 0);
+        nerrors += (s->s_error != 0);
+    }
+    post("sched-timeline: last %d ticks (%.2f seconds)", n,
+        ticks[n-1].s_start - ticks[0].s_start);
+    post("tick: %.1f usec average, %.1f max (tick %d, %d clocks)",
+        1e6 * sumtick / n,
+        1e6 * (ticks[maxtick].s_clocks + ticks[maxtick].s_dsp),
+            ticks[maxtick].s_tick, ticks[maxtick].s_nclocks);
+    post("DSP: %.1f usec average, %.1f max", 1e6 * sumdsp / n, 1e6 * maxdsp);
+    post("GUI, MIDI and idle tasks: %.1f usec max", 1e6 * maxidle);
+    if (maxinterval)
+        post("longest time between ticks: %.1f usec (before tick %d)",
+            1e6 * interval, ticks[maxinterval].s_tick);
+    post("ticks with xruns: %d, with audio I/O errors: %d", nxruns, nerrors);
+    freebytes(ticks, n * sizeof(*ticks));
+}
+
+    /* "sched-timeline <n>" to keep the last n ticks (0 to stop),
+    "sched-timeline print" for a summary, "sched-timeline dump <file>" to
+    write them all out, and "sched-timeline autodump <prefix>" to write
+    <prefix>-1.txt, <prefix>-2.txt, ... after xruns ("autodump" alone to
+    stop). */
+void glob_schedtimeline(void *dummy, t_symbol *s, int argc, t_atom *argv)
+{
+    t_symbol *what = atom_getsymbolarg(0, argc, argv);
+    if (argc && argv->a_type == A_FLOAT)
+    {
+        int size = argv->a_w.w_float;
+        if (size > 0 && size < 16)
+            size = 16;
+        if (size != sched_timelinesize)
+            sched_timeline_setsize(size);
+    }
+    else if (what == gensym("autodump"))
+    {
+        sched_timelineprefix = (argc > 1 &&
+            *atom_getsymbolarg(1, argc, argv)->s_name ?
+                atom_getsymbolarg(1, argc, argv) : 0);
+        sched_timelinendumps = 0;
+        sched_timelinedumpat = -1;
+        if (sched_timelineprefix && !sched_timeline)
+            pd_error(0, "sched-timeline: not started (send 'sched-timeline <n>')");
+    }
+    else if (!sched_timeline)
+        pd_error(0, "sched-timeline: not started (send 'sched-timeline <n>')");
+    else if (!argc || what == gensym("print"))
+        sched_timeline_print();
+    else if (what == gensym("dump") && argc > 1)
+    {
+        t_schedtick *ticks;
+        int n;
+        const char *filename = atom_getsymbolarg(1, argc, argv)->s_name;
+        ticks = sched_timeline_copy(&n);
+        if (!sched_timeline_write(filename, ticks, n))
+            pd_error(0, "%s: can't create", filename);
+        if (ticks)
+            freebytes(ticks, n * sizeof(*ticks));
+    }
+    else pd_error(0, "sched-timeline: unknown argument '%s'", what->s_name);
+}
 
 void sys_log_error(int type)
 {
+    if (type != ERR_NOTHING)
+        sched_timeline_error(type);
     if (type != ERR_NOTHING && !sched_diored &&
         (sched_counter >= sched_dioredtime))
     {
@@ -371,8 +808,13 @@ void messqueue_dispatch();
     /* take the scheduler forward one DSP tick, also handling clock timeouts */
 void sched_tick(void)
 {
-    double next_sys_time = pd_this->pd_systime + SYSTIMEPERTICK;
-    int countdown = 5000;
+    double next_sys_time = pd_this->pd_systime + SYSTIMEPERTICK, starttime = 0;
+    int countdown = 5000, nclocks = 0;
+    if (sched_timeline)
+    {
+        sched_timeline_begin();
+        starttime = sched_timelinenow->s_start;
+    }
     while (pd_this->pd_clock_setlist &&
         pd_this->pd_clock_setlist->c_settime < next_sys_time)
     {
@@ -381,6 +823,7 @@ void sched_tick(void)
         clock_unset(pd_this->pd_clock_setlist);
         outlet_setstacklim();
         (*c->c_fn)(c->c_owner);
+        nclocks++;
         if (!countdown--)
         {
             countdown = 5000;
@@ -392,8 +835,24 @@ void sched_tick(void)
     }
     pd_this->pd_systime = next_sys_time;
     messqueue_dispatch();
+        /* the clock callbacks might have restarted the timeline, in which
+        case sched_timelinenow is zero */
+    if (sched_timelinenow)
+    {
+        double now = sys_getrealtime();
+        sched_timelinenow->s_clocks = now - starttime;
+        sched_timelinenow->s_nclocks = nclocks;
+        starttime = now;
+    }
     dsp_tick();
+    if (sched_timelinenow)
+        sched_timelinenow->s_dsp = sys_getrealtime() - starttime;
     sched_counter++;
+    if (sched_counter == sched_timelinedumpat)
+    {
+        sched_timelinedumpat = -1;
+        sched_timelinedumpready = 1;
+    }
 }
 
 int sched_get_sleepgrain(void)
@@ -442,6 +901,7 @@ int sched_idletask(void)
 {
     static int sched_nextmeterpolltime, sched_nextpingtime;
     int rtn = 0, xrunsamples;
+    double idlestart = (sched_timelinenow ? sys_getrealtime() : 0);
     sys_lock();
     if (sys_pollgui())
         rtn = 1;
@@ -464,6 +924,8 @@ int sched_idletask(void)
     {
         t_pd *x;
         sys_lock();
+        if (sched_timelinenow)
+            sched_timelinenow->s_xrun = xrunsamples;
         sys_log_error(ERR_DATALATE);
         x = gensym("pd-xrun")->s_thing;
         if (x)
@@ -481,11 +943,15 @@ int sched_idletask(void)
         }
         sched_nextmeterpolltime = sched_counter + APPROXTICKSPERSEC;
     }
-    return (rtn || sys_idlehook && sys_idlehook());
+    if (!rtn && sys_idlehook)
+        rtn = sys_idlehook();
+    sched_timeline_idle(idlestart);
+    return (rtn);
 }
 
 static void m_pollingscheduler(void)
 {
+    double idlestart;
     sys_lock();
         /* NB: we don't need to lock the scheduler mutex because sys_quit
         will only be modified from this thread */
@@ -507,14 +973,18 @@ static void m_pollingscheduler(void)
         }
             /* do at least one GUI update per DSP tick, so that Pd stays responsive
              * if the scheduler can't keep up with the audio callback */
+        idlestart = (sched_timelinenow ? sys_getrealtime() : 0);
         sys_pollgui();
         sys_pollmidiqueue();
+        sched_timeline_idle(idlestart);
         sys_addhist(2);
         while (!sys_quit)   /* inner loop runs until it can transfer audio */
         {
             int timeforward; /* SENDDACS_YES if audio was transferred, SENDDACS_NO if not,
                                 or SENDDACS_SLEPT if yes but time elapsed during xfer */
             sys_unlock();
+            if (sched_timelinedumpready)
+                sched_timeline_autodump();
             if (sched_useaudio == SCHED_AUDIO_NONE)
             {
                     /* no audio; use system clock */
@@ -567,6 +1037,13 @@ void sched_audio_callbackfn(void)
     sys_unlock();
     (void)sched_idletask();
     sys_addhist(3);
+    if (sched_timelinedumpready)
+    {
+            /* have the main thread write it */
+        pthread_mutex_lock(&sched_mutex);
+        pthread_cond_signal(&sched_cond);
+        pthread_mutex_unlock(&sched_mutex);
+    }
     if (sched_request)
     {
             /* notify main thread! */
@@ -612,6 +1089,13 @@ static void m_callbackscheduler(void)
             /* sleep on condition variable (with timeout) */
         timewas = pd_this->pd_systime;
         wasinprogress = callback_inprogress;
+        if (sched_timelinedumpready)
+        {
+            pthread_mutex_unlock(&sched_mutex);
+            sched_timeline_autodump();
+            pthread_mutex_lock(&sched_mutex);
+            continue;
+        }
         if (pthread_cond_timedwait(&sched_cond, &sched_mutex, &ts) == ETIMEDOUT)
         {
                 /* check if the schedular has advanced since the last time
@@ -672,6 +1156,10 @@ int m_mainloop(void)
 int m_batchmain(void)
 {
     while (sys_quit != SYS_QUIT_QUIT)
+    {
         sched_tick();
+        if (sched_timelinedumpready)
+            sched_timeline_autodump();
+    }
     return (sys_exitcode);
 }
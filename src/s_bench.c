@@ -0,0 +1,265 @@
+/* Copyright (c) 2024 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* "pd bench": open patches one at a time, run them for a fixed number of
+DSP ticks, and write what it cost as JSON, so that the numbers can be
+compared between versions of Pd.  This is what the "pd-bench" program (see
+u_pdbench.c) runs; it only works in batch mode, since we call sched_tick()
+ourselves.  The reference patches are in the "bench" directory at the top
+of the source tree.
+
+For each patch we report nsec per tick (the best of several runs), nsec per
+sample (per tick, divided by the block size), and how many times getbytes()
+and resizebytes() were called per tick.  Then we run it again with the DSP
+profiler on (see "dsp-profile" in d_ugen.c) to get the time per sample for
+each class of object.  The profiler slows things down somewhat, so the
+per-class numbers don't add up exactly to the total. */
+
+#include "m_pd.h"
+#include "m_imp.h"
+#include "s_stuff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void glob_dspprofile(void *dummy, t_symbol *s, int argc, t_atom *argv);
+void sys_exit(int status);
+
+#define BENCH_MAXCLASSES 1024
+
+    /* the reference patches run when no patches are given */
+static const char *bench_defaults[] = {
+    "osc", "filter", "fft", "delay", "expr", "clone", "control", 0
+};
+
+typedef struct _bench
+{
+    int b_ticks;            /* ticks per run */
+    int b_warmup;           /* ticks to run first */
+    int b_runs;             /* number of runs; we report the fastest */
+    int b_profile;          /* also run with the DSP profiler */
+    const char *b_dir;      /* where to look for patches given by name */
+    FILE *b_fd;
+    int b_nrun;             /* number of patches run so far */
+} t_bench;
+
+    /* write a string in quotes with JSON escapes */
+static void bench_string(FILE *fd, const char *s)
+{
+    putc('"', fd);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fprintf(fd, "\\%c", *s);
+        else if ((unsigned char)*s < 32)
+            fprintf(fd, "\\u%04x", (unsigned char)*s);
+        else putc(*s, fd);
+    }
+    putc('"', fd);
+}
+
+static int bench_classcmp(const void *a, const void *b)
+{
+    return (strcmp(((const t_profclass *)a)->pc_class->s_name,
+        ((const t_profclass *)b)->pc_class->s_name));
+}
+
+static void bench_dspprofile(const char *what)
+{
+    t_atom at;
+    if (*what >= '0' && *what <= '9')
+        SETFLOAT(&at, *what - '0');
+    else SETSYMBOL(&at, gensym(what));
+    glob_dspprofile(0, 0, 1, &at);
+}
+
+static void bench_ticks(int n)
+{
+    while (n--)
+        sched_tick();
+}
+
+    /* run one patch, given either as a name (looked up in b_dir with ".pd"
+    appended) or as a file name; returns 0 if it couldn't be opened */
+static int bench_run(t_bench *b, const char *arg)
+{
+    char dirbuf[MAXPDSTRING], namebuf[MAXPDSTRING], *slash;
+    double best = -1, nsec;
+    size_t bestalloc = 0;
+    int i, n = 0, dspstate, blocksize = STUFF->st_schedblocksize;
+    t_profclass *classes = 0;
+    t_pd *x;
+    if (strlen(arg) > 3 && !strcmp(arg + strlen(arg) - 3, ".pd"))
+    {
+        pd_snprintf(dirbuf, MAXPDSTRING, "%s", arg);
+        if ((slash = strrchr(dirbuf, '/')))
+        {
+            *slash = 0;
+            pd_snprintf(namebuf, MAXPDSTRING, "%s", slash + 1);
+        }
+        else
+        {
+            pd_snprintf(namebuf, MAXPDSTRING, "%s", arg);
+            strcpy(dirbuf, ".");
+        }
+    }
+    else
+    {
+        pd_snprintf(dirbuf, MAXPDSTRING, "%s", b->b_dir);
+        pd_snprintf(namebuf, MAXPDSTRING, "%s.pd", arg);
+    }
+    dspstate = canvas_suspend_dsp();
+    if (!(x = glob_evalfile(0, gensym(namebuf), gensym(dirbuf))))
+    {
+        pd_error(0, "bench: %s/%s: couldn't open", dirbuf, namebuf);
+        canvas_resume_dsp(dspstate);
+        return (0);
+    }
+    canvas_resume_dsp(1);
+    bench_ticks(b->b_warmup);
+    for (i = 0; i < b->b_runs; i++)
+    {
+        size_t nalloc = mempool_nalloc();
+        double starttime = sys_getrealtime(), elapsed;
+        bench_ticks(b->b_ticks);
+        elapsed = sys_getrealtime() - starttime;
+        if (best < 0 || elapsed < best)
+            best = elapsed,
+                bestalloc = (unsigned int)(mempool_nalloc() - nalloc);
+    }
+    if (b->b_profile)
+    {
+        bench_dspprofile("1");
+        bench_ticks(b->b_warmup);
+        bench_dspprofile("clear");
+        bench_ticks(b->b_ticks);
+        classes = (t_profclass *)getbytes(
+            BENCH_MAXCLASSES * sizeof(t_profclass));
+        n = dspprofile_getclasses(classes, BENCH_MAXCLASSES);
+        qsort(classes, n, sizeof(*classes), bench_classcmp);
+        bench_dspprofile("0");
+    }
+    canvas_suspend_dsp();
+    pd_free(x);
+    canvas_resume_dsp(dspstate);
+
+    nsec = 1e9 * best / b->b_ticks;
+    fprintf(b->b_fd, "%s\n    {\n      \"name\": ", (b->b_nrun++ ? "," : ""));
+    bench_string(b->b_fd, arg);
+    fprintf(b->b_fd, ",\n      \"ns_per_tick\": %.1f,\n"
+        "      \"ns_per_sample\": %.3f,\n      \"allocs_per_tick\": %.3f",
+        nsec, nsec / blocksize, (double)bestalloc / b->b_ticks);
+    if (b->b_profile)
+    {
+        fprintf(b->b_fd, ",\n      \"classes\": {");
+        for (i = 0; i < n; i++)
+        {
+            fprintf(b->b_fd, "%s\n        ", (i ? "," : ""));
+            bench_string(b->b_fd, classes[i].pc_class->s_name);
+            fprintf(b->b_fd, ": {\"objects\": %d, \"calls_per_tick\": %g, "
+                "\"ns_per_sample\": %.3f}", classes[i].pc_nobjects,
+                    classes[i].pc_calls, classes[i].pc_nsec / blocksize);
+        }
+        fprintf(b->b_fd, "%s}", (n ? "\n      " : ""));
+        freebytes(classes, BENCH_MAXCLASSES * sizeof(t_profclass));
+    }
+    fprintf(b->b_fd, "\n    }");
+    return (1);
+}
+
+    /* "pd bench [flags] [patch ...]" -- flags are "-ticks <n>" (10000),
+    "-warmup <n>" (100), "-runs <n>" (3), "-dir <directory>" for patches
+    given by name, "-o <file>" to write to a file instead of the standard
+    output, "-noprofile" to skip the per-class times, and "-exit" to exit
+    Pd when done, with a nonzero status if any patch couldn't be opened. */
+void glob_bench(void *dummy, t_symbol *s, int argc, t_atom *argv)
+{
+    static int running;
+    t_bench b;
+    const char *filename = 0, **defaults;
+    char buf[MAXPDSTRING];
+    int major, minor, bugfix, nfailed = 0, exitwhendone = 0;
+    if (!sys_batch)
+    {
+        pd_error(0, "bench: only works in batch mode (see pd-bench)");
+        return;
+    }
+    if (running)
+    {
+        pd_error(0, "bench: already running");
+        return;
+    }
+    b.b_ticks = 10000;
+    b.b_warmup = 100;
+    b.b_runs = 3;
+    b.b_profile = 1;
+    b.b_dir = ".";
+    b.b_fd = stdout;
+    b.b_nrun = 0;
+    while (argc && argv->a_type == A_SYMBOL &&
+        *argv->a_w.w_symbol->s_name == '-')
+    {
+        const char *flag = argv->a_w.w_symbol->s_name + 1;
+        if (!strcmp(flag, "noprofile"))
+            b.b_profile = 0, argc--, argv++;
+        else if (!strcmp(flag, "exit"))
+            exitwhendone = 1, argc--, argv++;
+        else if (argc >= 2 && !strcmp(flag, "dir"))
+            b.b_dir = atom_getsymbolarg(1, argc, argv)->s_name,
+                argc -= 2, argv += 2;
+        else if (argc >= 2 && !strcmp(flag, "o"))
+            filename = atom_getsymbolarg(1, argc, argv)->s_name,
+                argc -= 2, argv += 2;
+        else if (argc >= 2 && (!strcmp(flag, "ticks") ||
+            !strcmp(flag, "warmup") || !strcmp(flag, "runs")))
+        {
+            int n = atom_getfloatarg(1, argc, argv);
+            if (*flag == 't')
+                b.b_ticks = (n > 0 ? n : 1);
+            else if (*flag == 'w')
+                b.b_warmup = (n > 0 ? n : 0);
+            else b.b_runs = (n > 0 ? n : 1);
+            argc -= 2, argv += 2;
+        }
+        else
+        {
+            pd_error(0, "bench: unknown flag '-%s'", flag);
+            return;
+        }
+    }
+    if (filename && !(b.b_fd = sys_fopen(filename, "w")))
+    {
+        pd_error(0, "%s: can't create", filename);
+        return;
+    }
+    running = 1;
+    sys_getversion(&major, &minor, &bugfix);
+    fprintf(b.b_fd, "{\n  \"version\": \"%d.%d.%d\",\n"
+        "  \"samplerate\": %g,\n  \"blocksize\": %d,\n  \"ticks\": %d,\n"
+        "  \"warmup\": %d,\n  \"runs\": %d,\n  \"benchmarks\": [",
+            major, minor, bugfix, sys_getsr(), STUFF->st_schedblocksize,
+                b.b_ticks, b.b_warmup, b.b_runs);
+    if (argc)
+    {
+        for (; argc--; argv++)
+        {
+            if (argv->a_type == A_SYMBOL)
+                nfailed += !bench_run(&b, argv->a_w.w_symbol->s_name);
+            else
+            {
+                atom_string(argv, buf, MAXPDSTRING);
+                nfailed += !bench_run(&b, buf);
+            }
+        }
+    }
+    else for (defaults = bench_defaults; *defaults; defaults++)
+        nfailed += !bench_run(&b, *defaults);
+    fprintf(b.b_fd, "%s]\n}\n", (b.b_nrun ? "\n  " : ""));
+    if (filename)
+        sys_fclose(b.b_fd);
+    else fflush(b.b_fd);
+    running = 0;
+    if (exitwhendone)
+        sys_exit(nfailed ? 1 : 0);
+}
@@ -19,6 +19,7 @@ that didn't really belong anywhere. */
 #include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sched.h>
 #endif
 #ifdef HAVE_BSTRING_H
 #include <bstring.h>
@@ -126,6 +127,25 @@ typedef struct _guiqueue
 } t_guiqueue;
 
 #if PDTHREADS
+    /* messages from other threads go into a fixed ring of slots (see
+    pd_queue_mess() below); if that fills up they "spill" into a linked list
+    protected by a mutex.  The ring size has to be a power of two. */
+#define MESSQUEUESIZE 1024
+#define MESSQUEUE_SPILL 0   /* overflow policies: spill to the list... */
+#define MESSQUEUE_DROP 1    /* ... or drop the message */
+    /* position arithmetic that wraps around without overflowing */
+#define MESSQUEUE_ADD(pos, n) ((int)((unsigned int)(pos) + (unsigned int)(n)))
+#define MESSQUEUE_DIFF(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)))
+
+typedef struct _messslot
+{
+    atomic_int s_seq;       /* position this slot is ready to be written
+                            at, or 1 + position it's been written at */
+    t_pd *s_obj;
+    void *s_data;
+    t_messfn s_fn;
+} t_messslot;
+
 typedef struct _messqueue
 {
     t_pd *m_obj;
@@ -161,9 +181,19 @@ struct _instanceinter
 #if PDTHREADS
     pthread_mutex_t i_mutex;
     pthread_mutex_t i_guimutex;
-    pthread_mutex_t i_messqueue_mutex;
+    t_messslot *i_messring;         /* ring of slots for queued messages */
+    atomic_int i_messring_head;     /* next position to write */
+    atomic_int i_messring_tail;     /* next position to read */
+    atomic_int i_messqueue_spilling;    /* ring overflowed into the list */
+    atomic_int i_messqueue_policy;  /* MESSQUEUE_SPILL or MESSQUEUE_DROP */
+    atomic_int i_messqueue_hiwater; /* most messages ever in the ring */
+    atomic_int i_messqueue_nspilled;    /* messages that went to the list */
+    atomic_int i_messqueue_ndropped;    /* messages that were dropped */
+    pthread_mutex_t i_messqueue_mutex;  /* protects both lists */
     t_messqueue *i_messqueue_head;
     t_messqueue *i_messqueue_tail;
+    t_messqueue *i_messqueue_dropped;   /* dropped, waiting to be freed */
+    atomic_int i_messqueue_havedropped; /* i_messqueue_dropped isn't empty */
 #endif
 
     unsigned char i_recvbuf[NET_MAXPACKETSIZE];
@@ -1925,10 +1955,25 @@ void glob_vis(void *dummy, t_symbol *s)
 
 void s_inter_newpdinstance(void)
 {
+#if PDTHREADS
+    int i;
+#endif
     INTER = getbytes(sizeof(*INTER));
 #if PDTHREADS
     pthread_mutex_init(&INTER->i_mutex, NULL);
     pthread_mutex_init(&INTER->i_messqueue_mutex, NULL);
+    INTER->i_messring = (t_messslot *)getbytes(
+        MESSQUEUESIZE * sizeof(*INTER->i_messring));
+    for (i = 0; i < MESSQUEUESIZE; i++)
+        atomic_int_store(&INTER->i_messring[i].s_seq, i);
+    atomic_int_store(&INTER->i_messring_head, 0);
+    atomic_int_store(&INTER->i_messring_tail, 0);
+    atomic_int_store(&INTER->i_messqueue_spilling, 0);
+    atomic_int_store(&INTER->i_messqueue_policy, MESSQUEUE_SPILL);
+    atomic_int_store(&INTER->i_messqueue_hiwater, 0);
+    atomic_int_store(&INTER->i_messqueue_nspilled, 0);
+    atomic_int_store(&INTER->i_messqueue_ndropped, 0);
+    atomic_int_store(&INTER->i_messqueue_havedropped, 0);
     pd_this->pd_islocked = 0;
     pthread_mutex_init(&INTER->i_guimutex, NULL);
 #endif
@@ -1954,6 +1999,16 @@ void s_inter_free(t_instanceinter *inter)
     pthread_mutex_destroy(&inter->i_mutex);
     pthread_mutex_destroy(&inter->i_guimutex);
         /* flush message queue */
+    while (1)
+    {
+        int tail = atomic_int_load(&inter->i_messring_tail);
+        t_messslot *slot = &inter->i_messring[tail & (MESSQUEUESIZE-1)];
+        if (atomic_int_load(&slot->s_seq) != MESSQUEUE_ADD(tail, 1))
+            break;
+        slot->s_fn(NULL, slot->s_data);
+        atomic_int_store(&inter->i_messring_tail, MESSQUEUE_ADD(tail, 1));
+    }
+    freebytes(inter->i_messring, MESSQUEUESIZE * sizeof(*inter->i_messring));
     while (inter->i_messqueue_head)
     {
         t_messqueue *m = inter->i_messqueue_head, *next = m->m_next;
@@ -1962,6 +2017,13 @@ void s_inter_free(t_instanceinter *inter)
         freebytes(m, sizeof(*m));
         inter->i_messqueue_head = next;
     }
+    while (inter->i_messqueue_dropped)
+    {
+        t_messqueue *m = inter->i_messqueue_dropped, *next = m->m_next;
+        m->m_fn(NULL, m->m_data);
+        freebytes(m, sizeof(*m));
+        inter->i_messqueue_dropped = next;
+    }
     pthread_mutex_destroy(&inter->i_messqueue_mutex);
 #endif
     freebytes(inter, sizeof(*inter));
@@ -2053,25 +2115,120 @@ int sys_trylock(void)
 #endif
 }
 
+/* pd_queue_mess() may be called from any thread, and messqueue_dispatch()
+is called from sched_tick() in Pd's own thread.  The ring is a bounded
+multi-producer, single-consumer queue after Dmitry Vyukov: each slot carries
+a sequence number that tells producers whether they may claim it (it equals
+the position they want to write) and the consumer whether it's been filled
+(it equals that position + 1).  Producers claim positions by bumping
+i_messring_head with compare-and-swap, so neither side ever takes a lock.
+
+When the ring is full the message goes to the old mutex-protected list
+("spilling"), or, if the policy is "drop", is dropped: it goes to a second
+list, which the consumer empties whenever it can, calling each function with
+a NULL object just like a canceled message.  So the function always runs in
+Pd's thread, whether the message is delivered, canceled or dropped; and
+dropped messages don't hold up the delivered ones.  Once something
+has spilled, everyone queues to the list until the consumer has emptied
+both the ring and the list, so that the messages from any one thread stay
+in order.  The consumer only ever trylocks the list, so sched_tick() never
+waits for a producer. */
+
+static int messqueue_push(t_instanceinter *inter,
+    t_pd *obj, void *data, t_messfn fn)
+{
+    int pos = atomic_int_load(&inter->i_messring_head), n, hiwater;
+    t_messslot *slot;
+    while (1)
+    {
+        int diff;
+        slot = &inter->i_messring[pos & (MESSQUEUESIZE-1)];
+        diff = MESSQUEUE_DIFF(atomic_int_load(&slot->s_seq), pos);
+        if (diff == 0)
+        {
+                /* on failure this reloads 'pos' for us */
+            if (atomic_int_compare_exchange(&inter->i_messring_head,
+                &pos, MESSQUEUE_ADD(pos, 1)))
+                    break;
+        }
+        else if (diff < 0)
+            return (0);     /* full */
+        else pos = atomic_int_load(&inter->i_messring_head);
+    }
+    slot->s_obj = obj;
+    slot->s_data = data;
+    slot->s_fn = fn;
+    atomic_int_store(&slot->s_seq, MESSQUEUE_ADD(pos, 1));
+        /* keep track of the high water mark */
+    n = MESSQUEUE_DIFF(MESSQUEUE_ADD(pos, 1),
+        atomic_int_load(&inter->i_messring_tail));
+    hiwater = atomic_int_load(&inter->i_messqueue_hiwater);
+    while (n > hiwater && !atomic_int_compare_exchange(
+        &inter->i_messqueue_hiwater, &hiwater, n))
+            ;
+    return (1);
+}
+
 void pd_queue_mess(struct _pdinstance *instance, t_pd *obj, void *data, t_messfn fn)
 {
     t_instanceinter *inter = instance->pd_inter;
-    t_messqueue *m = (t_messqueue *)getbytes(sizeof(*m));
-    m->m_obj = obj;
+    t_messqueue *m;
+    if (!atomic_int_load(&inter->i_messqueue_spilling) &&
+        messqueue_push(inter, obj, data, fn))
+            return;
+    m = (t_messqueue *)getbytes(sizeof(*m));
     m->m_data = data;
     m->m_fn = fn;
+    if (atomic_int_load(&inter->i_messqueue_policy) == MESSQUEUE_DROP)
+    {
+            /* fn still has to free the data, but in Pd's thread */
+        m->m_obj = NULL;
+        pthread_mutex_lock(&inter->i_messqueue_mutex);
+        m->m_next = inter->i_messqueue_dropped;
+        inter->i_messqueue_dropped = m;
+        atomic_int_store(&inter->i_messqueue_havedropped, 1);
+        pthread_mutex_unlock(&inter->i_messqueue_mutex);
+        atomic_int_fetch_add(&inter->i_messqueue_ndropped, 1);
+        return;
+    }
+    m->m_obj = obj;
     m->m_next = 0;
     pthread_mutex_lock(&inter->i_messqueue_mutex);
+    atomic_int_store(&inter->i_messqueue_spilling, 1);
     if (inter->i_messqueue_tail) /* add to tail */
         inter->i_messqueue_tail = (inter->i_messqueue_tail->m_next = m);
     else /* empty queue */
         inter->i_messqueue_head = inter->i_messqueue_tail = m;
     pthread_mutex_unlock(&inter->i_messqueue_mutex);
+    atomic_int_fetch_add(&inter->i_messqueue_nspilled, 1);
+}
+
+static void messqueue_relax(void)
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
 }
 
+    /* called from Pd's thread when an object is freed */
 void pd_queue_cancel(t_pd *obj)
 {
     t_messqueue *m;
+    int pos, head = atomic_int_load(&INTER->i_messring_head);
+    for (pos = atomic_int_load(&INTER->i_messring_tail); pos != head;
+        pos = MESSQUEUE_ADD(pos, 1))
+    {
+        t_messslot *slot = &INTER->i_messring[pos & (MESSQUEUESIZE-1)];
+            /* a producer may have claimed the slot but not yet filled it.
+            That only takes it a few instructions, but it might have been
+            preempted in between, so let it run. */
+        while (atomic_int_load(&slot->s_seq) != MESSQUEUE_ADD(pos, 1))
+            messqueue_relax();
+        if (slot->s_obj == obj)
+            slot->s_obj = NULL; /* mark as canceled */
+    }
     pthread_mutex_lock(&INTER->i_messqueue_mutex);
     for (m = INTER->i_messqueue_head; m; m = m->m_next)
     {
@@ -2083,18 +2240,63 @@ void pd_queue_cancel(t_pd *obj)
 
 void messqueue_dispatch(void)
 {
-    t_messqueue *m, *next;
-        /* first unlink all messages */
-    pthread_mutex_lock(&INTER->i_messqueue_mutex);
-    m = INTER->i_messqueue_head;
-    INTER->i_messqueue_head = INTER->i_messqueue_tail = NULL;
-    pthread_mutex_unlock(&INTER->i_messqueue_mutex);
-        /* then dispatch (without lock!) */
-    while (m)
+    t_messqueue *m = NULL, *dropped = NULL, *next;
+    int tail = atomic_int_load(&INTER->i_messring_tail),
+        head = atomic_int_load(&INTER->i_messring_head);
+        /* only dispatch what was there when we started, so that messages
+        queued by the messages themselves wait until the next tick */
+    while (tail != head)
     {
-            /* NB: if the message has been canceled, m_obj is NULL;
-            we still need to call m_fn because it is responsible
+        t_messslot *slot = &INTER->i_messring[tail & (MESSQUEUESIZE-1)];
+        t_pd *obj;
+        void *data;
+        t_messfn fn;
+        if (atomic_int_load(&slot->s_seq) != MESSQUEUE_ADD(tail, 1))
+            break;  /* still being written; get it next time */
+        obj = slot->s_obj;
+        data = slot->s_data;
+        fn = slot->s_fn;
+            /* give the slot back before calling, in case the message
+            queues or cancels others */
+        atomic_int_store(&slot->s_seq, MESSQUEUE_ADD(tail, MESSQUEUESIZE));
+        tail = MESSQUEUE_ADD(tail, 1);
+        atomic_int_store(&INTER->i_messring_tail, tail);
+            /* NB: if the message has been canceled, obj is NULL;
+            we still need to call fn because it is responsible
             for freeing the data! */
+        fn(obj, data);
+    }
+        /* take the spilled messages only once the ring is empty, and never
+        wait for the lock */
+    if (atomic_int_load(&INTER->i_messqueue_spilling) &&
+        !pthread_mutex_trylock(&INTER->i_messqueue_mutex))
+    {
+        if (atomic_int_load(&INTER->i_messring_head) ==
+            atomic_int_load(&INTER->i_messring_tail))
+        {
+            m = INTER->i_messqueue_head;
+            INTER->i_messqueue_head = INTER->i_messqueue_tail = NULL;
+            atomic_int_store(&INTER->i_messqueue_spilling, 0);
+        }
+        pthread_mutex_unlock(&INTER->i_messqueue_mutex);
+    }
+    if (atomic_int_load(&INTER->i_messqueue_havedropped) &&
+        !pthread_mutex_trylock(&INTER->i_messqueue_mutex))
+    {
+        dropped = INTER->i_messqueue_dropped;
+        INTER->i_messqueue_dropped = NULL;
+        atomic_int_store(&INTER->i_messqueue_havedropped, 0);
+        pthread_mutex_unlock(&INTER->i_messqueue_mutex);
+    }
+    while (dropped)
+    {
+        next = dropped->m_next;
+        dropped->m_fn(NULL, dropped->m_data);
+        freebytes(dropped, sizeof(*dropped));
+        dropped = next;
+    }
+    while (m)
+    {
         next = m->m_next;
         m->m_fn(m->m_obj, m->m_data);
         freebytes(m, sizeof(*m));
@@ -2102,6 +2304,29 @@ void messqueue_dispatch(void)
     }
 }
 
+    /* "pd messqueue-stats" */
+void glob_messqueuestats(void *dummy)
+{
+    post("message queue: %d slots, high water %d, %d spilled, %d dropped, "
+        "overflow policy '%s'", MESSQUEUESIZE,
+        atomic_int_load(&INTER->i_messqueue_hiwater),
+        atomic_int_load(&INTER->i_messqueue_nspilled),
+        atomic_int_load(&INTER->i_messqueue_ndropped),
+        (atomic_int_load(&INTER->i_messqueue_policy) == MESSQUEUE_DROP ?
+            "drop" : "spill"));
+}
+
+    /* "pd messqueue-policy spill|drop" */
+void glob_messqueuepolicy(void *dummy, t_symbol *s)
+{
+    if (s == gensym("spill"))
+        atomic_int_store(&INTER->i_messqueue_policy, MESSQUEUE_SPILL);
+    else if (s == gensym("drop"))
+        atomic_int_store(&INTER->i_messqueue_policy, MESSQUEUE_DROP);
+    else pd_error(0, "messqueue-policy: %s: expected 'spill' or 'drop'",
+        s->s_name);
+}
+
 void pdgui_lock(void)
 {
     pthread_mutex_lock(&INTER->i_guimutex);
@@ -2142,6 +2367,13 @@ void pd_queue_cancel(t_pd *obj) {}
 
 void messqueue_dispatch(void) {}
 
+void glob_messqueuestats(void *dummy)
+{
+    post("message queue: not compiled with thread support");
+}
+
+void glob_messqueuepolicy(void *dummy, t_symbol *s) {}
+
 void pdgui_lock(void) {}
 void pdgui_unlock(void) {}
 
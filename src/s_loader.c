@@ -397,7 +397,7 @@ static int sys_do_load_lib(t_canvas *canvas, const char *objectname,
         /* try looking in the path for (objectname).(sys_dllextent) ... */
     for(dllextent=sys_get_dllextensions(); *dllextent; dllextent++)
     {
-        if ((fd = sys_trytoopenit(path, objectname, *dllextent,
+        if ((fd = sys_trytoopenclass(path, objectname, *dllextent,
             dirbuf, &nameptr, MAXPDSTRING, 1, 1)) >= 0)
             if(sys_do_load_lib_from_file(fd, objectname, dirbuf, nameptr, symname))
                 return 1;
@@ -410,7 +410,7 @@ static int sys_do_load_lib(t_canvas *canvas, const char *objectname,
     filename[MAXPDSTRING-1] = 0;
     for(dllextent=sys_get_dllextensions(); *dllextent; dllextent++)
     {
-        if ((fd = sys_trytoopenit(path, filename, *dllextent,
+        if ((fd = sys_trytoopenclass(path, filename, *dllextent,
             dirbuf, &nameptr, MAXPDSTRING, 1, 1)) >= 0)
             if(sys_do_load_lib_from_file(fd, objectname, dirbuf, nameptr, symname))
                 return 1;
@@ -423,7 +423,7 @@ static int sys_do_load_lib(t_canvas *canvas, const char *objectname,
     if (libname[len-1] == '~' && len < MAXPDSTRING - 6) {
         strcpy(libname+len-1, "_tilde");
     }
-    if ((fd = sys_trytoopenit(path, libname, ".so",
+    if ((fd = sys_trytoopenclass(path, libname, ".so",
         dirbuf, &nameptr, MAXPDSTRING, 1, 1)) >= 0)
             if(sys_do_load_lib_from_file(fd, objectname, dirbuf, nameptr, symname))
                 return 1;
@@ -626,11 +626,11 @@ static t_pd *do_create_abstraction(t_symbol*s, int argc, t_atom *argv)
 
         t_pd *was = s__X.s_thing;
         pd_snprintf(classslashclass, MAXPDSTRING, "%s/%s", objectname, objectname);
-        if ((fd = canvas_open(canvas, objectname, ".pd",
+        if ((fd = canvas_open_class(canvas, objectname, ".pd",
                   dirbuf, &nameptr, MAXPDSTRING, 0)) >= 0 ||
-            (fd = canvas_open(canvas, objectname, ".pat",
+            (fd = canvas_open_class(canvas, objectname, ".pat",
                   dirbuf, &nameptr, MAXPDSTRING, 0)) >= 0 ||
-            (fd = canvas_open(canvas, classslashclass, ".pd",
+            (fd = canvas_open_class(canvas, classslashclass, ".pd",
                   dirbuf, &nameptr, MAXPDSTRING, 0)) >= 0)
         {
             close(fd);
@@ -662,11 +662,11 @@ static int sys_do_load_abs(t_canvas *canvas, const char *objectname,
     if (!path) return (0);
 
     pd_snprintf(classslashclass, MAXPDSTRING, "%s/%s", objectname, objectname);
-    if ((fd = sys_trytoopenit(path, objectname, ".pd",
+    if ((fd = sys_trytoopenclass(path, objectname, ".pd",
               dirbuf, &nameptr, MAXPDSTRING, 1, 1)) >= 0 ||
-        (fd = sys_trytoopenit(path, objectname, ".pat",
+        (fd = sys_trytoopenclass(path, objectname, ".pat",
               dirbuf, &nameptr, MAXPDSTRING, 1, 1)) >= 0 ||
-        (fd = sys_trytoopenit(path, classslashclass, ".pd",
+        (fd = sys_trytoopenclass(path, classslashclass, ".pd",
               dirbuf, &nameptr, MAXPDSTRING, 1, 1)) >= 0)
     {
         t_class*c=0;
@@ -54,7 +54,9 @@ void sys_addhelppath(char *p);
 void alsa_adddev(const char *name);
 #endif
 int sys_oktoloadfiles(int done);
+void glob_patchcachedir(void *dummy, t_symbol *s);
 void sys_doneglobinit( void);
+void glob_dspthreads(void *dummy, t_floatarg f);
 char sys_devicename[MAXPDSTRING] = "Pure Data";
 
 int sys_debuglevel;
@@ -592,6 +594,7 @@ static char *(usagemessage[]) = {
 #endif
 "-sleep           -- sleep when idle, don't spin (true by default)\n",
 "-nosleep         -- spin, don't sleep (may lower latency on multi-CPUs)\n",
+"-dspthreads <n>  -- run the DSP chain on n threads (0 or 1 for none)\n",
 "-schedlib <file> -- plug in external scheduler (omit file extensions)\n",
 "-extraflags <s>  -- string argument to send schedlib\n",
 "-batch           -- run off-line as a batch process\n",
@@ -599,6 +602,9 @@ static char *(usagemessage[]) = {
 "-autopatch       -- enable auto-patching to new objects (true by default)\n",
 "-noautopatch     -- defeat auto-patching\n",
 "-compatibility <f> -- set back-compatibility to version <f>\n",
+"-patchcache <dir> -- save parsed patches in <dir> to load them faster\n",
+"-pathcache       -- index directories on the search path (true by default)\n",
+"-nopathcache     -- try to open every file the slow way\n",
 };
 
 static void sys_printusage(void)
@@ -1414,6 +1420,24 @@ int sys_argparse(int argc, const char **argv)
             argv += 2;
             argc -= 2;
         }
+        else if (!strcmp(*argv, "-pathcache"))
+        {
+            sys_usepathcache = 1;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-nopathcache"))
+        {
+            sys_usepathcache = 0;
+            argc--; argv++;
+        }
+        else if (!strcmp(*argv, "-patchcache"))
+        {
+            if (argc < 2)
+                goto usage;
+            glob_patchcachedir(0, gensym(argv[1]));
+            argv += 2;
+            argc -= 2;
+        }
 #ifdef HAVE_UNISTD_H
         else if (!strcmp(*argv, "-rt") || !strcmp(*argv, "-realtime"))
         {
@@ -1444,6 +1468,13 @@ int sys_argparse(int argc, const char **argv)
             sys_nosleep = 1;
             argc--; argv++;
         }
+        else if (!strcmp(*argv, "-dspthreads"))
+        {
+            if (argc < 2)
+                goto usage;
+            glob_dspthreads(0, atoi(argv[1]));
+            argc -= 2; argv += 2;
+        }
         else if (!strcmp(*argv, "-noprefs")) /* did this earlier */
             argc--, argv++;
         else if (!strcmp(*argv, "-prefs")) /* did this earlier */
@@ -1631,6 +1662,7 @@ void glob_path_dialog(t_pd *dummy, t_symbol *s, int argc, t_atom *argv)
     STUFF->st_searchpath = 0;
     sys_usestdpath = atom_getfloatarg(0, argc, argv);
     sys_verbose = atom_getfloatarg(1, argc, argv);
+    sys_pathcache_clear();
     for (i = 0; i < argc-2; i++)
     {
         t_symbol *s = sys_decodedialog(atom_getsymbolarg(i+2, argc, argv));
@@ -1655,6 +1687,7 @@ void glob_addtopath(t_pd *dummy, t_symbol *path, t_float saveit)
         else
             STUFF->st_searchpath =
                 namelist_append_files(STUFF->st_searchpath, s->s_name);
+        sys_pathcache_clear();
         if (saveit > 0)
             sys_savepreferences(0);
     }
@@ -21,6 +21,9 @@
 #ifdef _WIN32
 #include <io.h>
 #include <windows.h>
+#else
+#include <dirent.h>
+#include <time.h>
 #endif
 
 #include <string.h>
@@ -30,6 +33,7 @@
 #include "s_utf8.h"
 #include <stdio.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #ifdef _LARGEFILE64_SOURCE
 # define open  open64
@@ -255,19 +259,351 @@ void sys_setextrapath(const char *p)
     STUFF->st_staticpath = namelist_append(STUFF->st_staticpath, p, 0);
 }
 
+/* ---------------- directory index for path searches ------------------ */
+
+/* Looking for an object that isn't built in means trying every directory on
+the search path with every extension the loaders know about, and each try
+is an open() that nearly always fails.  On slow (e.g., network) file systems
+that adds up to seconds per patch.  So the first time we look in a
+directory we read its contents into a hash table; after that, a name that
+isn't in the table fails without touching the file system, and only names
+that are in it get opened for real.
+
+Only the lookups for classes (externals and abstractions, through
+sys_trytoopenclass() and canvas_open_class()) use the table.  Other files
+are opened for real every time, since a patch may well be waiting for some
+other program to make them, and they may be opened from other threads;
+the table belongs to the Pd instance and only its own thread touches it.
+
+The table can only ever say "maybe": a file it lists is still opened, so a
+stale entry costs no more than the failed open it used to.  Missing entries
+are what we have to avoid.  When Pd creates a file itself, from whatever
+thread, sys_pathcache_touch() bumps a counter, after which every directory
+gets looked at again before it's next used; otherwise we look at a
+directory's modification time again when it's been more than
+PATHCACHE_RECHECK seconds since the last look, and reread the directory if
+it has changed or was changed so recently that a second change might not
+show.  Names with non-ASCII characters (which some file systems normalize)
+bypass the table, and on the Mac, whose file systems usually ignore case, so
+do we.  Changing the search path empties the whole cache.  Not on Windows
+for now. */
+
+#ifndef _WIN32
+#define PATHCACHE
+#endif
+
+#define PATHCACHE_RECHECK 1.        /* seconds */
+#define PATHCACHE_NDIRHASH 64
+
+typedef struct _dirindex
+{
+    char *di_dir;               /* directory name as given to opendir() */
+    int di_exists;              /* zero if we couldn't read it */
+    time_t di_mtime;            /* modification time when we read it */
+    time_t di_readtime;         /* when we read it */
+    double di_checktime;        /* when we last checked di_mtime */
+    int di_nnames;
+    int di_tabsize;             /* power of 2, at least twice di_nnames */
+    int *di_tab;                /* offsets into di_names+1, or 0 if empty */
+    char *di_names;             /* all the names, null terminated */
+    int di_namesize;
+    int di_namesalloc;
+    struct _dirindex *di_next;
+} t_dirindex;
+
+struct _pathcache
+{
+    t_dirindex *pc_dirs[PATHCACHE_NDIRHASH];
+    int pc_touched;             /* pathcache_touched when we last looked */
+    int pc_ntry;                /* class lookups */
+    int pc_nopen;               /* of which we actually tried to open */
+    int pc_nskip;               /* ...and these we knew would fail */
+    int pc_nread;               /* directories read */
+    int pc_nstat;               /* directories checked */
+};
+
+int sys_usepathcache = 1;
+static atomic_int pathcache_touched;    /* bumped for every file Pd makes */
+
+static t_pathcache *pathcache_get(void)
+{
+    if (!STUFF->st_pathcache)
+    {
+        STUFF->st_pathcache = (t_pathcache *)getbytes(
+            sizeof(*STUFF->st_pathcache));
+        memset(STUFF->st_pathcache, 0, sizeof(*STUFF->st_pathcache));
+    }
+    return (STUFF->st_pathcache);
+}
+
+static unsigned int pathcache_hash(const char *s, size_t n)
+{
+    unsigned int hash = 5381;
+    const char *e = s + n;
+    while (s != e)
+    {
+        int c = *s++;
+#ifdef __APPLE__
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+#endif
+        hash = ((hash << 5) + hash) + c;
+    }
+    return (hash);
+}
+
+static int pathcache_same(const char *s1, const char *s2, size_t n)
+{
+#ifdef __APPLE__
+    return (!strncasecmp(s1, s2, n) && !s1[n]);
+#else
+    return (!strncmp(s1, s2, n) && !s1[n]);
+#endif
+}
+
+#ifdef PATHCACHE
+static void dirindex_clear(t_dirindex *x)
+{
+    if (x->di_tab)
+        freebytes(x->di_tab, x->di_tabsize * sizeof(*x->di_tab));
+    if (x->di_names)
+        freebytes(x->di_names, x->di_namesalloc);
+    x->di_tab = 0;
+    x->di_names = 0;
+    x->di_nnames = x->di_tabsize = x->di_namesize = x->di_namesalloc = 0;
+}
+
+static void dirindex_free(t_dirindex *x)
+{
+    dirindex_clear(x);
+    freebytes(x->di_dir, strlen(x->di_dir) + 1);
+    freebytes(x, sizeof(*x));
+}
+
+static void dirindex_insert(t_dirindex *x, int offset)
+{
+    const char *name = x->di_names + offset;
+    unsigned int i = pathcache_hash(name, strlen(name)) & (x->di_tabsize - 1);
+    while (x->di_tab[i])
+        i = (i + 1) & (x->di_tabsize - 1);
+    x->di_tab[i] = offset + 1;
+}
+
+static void dirindex_add(t_dirindex *x, const char *name)
+{
+    int length = (int)strlen(name) + 1, i;
+    if (x->di_namesize + length > x->di_namesalloc)
+    {
+        int newsize = 2 * x->di_namesalloc + length + 256;
+        x->di_names = (char *)resizebytes(x->di_names, x->di_namesalloc,
+            newsize);
+        x->di_namesalloc = newsize;
+    }
+    memcpy(x->di_names + x->di_namesize, name, length);
+    if (2 * (x->di_nnames + 1) > x->di_tabsize)
+    {
+        int *oldtab = x->di_tab, oldsize = x->di_tabsize;
+        x->di_tabsize = (oldsize ? 2 * oldsize : 64);
+        x->di_tab = (int *)getbytes(x->di_tabsize * sizeof(*x->di_tab));
+        for (i = 0; i < oldsize; i++)
+            if (oldtab[i])
+                dirindex_insert(x, oldtab[i] - 1);
+        if (oldtab)
+            freebytes(oldtab, oldsize * sizeof(*oldtab));
+    }
+    dirindex_insert(x, x->di_namesize);
+    x->di_namesize += length;
+    x->di_nnames++;
+}
+
+static void dirindex_read(t_pathcache *pc, t_dirindex *x)
+{
+    DIR *dir;
+    struct dirent *ent;
+    struct stat statbuf;
+    dirindex_clear(x);
+    pc->pc_nread++;
+    x->di_exists = 0;
+    x->di_checktime = sys_getrealtime();
+    x->di_readtime = time(0);
+        /* get the time first so that changes while we read show up */
+    x->di_mtime = (stat(x->di_dir, &statbuf) >= 0 ? statbuf.st_mtime : 0);
+    if (!(dir = opendir(x->di_dir)))
+        return;
+    x->di_exists = 1;
+    while ((ent = readdir(dir)))
+        dirindex_add(x, ent->d_name);
+    closedir(dir);
+}
+
+    /* make sure the index is reasonably current */
+static void dirindex_check(t_pathcache *pc, t_dirindex *x)
+{
+    struct stat statbuf;
+    double now = sys_getrealtime();
+    time_t mtime;
+    if (now - x->di_checktime < PATHCACHE_RECHECK)
+        return;
+    pc->pc_nstat++;
+    x->di_checktime = now;
+    mtime = (stat(x->di_dir, &statbuf) >= 0 ? statbuf.st_mtime : 0);
+    if (mtime != x->di_mtime || mtime >= x->di_readtime - 1 ||
+        (mtime != 0) != (x->di_exists != 0))
+            dirindex_read(pc, x);
+}
+
+static t_dirindex *pathcache_getdir(t_pathcache *pc, const char *dirname)
+{
+    size_t length = strlen(dirname);
+    t_dirindex **dp = &pc->pc_dirs[pathcache_hash(dirname, length) %
+        PATHCACHE_NDIRHASH], *x;
+    for (x = *dp; x; x = x->di_next)
+        if (!strcmp(x->di_dir, dirname))
+    {
+        dirindex_check(pc, x);
+        return (x);
+    }
+    x = (t_dirindex *)getbytes(sizeof(*x));
+    x->di_dir = (char *)getbytes(length + 1);
+    strcpy(x->di_dir, dirname);
+    x->di_next = *dp;
+    *dp = x;
+    dirindex_read(pc, x);
+    return (x);
+}
+
+    /* check whether "dir" might have "name""ext" in it.  Name can have
+    slashes, in which case we only look for what's before the first one. */
+static int pathcache_mayexist(t_pathcache *pc, const char *dirname,
+    const char *name, const char *ext)
+{
+    char buf[MAXPDSTRING];
+    const char *slash, *s;
+    size_t n;
+    unsigned int i;
+    int touched;
+    t_dirindex *x;
+    if (!*dirname)
+        return (1);
+        /* if Pd has made any files since we last looked, look again */
+    if ((touched = atomic_int_load(&pathcache_touched)) != pc->pc_touched)
+    {
+        pc->pc_touched = touched;
+        for (i = 0; i < PATHCACHE_NDIRHASH; i++)
+            for (x = pc->pc_dirs[i]; x; x = x->di_next)
+                x->di_checktime = -PATHCACHE_RECHECK;
+    }
+    if ((slash = strchr(name, '/')))
+        n = slash - name;
+    else if (strlen(name) + strlen(ext) < MAXPDSTRING)
+    {
+        strcpy(buf, name);
+        strcat(buf, ext);
+        name = buf;
+        n = strlen(buf);
+    }
+    else return (1);
+    for (s = name; s < name + n; s++)
+        if (*s & 0x80)
+            return (1);
+    x = pathcache_getdir(pc, dirname);
+    if (!x->di_exists || !x->di_tabsize)
+        return (0);
+    for (i = pathcache_hash(name, n) & (x->di_tabsize - 1); x->di_tab[i];
+        i = (i + 1) & (x->di_tabsize - 1))
+            if (pathcache_same(x->di_names + x->di_tab[i] - 1, name, n))
+                return (1);
+    return (0);
+}
+#endif /* PATHCACHE */
+
+    /* called when Pd creates or renames a file, so that directories get
+    looked at again before they're next used.  This can be called from any
+    thread, so all we do is bump a counter. */
+void sys_pathcache_touch(const char *filename)
+{
+#ifdef PATHCACHE
+    atomic_int_fetch_add(&pathcache_touched, 1);
+#endif
+}
+
+    /* forget everything, e.g., when the search path changes */
+void sys_pathcache_clear(void)
+{
+#ifdef PATHCACHE
+    t_pathcache *pc;
+    int i;
+    if (!(pc = STUFF->st_pathcache))
+        return;
+    for (i = 0; i < PATHCACHE_NDIRHASH; i++)
+    {
+        t_dirindex *x, *next;
+        for (x = pc->pc_dirs[i]; x; x = next)
+        {
+            next = x->di_next;
+            dirindex_free(x);
+        }
+        pc->pc_dirs[i] = 0;
+    }
+#endif
+}
+
+    /* called when the Pd instance is freed */
+void sys_pathcache_free(void)
+{
+    if (STUFF->st_pathcache)
+    {
+        sys_pathcache_clear();
+        freebytes(STUFF->st_pathcache, sizeof(*STUFF->st_pathcache));
+        STUFF->st_pathcache = 0;
+    }
+}
+
+    /* "pd path-cache-stats" */
+void glob_pathcachestats(void *dummy)
+{
+    t_pathcache *pc = pathcache_get();
+    int ndirs = 0, nnames = 0;
+#ifdef PATHCACHE
+    int i;
+    for (i = 0; i < PATHCACHE_NDIRHASH; i++)
+    {
+        t_dirindex *x;
+        for (x = pc->pc_dirs[i]; x; x = x->di_next)
+            ndirs++, nnames += x->di_nnames;
+    }
+#endif
+    post("class search: %d tries, %d opened, %d known to fail",
+        pc->pc_ntry, pc->pc_nopen, pc->pc_nskip);
+    post("... %d directories indexed (%d names), %d reads, %d checks%s",
+        ndirs, nnames, pc->pc_nread, pc->pc_nstat,
+            (sys_usepathcache ? "" : " (cache off)"));
+}
+
+    /* "pd path-cache-clear": also zeroes the counters */
+void glob_pathcacheclear(void *dummy)
+{
+    t_pathcache *pc = pathcache_get();
+    sys_pathcache_clear();
+    pc->pc_ntry = pc->pc_nopen = pc->pc_nskip = pc->pc_nread =
+        pc->pc_nstat = 0;
+}
+
     /* try to open a file in the directory "dir", named "name""ext",
     for reading.  "Name" may have slashes.  The directory is copied to
     "dirresult" which must be at least "size" bytes.  "nameresult" is set
     to point to the filename (copied elsewhere into the same buffer).
     The "bin" flag requests opening for binary (which only makes a difference
-    on Windows). */
+    on Windows).  If "isclass" is set we're looking for a class and may
+    consult the directory index. */
 
-int sys_trytoopenit(const char *dir, const char *name, const char* ext,
+static int sys_dotrytoopen(const char *dir, const char *name, const char* ext,
     char *dirresult, char **nameresult, unsigned int size, int bin,
-    int okgui)
+    int okgui, int isclass)
 {
     int fd;
     char buf[MAXPDSTRING];
+    t_pathcache *pc;
     if (strlen(dir) + strlen(name) + strlen(ext) + 4 > size)
         return (-1);
     sys_expandpath(dir, buf, MAXPDSTRING);
@@ -277,6 +613,22 @@ int sys_trytoopenit(const char *dir, const char *name, const char* ext,
     strcat(dirresult, name);
     strcat(dirresult, ext);
 
+    if (isclass)
+    {
+        pc = pathcache_get();
+        pc->pc_ntry++;
+#ifdef PATHCACHE
+        if (sys_usepathcache && !pathcache_mayexist(pc, buf, name, ext))
+        {
+            pc->pc_nskip++;
+            if (okgui)
+                logpost(NULL, PD_VERBOSE, "tried %s and failed", dirresult);
+            errno = ENOENT;
+            return (-1);
+        }
+#endif
+        pc->pc_nopen++;
+    }
     DEBUG(post("looking for %s",dirresult));
         /* see if we can open the file for reading */
     if ((fd=sys_open(dirresult, O_RDONLY)) >= 0)
@@ -320,6 +672,23 @@ int sys_trytoopenit(const char *dir, const char *name, const char* ext,
     return (-1);
 }
 
+int sys_trytoopenit(const char *dir, const char *name, const char* ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin,
+    int okgui)
+{
+    return (sys_dotrytoopen(dir, name, ext, dirresult, nameresult, size, bin,
+        okgui, 0));
+}
+
+    /* the same, looking for an external or abstraction */
+int sys_trytoopenclass(const char *dir, const char *name, const char* ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin,
+    int okgui)
+{
+    return (sys_dotrytoopen(dir, name, ext, dirresult, nameresult, size, bin,
+        okgui, 1));
+}
+
     /* keep this in the Pd app for binary compatibility
     with existing loaders such as pdlua. */
 EXTERN int sys_trytoopenone(const char *dir, const char *name, const char* ext,
@@ -476,6 +845,7 @@ int sys_open(const char *path, int oflag, ...)
         mode = (mode_t)imode;
         va_end(ap);
         fd = open(pathbuf, oflag, mode);
+        sys_pathcache_touch(pathbuf);
     }
     else
         fd = open(pathbuf, oflag);
@@ -485,8 +855,12 @@ int sys_open(const char *path, int oflag, ...)
 FILE *sys_fopen(const char *filename, const char *mode)
 {
   char namebuf[MAXPDSTRING];
+  FILE *f;
   sys_bashfilename(filename, namebuf);
-  return fopen(namebuf, mode);
+  f = fopen(namebuf, mode);
+  if (strpbrk(mode, "wa"))
+      sys_pathcache_touch(namebuf);
+  return f;
 }
 #endif /* _WIN32 */
 
@@ -28,11 +28,18 @@ int do_open_via_path(const char *dir, const char *name,
 
 void sys_setextrapath(const char *p);
 extern int sys_usestdpath;
+extern int sys_usepathcache;
+typedef struct _pathcache t_pathcache;
+void sys_pathcache_touch(const char *filename);
+void sys_pathcache_clear(void);
+void sys_pathcache_free(void);
 int sys_open_absolute(const char *name, const char* ext,
     char *dirresult, char **nameresult, unsigned int size, int bin, int *fdp,
     int okgui);
 int sys_trytoopenit(const char *dir, const char *name, const char* ext,
     char *dirresult, char **nameresult, unsigned int size, int bin, int okgui);
+int sys_trytoopenclass(const char *dir, const char *name, const char* ext,
+    char *dirresult, char **nameresult, unsigned int size, int bin, int okgui);
 t_symbol *sys_decodedialog(t_symbol *s);
 
 /* s_file.c */
@@ -323,6 +330,29 @@ void sys_alsa_do_open_midi(int nmidiindev, int *midiindev,
     int nmidioutdev, int *midioutdev);
 #endif
 
+/* m_class.c */
+t_symbol *gensymn(const char *s, size_t length);
+
+/* m_binbuf.c */
+typedef struct _patchcache t_patchcache;
+void patchcache_free(void);
+
+/* m_memory.c */
+typedef struct _mempool t_mempool;
+t_mempool *mempool_new(void);
+void mempool_retire(t_mempool *x);
+size_t mempool_nalloc(void);
+
+/* d_ugen.c: DSP time per class, from the DSP profiler */
+typedef struct _profclass
+{
+    t_symbol *pc_class;
+    double pc_nsec;             /* nsec per DSP tick */
+    double pc_calls;            /* perform routine calls per DSP tick */
+    int pc_nobjects;
+} t_profclass;
+int dspprofile_getclasses(t_profclass *vec, int max);
+
 /* m_sched.c */
 EXTERN void sys_log_error(int type);
 #define ERR_NOTHING 0
@@ -436,6 +466,13 @@ struct _instancestuff
     double st_time_per_dsp_tick;    /* obsolete - included for GEM?? */
     t_printhook st_printhook;   /* set this to override per-instance printing */
     void *st_impdata; /* optional implementation-specific data for libpd, etc */
+    t_clock **st_clockheap;     /* set clocks as a binary heap (m_sched.c) */
+    int st_nclocks;             /* number of clocks in the heap */
+    int st_clockheapsize;       /* allocated size of the heap */
+    uint64_t st_clockseq;       /* order in which clocks were set */
+    struct _mempool *st_mempool;    /* small block allocator (m_memory.c) */
+    struct _patchcache *st_patchcache;  /* parsed patch files (m_binbuf.c) */
+    struct _pathcache *st_pathcache;    /* directory index (s_path.c) */
 };
 
 #define STUFF (pd_this->pd_stuff)
@@ -0,0 +1,102 @@
+/* Copyright (c) 2024 Miller Puckette and others.
+* For information on usage and redistribution, and for a DISCLAIMER OF ALL
+* WARRANTIES, see the file, "LICENSE.txt," in this distribution.  */
+
+/* pd-bench: Pd's own main() in batch mode, running "pd bench" (s_bench.c)
+on the reference patches or on patches given on the command line, and
+writing the results as JSON.  Build it with "make pd-bench".
+
+usage: pd-bench [-r <samplerate>] [-threads <n>] [-nofuse] [-ticks <n>]
+    [-warmup <n>] [-runs <n>] [-noprofile] [-o <file>] [patch ...]
+
+Patches are either names of the reference patches (osc, filter, fft, delay,
+expr, clone, control) or file names ending in ".pd". */
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef PD_BENCHDIR
+#define PD_BENCHDIR "."
+#endif
+
+#define MAXARGS 64
+#define MAXMESS 4096
+
+int sys_main(int argc, const char **argv);
+
+    /* add a word to the message, escaping anything binbuf_text() would
+    take for a separator */
+static void pdbench_addword(char *mess, const char *word)
+{
+    size_t n = strlen(mess);
+    if (n && n < MAXMESS - 1)
+        mess[n++] = ' ';
+    for (; *word && n < MAXMESS - 2; word++)
+    {
+        if (strchr(" \t\n;,$\\", *word))
+            mess[n++] = '\\';
+        mess[n++] = *word;
+    }
+    mess[n] = 0;
+}
+
+static int pdbench_usage(void)
+{
+    fprintf(stderr, "usage: pd-bench [-r <samplerate>] [-threads <n>] "
+        "[-nofuse] [-ticks <n>]\n"
+        "    [-warmup <n>] [-runs <n>] [-noprofile] [-o <file>] "
+        "[patch ...]\n");
+    return (1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *pdargv[MAXARGS];
+    static char bench[MAXMESS], threads[64];
+    int pdargc = 0, i;
+    pdargv[pdargc++] = argv[0];
+    pdargv[pdargc++] = "-batch";
+    pdargv[pdargc++] = "-noprefs";
+    pdargv[pdargc++] = "-stderr";
+    strcpy(bench, "pd bench -exit -dir");
+    pdbench_addword(bench, PD_BENCHDIR);
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "-help"))
+            return (pdbench_usage());
+        else if (!strcmp(argv[i], "-r") && i < argc - 1)
+        {
+            pdargv[pdargc++] = "-r";
+            pdargv[pdargc++] = argv[++i];
+        }
+        else if (!strcmp(argv[i], "-threads") && i < argc - 1)
+        {
+            snprintf(threads, sizeof(threads), "pd dsp-threads %s",
+                argv[++i]);
+            pdargv[pdargc++] = "-send";
+            pdargv[pdargc++] = threads;
+        }
+        else if (!strcmp(argv[i], "-nofuse"))
+        {
+            pdargv[pdargc++] = "-send";
+            pdargv[pdargc++] = "pd dsp-fuse 0";
+        }
+        else if ((!strcmp(argv[i], "-ticks") || !strcmp(argv[i], "-warmup") ||
+            !strcmp(argv[i], "-runs") || !strcmp(argv[i], "-o")) &&
+                i < argc - 1)
+        {
+            pdbench_addword(bench, argv[i]);
+            pdbench_addword(bench, argv[++i]);
+        }
+        else if (!strcmp(argv[i], "-noprofile"))
+            pdbench_addword(bench, argv[i]);
+        else if (argv[i][0] == '-')
+            return (pdbench_usage());
+        else pdbench_addword(bench, argv[i]);
+        if (pdargc > MAXARGS - 4)
+            return (pdbench_usage());
+    }
+    pdargv[pdargc++] = "-send";
+    pdargv[pdargc++] = bench;
+    return (sys_main(pdargc, pdargv));
+}
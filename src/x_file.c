@@ -112,10 +112,14 @@ static int sys_stat(const char *pathname, struct stat *statbuf) {
 }
 
 static int sys_rename(const char *oldpath, const char *newpath) {
-    return rename(oldpath, newpath);
+    int result = rename(oldpath, newpath);
+    sys_pathcache_touch(newpath);
+    return result;
 }
 static int sys_mkdir(const char *pathname, mode_t mode) {
-    return mkdir(pathname, mode);
+    int result = mkdir(pathname, mode);
+    sys_pathcache_touch(pathname);
+    return result;
 }
 static int sys_remove(const char *pathname) {
     return remove(pathname);
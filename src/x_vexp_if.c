@@ -28,6 +28,8 @@
 
 #include "x_vexp.h"
 
+void class_setdspshared(t_class *c);   /* in m_class.c */
+
 static char *exp_version = "0.57";
 
 extern struct ex_ex *ex_eval(struct expr *expr, struct ex_ex *eptr,
@@ -879,6 +881,7 @@ expr_setup(void)
          */
         expr_tilde_class = class_new(gensym("expr~"), (t_newmethod)expr_new,
             (t_method)expr_ff, sizeof(t_expr), 0, A_GIMME, 0);
+        class_setdspshared(expr_tilde_class);
         class_addmethod(expr_tilde_class, nullfn, gensym("signal"), 0);
         CLASS_MAINSIGNALIN(expr_tilde_class, t_expr, exp_f);
         class_addmethod(expr_tilde_class,(t_method)expr_dsp, gensym("dsp"),
@@ -891,6 +894,7 @@ expr_setup(void)
          */
         fexpr_tilde_class = class_new(gensym("fexpr~"), (t_newmethod)expr_new,
             (t_method)expr_ff, sizeof(t_expr), 0, A_GIMME, 0);
+        class_setdspshared(fexpr_tilde_class);
         class_addmethod(fexpr_tilde_class, nullfn, gensym("signal"), 0);
         CLASS_MAINSIGNALIN(fexpr_tilde_class, t_expr, exp_f);
         class_addmethod(fexpr_tilde_class,(t_method)expr_start,